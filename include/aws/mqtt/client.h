@@ -32,6 +32,8 @@ struct aws_mqtt_client {
 };
 
 struct aws_mqtt_client_connection;
+struct aws_mqtt_topic_handle;
+struct aws_mqtt_prepared_publish;
 
 /**
  * Callback called when a request roundtrip is complete (QoS0 immediately, QoS1 on PUBACK, QoS2 on PUBCOMP). Either
@@ -118,6 +120,45 @@ typedef void(aws_mqtt_client_publish_received_fn)(
     bool retain,
     void *userdata);
 
+/**
+ * Called when a publish message that is streamed begins, once its topic has been received but before any of its
+ * payload. See aws_mqtt_client_connection_set_publish_stream_handler().
+ *
+ * \param[in] connection    The connection object
+ * \param[in] topic         The information channel to which the payload data was published.
+ * \param[in] payload_size  The total size of the payload that on_chunk will be called with.
+ * \param[in] dup           DUP flag. If true, this might be re-delivery of an earlier attempt to send the message.
+ * \param[in] qos           Quality of Service used to deliver the message.
+ * \param[in] retain        Retain flag. If true, the message was sent as a result of a new subscription being
+ *                          made by the client.
+ */
+typedef void(aws_mqtt_client_publish_stream_begin_fn)(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    size_t payload_size,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *userdata);
+
+/**
+ * Called with each piece of a streamed publish message's payload, in order, as it arrives.
+ * chunk is only valid for the duration of the call.
+ */
+typedef void(aws_mqtt_client_publish_stream_chunk_fn)(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *chunk,
+    void *userdata);
+
+/**
+ * Called when a streamed publish message ends. If error_code is AWS_ERROR_SUCCESS the whole payload was delivered,
+ * otherwise the connection was lost part way through the payload.
+ */
+typedef void(aws_mqtt_client_publish_stream_end_fn)(
+    struct aws_mqtt_client_connection *connection,
+    int error_code,
+    void *userdata);
+
 /** Called when a connection is closed, right before any resources are deleted */
 typedef void(aws_mqtt_client_on_disconnect_fn)(struct aws_mqtt_client_connection *connection, void *userdata);
 
@@ -177,6 +218,72 @@ struct aws_mqtt_topic_subscription {
     void *on_publish_ud;
 };
 
+/** A single PUBLISH passed to aws_mqtt_client_connection_publish_batch() */
+struct aws_mqtt_publish_batch_entry {
+    struct aws_byte_cursor topic;
+    enum aws_mqtt_qos qos;
+    bool retain;
+    struct aws_byte_cursor payload;
+
+    aws_mqtt_op_complete_fn *on_complete;
+    void *userdata;
+
+    /* (nullable) Registered topic to publish on instead of topic, see aws_mqtt_topic_handle_new() */
+    struct aws_mqtt_topic_handle *topic_handle;
+};
+
+/**
+ * Passed to aws_mqtt_client_connection_set_publish_stream_handler().
+ *
+ * min_payload_size          Publish messages with a payload of at least this many bytes are streamed
+ * on_begin                  Called once the topic of a streamed publish message has been received
+ * on_chunk                  Called with each piece of the payload as it arrives
+ * on_end                    Called once the payload is complete, or the connection was lost before it was
+ * user_data                 Passed to the userdata param of on_begin, on_chunk and on_end
+ */
+struct aws_mqtt_publish_stream_options {
+    size_t min_payload_size;
+    aws_mqtt_client_publish_stream_begin_fn *on_begin;
+    aws_mqtt_client_publish_stream_chunk_fn *on_chunk;
+    aws_mqtt_client_publish_stream_end_fn *on_end;
+    void *user_data;
+};
+
+/**
+ * Identifies a received QoS 1 or QoS 2 publish for aws_mqtt_client_connection_ack_publish(), while manual publish acks
+ * are on. A value of 0 identifies nothing to acknowledge, such as a QoS 0 publish.
+ */
+struct aws_mqtt_publish_ack_token {
+    uint64_t value;
+};
+
+/**
+ * A publish received by the connection, as passed to the on_any_publish_batch handler. The topic and payload point
+ * into the connection's read buffers and are only valid for the duration of the callback.
+ */
+struct aws_mqtt_publish_view {
+    struct aws_byte_cursor topic;
+    struct aws_byte_cursor payload;
+    bool dup;
+    enum aws_mqtt_qos qos;
+    bool retain;
+    /* Only set while manual publish acks are on, see aws_mqtt_client_connection_set_manual_publish_acks() */
+    struct aws_mqtt_publish_ack_token ack_token;
+};
+
+/**
+ * Called once per read with every publish that was received in it, in the order they were received.
+ *
+ * \param[in] connection        The connection object
+ * \param[in] publishes         The publishes received, valid for the duration of the callback only
+ * \param[in] publish_count     Number of publishes, never 0
+ */
+typedef void(aws_mqtt_client_publish_batch_received_fn)(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_publish_view *publishes,
+    size_t publish_count,
+    void *userdata);
+
 /**
  * host_name                 The server name to connect to. This resource may be freed immediately on return.
  * port                      The port on the server to connect to
@@ -388,6 +495,141 @@ int aws_mqtt_client_connection_set_on_any_publish_handler(
     aws_mqtt_client_publish_received_fn *on_any_publish,
     void *on_any_publish_ud);
 
+/**
+ * Sets the callback to call with ALL the publish packets received in one read at once, rather than one at a time like
+ * on_any_publish. Each batch is delivered after the publishes in it were passed to the subscription callbacks and
+ * on_any_publish. Streamed publish messages are not included. Only safe to set when connection is not connected.
+ *
+ * \param[in] connection                The connection object
+ * \param[in] on_any_publish_batch      The function to call with the publishes of a read (pass NULL to unset)
+ * \param[in] on_any_publish_batch_ud   Userdata for on_any_publish_batch
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_on_any_publish_batch_handler(
+    struct aws_mqtt_client_connection *connection,
+    aws_mqtt_client_publish_batch_received_fn *on_any_publish_batch,
+    void *on_any_publish_batch_ud);
+
+/**
+ * Streams large publish messages instead of buffering them whole: their payload is passed to options->on_chunk
+ * straight from each read, as it arrives, so the whole packet is never held in memory.
+ * Streamed publish messages are not delivered to subscription callbacks or to the on_any_publish handler, and are only
+ * acknowledged once their payload is complete. Only safe to set when connection is not connected.
+ *
+ * \param[in] connection    The connection object
+ * \param[in] options       The stream callbacks and the payload size from which to stream (pass NULL to unset).
+ *                          This is copied into the connection
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_publish_stream_handler(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_publish_stream_options *options);
+
+/**
+ * Sets the limits of the buffer that incoming packets split across several reads are reassembled in.
+ * Only safe to set when connection is not connected.
+ *
+ * \param[in] connection        The connection object
+ * \param[in] retain_size       The buffer keeps its capacity between packets up to this many bytes, so that
+ *                              reassembling packets no bigger than this doesn't allocate (256KiB by default)
+ * \param[in] max_packet_size   The largest incoming packet accepted, larger ones fail the connection with
+ *                              AWS_ERROR_MQTT_BUFFER_TOO_BIG (pass 0, the default, for no limit). Only the headers of
+ *                              a PUBLISH whose payload is streamed count, as its payload is never buffered
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_reassembly_limits(
+    struct aws_mqtt_client_connection *connection,
+    size_t retain_size,
+    size_t max_packet_size);
+
+/**
+ * Turns on flow control of incoming publishes, so that the server is slowed down by TCP back-pressure when the
+ * application can't keep up instead of publishes piling up in memory. The connection starts out reading at most
+ * initial_window_size bytes ahead. Afterwards, the bytes of every publish payload delivered to the application (whole
+ * or streamed) stay out of the read window until the application hands them back with
+ * aws_mqtt_client_connection_update_window(). Everything else re-opens the window on its own.
+ * Off by default, in which case reads are never held back. Only safe to set when connection is not connected.
+ *
+ * \param[in] connection                The connection object
+ * \param[in] manual_window_management  True to turn flow control on
+ * \param[in] initial_window_size       How many bytes may be read ahead, must not be 0 when turning flow control on
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_manual_window_management(
+    struct aws_mqtt_client_connection *connection,
+    bool manual_window_management,
+    size_t initial_window_size);
+
+/**
+ * Re-opens the read window by increment_size bytes, typically the size of the payloads the application is done with.
+ * Only does anything while connected with manual window management on, a new connection starts with the initial
+ * window size again. May be called from any thread.
+ *
+ * \param[in] connection        The connection object
+ * \param[in] increment_size    How many bytes to re-open the read window by
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_update_window(struct aws_mqtt_client_connection *connection, size_t increment_size);
+
+/**
+ * Turns on manual acknowledgement of received QoS 1 and QoS 2 publishes. Instead of the PUBACK or PUBREC being sent as
+ * soon as the publish callbacks return, the application takes a token for the publish with
+ * aws_mqtt_client_connection_get_publish_ack_token() and acknowledges it with aws_mqtt_client_connection_ack_publish()
+ * once it's done with it, from any thread. Publishes that are never acknowledged are re-sent by the server after
+ * reconnecting, as long as the session is kept. A QoS 2 publish the server re-sends after it was delivered isn't
+ * delivered again, it's acknowledged along with the original. Off by default. Only safe to set when connection is not
+ * connected.
+ *
+ * \param[in] connection            The connection object
+ * \param[in] manual_publish_acks   True to acknowledge publishes manually
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_manual_publish_acks(
+    struct aws_mqtt_client_connection *connection,
+    bool manual_publish_acks);
+
+/**
+ * Gets the token to acknowledge the publish currently being delivered with. Only valid when called from a publish
+ * callback (subscription, on_any_publish, or any of the publish stream callbacks) while manual publish acks are on;
+ * returns a token of 0 otherwise, and for QoS 0 publishes. The on_any_publish_batch handler finds each publish's token
+ * in its aws_mqtt_publish_view instead.
+ *
+ * \param[in] connection    The connection object
+ */
+AWS_MQTT_API
+struct aws_mqtt_publish_ack_token aws_mqtt_client_connection_get_publish_ack_token(
+    const struct aws_mqtt_client_connection *connection);
+
+/**
+ * Acknowledges a publish received while manual publish acks are on. May be called from any thread. Acks made in quick
+ * succession are sent together. Acks for QoS 1 publishes received before the connection was interrupted are dropped,
+ * the server sends those publishes again. Acks for QoS 2 publishes are sent once the connection is back, as long as the
+ * server kept the session.
+ *
+ * \param[in] connection    The connection object
+ * \param[in] token         The token of the publish, see aws_mqtt_client_connection_get_publish_ack_token()
+ *
+ * \returns AWS_OP_SUCCESS if the ack was queued or there's nothing to acknowledge, otherwise AWS_OP_ERR and
+ *          aws_last_error() will be set.
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_ack_publish(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_publish_ack_token token);
+
+/**
+ * Caches which subscriptions match each of the max_topics most recently received publish topics, so that publishes on
+ * a small set of hot topics skip matching against the subscriptions. The cache is emptied whenever the subscriptions
+ * change. Disabled (0) by default. Only safe to set when connection is not connected.
+ *
+ * \param[in] connection    The connection object
+ * \param[in] max_topics    The number of topics to cache (pass 0 to disable the cache)
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_set_publish_dispatch_cache_size(
+    struct aws_mqtt_client_connection *connection,
+    size_t max_topics);
+
 /**
  * Opens the actual connection defined by aws_mqtt_client_connection_new.
  * Once the connection is opened, on_connack will be called. Only called when connection is disconnected.
@@ -572,6 +814,204 @@ uint16_t aws_mqtt_client_connection_publish(
     aws_mqtt_op_complete_fn *on_complete,
     void *userdata);
 
+/**
+ * Send a PUBLISH packet over connection without copying the payload.
+ * The payload memory is borrowed and must remain valid and unmodified until on_payload_release is invoked, which
+ * happens once the publish completes (successfully or not) and the connection no longer references it.
+ * If this function fails (returns 0), on_payload_release is not invoked and the caller keeps ownership of the payload.
+ *
+ * \param[in] connection            The connection to publish on
+ * \param[in] topic                 The topic to publish on
+ * \param[in] qos                   The requested QoS of the packet
+ * \param[in] retain                True to have the server save the packet, and send to all new subscriptions matching
+ *                                  topic
+ * \param[in] payload               The data to send as the payload of the publish, referenced without copying
+ * \param[in] on_payload_release    Called when the connection is done with payload
+ * \param[in] payload_release_ud    (nullable) Passed to on_payload_release
+ * \param[in] on_complete           (nullable) For QoS 0, called as soon as the packet is sent
+ *                                  For QoS 1, called when PUBACK is received
+ *                                  For QoS 2, called when PUBCOMP is received
+ * \param[in] user_data             (nullable) Passed to on_complete
+ *
+ * \returns The packet id of the publish packet if successfully sent, otherwise 0.
+ */
+AWS_MQTT_API
+uint16_t aws_mqtt_client_connection_publish_no_copy(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata);
+
+/**
+ * Registers a topic to publish on repeatedly. The topic is validated and encoded once, and publishes made with the
+ * returned handle skip both steps, as well as the copy of the topic made by aws_mqtt_client_connection_publish().
+ * A handle is immutable and not tied to any connection, so it may be shared between threads and connections.
+ *
+ * \param[in] allocator     The allocator the handle is allocated with
+ * \param[in] topic         The topic to register, copied into the handle
+ *
+ * \returns A handle with a reference count of 1, or NULL (AWS_ERROR_MQTT_INVALID_TOPIC if the topic is invalid).
+ */
+AWS_MQTT_API
+struct aws_mqtt_topic_handle *aws_mqtt_topic_handle_new(
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *topic);
+
+/**
+ * Increments the ref count of a topic handle.
+ *
+ * \param[in] topic_handle  The topic handle to acquire
+ *
+ * \returns topic_handle
+ */
+AWS_MQTT_API
+struct aws_mqtt_topic_handle *aws_mqtt_topic_handle_acquire(struct aws_mqtt_topic_handle *topic_handle);
+
+/**
+ * Decrements the ref count of a topic handle, freeing it once the last reference goes away. Publishes still in flight
+ * hold their own reference, so a handle may be released as soon as the caller is done publishing with it.
+ *
+ * \param[in] topic_handle  (nullable) The topic handle to release
+ */
+AWS_MQTT_API
+void aws_mqtt_topic_handle_release(struct aws_mqtt_topic_handle *topic_handle);
+
+/**
+ * Returns the topic a handle was registered with. The cursor is valid for as long as the handle is.
+ */
+AWS_MQTT_API
+struct aws_byte_cursor aws_mqtt_topic_handle_get_topic(const struct aws_mqtt_topic_handle *topic_handle);
+
+/**
+ * Send a PUBLISH packet over connection to a registered topic.
+ * Same as aws_mqtt_client_connection_publish() if on_payload_release is NULL, and as
+ * aws_mqtt_client_connection_publish_no_copy() otherwise.
+ *
+ * \param[in] connection            The connection to publish on
+ * \param[in] topic_handle          The topic to publish on, referenced until the publish completes
+ * \param[in] qos                   The requested QoS of the packet
+ * \param[in] retain                True to have the server save the packet, and send to all new subscriptions matching
+ *                                  topic
+ * \param[in] payload               The data to send as the payload of the publish
+ * \param[in] on_payload_release    (nullable) If set, payload is borrowed rather than copied, and this is called when
+ *                                  the connection is done with it
+ * \param[in] payload_release_ud    (nullable) Passed to on_payload_release
+ * \param[in] on_complete           (nullable) For QoS 0, called as soon as the packet is sent
+ *                                  For QoS 1, called when PUBACK is received
+ *                                  For QoS 2, called when PUBCOMP is received
+ * \param[in] user_data             (nullable) Passed to on_complete
+ *
+ * \returns The packet id of the publish packet if successfully sent, otherwise 0.
+ */
+AWS_MQTT_API
+uint16_t aws_mqtt_client_connection_publish_with_topic_handle(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_topic_handle *topic_handle,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata);
+
+/**
+ * Encodes a PUBLISH packet once, to be sent any number of times with aws_mqtt_client_connection_publish_prepared().
+ * Every send shares the encoded packet, patching in only its packet id and, when resent, the DUP flag. Packets too
+ * large to be coalesced with other writes have their payload written by reference rather than copied.
+ * A prepared publish is immutable and not tied to any connection, so it may be shared between threads and connections.
+ *
+ * \param[in] allocator     The allocator the prepared publish is allocated with
+ * \param[in] topic         The topic to publish on
+ * \param[in] qos           The requested QoS of the packet
+ * \param[in] retain        True to have the server save the packet, and send to all new subscriptions matching topic
+ * \param[in] payload       The data to send as the payload of the publish, copied into the encoded packet
+ *
+ * \returns A prepared publish with a reference count of 1, or NULL (AWS_ERROR_MQTT_INVALID_TOPIC if the topic is
+ *          invalid).
+ */
+AWS_MQTT_API
+struct aws_mqtt_prepared_publish *aws_mqtt_prepared_publish_new(
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *topic,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload);
+
+/**
+ * Increments the ref count of a prepared publish.
+ *
+ * \param[in] prepared      The prepared publish to acquire
+ *
+ * \returns prepared
+ */
+AWS_MQTT_API
+struct aws_mqtt_prepared_publish *aws_mqtt_prepared_publish_acquire(struct aws_mqtt_prepared_publish *prepared);
+
+/**
+ * Decrements the ref count of a prepared publish, freeing it once the last reference goes away. Sends still in flight
+ * hold their own reference.
+ *
+ * \param[in] prepared      (nullable) The prepared publish to release
+ */
+AWS_MQTT_API
+void aws_mqtt_prepared_publish_release(struct aws_mqtt_prepared_publish *prepared);
+
+/**
+ * Send a prepared PUBLISH packet over connection, see aws_mqtt_prepared_publish_new().
+ *
+ * \param[in] connection    The connection to publish on
+ * \param[in] prepared      The publish to send, referenced until the publish completes
+ * \param[in] on_complete   (nullable) For QoS 0, called as soon as the packet is sent
+ *                          For QoS 1, called when PUBACK is received
+ *                          For QoS 2, called when PUBCOMP is received
+ * \param[in] user_data     (nullable) Passed to on_complete
+ *
+ * \returns The packet id of the publish packet if successfully sent, otherwise 0.
+ */
+AWS_MQTT_API
+uint16_t aws_mqtt_client_connection_publish_prepared(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_prepared_publish *prepared,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata);
+
+/**
+ * Send several PUBLISH packets over connection at once.
+ * This is equivalent to calling aws_mqtt_client_connection_publish() for each entry in order, but the connection's
+ * lock is taken once for the whole batch and all of the packets are written from a single event-loop task.
+ * Topics and payloads are copied, except for topic handles which are referenced; entries may be freed immediately on
+ * return.
+ * Either every entry is accepted, or none is.
+ *
+ * \param[in] connection        The connection to publish on
+ * \param[in] entries           The publishes to send, see aws_mqtt_client_connection_publish() for each field
+ * \param[in] entry_count       Number of elements in entries
+ * \param[out] out_packet_ids   (nullable) Array of entry_count elements, receives the packet id of each publish
+ *
+ * \returns AWS_OP_SUCCESS if every publish was started, otherwise AWS_OP_ERR and none were.
+ */
+AWS_MQTT_API
+int aws_mqtt_client_connection_publish_batch(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_publish_batch_entry *entries,
+    size_t entry_count,
+    uint16_t *out_packet_ids);
+
+/**
+ * Gets the number of packet identifiers in use, one per request that hasn't completed yet, including the ones queued
+ * while offline. QoS 0 publishes hold one too, until they're sent. May be called from any thread.
+ *
+ * \param[in] connection    The connection object
+ */
+AWS_MQTT_API
+size_t aws_mqtt_client_connection_get_packet_ids_in_use(struct aws_mqtt_client_connection *connection);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_MQTT_CLIENT_H */
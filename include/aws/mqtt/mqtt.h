@@ -74,6 +74,19 @@ bool aws_mqtt_is_valid_topic(const struct aws_byte_cursor *topic);
 AWS_MQTT_API
 bool aws_mqtt_is_valid_topic_filter(const struct aws_byte_cursor *topic_filter);
 
+/**
+ * Validates topic as a topic name, or as a topic filter if is_filter is true, in a single pass over it.
+ * While at it, stores the offset of the start of each of its levels into level_offsets, up to max_levels of them, and
+ * the number of levels into level_count_out, which may be more than max_levels. Both may be NULL.
+ */
+AWS_MQTT_API
+bool aws_mqtt_validate_topic_levels(
+    const struct aws_byte_cursor *topic,
+    bool is_filter,
+    uint16_t *level_offsets,
+    size_t max_levels,
+    size_t *level_count_out);
+
 /**
  * Initializes internal datastructures used by aws-c-mqtt.
  * Must be called before using any functionality in aws-c-mqtt.
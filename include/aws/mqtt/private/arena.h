@@ -0,0 +1,58 @@
+#ifndef AWS_MQTT_PRIVATE_ARENA_H
+#define AWS_MQTT_PRIVATE_ARENA_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/mqtt.h>
+
+#include <aws/common/linked_list.h>
+
+/* Blocks of 16, 32, 48, ... 1024 bytes (header included) are carved from chunks, anything bigger goes to the parent. */
+#define AWS_MQTT_ARENA_SIZE_CLASS_COUNT 64
+
+/**
+ * A slab allocator for many small, long lived allocations of a few sizes, such as the nodes of a topic tree.
+ * Blocks are carved from large chunks and recycled through a free list per size class, so allocations made together
+ * stay close together in memory. Destroying the arena releases everything still allocated from it at once.
+ * Not thread safe.
+ */
+struct aws_mqtt_arena {
+    /* Pass this to aws_mem_* and friends to allocate from the arena */
+    struct aws_allocator allocator;
+
+    struct aws_allocator *parent;
+    size_t chunk_size;
+
+    /* Everything acquired from parent: chunks, and blocks too big for a size class */
+    struct aws_linked_list chunks;
+
+    /* Unused space at the end of the newest chunk */
+    uint8_t *chunk_next;
+    uint8_t *chunk_end;
+
+    /* Released blocks of each size class, linked through their first bytes */
+    void *free_lists[AWS_MQTT_ARENA_SIZE_CLASS_COUNT];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates an arena that acquires memory from parent chunk_size bytes at a time. Pass 0 for the default chunk size.
+ */
+AWS_MQTT_API struct aws_mqtt_arena *aws_mqtt_arena_new(struct aws_allocator *parent, size_t chunk_size);
+
+/**
+ * Releases all memory allocated from the arena, whether or not it was released individually, and the arena itself.
+ */
+AWS_MQTT_API void aws_mqtt_arena_destroy(struct aws_mqtt_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_MQTT_PRIVATE_ARENA_H */
@@ -9,9 +9,11 @@
 #include <aws/mqtt/client.h>
 
 #include <aws/mqtt/private/fixed_header.h>
+#include <aws/mqtt/private/mpsc_queue.h>
+#include <aws/mqtt/private/packet_id_set.h>
+#include <aws/mqtt/private/packet_id_table.h>
 #include <aws/mqtt/private/topic_tree.h>
 
-#include <aws/common/hash_table.h>
 #include <aws/common/mutex.h>
 #include <aws/common/task_scheduler.h>
 
@@ -72,6 +74,9 @@ typedef enum aws_mqtt_client_request_state(
 struct aws_mqtt_request {
     struct aws_linked_list_node list_node;
 
+    /* Links the request into the connection's submission_queue, between creation and the first send. */
+    struct aws_mqtt_mpsc_queue_node submission_node;
+
     struct aws_allocator *allocator;
     struct aws_mqtt_client_connection *connection;
 
@@ -162,6 +167,15 @@ struct aws_mqtt_client_connection {
         uint64_t next_attempt_ms;             /* milliseconds */
         uint64_t next_attempt_reset_timer_ns; /* nanoseconds */
     } reconnect_timeouts;
+    struct {
+        size_t retain_size; /* pending_packet capacity kept between packets */
+        size_t max_size;    /* largest incoming packet accepted, 0 for no limit */
+    } reassembly_limits;
+    struct {
+        bool enabled;               /* publish payloads only re-open the read window through update_window() */
+        size_t initial_window_size; /* the read window of each new channel */
+    } manual_window;
+    bool manual_publish_acks; /* QoS 1 and 2 publishes are only acked by aws_mqtt_client_connection_ack_publish() */
 
     /* User connection callbacks */
     aws_mqtt_client_on_connection_complete_fn *on_connection_complete;
@@ -172,6 +186,9 @@ struct aws_mqtt_client_connection {
     void *on_resumed_ud;
     aws_mqtt_client_publish_received_fn *on_any_publish;
     void *on_any_publish_ud;
+    aws_mqtt_client_publish_batch_received_fn *on_any_publish_batch;
+    void *on_any_publish_batch_ud;
+    struct aws_mqtt_publish_stream_options publish_stream_options; /* streaming is off while on_begin is NULL */
     aws_mqtt_client_on_disconnect_fn *on_disconnect;
     void *on_disconnect_ud;
 
@@ -189,8 +206,61 @@ struct aws_mqtt_client_connection {
 
     /* Only the event-loop thread may touch this data */
     struct {
-        /* If an incomplete packet arrives, store the data here. */
+        /**
+         * If an incomplete packet arrives, store the data here. The capacity is kept once the packet is handled, up
+         * to reassembly_limits.retain_size, so that reassembling packets split across reads doesn't allocate.
+         */
         struct aws_byte_buf pending_packet;
+        /* Full size of the packet in pending_packet, 0 until enough of it has arrived to decode its fixed header */
+        size_t pending_packet_size;
+
+        /**
+         * Set while the payload of an incoming PUBLISH is passed to publish_stream_options.on_chunk as it arrives.
+         * Only the PUBLISH's headers go through pending_packet, and its payload never does.
+         */
+        struct {
+            bool active;
+            size_t payload_remaining;
+            uint16_t packet_identifier;
+            enum aws_mqtt_qos qos;
+            /* A resent QoS 2 publish that was already delivered, its payload is skipped rather than passed on */
+            bool redelivery;
+        } publish_stream;
+
+        /**
+         * Bytes of publish payloads delivered to the user that the read window hasn't been held back by yet. It's held
+         * back by as much as possible after each read, the rest carries over to the next reads.
+         */
+        size_t read_window_debt;
+
+        /* Bumped on every CONNACK, so that acks for publishes received over an earlier channel can be told apart */
+        uint32_t publish_ack_generation;
+        /* The token aws_mqtt_client_connection_get_publish_ack_token() returns while a publish is being delivered */
+        struct aws_mqtt_publish_ack_token publish_ack_token;
+        /* Acks taken from synced_data.pending_publish_acks, kept to reuse its memory */
+        struct aws_array_list publish_acks_to_send;
+
+        /**
+         * Publishes dispatched during the current read, waiting to be passed to on_any_publish_batch. Only filled while
+         * it's set, the capacity is kept from one read to the next.
+         */
+        struct aws_array_list publish_batch; /* struct aws_mqtt_publish_view */
+
+        /**
+         * Packet IDs of the QoS 2 publishes delivered to the user whose PUBREL hasn't arrived yet. Until then the
+         * server may resend them, resends are acknowledged but not delivered again. Kept across reconnects as long as
+         * the server keeps the session.
+         */
+        struct aws_mqtt_packet_id_set qos2_publishes_received;
+
+        /**
+         * The QoS 2 publishes of qos2_publishes_received the user has yet to ack, while manual publish acks are on.
+         * Resends of these aren't acknowledged either, the PUBREC waits for the user's ack.
+         */
+        struct aws_mqtt_packet_id_set qos2_publishes_unacked;
+        /* publish_ack_generation when the server last started a new session. Acks of QoS 2 publishes received since
+         * then stay good across reconnects, the server's resends of those publishes aren't delivered again. */
+        uint32_t qos2_session_generation;
 
         bool waiting_on_ping_response;
 
@@ -203,6 +273,14 @@ struct aws_mqtt_client_connection {
          * List of all requests waiting for response.
          */
         struct aws_linked_list ongoing_requests_list;
+
+        /**
+         * Small packets encoded during the current event-loop tick, waiting to be written together.
+         * See mqtt_get_coalesced_message_for_packet().
+         */
+        struct aws_io_message *pending_write;
+        struct aws_channel_task flush_pending_write_task;
+        bool flush_pending_write_task_scheduled;
     } thread_data;
 
     /* Any thread may touch this data, but the lock must be held (unless it's an atomic) */
@@ -221,22 +299,54 @@ struct aws_mqtt_client_connection {
         /**
          * Store all requests that is not completed including the pending requests.
          *
-         * hash table from uint16_t (packet_id) to aws_mqtt_outstanding_request
+         * Indexed directly by packet_id, maps to the aws_mqtt_request.
          */
-        struct aws_hash_table outstanding_requests_table;
+        struct aws_mqtt_packet_id_table outstanding_requests_table;
 
         /**
          * List of all requests that cannot be scheduled until the connection comes online.
          */
         struct aws_linked_list pending_requests_list;
 
+        /**
+         * Packet IDs of every request in outstanding_requests_table, used to find a free ID without probing the table.
+         */
+        struct aws_mqtt_packet_id_set packet_ids_in_use;
+
         /**
          * Remember the last packet ID assigned.
-         * Helps us find the next free ID faster.
+         * The search for a free ID starts right after it.
          */
         uint16_t packet_id;
+
+        /* Sum of aws_mqtt_client_connection_update_window() calls not yet applied by window_update_task */
+        size_t pending_window_increment;
+        bool window_update_task_scheduled;
+
+        /* Tokens passed to aws_mqtt_client_connection_ack_publish() not yet sent by publish_ack_task */
+        struct aws_array_list pending_publish_acks; /* struct aws_mqtt_publish_ack_token */
+        bool publish_ack_task_scheduled;
     } synced_data;
 
+    /**
+     * Requests created while connected, handed over to the event-loop thread without going through the channel's
+     * cross-thread task scheduling one request at a time. The producer whose push finds the queue empty schedules
+     * submission_task, which sends everything queued by the time it runs. Other producers just push. If the task is
+     * canceled along with submission_channel while the connection is back online over another channel, it's scheduled
+     * again on that one.
+     */
+    struct aws_mqtt_mpsc_queue submission_queue;
+    struct aws_channel_task submission_task;
+    struct aws_channel *submission_channel; /* only compared against, never dereferenced */
+
+    /* Applies synced_data.pending_window_increment on the event-loop thread */
+    struct aws_channel_task window_update_task;
+    struct aws_channel *window_update_channel; /* the channel it was last scheduled on, only touched under the lock */
+
+    /* Sends synced_data.pending_publish_acks on the event-loop thread */
+    struct aws_channel_task publish_ack_task;
+    struct aws_channel *publish_ack_channel; /* the channel it was last scheduled on, only touched under the lock */
+
     struct {
         aws_mqtt_transform_websocket_handshake_fn *handshake_transformer;
         void *handshake_transformer_ud;
@@ -255,9 +365,55 @@ struct aws_io_message *mqtt_get_message_for_packet(
     struct aws_mqtt_client_connection *connection,
     struct aws_mqtt_fixed_header *header);
 
+/**
+ * Returns the connection's pending-write message with room for a packet with the given header, so that small packets
+ * written during the same event-loop tick go down the channel as a single message. Encode the packet straight into
+ * message->message_data and do not send or release the message: it is sent at the end of the tick, or as soon as the
+ * next packet no longer fits. Returns NULL if the packet is too large to be coalesced or on allocation failure.
+ * Must be called from the event-loop thread.
+ */
+struct aws_io_message *mqtt_get_coalesced_message_for_packet(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_fixed_header *header);
+
+/**
+ * Sends the PUBACK or PUBREC a received publish of the given QoS calls for, if any. Must be called from the event-loop
+ * thread.
+ */
+int mqtt_connection_send_publish_ack(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_qos qos,
+    uint16_t packet_identifier);
+
+/**
+ * Sends a message down the channel, after any packets coalesced so far so that ordering is preserved.
+ * Same contract as aws_channel_slot_send_message(): on failure the caller still owns the message.
+ * Must be called from the event-loop thread.
+ */
+int mqtt_connection_send_message(struct aws_mqtt_client_connection *connection, struct aws_io_message *message);
+
+/**
+ * Schedules the sending of the publish acks queued while the publish ack task couldn't run, if there are any. Called
+ * once the connection is back online.
+ */
+void mqtt_connection_schedule_pending_publish_acks(struct aws_mqtt_client_connection *connection);
+
+/* Sends any packets coalesced so far down the channel right away. Must be called from the event-loop thread. */
+void mqtt_connection_flush_pending_write(struct aws_mqtt_client_connection *connection);
+
 void mqtt_connection_lock_synced_data(struct aws_mqtt_client_connection *connection);
 void mqtt_connection_unlock_synced_data(struct aws_mqtt_client_connection *connection);
 
+/**
+ * For a task shared by the whole connection that was canceled along with canceled_channel: if the connection is
+ * connected over another channel by now, returns that channel with a hold on it (aws_channel_acquire_hold) for the
+ * task to be scheduled on again. Returns NULL otherwise.
+ * Note: needs to be called with lock held.
+ */
+struct aws_channel *mqtt_connection_acquire_rescheduling_channel_synced(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_channel *canceled_channel);
+
 /* Note: needs to be called with lock held. */
 void mqtt_connection_set_state(
     struct aws_mqtt_client_connection *connection,
@@ -277,6 +433,37 @@ AWS_MQTT_API uint16_t mqtt_create_request(
     void *on_complete_ud,
     bool noRetry);
 
+/**
+ * Removes a request from the outstanding requests table, frees its packet id and returns it to the pool.
+ * The request must not be in any list.
+ * Note: needs to be called with lock held.
+ */
+void mqtt_connection_release_request_synced(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_request *request);
+
+/* One request of a batch registered through mqtt_create_request_batch */
+struct aws_mqtt_request_batch_entry {
+    aws_mqtt_send_request_fn *send_request;
+    void *send_request_ud;
+    aws_mqtt_op_complete_fn *on_complete;
+    void *on_complete_ud;
+    bool no_retry;
+
+    /* Set by mqtt_create_request_batch on success */
+    uint16_t packet_id;
+};
+
+/**
+ * Same as mqtt_create_request, for a whole batch of requests at once: the lock is taken once to reserve every packet
+ * id, and when connected a single task is scheduled that sends all of them in order.
+ * Either every request is registered, or none is and an error is raised.
+ */
+AWS_MQTT_API int mqtt_create_request_batch(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_request_batch_entry *entries,
+    size_t entry_count);
+
 /* Call when an ack packet comes back from the server. */
 AWS_MQTT_API void mqtt_request_complete(
     struct aws_mqtt_client_connection *connection,
@@ -39,6 +39,18 @@ struct aws_mqtt_fixed_header {
     uint8_t flags;
 };
 
+/**
+ * A complete packet found in a buffer by aws_mqtt_frame_index_scan().
+ */
+struct aws_mqtt_frame {
+    /* Offset of the packet's first byte from the start of the buffer */
+    uint32_t offset;
+    /* Size of the whole packet, fixed header included */
+    uint32_t size;
+    uint8_t packet_type;
+    uint8_t flags;
+};
+
 /**
  * Get the type of packet from the first byte of the buffer [MQTT-2.2.1].
  */
@@ -50,7 +62,18 @@ AWS_MQTT_API enum aws_mqtt_packet_type aws_mqtt_get_packet_type(const uint8_t *b
 AWS_MQTT_API bool aws_mqtt_packet_has_flags(const struct aws_mqtt_fixed_header *header);
 
 /**
- * Write a fixed header to a byte stream.
+ * Get the exact number of bytes header encodes to: the packet type and flags, and the 1-4 bytes of remaining length.
+ */
+AWS_MQTT_API size_t aws_mqtt_fixed_header_encoded_size(const struct aws_mqtt_fixed_header *header);
+
+/**
+ * Get the exact number of bytes of the whole packet described by header: its fixed header, followed by remaining_length
+ * bytes.
+ */
+AWS_MQTT_API size_t aws_mqtt_packet_encoded_size(const struct aws_mqtt_fixed_header *header);
+
+/**
+ * Write a fixed header to a byte stream. Nothing is written if it doesn't fit.
  */
 AWS_MQTT_API int aws_mqtt_fixed_header_encode(struct aws_byte_buf *buf, const struct aws_mqtt_fixed_header *header);
 
@@ -59,4 +82,13 @@ AWS_MQTT_API int aws_mqtt_fixed_header_encode(struct aws_byte_buf *buf, const st
  */
 AWS_MQTT_API int aws_mqtt_fixed_header_decode(struct aws_byte_cursor *cur, struct aws_mqtt_fixed_header *header);
 
+/**
+ * Indexes the complete packets at the start of data, back to back, into frames, decoding nothing but their fixed
+ * headers' type, flags and remaining length. Stops at the first packet that isn't complete, whose remaining length is
+ * malformed or whose reserved bits are set [MQTT-2.2.2-2], or once max_frames packets are indexed. Returns the number of
+ * frames indexed, the bytes after the last of them are left for aws_mqtt_fixed_header_decode() to make sense of.
+ */
+AWS_MQTT_API size_t
+    aws_mqtt_frame_index_scan(struct aws_byte_cursor data, struct aws_mqtt_frame *frames, size_t max_frames);
+
 #endif /* AWS_MQTT_PRIVATE_FIXED_HEADER_H */
@@ -0,0 +1,52 @@
+#ifndef AWS_MQTT_PRIVATE_MPSC_QUEUE_H
+#define AWS_MQTT_PRIVATE_MPSC_QUEUE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/mqtt.h>
+
+#include <aws/common/atomics.h>
+
+struct aws_mqtt_mpsc_queue_node {
+    struct aws_mqtt_mpsc_queue_node *next;
+};
+
+/**
+ * Intrusive, lock-free, multi-producer single-consumer queue.
+ * Any thread may push, and a single consumer takes everything pushed so far in one go. Since the consumer always
+ * empties the queue, push can report whether the queue was empty: only that producer needs to wake the consumer up,
+ * which gives exactly one wakeup per drain no matter how many producers raced.
+ */
+struct aws_mqtt_mpsc_queue {
+    /* The most recently pushed node, each node links to the one pushed before it. */
+    struct aws_atomic_var head;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+AWS_MQTT_API void aws_mqtt_mpsc_queue_init(struct aws_mqtt_mpsc_queue *queue);
+
+/**
+ * Pushes node onto the queue, may be called from any thread.
+ * Returns true if the queue was empty, in which case the caller is responsible for getting the consumer to drain it.
+ */
+AWS_MQTT_API bool aws_mqtt_mpsc_queue_push(struct aws_mqtt_mpsc_queue *queue, struct aws_mqtt_mpsc_queue_node *node);
+
+/**
+ * Removes every node from the queue and returns the first one pushed, the rest follow through next in push order.
+ * Returns NULL if the queue is empty. Only the consumer may call this.
+ */
+AWS_MQTT_API struct aws_mqtt_mpsc_queue_node *aws_mqtt_mpsc_queue_pop_all(struct aws_mqtt_mpsc_queue *queue);
+
+AWS_MQTT_API bool aws_mqtt_mpsc_queue_is_empty(struct aws_mqtt_mpsc_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_MQTT_PRIVATE_MPSC_QUEUE_H */
@@ -0,0 +1,64 @@
+#ifndef AWS_MQTT_PRIVATE_PACKET_ID_SET_H
+#define AWS_MQTT_PRIVATE_PACKET_ID_SET_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/mqtt.h>
+
+#define AWS_MQTT_PACKET_ID_SET_WORD_COUNT ((UINT16_MAX + 1) / 64)
+
+/**
+ * A set of packet identifiers, backed by one bit per possible id.
+ * Never allocates; insert, remove and lookup are O(1), and finding an id that isn't in the set skips 64 ids at a time.
+ * Packet id 0 is not a valid MQTT packet identifier and is never part of the set.
+ */
+struct aws_mqtt_packet_id_set {
+    uint64_t words[AWS_MQTT_PACKET_ID_SET_WORD_COUNT];
+
+    /* Number of ids in the set */
+    size_t count;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Empties the set.
+ */
+AWS_MQTT_API void aws_mqtt_packet_id_set_clear(struct aws_mqtt_packet_id_set *set);
+
+/**
+ * Returns true if packet_id is in the set.
+ */
+AWS_MQTT_API bool aws_mqtt_packet_id_set_contains(const struct aws_mqtt_packet_id_set *set, uint16_t packet_id);
+
+/**
+ * Adds packet_id (which must not be 0) to the set. Returns false if it was already there.
+ */
+AWS_MQTT_API bool aws_mqtt_packet_id_set_add(struct aws_mqtt_packet_id_set *set, uint16_t packet_id);
+
+/**
+ * Removes packet_id from the set. Returns false if it wasn't there.
+ */
+AWS_MQTT_API bool aws_mqtt_packet_id_set_remove(struct aws_mqtt_packet_id_set *set, uint16_t packet_id);
+
+/**
+ * Returns the number of ids in the set.
+ */
+AWS_MQTT_API size_t aws_mqtt_packet_id_set_count(const struct aws_mqtt_packet_id_set *set);
+
+/**
+ * Finds the first id not in the set, searching upward from start (inclusive) and wrapping around past UINT16_MAX.
+ * Returns 0 if every id is taken.
+ */
+AWS_MQTT_API uint16_t aws_mqtt_packet_id_set_find_free(const struct aws_mqtt_packet_id_set *set, uint16_t start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_MQTT_PRIVATE_PACKET_ID_SET_H */
@@ -0,0 +1,72 @@
+#ifndef AWS_MQTT_PRIVATE_PACKET_ID_TABLE_H
+#define AWS_MQTT_PRIVATE_PACKET_ID_TABLE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/mqtt.h>
+
+#define AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE 256
+#define AWS_MQTT_PACKET_ID_TABLE_PAGE_COUNT ((UINT16_MAX + 1) / AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE)
+
+/**
+ * Maps packet identifiers to pointers by indexing directly on the id: no hashing, no probing.
+ * The index is two-level: the high byte of the id picks a page of 256 entries, the low byte the entry. Pages are only
+ * allocated while at least one of their ids is in use, and since ids are handed out sequentially the live ones
+ * usually share a handful of pages. The last page to empty is kept as a spare for the next page needed, so that a
+ * single id put and removed over and over doesn't allocate each time.
+ */
+struct aws_mqtt_packet_id_table {
+    struct aws_allocator *allocator;
+
+    void **pages[AWS_MQTT_PACKET_ID_TABLE_PAGE_COUNT];
+
+    /* Number of entries in use in each page, a page is freed when this drops back to 0 */
+    uint16_t page_counts[AWS_MQTT_PACKET_ID_TABLE_PAGE_COUNT];
+
+    /* An emptied page, every entry NULL, kept for the next page to be allocated. NULL if there's none */
+    void **spare_page;
+
+    /* Number of entries in the table */
+    size_t count;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initializes an empty table. Nothing is allocated until the first put.
+ */
+AWS_MQTT_API void aws_mqtt_packet_id_table_init(
+    struct aws_mqtt_packet_id_table *table,
+    struct aws_allocator *allocator);
+
+/**
+ * Frees every page of the table, the spare one included. The values themselves are not touched.
+ */
+AWS_MQTT_API void aws_mqtt_packet_id_table_clean_up(struct aws_mqtt_packet_id_table *table);
+
+/**
+ * Returns the value stored for packet_id, or NULL if there is none.
+ */
+AWS_MQTT_API void *aws_mqtt_packet_id_table_find(const struct aws_mqtt_packet_id_table *table, uint16_t packet_id);
+
+/**
+ * Stores value (which must not be NULL) for packet_id, replacing any previous value.
+ * Only fails if a page needs to be allocated and allocation fails.
+ */
+AWS_MQTT_API int aws_mqtt_packet_id_table_put(struct aws_mqtt_packet_id_table *table, uint16_t packet_id, void *value);
+
+/**
+ * Removes packet_id from the table and returns the value that was stored for it, or NULL if there was none.
+ */
+AWS_MQTT_API void *aws_mqtt_packet_id_table_remove(struct aws_mqtt_packet_id_table *table, uint16_t packet_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_MQTT_PRIVATE_PACKET_ID_TABLE_H */
@@ -20,6 +20,12 @@
  *     3. Payload, preset in some packets
  */
 
+/*
+ * Number of entries the lists of SUBSCRIBE, SUBACK and UNSUBSCRIBE packets hold in storage inline in the packet, before
+ * moving to the heap. Since their lists point into them, those packets must not be moved once initialized.
+ */
+#define AWS_MQTT_PACKET_INLINE_LIST_SIZE 8
+
 /* Struct used internally for representing subscriptions */
 struct aws_mqtt_subscription {
     /* Topic filter to subscribe to [MQTT-4.7]. */
@@ -55,8 +61,11 @@ struct aws_mqtt_packet_suback {
     uint16_t packet_identifier;
 
     /* Payload */
-    /* List of uint8_t return code */
+    /* List of uint8_t return code, a view of the buffer once decoded */
     struct aws_array_list return_codes;
+
+    struct aws_allocator *allocator;
+    uint8_t inline_return_codes[AWS_MQTT_PACKET_INLINE_LIST_SIZE];
 };
 
 /* Represents the MQTT CONNECT packet */
@@ -99,6 +108,9 @@ struct aws_mqtt_packet_publish {
     uint16_t packet_identifier;
     struct aws_byte_cursor topic_name;
 
+    /* (optional) topic_name already encoded with its length prefix, written as-is by the encoders when set */
+    struct aws_byte_cursor encoded_topic_name;
+
     /* Payload */
     struct aws_byte_cursor payload;
 };
@@ -114,6 +126,9 @@ struct aws_mqtt_packet_subscribe {
     /* Payload */
     /* List of aws_mqtt_subscription */
     struct aws_array_list topic_filters;
+
+    struct aws_allocator *allocator;
+    struct aws_mqtt_subscription inline_topic_filters[AWS_MQTT_PACKET_INLINE_LIST_SIZE];
 };
 
 /* Represents the MQTT UNSUBSCRIBE packet */
@@ -127,6 +142,9 @@ struct aws_mqtt_packet_unsubscribe {
     /* Payload */
     /* List of aws_byte_cursors */
     struct aws_array_list topic_filters;
+
+    struct aws_allocator *allocator;
+    struct aws_byte_cursor inline_topic_filters[AWS_MQTT_PACKET_INLINE_LIST_SIZE];
 };
 /**
  * Used to represent the following MQTT packets:
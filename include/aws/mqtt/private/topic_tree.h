@@ -50,9 +50,30 @@ struct aws_mqtt_topic_node {
     void *userdata;
 };
 
+struct aws_mqtt_arena;
+struct aws_mqtt_topic_tree_matcher;
+struct aws_mqtt_topic_tree_dispatch_cache;
+
 struct aws_mqtt_topic_tree {
     struct aws_mqtt_topic_node *root;
     struct aws_allocator *allocator;
+
+    /* Backs the nodes, their subtopics tables and the topic filter strings, and frees them all at once on clean up. */
+    struct aws_mqtt_arena *arena;
+
+    /* Bumped once per transaction committed or rolled back, anything derived from an older epoch is stale. */
+    uint64_t epoch;
+
+    /**
+     * Flattened copy of the tree that publishes are dispatched with: each node links straight to its '+' and '#'
+     * children and to a hash-indexed array of its literal children, so every publish topic level is hashed only once.
+     * While it's stale, publishes walk the tree instead, and it's rebuilt once the tree has stayed unchanged for a
+     * while.
+     */
+    struct aws_mqtt_topic_tree_matcher *matcher;
+
+    /* Subscriptions matching recently published topics, NULL unless enabled. */
+    struct aws_mqtt_topic_tree_dispatch_cache *dispatch_cache;
 };
 
 /**
@@ -71,6 +92,15 @@ AWS_MQTT_API int aws_mqtt_topic_tree_init(struct aws_mqtt_topic_tree *tree, stru
  */
 AWS_MQTT_API void aws_mqtt_topic_tree_clean_up(struct aws_mqtt_topic_tree *tree);
 
+/**
+ * Caches the subscriptions matching each of the max_topics most recently published topics, so that publishing on one
+ * of them again doesn't have to match it against the tree. The cache is invalidated whenever the tree changes.
+ * Passing 0 disables the cache, which is the default.
+ *
+ * \returns AWS_OP_SUCCESS on success, AWS_OP_ERR with aws_last_error() populated if the cache couldn't be allocated.
+ */
+AWS_MQTT_API int aws_mqtt_topic_tree_set_dispatch_cache_size(struct aws_mqtt_topic_tree *tree, size_t max_topics);
+
 /**
  * Iterates through all registered subscriptions, and calls iterator.
  *
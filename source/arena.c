@@ -0,0 +1,142 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/arena.h>
+
+#define AWS_MQTT_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define AWS_MQTT_ARENA_ALIGNMENT 16
+#define AWS_MQTT_ARENA_LARGE_BLOCK UINT64_MAX
+
+/* Precedes every block handed out, 16 bytes so that what follows stays aligned */
+struct arena_block_header {
+    uint64_t size_class; /* AWS_MQTT_ARENA_LARGE_BLOCK if the block was acquired from the parent on its own */
+    uint64_t reserved;
+};
+
+/* Precedes every chunk and large block acquired from the parent */
+struct arena_chunk_header {
+    struct aws_linked_list_node node;
+};
+
+static size_t s_align(size_t size) {
+    return (size + AWS_MQTT_ARENA_ALIGNMENT - 1) & ~(size_t)(AWS_MQTT_ARENA_ALIGNMENT - 1);
+}
+
+/* Size classes are 16 bytes apart, so that a block wastes less than 16 bytes of padding */
+static size_t s_class_block_size(size_t size_class) {
+    return (size_class + 1) * AWS_MQTT_ARENA_ALIGNMENT;
+}
+
+static void *s_arena_acquire_from_parent(struct aws_mqtt_arena *arena, size_t size) {
+    const size_t chunk_header_size = s_align(sizeof(struct arena_chunk_header));
+
+    uint8_t *memory = aws_mem_acquire(arena->parent, chunk_header_size + size);
+    if (!memory) {
+        return NULL;
+    }
+
+    struct arena_chunk_header *chunk = (struct arena_chunk_header *)memory;
+    aws_linked_list_push_back(&arena->chunks, &chunk->node);
+
+    return memory + chunk_header_size;
+}
+
+static void *s_arena_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    struct aws_mqtt_arena *arena = AWS_CONTAINER_OF(allocator, struct aws_mqtt_arena, allocator);
+
+    const size_t block_size = s_align(sizeof(struct arena_block_header) + size);
+    if (block_size < size) {
+        return NULL;
+    }
+
+    const size_t size_class = block_size / AWS_MQTT_ARENA_ALIGNMENT - 1;
+
+    struct arena_block_header *header = NULL;
+    if (size_class >= AWS_MQTT_ARENA_SIZE_CLASS_COUNT) {
+        header = s_arena_acquire_from_parent(arena, block_size);
+        if (!header) {
+            return NULL;
+        }
+        header->size_class = AWS_MQTT_ARENA_LARGE_BLOCK;
+        return header + 1;
+    }
+
+    void *free_block = arena->free_lists[size_class];
+    if (free_block) {
+        /* The header is still there from the block's last use */
+        arena->free_lists[size_class] = *(void **)free_block;
+        return free_block;
+    }
+
+    const size_t class_block_size = s_class_block_size(size_class);
+    if ((size_t)(arena->chunk_end - arena->chunk_next) < class_block_size) {
+        /* What's left of the current chunk is abandoned until the arena is destroyed */
+        uint8_t *chunk = s_arena_acquire_from_parent(arena, arena->chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        arena->chunk_next = chunk;
+        arena->chunk_end = chunk + arena->chunk_size;
+    }
+
+    header = (struct arena_block_header *)arena->chunk_next;
+    arena->chunk_next += class_block_size;
+    header->size_class = size_class;
+    return header + 1;
+}
+
+static void s_arena_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct aws_mqtt_arena *arena = AWS_CONTAINER_OF(allocator, struct aws_mqtt_arena, allocator);
+
+    struct arena_block_header *header = (struct arena_block_header *)ptr - 1;
+    if (header->size_class == AWS_MQTT_ARENA_LARGE_BLOCK) {
+        uint8_t *memory = (uint8_t *)header - s_align(sizeof(struct arena_chunk_header));
+        struct arena_chunk_header *chunk = (struct arena_chunk_header *)memory;
+        aws_linked_list_remove(&chunk->node);
+        aws_mem_release(arena->parent, memory);
+        return;
+    }
+
+    AWS_ASSERT(header->size_class < AWS_MQTT_ARENA_SIZE_CLASS_COUNT);
+    *(void **)ptr = arena->free_lists[header->size_class];
+    arena->free_lists[header->size_class] = ptr;
+}
+
+struct aws_mqtt_arena *aws_mqtt_arena_new(struct aws_allocator *parent, size_t chunk_size) {
+    AWS_PRECONDITION(parent);
+
+    struct aws_mqtt_arena *arena = aws_mem_calloc(parent, 1, sizeof(struct aws_mqtt_arena));
+    if (!arena) {
+        return NULL;
+    }
+
+    /* No realloc or calloc, aws_mem_realloc and aws_mem_calloc fall back to acquire and release */
+    arena->allocator.mem_acquire = s_arena_mem_acquire;
+    arena->allocator.mem_release = s_arena_mem_release;
+    arena->allocator.impl = arena;
+
+    arena->parent = parent;
+    arena->chunk_size = chunk_size ? chunk_size : AWS_MQTT_ARENA_DEFAULT_CHUNK_SIZE;
+    /* A chunk must hold at least one block of the largest size class */
+    if (arena->chunk_size < s_class_block_size(AWS_MQTT_ARENA_SIZE_CLASS_COUNT - 1)) {
+        arena->chunk_size = s_class_block_size(AWS_MQTT_ARENA_SIZE_CLASS_COUNT - 1);
+    }
+    aws_linked_list_init(&arena->chunks);
+
+    return arena;
+}
+
+void aws_mqtt_arena_destroy(struct aws_mqtt_arena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    while (!aws_linked_list_empty(&arena->chunks)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&arena->chunks);
+        aws_mem_release(arena->parent, AWS_CONTAINER_OF(node, struct arena_chunk_header, node));
+    }
+
+    aws_mem_release(arena->parent, arena);
+}
@@ -19,6 +19,7 @@
 #include <aws/io/uri.h>
 
 #include <aws/common/clock.h>
+#include <aws/common/math.h>
 #include <aws/common/task_scheduler.h>
 
 #include <inttypes.h>
@@ -61,6 +62,26 @@ void mqtt_connection_unlock_synced_data(struct aws_mqtt_client_connection *conne
     (void)err;
 }
 
+struct aws_channel *mqtt_connection_acquire_rescheduling_channel_synced(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_channel *canceled_channel) {
+    ASSERT_SYNCED_DATA_LOCK_HELD(connection);
+    if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
+        return NULL;
+    }
+
+    AWS_ASSERT(connection->slot);
+    AWS_ASSERT(connection->slot->channel);
+    struct aws_channel *channel = connection->slot->channel;
+    if (channel == canceled_channel) {
+        /* Still going away, the task would only be canceled again */
+        return NULL;
+    }
+
+    aws_channel_acquire_hold(channel);
+    return channel;
+}
+
 static void s_aws_mqtt_client_destroy(struct aws_mqtt_client *client) {
 
     AWS_LOGF_DEBUG(AWS_LS_MQTT_CLIENT, "client=%p: Cleaning up MQTT client", (void *)client);
@@ -288,9 +309,7 @@ static void s_mqtt_client_shutdown(
             while (!aws_linked_list_empty(&cancelling_requests)) {
                 struct aws_linked_list_node *node = aws_linked_list_pop_front(&cancelling_requests);
                 struct aws_mqtt_request *request = AWS_CONTAINER_OF(node, struct aws_mqtt_request, list_node);
-                aws_hash_table_remove(
-                    &connection->synced_data.outstanding_requests_table, &request->packet_id, NULL, NULL);
-                aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+                mqtt_connection_release_request_synced(connection, request);
             }
             mqtt_connection_unlock_synced_data(connection);
         } /* END CRITICAL SECTION */
@@ -574,7 +593,7 @@ static void s_mqtt_client_init(
         goto handle_error;
     }
 
-    if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+    if (mqtt_connection_send_message(connection, message)) {
 
         AWS_LOGF_ERROR(AWS_LS_MQTT_CLIENT, "id=%p: Failed to send encoded CONNECT packet upstream", (void *)connection);
         goto handle_error;
@@ -660,14 +679,6 @@ void aws_create_reconnect_task(struct aws_mqtt_client_connection *connection) {
     }
 }
 
-static uint64_t s_hash_uint16_t(const void *item) {
-    return *(uint16_t *)item;
-}
-
-static bool s_uint16_t_eq(const void *a, const void *b) {
-    return *(uint16_t *)a == *(uint16_t *)b;
-}
-
 static void s_mqtt_client_connection_destroy_final(struct aws_mqtt_client_connection *connection) {
     AWS_PRECONDITION(!connection || connection->allocator);
     if (!connection) {
@@ -701,10 +712,12 @@ static void s_mqtt_client_connection_destroy_final(struct aws_mqtt_client_connec
     /* Clear the client_id */
     aws_byte_buf_clean_up(&connection->client_id);
 
+    aws_byte_buf_clean_up(&connection->thread_data.pending_packet);
+
     /* Free all of the active subscriptions */
     aws_mqtt_topic_tree_clean_up(&connection->thread_data.subscriptions);
 
-    aws_hash_table_clean_up(&connection->synced_data.outstanding_requests_table);
+    aws_mqtt_packet_id_table_clean_up(&connection->synced_data.outstanding_requests_table);
     /* clean up the pending_requests if it's not empty */
     while (!aws_linked_list_empty(&connection->synced_data.pending_requests_list)) {
         struct aws_linked_list_node *node = aws_linked_list_pop_front(&connection->synced_data.pending_requests_list);
@@ -718,6 +731,10 @@ static void s_mqtt_client_connection_destroy_final(struct aws_mqtt_client_connec
     }
     aws_memory_pool_clean_up(&connection->synced_data.requests_pool);
 
+    aws_array_list_clean_up(&connection->synced_data.pending_publish_acks);
+    aws_array_list_clean_up(&connection->thread_data.publish_acks_to_send);
+    aws_array_list_clean_up(&connection->thread_data.publish_batch);
+
     aws_mutex_clean_up(&connection->synced_data.lock);
 
     aws_tls_connection_options_clean_up(&connection->tls_options);
@@ -796,8 +813,10 @@ struct aws_mqtt_client_connection *aws_mqtt_client_connection_new(struct aws_mqt
     connection->synced_data.state = AWS_MQTT_CLIENT_STATE_DISCONNECTED;
     connection->reconnect_timeouts.min_sec = 1;
     connection->reconnect_timeouts.max_sec = 128;
+    connection->reassembly_limits.retain_size = 256 * 1024;
     aws_linked_list_init(&connection->synced_data.pending_requests_list);
     aws_linked_list_init(&connection->thread_data.ongoing_requests_list);
+    aws_mqtt_mpsc_queue_init(&connection->submission_queue);
 
     if (aws_mutex_init(&connection->synced_data.lock)) {
         AWS_LOGF_ERROR(
@@ -832,22 +851,28 @@ struct aws_mqtt_client_connection *aws_mqtt_client_connection_new(struct aws_mqt
         goto failed_init_requests_pool;
     }
 
-    if (aws_hash_table_init(
-            &connection->synced_data.outstanding_requests_table,
+    aws_mqtt_packet_id_table_init(&connection->synced_data.outstanding_requests_table, connection->allocator);
+
+    if (aws_array_list_init_dynamic(
+            &connection->synced_data.pending_publish_acks,
             connection->allocator,
-            sizeof(struct aws_mqtt_request *),
-            s_hash_uint16_t,
-            s_uint16_t_eq,
-            NULL,
-            NULL)) {
+            0,
+            sizeof(struct aws_mqtt_publish_ack_token)) ||
+        aws_array_list_init_dynamic(
+            &connection->thread_data.publish_acks_to_send,
+            connection->allocator,
+            0,
+            sizeof(struct aws_mqtt_publish_ack_token)) ||
+        aws_array_list_init_dynamic(
+            &connection->thread_data.publish_batch, connection->allocator, 0, sizeof(struct aws_mqtt_publish_view))) {
 
         AWS_LOGF_ERROR(
             AWS_LS_MQTT_CLIENT,
-            "id=%p: Failed to initialize outstanding requests table, error %d (%s)",
+            "id=%p: Failed to initialize publish ack and batch lists, error %d (%s)",
             (void *)connection,
             aws_last_error(),
             aws_error_name(aws_last_error()));
-        goto failed_init_outstanding_requests_table;
+        goto failed_init_publish_acks;
     }
 
     /* Initialize the handler */
@@ -857,7 +882,11 @@ struct aws_mqtt_client_connection *aws_mqtt_client_connection_new(struct aws_mqt
 
     return connection;
 
-failed_init_outstanding_requests_table:
+failed_init_publish_acks:
+    aws_array_list_clean_up(&connection->synced_data.pending_publish_acks);
+    aws_array_list_clean_up(&connection->thread_data.publish_acks_to_send);
+    aws_array_list_clean_up(&connection->thread_data.publish_batch);
+    aws_mqtt_packet_id_table_clean_up(&connection->synced_data.outstanding_requests_table);
     aws_memory_pool_clean_up(&connection->synced_data.requests_pool);
 
 failed_init_requests_pool:
@@ -1100,197 +1129,646 @@ int aws_mqtt_client_connection_set_on_any_publish_handler(
     return AWS_OP_SUCCESS;
 }
 
-/*******************************************************************************
- * Websockets
- ******************************************************************************/
-#ifdef AWS_MQTT_WITH_WEBSOCKETS
-
-int aws_mqtt_client_connection_use_websockets(
+int aws_mqtt_client_connection_set_on_any_publish_batch_handler(
     struct aws_mqtt_client_connection *connection,
-    aws_mqtt_transform_websocket_handshake_fn *transformer,
-    void *transformer_ud,
-    aws_mqtt_validate_websocket_handshake_fn *validator,
-    void *validator_ud) {
+    aws_mqtt_client_publish_batch_received_fn *on_any_publish_batch,
+    void *on_any_publish_batch_ud) {
 
-    connection->websocket.handshake_transformer = transformer;
-    connection->websocket.handshake_transformer_ud = transformer_ud;
-    connection->websocket.handshake_validator = validator;
-    connection->websocket.handshake_validator_ud = validator_ud;
-    connection->websocket.enabled = true;
+    AWS_PRECONDITION(connection);
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-    AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Using websockets", (void *)connection);
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Connection is connected, publishes may arrive anytime. Unable to set publish batch handler "
+                "until offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Setting on_any_publish_batch handler", (void *)connection);
+
+    connection->on_any_publish_batch = on_any_publish_batch;
+    connection->on_any_publish_batch_ud = on_any_publish_batch_ud;
 
     return AWS_OP_SUCCESS;
 }
 
-int aws_mqtt_client_connection_set_http_proxy_options(
+int aws_mqtt_client_connection_set_publish_stream_handler(
     struct aws_mqtt_client_connection *connection,
-    struct aws_http_proxy_options *proxy_options) {
+    const struct aws_mqtt_publish_stream_options *options) {
 
-    /* If there is existing proxy options, nuke em */
-    if (connection->http_proxy_config) {
-        aws_http_proxy_config_destroy(connection->http_proxy_config);
-        connection->http_proxy_config = NULL;
+    AWS_PRECONDITION(connection);
+    if (options && (!options->on_begin || !options->on_chunk || !options->on_end)) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
     }
 
-    connection->http_proxy_config =
-        aws_http_proxy_config_new_tunneling_from_proxy_options(connection->allocator, proxy_options);
-
-    return connection->http_proxy_config != NULL ? AWS_OP_SUCCESS : AWS_OP_ERR;
-}
-
-static void s_on_websocket_shutdown(struct aws_websocket *websocket, int error_code, void *user_data) {
-    struct aws_mqtt_client_connection *connection = user_data;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-    struct aws_channel *channel = connection->slot ? connection->slot->channel : NULL;
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Connection is connected, publishes may arrive anytime. Unable to set publish stream handler "
+                "until offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
 
-    s_mqtt_client_shutdown(connection->client->bootstrap, error_code, channel, connection);
+    AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Setting publish stream handler", (void *)connection);
 
-    if (websocket) {
-        aws_websocket_release(websocket);
+    if (options) {
+        connection->publish_stream_options = *options;
+    } else {
+        AWS_ZERO_STRUCT(connection->publish_stream_options);
     }
+
+    return AWS_OP_SUCCESS;
 }
 
-static void s_on_websocket_setup(
-    struct aws_websocket *websocket,
-    int error_code,
-    int handshake_response_status,
-    const struct aws_http_header *handshake_response_header_array,
-    size_t num_handshake_response_headers,
-    void *user_data) {
+int aws_mqtt_client_connection_set_reassembly_limits(
+    struct aws_mqtt_client_connection *connection,
+    size_t retain_size,
+    size_t max_packet_size) {
 
-    (void)handshake_response_status;
+    AWS_PRECONDITION(connection);
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-    /* Setup callback contract is: if error_code is non-zero then websocket is NULL. */
-    AWS_FATAL_ASSERT((error_code != 0) == (websocket == NULL));
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Connection is connected, packets may arrive anytime. Unable to set reassembly limits until "
+                "offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
 
-    struct aws_mqtt_client_connection *connection = user_data;
-    struct aws_channel *channel = NULL;
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Setting reassembly limits retain: %zu max packet size: %zu",
+        (void *)connection,
+        retain_size,
+        max_packet_size);
 
-    if (connection->websocket.handshake_request) {
-        aws_http_message_release(connection->websocket.handshake_request);
-        connection->websocket.handshake_request = NULL;
+    connection->reassembly_limits.retain_size = retain_size;
+    connection->reassembly_limits.max_size = max_packet_size;
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_mqtt_client_connection_set_manual_window_management(
+    struct aws_mqtt_client_connection *connection,
+    bool manual_window_management,
+    size_t initial_window_size) {
+
+    AWS_PRECONDITION(connection);
+    if (manual_window_management && initial_window_size == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT, "id=%p: Initial window size must be greater than 0.", (void *)connection);
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
     }
 
-    if (websocket) {
-        channel = aws_websocket_get_channel(websocket);
-        AWS_ASSERT(channel);
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-        /* Websocket must be "converted" before the MQTT handler can be installed next to it. */
-        if (aws_websocket_convert_to_midchannel_handler(websocket)) {
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
             AWS_LOGF_ERROR(
                 AWS_LS_MQTT_CLIENT,
-                "id=%p: Failed converting websocket, error %d (%s)",
-                (void *)connection,
-                aws_last_error(),
-                aws_error_name(aws_last_error()));
-
-            aws_channel_shutdown(channel, aws_last_error());
-            return;
+                "id=%p: Connection is connected, data may arrive anytime. Unable to set manual window management until "
+                "offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
         }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
 
-        /* If validation callback is set, let the user accept/reject the handshake */
-        if (connection->websocket.handshake_validator) {
-            AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Validating websocket handshake response.", (void *)connection);
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Setting manual window management %s, initial window size %zu",
+        (void *)connection,
+        manual_window_management ? "on" : "off",
+        initial_window_size);
 
-            if (connection->websocket.handshake_validator(
-                    connection,
-                    handshake_response_header_array,
-                    num_handshake_response_headers,
-                    connection->websocket.handshake_validator_ud)) {
+    connection->manual_window.enabled = manual_window_management;
+    connection->manual_window.initial_window_size = initial_window_size;
 
-                AWS_LOGF_ERROR(
-                    AWS_LS_MQTT_CLIENT,
-                    "id=%p: Failure reported by websocket handshake validator callback, error %d (%s)",
-                    (void *)connection,
-                    aws_last_error(),
-                    aws_error_name(aws_last_error()));
+    return AWS_OP_SUCCESS;
+}
 
-                aws_channel_shutdown(channel, aws_last_error());
-                return;
-            }
+static void s_window_update_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_mqtt_client_connection *connection = arg;
 
-            AWS_LOGF_TRACE(
-                AWS_LS_MQTT_CLIENT, "id=%p: Done validating websocket handshake response.", (void *)connection);
+    size_t increment_size = 0;
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+        /* Canceled along with a channel that was going away when the task was scheduled, while increments made over
+         * the channel that replaced it were left to it. Those are applied on that channel instead. */
+        if (status == AWS_TASK_STATUS_CANCELED) {
+            channel =
+                mqtt_connection_acquire_rescheduling_channel_synced(connection, connection->window_update_channel);
         }
-    }
-
-    /* Call into the channel-setup callback, the rest of the logic is the same. */
-    s_mqtt_client_init(connection->client->bootstrap, error_code, channel, connection);
-}
+        if (channel) {
+            connection->window_update_channel = channel;
+        } else {
+            increment_size = connection->synced_data.pending_window_increment;
+            connection->synced_data.pending_window_increment = 0;
+            connection->synced_data.window_update_task_scheduled = false;
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
 
-static aws_mqtt_transform_websocket_handshake_complete_fn s_websocket_handshake_transform_complete; /* fwd declare */
+    if (channel) {
+        aws_channel_task_init(&connection->window_update_task, s_window_update_task, connection, "mqtt_window_update");
+        aws_channel_schedule_task_now(channel, &connection->window_update_task);
+        aws_channel_release_hold(channel);
+        return;
+    }
 
-static int s_websocket_connect(struct aws_mqtt_client_connection *connection) {
-    AWS_ASSERT(connection->websocket.enabled);
+    /* Otherwise, a new channel starts with the initial window size */
+    if (status != AWS_TASK_STATUS_RUN_READY || !increment_size) {
+        return;
+    }
 
-    /* These defaults were chosen because they're commmon in other MQTT libraries.
-     * The user can modify the request in their transform callback if they need to. */
-    const struct aws_byte_cursor default_path = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("/mqtt");
-    const struct aws_http_header default_protocol_header = {
-        .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Protocol"),
-        .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("mqtt"),
-    };
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT, "id=%p: Incrementing read window by %zu bytes", (void *)connection, increment_size);
+    aws_channel_slot_increment_read_window(connection->slot, increment_size);
+}
 
-    /* Build websocket handshake request */
-    connection->websocket.handshake_request = aws_http_message_new_websocket_handshake_request(
-        connection->allocator, default_path, aws_byte_cursor_from_string(connection->host_name));
+int aws_mqtt_client_connection_update_window(struct aws_mqtt_client_connection *connection, size_t increment_size) {
+    AWS_PRECONDITION(connection);
 
-    if (!connection->websocket.handshake_request) {
-        AWS_LOGF_ERROR(AWS_LS_MQTT_CLIENT, "id=%p: Failed to generate websocket handshake request", (void *)connection);
-        goto error;
+    if (!connection->manual_window.enabled || !increment_size) {
+        return AWS_OP_SUCCESS;
     }
 
-    if (aws_http_message_add_header(connection->websocket.handshake_request, default_protocol_header)) {
-        AWS_LOGF_ERROR(AWS_LS_MQTT_CLIENT, "id=%p: Failed to generate websocket handshake request", (void *)connection);
-        goto error;
-    }
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-    /* If user registered a transform callback, call it and wait for transform_complete() to be called.
-     * If no callback registered, call the transform_complete() function ourselves. */
-    if (connection->websocket.handshake_transformer) {
-        AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Transforming websocket handshake request.", (void *)connection);
+        /* A new channel starts with the initial window size, nothing to do until then */
+        if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            return AWS_OP_SUCCESS;
+        }
 
-        connection->websocket.handshake_transformer(
-            connection->websocket.handshake_request,
-            connection->websocket.handshake_transformer_ud,
-            s_websocket_handshake_transform_complete,
-            connection);
+        connection->synced_data.pending_window_increment =
+            aws_add_size_saturating(connection->synced_data.pending_window_increment, increment_size);
+
+        /* Increments made before the task runs are applied along with this one */
+        if (!connection->synced_data.window_update_task_scheduled) {
+            connection->synced_data.window_update_task_scheduled = true;
+            AWS_ASSERT(connection->slot);
+            AWS_ASSERT(connection->slot->channel);
+            channel = connection->slot->channel;
+            connection->window_update_channel = channel;
+            /* keep the channel alive until the task is scheduled */
+            aws_channel_acquire_hold(channel);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
 
-    } else {
-        s_websocket_handshake_transform_complete(
-            connection->websocket.handshake_request, AWS_ERROR_SUCCESS, connection);
+    if (channel) {
+        aws_channel_task_init(&connection->window_update_task, s_window_update_task, connection, "mqtt_window_update");
+        aws_channel_schedule_task_now(channel, &connection->window_update_task);
+        aws_channel_release_hold(channel);
     }
 
     return AWS_OP_SUCCESS;
-
-error:
-    aws_http_message_release(connection->websocket.handshake_request);
-    connection->websocket.handshake_request = NULL;
-    return AWS_OP_ERR;
 }
 
-static void s_websocket_handshake_transform_complete(
-    struct aws_http_message *handshake_request,
-    int error_code,
-    void *complete_ctx) {
-
-    struct aws_mqtt_client_connection *connection = complete_ctx;
-
-    if (error_code) {
-        AWS_LOGF_ERROR(
-            AWS_LS_MQTT_CLIENT,
-            "id=%p: Failure reported by websocket handshake transform callback.",
-            (void *)connection);
-
-        goto error;
-    }
+int aws_mqtt_client_connection_set_manual_publish_acks(
+    struct aws_mqtt_client_connection *connection,
+    bool manual_publish_acks) {
 
-    if (connection->websocket.handshake_transformer) {
-        AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Done transforming websocket handshake request.", (void *)connection);
-    }
+    AWS_PRECONDITION(connection);
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-    /* Call websocket connect() */
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Connection is connected, publishes may arrive anytime. Unable to set manual publish acks until "
+                "offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Setting manual publish acks %s",
+        (void *)connection,
+        manual_publish_acks ? "on" : "off");
+
+    connection->manual_publish_acks = manual_publish_acks;
+
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_mqtt_publish_ack_token aws_mqtt_client_connection_get_publish_ack_token(
+    const struct aws_mqtt_client_connection *connection) {
+
+    AWS_PRECONDITION(connection);
+
+    return connection->thread_data.publish_ack_token;
+}
+
+static void s_publish_ack_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_mqtt_client_connection *connection = arg;
+
+    /* Swap rather than copy, both lists keep their memory for next time */
+    struct aws_array_list *acks = &connection->thread_data.publish_acks_to_send;
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+        if (status == AWS_TASK_STATUS_RUN_READY) {
+            aws_array_list_swap_contents(acks, &connection->synced_data.pending_publish_acks);
+            connection->synced_data.publish_ack_task_scheduled = false;
+        } else {
+            /* Canceled along with a channel that was going away when the task was scheduled. Acks made over the
+             * channel that replaced it may be waiting on it, so it's scheduled again on that channel if there's one
+             * by now. Otherwise the acks wait for the next CONNACK. */
+            channel = mqtt_connection_acquire_rescheduling_channel_synced(connection, connection->publish_ack_channel);
+            if (channel) {
+                connection->publish_ack_channel = channel;
+            } else {
+                connection->synced_data.publish_ack_task_scheduled = false;
+            }
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    if (channel) {
+        aws_channel_task_init(&connection->publish_ack_task, s_publish_ack_task, connection, "mqtt_publish_ack");
+        aws_channel_schedule_task_now(channel, &connection->publish_ack_task);
+        aws_channel_release_hold(channel);
+        return;
+    }
+
+    const size_t ack_count = aws_array_list_length(acks);
+    for (size_t i = 0; i < ack_count; ++i) {
+        struct aws_mqtt_publish_ack_token token;
+        aws_array_list_get_at(acks, &token, i);
+
+        const uint16_t packet_identifier = (uint16_t)token.value;
+        const enum aws_mqtt_qos qos = (enum aws_mqtt_qos)((token.value >> 16) & 0x3);
+        const uint32_t generation = (uint32_t)(token.value >> 32);
+        bool still_valid = generation == connection->thread_data.publish_ack_generation;
+        /* The server's resend of a QoS 2 publish isn't delivered again, so the original's ack stands for it */
+        if (qos == AWS_MQTT_QOS_EXACTLY_ONCE && generation >= connection->thread_data.qos2_session_generation &&
+            aws_mqtt_packet_id_set_remove(&connection->thread_data.qos2_publishes_unacked, packet_identifier)) {
+            still_valid = true;
+        }
+        if (!still_valid) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Dropping ack for publish with msg id=%" PRIu16 " received before the connection was lost",
+                (void *)connection,
+                packet_identifier);
+            continue;
+        }
+
+        /* Acks are coalesced, so this all goes out in as few writes as it fits in */
+        if (mqtt_connection_send_publish_ack(connection, qos, packet_identifier)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Failed to ack publish with msg id=%" PRIu16 ", error %d (%s)",
+                (void *)connection,
+                packet_identifier,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+        }
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Processed %zu publish acks, status %d.",
+        (void *)connection,
+        ack_count,
+        (int)status);
+    aws_array_list_clear(acks);
+}
+
+/**
+ * If there are acks to send over the current channel and publish_ack_task isn't scheduled yet, marks it scheduled and
+ * returns the channel to schedule it on, held until s_schedule_publish_ack_task(). Returns NULL otherwise.
+ * Note: needs to be called with lock held.
+ */
+static struct aws_channel *s_acquire_publish_ack_channel_synced(struct aws_mqtt_client_connection *connection) {
+    ASSERT_SYNCED_DATA_LOCK_HELD(connection);
+    if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED ||
+        connection->synced_data.publish_ack_task_scheduled ||
+        aws_array_list_length(&connection->synced_data.pending_publish_acks) == 0) {
+        return NULL;
+    }
+
+    connection->synced_data.publish_ack_task_scheduled = true;
+    AWS_ASSERT(connection->slot);
+    AWS_ASSERT(connection->slot->channel);
+    struct aws_channel *channel = connection->slot->channel;
+    connection->publish_ack_channel = channel;
+    /* keep the channel alive until the task is scheduled */
+    aws_channel_acquire_hold(channel);
+    return channel;
+}
+
+static void s_schedule_publish_ack_task(struct aws_mqtt_client_connection *connection, struct aws_channel *channel) {
+    aws_channel_task_init(&connection->publish_ack_task, s_publish_ack_task, connection, "mqtt_publish_ack");
+    aws_channel_schedule_task_now(channel, &connection->publish_ack_task);
+    aws_channel_release_hold(channel);
+}
+
+void mqtt_connection_schedule_pending_publish_acks(struct aws_mqtt_client_connection *connection) {
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+        channel = s_acquire_publish_ack_channel_synced(connection);
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    if (channel) {
+        s_schedule_publish_ack_task(connection, channel);
+    }
+}
+
+int aws_mqtt_client_connection_ack_publish(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_publish_ack_token token) {
+
+    AWS_PRECONDITION(connection);
+
+    if (!token.value) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+
+        /* The publish will be sent again after reconnecting, ack that one instead. Except for a QoS 2 publish, whose
+         * resend isn't delivered again: its ack is kept until the connection is back. */
+        const enum aws_mqtt_qos qos = (enum aws_mqtt_qos)((token.value >> 16) & 0x3);
+        if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED && qos != AWS_MQTT_QOS_EXACTLY_ONCE) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_DEBUG(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Dropping ack for publish with msg id=%" PRIu16 ", the connection is not connected",
+                (void *)connection,
+                (uint16_t)token.value);
+            return AWS_OP_SUCCESS;
+        }
+
+        if (aws_array_list_push_back(&connection->synced_data.pending_publish_acks, &token)) {
+            mqtt_connection_unlock_synced_data(connection);
+            return AWS_OP_ERR;
+        }
+
+        /* Acks made before the task runs are sent along with this one */
+        channel = s_acquire_publish_ack_channel_synced(connection);
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    if (channel) {
+        s_schedule_publish_ack_task(connection, channel);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_mqtt_client_connection_set_publish_dispatch_cache_size(
+    struct aws_mqtt_client_connection *connection,
+    size_t max_topics) {
+
+    AWS_PRECONDITION(connection);
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+
+        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            mqtt_connection_unlock_synced_data(connection);
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Connection is connected, publishes may arrive anytime. Unable to set dispatch cache size until "
+                "offline.",
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT, "id=%p: Setting publish dispatch cache size to %zu topics", (void *)connection, max_topics);
+
+    return aws_mqtt_topic_tree_set_dispatch_cache_size(&connection->thread_data.subscriptions, max_topics);
+}
+
+/*******************************************************************************
+ * Websockets
+ ******************************************************************************/
+#ifdef AWS_MQTT_WITH_WEBSOCKETS
+
+int aws_mqtt_client_connection_use_websockets(
+    struct aws_mqtt_client_connection *connection,
+    aws_mqtt_transform_websocket_handshake_fn *transformer,
+    void *transformer_ud,
+    aws_mqtt_validate_websocket_handshake_fn *validator,
+    void *validator_ud) {
+
+    connection->websocket.handshake_transformer = transformer;
+    connection->websocket.handshake_transformer_ud = transformer_ud;
+    connection->websocket.handshake_validator = validator;
+    connection->websocket.handshake_validator_ud = validator_ud;
+    connection->websocket.enabled = true;
+
+    AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Using websockets", (void *)connection);
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_mqtt_client_connection_set_http_proxy_options(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_http_proxy_options *proxy_options) {
+
+    /* If there is existing proxy options, nuke em */
+    if (connection->http_proxy_config) {
+        aws_http_proxy_config_destroy(connection->http_proxy_config);
+        connection->http_proxy_config = NULL;
+    }
+
+    connection->http_proxy_config =
+        aws_http_proxy_config_new_tunneling_from_proxy_options(connection->allocator, proxy_options);
+
+    return connection->http_proxy_config != NULL ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static void s_on_websocket_shutdown(struct aws_websocket *websocket, int error_code, void *user_data) {
+    struct aws_mqtt_client_connection *connection = user_data;
+
+    struct aws_channel *channel = connection->slot ? connection->slot->channel : NULL;
+
+    s_mqtt_client_shutdown(connection->client->bootstrap, error_code, channel, connection);
+
+    if (websocket) {
+        aws_websocket_release(websocket);
+    }
+}
+
+static void s_on_websocket_setup(
+    struct aws_websocket *websocket,
+    int error_code,
+    int handshake_response_status,
+    const struct aws_http_header *handshake_response_header_array,
+    size_t num_handshake_response_headers,
+    void *user_data) {
+
+    (void)handshake_response_status;
+
+    /* Setup callback contract is: if error_code is non-zero then websocket is NULL. */
+    AWS_FATAL_ASSERT((error_code != 0) == (websocket == NULL));
+
+    struct aws_mqtt_client_connection *connection = user_data;
+    struct aws_channel *channel = NULL;
+
+    if (connection->websocket.handshake_request) {
+        aws_http_message_release(connection->websocket.handshake_request);
+        connection->websocket.handshake_request = NULL;
+    }
+
+    if (websocket) {
+        channel = aws_websocket_get_channel(websocket);
+        AWS_ASSERT(channel);
+
+        /* Websocket must be "converted" before the MQTT handler can be installed next to it. */
+        if (aws_websocket_convert_to_midchannel_handler(websocket)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Failed converting websocket, error %d (%s)",
+                (void *)connection,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+
+            aws_channel_shutdown(channel, aws_last_error());
+            return;
+        }
+
+        /* If validation callback is set, let the user accept/reject the handshake */
+        if (connection->websocket.handshake_validator) {
+            AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Validating websocket handshake response.", (void *)connection);
+
+            if (connection->websocket.handshake_validator(
+                    connection,
+                    handshake_response_header_array,
+                    num_handshake_response_headers,
+                    connection->websocket.handshake_validator_ud)) {
+
+                AWS_LOGF_ERROR(
+                    AWS_LS_MQTT_CLIENT,
+                    "id=%p: Failure reported by websocket handshake validator callback, error %d (%s)",
+                    (void *)connection,
+                    aws_last_error(),
+                    aws_error_name(aws_last_error()));
+
+                aws_channel_shutdown(channel, aws_last_error());
+                return;
+            }
+
+            AWS_LOGF_TRACE(
+                AWS_LS_MQTT_CLIENT, "id=%p: Done validating websocket handshake response.", (void *)connection);
+        }
+    }
+
+    /* Call into the channel-setup callback, the rest of the logic is the same. */
+    s_mqtt_client_init(connection->client->bootstrap, error_code, channel, connection);
+}
+
+static aws_mqtt_transform_websocket_handshake_complete_fn s_websocket_handshake_transform_complete; /* fwd declare */
+
+static int s_websocket_connect(struct aws_mqtt_client_connection *connection) {
+    AWS_ASSERT(connection->websocket.enabled);
+
+    /* These defaults were chosen because they're commmon in other MQTT libraries.
+     * The user can modify the request in their transform callback if they need to. */
+    const struct aws_byte_cursor default_path = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("/mqtt");
+    const struct aws_http_header default_protocol_header = {
+        .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Protocol"),
+        .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("mqtt"),
+    };
+
+    /* Build websocket handshake request */
+    connection->websocket.handshake_request = aws_http_message_new_websocket_handshake_request(
+        connection->allocator, default_path, aws_byte_cursor_from_string(connection->host_name));
+
+    if (!connection->websocket.handshake_request) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_CLIENT, "id=%p: Failed to generate websocket handshake request", (void *)connection);
+        goto error;
+    }
+
+    if (aws_http_message_add_header(connection->websocket.handshake_request, default_protocol_header)) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_CLIENT, "id=%p: Failed to generate websocket handshake request", (void *)connection);
+        goto error;
+    }
+
+    /* If user registered a transform callback, call it and wait for transform_complete() to be called.
+     * If no callback registered, call the transform_complete() function ourselves. */
+    if (connection->websocket.handshake_transformer) {
+        AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Transforming websocket handshake request.", (void *)connection);
+
+        connection->websocket.handshake_transformer(
+            connection->websocket.handshake_request,
+            connection->websocket.handshake_transformer_ud,
+            s_websocket_handshake_transform_complete,
+            connection);
+
+    } else {
+        s_websocket_handshake_transform_complete(
+            connection->websocket.handshake_request, AWS_ERROR_SUCCESS, connection);
+    }
+
+    return AWS_OP_SUCCESS;
+
+error:
+    aws_http_message_release(connection->websocket.handshake_request);
+    connection->websocket.handshake_request = NULL;
+    return AWS_OP_ERR;
+}
+
+static void s_websocket_handshake_transform_complete(
+    struct aws_http_message *handshake_request,
+    int error_code,
+    void *complete_ctx) {
+
+    struct aws_mqtt_client_connection *connection = complete_ctx;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Failure reported by websocket handshake transform callback.",
+            (void *)connection);
+
+        goto error;
+    }
+
+    if (connection->websocket.handshake_transformer) {
+        AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: Done transforming websocket handshake request.", (void *)connection);
+    }
+
+    /* Call websocket connect() */
     struct aws_websocket_client_connection_options websocket_options = {
         .allocator = connection->allocator,
         .bootstrap = connection->client->bootstrap,
@@ -1526,9 +2004,7 @@ int aws_mqtt_client_connection_connect(
             while (!aws_linked_list_empty(&cancelling_requests)) {
                 struct aws_linked_list_node *node = aws_linked_list_pop_front(&cancelling_requests);
                 struct aws_mqtt_request *request = AWS_CONTAINER_OF(node, struct aws_mqtt_request, list_node);
-                aws_hash_table_remove(
-                    &connection->synced_data.outstanding_requests_table, &request->packet_id, NULL, NULL);
-                aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+                mqtt_connection_release_request_synced(connection, request);
             }
             mqtt_connection_unlock_synced_data(connection);
         } /* END CRITICAL SECTION */
@@ -1786,7 +2262,7 @@ static enum aws_mqtt_client_request_state s_subscribe_send(uint16_t packet_id, b
 
     /* This is not necessarily a fatal error; if the subscribe fails, it'll just retry. Still need to clean up though.
      */
-    if (aws_channel_slot_send_message(task_arg->connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+    if (mqtt_connection_send_message(task_arg->connection, message)) {
         aws_mem_release(message->allocator, message);
     }
 
@@ -2345,7 +2821,7 @@ static enum aws_mqtt_client_request_state s_resubscribe_send(
     }
 
     /* This is not necessarily a fatal error; if the send fails, it'll just retry.  Still need to clean up though. */
-    if (aws_channel_slot_send_message(task_arg->connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+    if (mqtt_connection_send_message(task_arg->connection, message)) {
         aws_mem_release(message->allocator, message);
     }
 
@@ -2532,7 +3008,7 @@ static enum aws_mqtt_client_request_state s_unsubscribe_send(
             goto handle_error;
         }
 
-        if (aws_channel_slot_send_message(task_arg->connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+        if (mqtt_connection_send_message(task_arg->connection, message)) {
             goto handle_error;
         }
 
@@ -2642,14 +3118,187 @@ uint16_t aws_mqtt_client_connection_unsubscribe(
 
     AWS_LOGF_DEBUG(AWS_LS_MQTT_CLIENT, "id=%p: Starting unsubscribe %" PRIu16, (void *)connection, packet_id);
 
-    return packet_id;
+    return packet_id;
+
+handle_error:
+
+    aws_string_destroy(task_arg->filter_string);
+    aws_mem_release(connection->allocator, task_arg);
+
+    return 0;
+}
+
+/*******************************************************************************
+ * Topic Handles
+ ******************************************************************************/
+
+struct aws_mqtt_topic_handle {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+
+    /* Points into encoded_topic, past the length prefix */
+    struct aws_byte_cursor topic;
+
+    /* The topic as it is written in a PUBLISH packet: its big-endian 16-bit length, followed by the topic itself.
+     * Stored in the same allocation, right after the struct. */
+    struct aws_byte_cursor encoded_topic;
+};
+
+static void s_topic_handle_destroy(struct aws_mqtt_topic_handle *topic_handle) {
+    aws_mem_release(topic_handle->allocator, topic_handle);
+}
+
+struct aws_mqtt_topic_handle *aws_mqtt_topic_handle_new(
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *topic) {
+
+    AWS_PRECONDITION(allocator);
+    AWS_PRECONDITION(topic);
+
+    if (!aws_mqtt_is_valid_topic(topic)) {
+        aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+        return NULL;
+    }
+
+    const size_t encoded_len = sizeof(uint16_t) + topic->len;
+    struct aws_mqtt_topic_handle *topic_handle =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_mqtt_topic_handle) + encoded_len);
+    if (!topic_handle) {
+        return NULL;
+    }
+
+    topic_handle->allocator = allocator;
+    aws_ref_count_init(
+        &topic_handle->ref_count, topic_handle, (aws_simple_completion_callback *)s_topic_handle_destroy);
+
+    /* Validation capped the topic at 65535 bytes, so the writes can't fail */
+    struct aws_byte_buf encoded_buf = aws_byte_buf_from_empty_array(topic_handle + 1, encoded_len);
+    aws_byte_buf_write_be16(&encoded_buf, (uint16_t)topic->len);
+    aws_byte_buf_write_from_whole_cursor(&encoded_buf, *topic);
+
+    topic_handle->encoded_topic = aws_byte_cursor_from_buf(&encoded_buf);
+    topic_handle->topic = aws_byte_cursor_from_array(encoded_buf.buffer + sizeof(uint16_t), topic->len);
+
+    return topic_handle;
+}
+
+struct aws_mqtt_topic_handle *aws_mqtt_topic_handle_acquire(struct aws_mqtt_topic_handle *topic_handle) {
+    AWS_PRECONDITION(topic_handle);
+
+    aws_ref_count_acquire(&topic_handle->ref_count);
+    return topic_handle;
+}
+
+void aws_mqtt_topic_handle_release(struct aws_mqtt_topic_handle *topic_handle) {
+    if (topic_handle) {
+        aws_ref_count_release(&topic_handle->ref_count);
+    }
+}
+
+struct aws_byte_cursor aws_mqtt_topic_handle_get_topic(const struct aws_mqtt_topic_handle *topic_handle) {
+    AWS_PRECONDITION(topic_handle);
+
+    return topic_handle->topic;
+}
+
+/*******************************************************************************
+ * Prepared Publishes
+ ******************************************************************************/
+
+struct aws_mqtt_prepared_publish {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+
+    enum aws_mqtt_qos qos;
+    bool retain;
+
+    /* Header of the encoded packet, used to size the messages it is written into */
+    struct aws_mqtt_fixed_header fixed_header;
+
+    /* The whole PUBLISH packet, encoded with a packet identifier of 0 and the DUP flag clear */
+    struct aws_byte_buf encoded_packet;
+
+    /* Offset of the packet identifier in encoded_packet, only meaningful for QoS > 0 */
+    size_t packet_identifier_offset;
+
+    /* Point into encoded_packet */
+    struct aws_byte_cursor topic;
+    struct aws_byte_cursor payload;
+};
+
+static void s_prepared_publish_destroy(struct aws_mqtt_prepared_publish *prepared) {
+    aws_byte_buf_clean_up(&prepared->encoded_packet);
+    aws_mem_release(prepared->allocator, prepared);
+}
+
+struct aws_mqtt_prepared_publish *aws_mqtt_prepared_publish_new(
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *topic,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload) {
+
+    AWS_PRECONDITION(allocator);
+    AWS_PRECONDITION(topic);
+    AWS_PRECONDITION(payload);
+
+    if (!aws_mqtt_is_valid_topic(topic)) {
+        aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+        return NULL;
+    }
+
+    struct aws_mqtt_prepared_publish *prepared = aws_mem_calloc(allocator, 1, sizeof(struct aws_mqtt_prepared_publish));
+    if (!prepared) {
+        return NULL;
+    }
+
+    prepared->allocator = allocator;
+    prepared->qos = qos;
+    prepared->retain = retain;
+
+    struct aws_mqtt_packet_publish publish;
+    if (aws_mqtt_packet_publish_init(&publish, retain, qos, false, *topic, 0, *payload)) {
+        goto handle_error;
+    }
+    prepared->fixed_header = publish.fixed_header;
+
+    if (aws_byte_buf_init(&prepared->encoded_packet, allocator, aws_mqtt_packet_encoded_size(&publish.fixed_header))) {
+        goto handle_error;
+    }
+    if (aws_mqtt_packet_publish_encode(&prepared->encoded_packet, &publish)) {
+        goto handle_error;
+    }
+
+    const size_t fixed_header_len = aws_mqtt_fixed_header_encoded_size(&publish.fixed_header);
+    uint8_t *topic_ptr = prepared->encoded_packet.buffer + fixed_header_len + sizeof(uint16_t);
+    prepared->topic = aws_byte_cursor_from_array(topic_ptr, topic->len);
+    prepared->packet_identifier_offset = fixed_header_len + sizeof(uint16_t) + topic->len;
+    prepared->payload = aws_byte_cursor_from_array(
+        prepared->encoded_packet.buffer + prepared->encoded_packet.len - payload->len, payload->len);
+
+    aws_ref_count_init(&prepared->ref_count, prepared, (aws_simple_completion_callback *)s_prepared_publish_destroy);
+
+    return prepared;
 
 handle_error:
 
-    aws_string_destroy(task_arg->filter_string);
-    aws_mem_release(connection->allocator, task_arg);
+    aws_byte_buf_clean_up(&prepared->encoded_packet);
+    aws_mem_release(allocator, prepared);
 
-    return 0;
+    return NULL;
+}
+
+struct aws_mqtt_prepared_publish *aws_mqtt_prepared_publish_acquire(struct aws_mqtt_prepared_publish *prepared) {
+    AWS_PRECONDITION(prepared);
+
+    aws_ref_count_acquire(&prepared->ref_count);
+    return prepared;
+}
+
+void aws_mqtt_prepared_publish_release(struct aws_mqtt_prepared_publish *prepared) {
+    if (prepared) {
+        aws_ref_count_release(&prepared->ref_count);
+    }
 }
 
 /*******************************************************************************
@@ -2657,14 +3306,24 @@ handle_error:
  ******************************************************************************/
 
 struct publish_task_arg {
+    struct aws_allocator *allocator;
     struct aws_mqtt_client_connection *connection;
+    /* Exactly one of topic_string, topic_handle and prepared is set, topic points into it */
     struct aws_string *topic_string;
+    struct aws_mqtt_topic_handle *topic_handle;
     struct aws_byte_cursor topic;
+
+    /* Set when sending a prepared publish, in which case payload points into it too and publish is unused */
+    struct aws_mqtt_prepared_publish *prepared;
     enum aws_mqtt_qos qos;
     bool retain;
     struct aws_byte_cursor payload;
     struct aws_byte_buf payload_buf;
 
+    /* Set when the payload is borrowed from the user rather than copied into payload_buf */
+    aws_mqtt_userdata_cleanup_fn *on_payload_release;
+    void *payload_release_ud;
+
     /* Packet to populate */
     struct aws_mqtt_packet_publish publish;
 
@@ -2672,8 +3331,78 @@ struct publish_task_arg {
     void *userdata;
 
     struct request_timeout_wrapper timeout_wrapper;
+
+    /*
+     * One reference is held by the request itself, plus one per in-flight payload message (see
+     * s_publish_payload_message_new). Topic and payload are freed when the last reference goes away.
+     */
+    struct aws_ref_count ref_count;
 };
 
+static void s_publish_task_arg_destroy(struct publish_task_arg *task_arg) {
+    if (task_arg->on_payload_release) {
+        task_arg->on_payload_release(task_arg->payload_release_ud);
+    }
+
+    aws_byte_buf_clean_up(&task_arg->payload_buf);
+    aws_string_destroy(task_arg->topic_string);
+    aws_mqtt_topic_handle_release(task_arg->topic_handle);
+    aws_mqtt_prepared_publish_release(task_arg->prepared);
+    aws_mem_release(task_arg->allocator, task_arg);
+}
+
+/*
+ * A write message whose data points straight at a publish payload instead of a copy of it. The message's allocator is
+ * a shim: when whichever handler ends up owning the message releases it, the shim frees the wrapper and drops the
+ * reference it held on the publish, so the payload stays valid for as long as the write is in flight even if the
+ * publish itself completes first (always the case for QoS 0).
+ */
+struct publish_payload_message {
+    struct aws_allocator shim_allocator;
+    struct aws_io_message message;
+    struct publish_task_arg *task_arg;
+};
+
+static void *s_publish_payload_message_mem_acquire(struct aws_allocator *allocator, size_t size) {
+    (void)allocator;
+    (void)size;
+
+    /* The shim only ever releases the message it is embedded in */
+    aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    return NULL;
+}
+
+static void s_publish_payload_message_mem_release(struct aws_allocator *allocator, void *ptr) {
+    struct publish_payload_message *payload_message = allocator->impl;
+    AWS_ASSERT(ptr == &payload_message->message);
+    (void)ptr;
+
+    struct publish_task_arg *task_arg = payload_message->task_arg;
+    aws_mem_release(task_arg->allocator, payload_message);
+    aws_ref_count_release(&task_arg->ref_count);
+}
+
+static struct aws_io_message *s_publish_payload_message_new(struct publish_task_arg *task_arg) {
+    struct publish_payload_message *payload_message =
+        aws_mem_calloc(task_arg->allocator, 1, sizeof(struct publish_payload_message));
+    if (!payload_message) {
+        return NULL;
+    }
+
+    payload_message->shim_allocator.mem_acquire = s_publish_payload_message_mem_acquire;
+    payload_message->shim_allocator.mem_release = s_publish_payload_message_mem_release;
+    payload_message->shim_allocator.impl = payload_message;
+
+    payload_message->message.allocator = &payload_message->shim_allocator;
+    payload_message->message.message_type = AWS_IO_MESSAGE_APPLICATION_DATA;
+    payload_message->message.message_data = aws_byte_buf_from_array(task_arg->payload.ptr, task_arg->payload.len);
+
+    payload_message->task_arg = task_arg;
+    aws_ref_count_acquire(&task_arg->ref_count);
+
+    return &payload_message->message;
+}
+
 /* should only be called by tests */
 static int s_get_stuff_from_outstanding_requests_table(
     struct aws_mqtt_client_connection *connection,
@@ -2685,23 +3414,21 @@ static int s_get_stuff_from_outstanding_requests_table(
     int err = AWS_OP_SUCCESS;
 
     aws_mutex_lock(&connection->synced_data.lock);
-    struct aws_hash_element *elem = NULL;
-    aws_hash_table_find(&connection->synced_data.outstanding_requests_table, &packet_id, &elem);
-    if (elem) {
-        struct aws_mqtt_request *request = elem->value;
+    struct aws_mqtt_request *request =
+        aws_mqtt_packet_id_table_find(&connection->synced_data.outstanding_requests_table, packet_id);
+    if (request) {
         struct publish_task_arg *pub = (struct publish_task_arg *)request->send_request_ud;
         if (result_buf != NULL) {
-            if (aws_byte_buf_init_copy(result_buf, allocator, &pub->payload_buf)) {
+            if (aws_byte_buf_init_copy_from_cursor(result_buf, allocator, pub->payload)) {
                 err = AWS_OP_ERR;
             }
         } else if (result_string != NULL) {
-            *result_string = aws_string_new_from_string(allocator, pub->topic_string);
+            *result_string = aws_string_new_from_array(allocator, pub->topic.ptr, pub->topic.len);
             if (*result_string == NULL) {
                 err = AWS_OP_ERR;
             }
         }
     } else {
-        /* So lovely that this error is defined, but hashtable never actually raises it */
         err = aws_raise_error(AWS_ERROR_HASHTBL_ITEM_NOT_FOUND);
     }
     aws_mutex_unlock(&connection->synced_data.lock);
@@ -2731,6 +3458,39 @@ int aws_mqtt_client_get_topic_for_outstanding_publish_packet(
     return s_get_stuff_from_outstanding_requests_table(connection, packet_id, allocator, NULL, result);
 }
 
+/*
+ * Writes everything but the payload of the publish. A prepared publish is copied as-is, with only its packet identifier
+ * and DUP flag patched for this attempt.
+ */
+static int s_publish_encode_headers(
+    struct aws_byte_buf *buf,
+    struct publish_task_arg *task_arg,
+    uint16_t packet_id,
+    bool is_first_attempt) {
+
+    struct aws_mqtt_prepared_publish *prepared = task_arg->prepared;
+    if (!prepared) {
+        return aws_mqtt_packet_publish_encode_headers(buf, &task_arg->publish);
+    }
+
+    const size_t headers_len = prepared->encoded_packet.len - prepared->payload.len;
+    uint8_t *headers = buf->buffer + buf->len;
+    if (!aws_byte_buf_write(buf, prepared->encoded_packet.buffer, headers_len)) {
+        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+    }
+
+    if (prepared->qos != AWS_MQTT_QOS_AT_MOST_ONCE) {
+        if (!is_first_attempt) {
+            /* [MQTT-3.3.1-1] */
+            headers[0] |= 1 << 3;
+        }
+        headers[prepared->packet_identifier_offset] = (uint8_t)(packet_id >> 8);
+        headers[prepared->packet_identifier_offset + 1] = (uint8_t)(packet_id & 0xFF);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static enum aws_mqtt_client_request_state s_publish_send(uint16_t packet_id, bool is_first_attempt, void *userdata) {
     struct publish_task_arg *task_arg = userdata;
     struct aws_mqtt_client_connection *connection = task_arg->connection;
@@ -2747,7 +3507,7 @@ static enum aws_mqtt_client_request_state s_publish_send(uint16_t packet_id, boo
         packet_id = 0;
     }
 
-    if (is_first_attempt) {
+    if (is_first_attempt && !task_arg->prepared) {
         if (aws_mqtt_packet_publish_init(
                 &task_arg->publish,
                 task_arg->retain,
@@ -2759,50 +3519,72 @@ static enum aws_mqtt_client_request_state s_publish_send(uint16_t packet_id, boo
 
             return AWS_MQTT_CLIENT_REQUEST_ERROR;
         }
-    }
 
-    struct aws_io_message *message = mqtt_get_message_for_packet(task_arg->connection, &task_arg->publish.fixed_header);
-    if (!message) {
-        return AWS_MQTT_CLIENT_REQUEST_ERROR;
-    }
-
-    /* Encode the headers, and everything but the payload */
-    if (aws_mqtt_packet_publish_encode_headers(&message->message_data, &task_arg->publish)) {
-        return AWS_MQTT_CLIENT_REQUEST_ERROR;
+        if (task_arg->topic_handle) {
+            task_arg->publish.encoded_topic_name = task_arg->topic_handle->encoded_topic;
+        }
     }
 
-    struct aws_byte_cursor payload_cur = task_arg->payload;
-    {
-    write_payload_chunk:
-        (void)NULL;
+    struct aws_mqtt_fixed_header *fixed_header =
+        task_arg->prepared ? &task_arg->prepared->fixed_header : &task_arg->publish.fixed_header;
 
-        const size_t left_in_message = message->message_data.capacity - message->message_data.len;
-        const size_t to_write = payload_cur.len < left_in_message ? payload_cur.len : left_in_message;
+    /* Publishes small enough are coalesced with everything else written during this event-loop tick */
+    struct aws_io_message *message = mqtt_get_coalesced_message_for_packet(connection, fixed_header);
+    if (message) {
+        /* The message has room for the whole packet, so writing the payload can't fail */
+        const size_t rollback_len = message->message_data.len;
+        if (s_publish_encode_headers(&message->message_data, task_arg, packet_id, is_first_attempt) ||
+            !aws_byte_buf_write_from_whole_cursor(&message->message_data, task_arg->payload)) {
+            message->message_data.len = rollback_len;
+            return AWS_MQTT_CLIENT_REQUEST_ERROR;
+        }
+    } else {
+        message = mqtt_get_message_for_packet(connection, fixed_header);
+        if (!message) {
+            return AWS_MQTT_CLIENT_REQUEST_ERROR;
+        }
 
-        if (to_write) {
-            /* Write this chunk */
-            struct aws_byte_cursor to_write_cur = aws_byte_cursor_advance(&payload_cur, to_write);
-            AWS_ASSERT(to_write_cur.ptr); /* to_write is guaranteed to be inside the bounds of payload_cur */
-            if (!aws_byte_buf_write_from_whole_cursor(&message->message_data, to_write_cur)) {
+        /* Encode the headers, and everything but the payload */
+        if (s_publish_encode_headers(&message->message_data, task_arg, packet_id, is_first_attempt)) {
+            return AWS_MQTT_CLIENT_REQUEST_ERROR;
+        }
 
+        /*
+         * Too large to be coalesced. If the payload still fits alongside the headers, copy it in and send a single
+         * message. Otherwise send the headers on their own, followed by one message that references the payload memory
+         * directly, rather than copying the payload through a chain of pooled messages.
+         */
+        struct aws_io_message *payload_message = NULL;
+        const size_t left_in_message = message->message_data.capacity - message->message_data.len;
+        if (task_arg->payload.len > left_in_message) {
+            payload_message = s_publish_payload_message_new(task_arg);
+            if (!payload_message) {
+                aws_mem_release(message->allocator, message);
+                return AWS_MQTT_CLIENT_REQUEST_ERROR;
+            }
+        } else if (task_arg->payload.len) {
+            if (!aws_byte_buf_write_from_whole_cursor(&message->message_data, task_arg->payload)) {
                 aws_mem_release(message->allocator, message);
                 return AWS_MQTT_CLIENT_REQUEST_ERROR;
             }
         }
 
-        if (aws_channel_slot_send_message(task_arg->connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+        if (mqtt_connection_send_message(connection, message)) {
             aws_mem_release(message->allocator, message);
+            if (payload_message) {
+                aws_mem_release(payload_message->allocator, payload_message);
+            }
             /* If it's QoS 0, telling user that the message haven't been sent, else, the message will be resent once the
              * connection is back */
             return is_qos_0 ? AWS_MQTT_CLIENT_REQUEST_ERROR : AWS_MQTT_CLIENT_REQUEST_ONGOING;
         }
 
-        /* If there's still payload left, get a new message and start again. */
-        if (payload_cur.len) {
-            message = mqtt_get_message_for_packet(task_arg->connection, &task_arg->publish.fixed_header);
-            goto write_payload_chunk;
+        if (payload_message && mqtt_connection_send_message(connection, payload_message)) {
+            aws_mem_release(payload_message->allocator, payload_message);
+            return is_qos_0 ? AWS_MQTT_CLIENT_REQUEST_ERROR : AWS_MQTT_CLIENT_REQUEST_ONGOING;
         }
     }
+
     if (!is_qos_0 && connection->operation_timeout_ns != UINT64_MAX) {
         /* TODO: timing should start from the message written into the socket, which is aws_io_message->on_completion
          * invoked, but there are bugs in the websocket handler (and maybe also the h1 handler?) where we don't properly
@@ -2848,45 +3630,106 @@ static void s_publish_complete(
         task_arg->timeout_wrapper.timeout_task_arg = NULL;
     }
 
-    aws_byte_buf_clean_up(&task_arg->payload_buf);
-    aws_string_destroy(task_arg->topic_string);
-    aws_mem_release(connection->allocator, task_arg);
+    aws_ref_count_release(&task_arg->ref_count);
 }
 
-uint16_t aws_mqtt_client_connection_publish(
+/*
+ * Allocates the task arg for a single publish. If on_payload_release is NULL the payload is copied, otherwise the
+ * cursor is referenced as-is and on_payload_release is invoked once the last reference to the task arg goes away.
+ * Likewise, topic is copied unless a topic_handle is given, in which case the handle is referenced and topic ignored.
+ */
+static struct publish_task_arg *s_publish_task_arg_new(
     struct aws_mqtt_client_connection *connection,
     const struct aws_byte_cursor *topic,
+    struct aws_mqtt_topic_handle *topic_handle,
     enum aws_mqtt_qos qos,
     bool retain,
     const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
     aws_mqtt_op_complete_fn *on_complete,
     void *userdata) {
 
-    AWS_PRECONDITION(connection);
-
-    if (!aws_mqtt_is_valid_topic(topic)) {
-        aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
-        return 0;
-    }
-
     struct publish_task_arg *arg = aws_mem_calloc(connection->allocator, 1, sizeof(struct publish_task_arg));
     if (!arg) {
-        return 0;
+        return NULL;
     }
 
+    arg->allocator = connection->allocator;
     arg->connection = connection;
-    arg->topic_string = aws_string_new_from_array(connection->allocator, topic->ptr, topic->len);
-    arg->topic = aws_byte_cursor_from_string(arg->topic_string);
+    if (topic_handle) {
+        arg->topic_handle = aws_mqtt_topic_handle_acquire(topic_handle);
+        arg->topic = topic_handle->topic;
+    } else {
+        arg->topic_string = aws_string_new_from_array(connection->allocator, topic->ptr, topic->len);
+        if (!arg->topic_string) {
+            goto handle_error;
+        }
+        arg->topic = aws_byte_cursor_from_string(arg->topic_string);
+    }
     arg->qos = qos;
     arg->retain = retain;
-    if (aws_byte_buf_init_copy_from_cursor(&arg->payload_buf, connection->allocator, *payload)) {
-        goto handle_error;
+    if (on_payload_release) {
+        arg->payload = *payload;
+    } else {
+        if (aws_byte_buf_init_copy_from_cursor(&arg->payload_buf, connection->allocator, *payload)) {
+            goto handle_error;
+        }
+        arg->payload = aws_byte_cursor_from_buf(&arg->payload_buf);
+    }
+    arg->on_payload_release = on_payload_release;
+    arg->payload_release_ud = payload_release_ud;
+    arg->on_complete = on_complete;
+    arg->userdata = userdata;
+    aws_ref_count_init(&arg->ref_count, arg, (aws_simple_completion_callback *)s_publish_task_arg_destroy);
+
+    return arg;
+
+handle_error:
+
+    aws_string_destroy(arg->topic_string);
+    aws_mqtt_topic_handle_release(arg->topic_handle);
+    aws_byte_buf_clean_up(&arg->payload_buf);
+    aws_mem_release(connection->allocator, arg);
+
+    return NULL;
+}
+
+/* Allocates the task arg for sending a prepared publish, which is referenced rather than copied */
+static struct publish_task_arg *s_publish_task_arg_new_prepared(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_prepared_publish *prepared,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    struct publish_task_arg *arg = aws_mem_calloc(connection->allocator, 1, sizeof(struct publish_task_arg));
+    if (!arg) {
+        return NULL;
     }
-    arg->payload = aws_byte_cursor_from_buf(&arg->payload_buf);
+
+    arg->allocator = connection->allocator;
+    arg->connection = connection;
+    arg->prepared = aws_mqtt_prepared_publish_acquire(prepared);
+    arg->topic = prepared->topic;
+    arg->qos = prepared->qos;
+    arg->retain = prepared->retain;
+    arg->payload = prepared->payload;
     arg->on_complete = on_complete;
     arg->userdata = userdata;
+    aws_ref_count_init(&arg->ref_count, arg, (aws_simple_completion_callback *)s_publish_task_arg_destroy);
+
+    return arg;
+}
+
+/* Frees a task arg that never made it into a request. A borrowed payload is left with the caller. */
+static void s_publish_task_arg_discard(struct publish_task_arg *arg) {
+    arg->on_payload_release = NULL;
+    aws_ref_count_release(&arg->ref_count);
+}
 
-    bool retry = qos == AWS_MQTT_QOS_AT_MOST_ONCE;
+/* Hands a publish over to the connection, or discards it on failure */
+static uint16_t s_publish_start(struct aws_mqtt_client_connection *connection, struct publish_task_arg *arg) {
+    bool retry = arg->qos == AWS_MQTT_QOS_AT_MOST_ONCE;
     uint16_t packet_id = mqtt_create_request(connection, &s_publish_send, arg, &s_publish_complete, arg, retry);
 
     if (packet_id == 0) {
@@ -2895,10 +3738,11 @@ uint16_t aws_mqtt_client_connection_publish(
             AWS_LS_MQTT_CLIENT,
             "id=%p: Failed starting publish to topic " PRInSTR ",error %d (%s)",
             (void *)connection,
-            AWS_BYTE_CURSOR_PRI(*topic),
+            AWS_BYTE_CURSOR_PRI(arg->topic),
             aws_last_error(),
             aws_error_name(aws_last_error()));
-        goto handle_error;
+        s_publish_task_arg_discard(arg);
+        return 0;
     }
 
     AWS_LOGF_DEBUG(
@@ -2906,21 +3750,213 @@ uint16_t aws_mqtt_client_connection_publish(
         "id=%p: Starting publish %" PRIu16 " to topic " PRInSTR,
         (void *)connection,
         packet_id,
-        AWS_BYTE_CURSOR_PRI(*topic));
+        AWS_BYTE_CURSOR_PRI(arg->topic));
     return packet_id;
+}
 
-handle_error:
+/* Shared by the copying and borrowing publish variants. A registered topic_handle was validated when created. */
+static uint16_t s_publish_common(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    struct aws_mqtt_topic_handle *topic_handle,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    AWS_PRECONDITION(connection);
 
-    /* we know arg is valid, topic_string may or may not be valid */
-    if (arg->topic_string) {
-        aws_string_destroy(arg->topic_string);
+    if (topic_handle) {
+        topic = &topic_handle->topic;
+    } else if (!aws_mqtt_is_valid_topic(topic)) {
+        aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+        return 0;
     }
 
-    aws_byte_buf_clean_up(&arg->payload_buf);
+    struct publish_task_arg *arg = s_publish_task_arg_new(
+        connection,
+        topic,
+        topic_handle,
+        qos,
+        retain,
+        payload,
+        on_payload_release,
+        payload_release_ud,
+        on_complete,
+        userdata);
+    if (!arg) {
+        return 0;
+    }
 
-    aws_mem_release(connection->allocator, arg);
+    return s_publish_start(connection, arg);
+}
 
-    return 0;
+uint16_t aws_mqtt_client_connection_publish(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    return s_publish_common(connection, topic, NULL, qos, retain, payload, NULL, NULL, on_complete, userdata);
+}
+
+uint16_t aws_mqtt_client_connection_publish_no_copy(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    /* Without it the payload would have to be copied, which is what aws_mqtt_client_connection_publish() is for */
+    if (!on_payload_release) {
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    return s_publish_common(
+        connection, topic, NULL, qos, retain, payload, on_payload_release, payload_release_ud, on_complete, userdata);
+}
+
+uint16_t aws_mqtt_client_connection_publish_with_topic_handle(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_topic_handle *topic_handle,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    const struct aws_byte_cursor *payload,
+    aws_mqtt_userdata_cleanup_fn *on_payload_release,
+    void *payload_release_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    AWS_PRECONDITION(topic_handle);
+
+    return s_publish_common(
+        connection,
+        NULL,
+        topic_handle,
+        qos,
+        retain,
+        payload,
+        on_payload_release,
+        payload_release_ud,
+        on_complete,
+        userdata);
+}
+
+uint16_t aws_mqtt_client_connection_publish_prepared(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_prepared_publish *prepared,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *userdata) {
+
+    AWS_PRECONDITION(connection);
+    AWS_PRECONDITION(prepared);
+
+    struct publish_task_arg *arg = s_publish_task_arg_new_prepared(connection, prepared, on_complete, userdata);
+    if (!arg) {
+        return 0;
+    }
+
+    return s_publish_start(connection, arg);
+}
+
+int aws_mqtt_client_connection_publish_batch(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_publish_batch_entry *entries,
+    size_t entry_count,
+    uint16_t *out_packet_ids) {
+
+    AWS_PRECONDITION(connection);
+    AWS_PRECONDITION(entries || entry_count == 0);
+
+    if (entry_count == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    for (size_t i = 0; i < entry_count; ++i) {
+        if (!entries[i].topic_handle && !aws_mqtt_is_valid_topic(&entries[i].topic)) {
+            return aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+        }
+    }
+
+    struct aws_mqtt_request_batch_entry *requests =
+        aws_mem_calloc(connection->allocator, entry_count, sizeof(struct aws_mqtt_request_batch_entry));
+    if (!requests) {
+        return AWS_OP_ERR;
+    }
+
+    size_t args_created = 0;
+    for (; args_created < entry_count; ++args_created) {
+        const struct aws_mqtt_publish_batch_entry *entry = &entries[args_created];
+        struct publish_task_arg *arg = s_publish_task_arg_new(
+            connection,
+            &entry->topic,
+            entry->topic_handle,
+            entry->qos,
+            entry->retain,
+            &entry->payload,
+            NULL,
+            NULL,
+            entry->on_complete,
+            entry->userdata);
+        if (!arg) {
+            goto handle_error;
+        }
+
+        struct aws_mqtt_request_batch_entry *request = &requests[args_created];
+        request->send_request = &s_publish_send;
+        request->send_request_ud = arg;
+        request->on_complete = &s_publish_complete;
+        request->on_complete_ud = arg;
+        request->no_retry = entry->qos == AWS_MQTT_QOS_AT_MOST_ONCE;
+    }
+
+    if (mqtt_create_request_batch(connection, requests, entry_count)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Failed starting batch of %zu publishes, error %d (%s)",
+            (void *)connection,
+            entry_count,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        goto handle_error;
+    }
+
+    if (out_packet_ids) {
+        for (size_t i = 0; i < entry_count; ++i) {
+            out_packet_ids[i] = requests[i].packet_id;
+        }
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Starting batch of %zu publishes, packet ids %" PRIu16 " to %" PRIu16,
+        (void *)connection,
+        entry_count,
+        requests[0].packet_id,
+        requests[entry_count - 1].packet_id);
+
+    aws_mem_release(connection->allocator, requests);
+    return AWS_OP_SUCCESS;
+
+handle_error:
+
+    for (size_t i = 0; i < args_created; ++i) {
+        s_publish_task_arg_discard(requests[i].send_request_ud);
+    }
+    aws_mem_release(connection->allocator, requests);
+
+    return AWS_OP_ERR;
 }
 
 /*******************************************************************************
@@ -2954,18 +3990,14 @@ static enum aws_mqtt_client_request_state s_pingreq_send(uint16_t packet_id, boo
     struct aws_mqtt_packet_connection pingreq;
     aws_mqtt_packet_pingreq_init(&pingreq);
 
-    struct aws_io_message *message = mqtt_get_message_for_packet(connection, &pingreq.fixed_header);
+    struct aws_io_message *message = mqtt_get_coalesced_message_for_packet(connection, &pingreq.fixed_header);
     if (!message) {
         return AWS_MQTT_CLIENT_REQUEST_ERROR;
     }
 
+    const size_t rollback_len = message->message_data.len;
     if (aws_mqtt_packet_connection_encode(&message->message_data, &pingreq)) {
-        aws_mem_release(message->allocator, message);
-        return AWS_MQTT_CLIENT_REQUEST_ERROR;
-    }
-
-    if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
-        aws_mem_release(message->allocator, message);
+        message->message_data.len = rollback_len;
         return AWS_MQTT_CLIENT_REQUEST_ERROR;
     }
 
@@ -3001,3 +4033,17 @@ int aws_mqtt_client_connection_ping(struct aws_mqtt_client_connection *connectio
 
     return (packet_id > 0) ? AWS_OP_SUCCESS : AWS_OP_ERR;
 }
+
+size_t aws_mqtt_client_connection_get_packet_ids_in_use(struct aws_mqtt_client_connection *connection) {
+
+    AWS_PRECONDITION(connection);
+
+    size_t packet_ids_in_use = 0;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
+        packet_ids_in_use = aws_mqtt_packet_id_set_count(&connection->synced_data.packet_ids_in_use);
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+
+    return packet_ids_in_use;
+}
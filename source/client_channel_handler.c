@@ -20,6 +20,123 @@
 #    pragma warning(disable : 4204)
 #endif
 
+/* How many packets of a read are indexed at a time before dispatching them, see aws_mqtt_frame_index_scan() */
+#define MQTT_READ_FRAME_INDEX_SIZE 32
+
+/*******************************************************************************
+ * Write Coalescing
+ ******************************************************************************/
+
+/*
+ * Small packets (acks, pings, small publishes) are encoded back to back into one pending-write message instead of each
+ * getting its own aws_io_message, so that a burst of them costs one syscall (and one TLS record) instead of one each.
+ * The message is capped at the channel's max fragment size, which is also the largest TLS record.
+ */
+
+static void s_release_pending_write(struct aws_mqtt_client_connection *connection) {
+    struct aws_io_message *message = connection->thread_data.pending_write;
+    if (message) {
+        connection->thread_data.pending_write = NULL;
+        aws_mem_release(message->allocator, message);
+    }
+}
+
+static void s_flush_pending_write_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_mqtt_client_connection *connection = arg;
+
+    connection->thread_data.flush_pending_write_task_scheduled = false;
+
+    if (status == AWS_TASK_STATUS_CANCELED) {
+        /* The channel is going away, along with anything still waiting to be written to it */
+        s_release_pending_write(connection);
+        return;
+    }
+
+    mqtt_connection_flush_pending_write(connection);
+}
+
+void mqtt_connection_flush_pending_write(struct aws_mqtt_client_connection *connection) {
+    struct aws_io_message *message = connection->thread_data.pending_write;
+    if (!message) {
+        return;
+    }
+
+    if (message->message_data.len == 0) {
+        s_release_pending_write(connection);
+        return;
+    }
+
+    connection->thread_data.pending_write = NULL;
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Flushing %zu bytes of coalesced packets",
+        (void *)connection,
+        message->message_data.len);
+
+    if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
+        /* Only fails if the channel is shutting down. Anything expecting an ack will be retried on reconnect. */
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Failed to send coalesced packets, error %d (%s)",
+            (void *)connection,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        aws_mem_release(message->allocator, message);
+    }
+}
+
+struct aws_io_message *mqtt_get_coalesced_message_for_packet(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_fixed_header *header) {
+
+    const size_t required_length = aws_mqtt_packet_encoded_size(header);
+    if (required_length > g_aws_channel_max_fragment_size) {
+        return NULL;
+    }
+
+    struct aws_io_message *message = connection->thread_data.pending_write;
+    if (message && message->message_data.capacity - message->message_data.len >= required_length) {
+        return message;
+    }
+
+    /* Doesn't fit after what's already pending, send that out and start a new one */
+    mqtt_connection_flush_pending_write(connection);
+
+    message = aws_channel_acquire_message_from_pool(
+        connection->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, g_aws_channel_max_fragment_size);
+    if (!message) {
+        return NULL;
+    }
+
+    if (message->message_data.capacity < required_length) {
+        aws_mem_release(message->allocator, message);
+        return NULL;
+    }
+
+    connection->thread_data.pending_write = message;
+
+    if (!connection->thread_data.flush_pending_write_task_scheduled) {
+        connection->thread_data.flush_pending_write_task_scheduled = true;
+        aws_channel_task_init(
+            &connection->thread_data.flush_pending_write_task,
+            s_flush_pending_write_task,
+            connection,
+            "mqtt_flush_pending_write");
+        aws_channel_schedule_task_now(connection->slot->channel, &connection->thread_data.flush_pending_write_task);
+    }
+
+    return message;
+}
+
+int mqtt_connection_send_message(struct aws_mqtt_client_connection *connection, struct aws_io_message *message) {
+    /* Whatever was coalesced so far was encoded first, so it has to be written first */
+    mqtt_connection_flush_pending_write(connection);
+
+    return aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE);
+}
+
 /*******************************************************************************
  * Packet State Machine
  ******************************************************************************/
@@ -36,6 +153,22 @@ static int s_packet_handler_default(
     return aws_raise_error(AWS_ERROR_MQTT_INVALID_PACKET_TYPE);
 }
 
+/* Acks are tiny, they're always coalesced with whatever else is written this tick */
+static int s_send_ack(struct aws_mqtt_client_connection *connection, struct aws_mqtt_packet_ack *ack) {
+    struct aws_io_message *message = mqtt_get_coalesced_message_for_packet(connection, &ack->fixed_header);
+    if (!message) {
+        return AWS_OP_ERR;
+    }
+
+    const size_t rollback_len = message->message_data.len;
+    if (aws_mqtt_packet_ack_encode(&message->message_data, ack)) {
+        message->message_data.len = rollback_len;
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static void s_on_time_to_ping(struct aws_channel_task *channel_task, void *arg, enum aws_task_status status);
 static void s_schedule_ping(struct aws_mqtt_client_connection *connection) {
     aws_channel_task_init(&connection->ping_task, s_on_time_to_ping, connection, "mqtt_ping");
@@ -106,6 +239,17 @@ static int s_packet_handler_connack(
         mqtt_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
     connection->connection_count++;
+    /* Publishes received from here on are acked over this channel */
+    connection->thread_data.publish_ack_generation++;
+    /* Acks left behind by a publish ack task canceled along with the previous channel */
+    mqtt_connection_schedule_pending_publish_acks(connection);
+
+    /* Without a session, the server won't resend or release any QoS 2 publish received so far */
+    if (connack.connect_return_code == AWS_MQTT_CONNECT_ACCEPTED && !connack.session_present) {
+        aws_mqtt_packet_id_set_clear(&connection->thread_data.qos2_publishes_received);
+        aws_mqtt_packet_id_set_clear(&connection->thread_data.qos2_publishes_unacked);
+        connection->thread_data.qos2_session_generation = connection->thread_data.publish_ack_generation;
+    }
 
     uint64_t now = 0;
     aws_high_res_clock_get_ticks(&now);
@@ -185,34 +329,11 @@ static int s_packet_handler_connack(
     return AWS_OP_SUCCESS;
 }
 
-static int s_packet_handler_publish(
+int mqtt_connection_send_publish_ack(
     struct aws_mqtt_client_connection *connection,
-    struct aws_byte_cursor message_cursor) {
-
-    /* TODO: need to handle the QoS 2 message to avoid processing the message a second time */
-    struct aws_mqtt_packet_publish publish;
-    if (aws_mqtt_packet_publish_decode(&message_cursor, &publish)) {
-        return AWS_OP_ERR;
-    }
-
-    aws_mqtt_topic_tree_publish(&connection->thread_data.subscriptions, &publish);
-
-    bool dup = aws_mqtt_packet_publish_get_dup(&publish);
-    enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(&publish);
-    bool retain = aws_mqtt_packet_publish_get_retain(&publish);
-
-    MQTT_CLIENT_CALL_CALLBACK_ARGS(connection, on_any_publish, &publish.topic_name, &publish.payload, dup, qos, retain);
+    enum aws_mqtt_qos qos,
+    uint16_t packet_identifier) {
 
-    AWS_LOGF_TRACE(
-        AWS_LS_MQTT_CLIENT,
-        "id=%p: publish received with msg id=%" PRIu16 " dup=%d qos=%d retain=%d payload-size=%zu topic=" PRInSTR,
-        (void *)connection,
-        publish.packet_identifier,
-        dup,
-        qos,
-        retain,
-        publish.payload.len,
-        AWS_BYTE_CURSOR_PRI(publish.topic_name));
     struct aws_mqtt_packet_ack puback;
     AWS_ZERO_STRUCT(puback);
 
@@ -225,11 +346,11 @@ static int s_packet_handler_publish(
             break;
         case AWS_MQTT_QOS_AT_LEAST_ONCE:
             AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: received publish QOS is 1, sending puback", (void *)connection);
-            aws_mqtt_packet_puback_init(&puback, publish.packet_identifier);
+            aws_mqtt_packet_puback_init(&puback, packet_identifier);
             break;
         case AWS_MQTT_QOS_EXACTLY_ONCE:
             AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: received publish QOS is 2, sending pubrec", (void *)connection);
-            aws_mqtt_packet_pubrec_init(&puback, publish.packet_identifier);
+            aws_mqtt_packet_pubrec_init(&puback, packet_identifier);
             break;
         default:
             /* Impossible to hit this branch. QoS value is checked when decoding */
@@ -238,23 +359,248 @@ static int s_packet_handler_publish(
     }
 
     if (puback.packet_identifier) {
-        struct aws_io_message *message = mqtt_get_message_for_packet(connection, &puback.fixed_header);
-        if (!message) {
-            return AWS_OP_ERR;
+        return s_send_ack(connection, &puback);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Keeps size bytes of delivered publish payload out of the read window, if the user manages it. */
+static void s_hold_back_read_window(struct aws_mqtt_client_connection *connection, size_t size) {
+    if (connection->manual_window.enabled) {
+        connection->thread_data.read_window_debt += size;
+    }
+}
+
+/* Sets the token aws_mqtt_client_connection_get_publish_ack_token() returns while the publish is delivered. */
+static void s_set_publish_ack_token(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_qos qos,
+    uint16_t packet_identifier) {
+
+    /* The generation, then the QoS, then the packet identifier */
+    connection->thread_data.publish_ack_token.value = 0;
+    if (connection->manual_publish_acks && qos != AWS_MQTT_QOS_AT_MOST_ONCE) {
+        const uint64_t generation = connection->thread_data.publish_ack_generation;
+        connection->thread_data.publish_ack_token.value =
+            (generation << 32) | ((uint64_t)qos << 16) | packet_identifier;
+    }
+}
+
+/* Acks a publish once it's been delivered, unless the user does that. */
+static int s_on_publish_delivered(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_qos qos,
+    uint16_t packet_identifier) {
+
+    connection->thread_data.publish_ack_token.value = 0;
+
+    if (connection->manual_publish_acks && qos != AWS_MQTT_QOS_AT_MOST_ONCE) {
+        AWS_LOGF_TRACE(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: waiting on the user to ack publish with msg id=%" PRIu16,
+            (void *)connection,
+            packet_identifier);
+        if (qos == AWS_MQTT_QOS_EXACTLY_ONCE) {
+            aws_mqtt_packet_id_set_add(&connection->thread_data.qos2_publishes_unacked, packet_identifier);
         }
+        return AWS_OP_SUCCESS;
+    }
 
-        if (aws_mqtt_packet_ack_encode(&message->message_data, &puback)) {
-            aws_mem_release(message->allocator, message);
-            return AWS_OP_ERR;
+    return mqtt_connection_send_publish_ack(connection, qos, packet_identifier);
+}
+
+/* True if publish is a QoS 2 publish resent by the server after it was delivered, but before it was released */
+static bool s_is_qos2_redelivery(struct aws_mqtt_client_connection *connection, enum aws_mqtt_qos qos, uint16_t id) {
+    return qos == AWS_MQTT_QOS_EXACTLY_ONCE &&
+           aws_mqtt_packet_id_set_contains(&connection->thread_data.qos2_publishes_received, id);
+}
+
+/**
+ * Acks a resent QoS 2 publish that was already delivered. Unless the user has yet to ack the original: acking the
+ * resend would let the server complete the exchange before the user is done with the publish.
+ */
+static int s_on_qos2_redelivered(struct aws_mqtt_client_connection *connection, uint16_t packet_identifier) {
+    if (connection->manual_publish_acks &&
+        aws_mqtt_packet_id_set_contains(&connection->thread_data.qos2_publishes_unacked, packet_identifier)) {
+        AWS_LOGF_TRACE(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: still waiting on the user to ack publish with msg id=%" PRIu16,
+            (void *)connection,
+            packet_identifier);
+        return AWS_OP_SUCCESS;
+    }
+
+    return mqtt_connection_send_publish_ack(connection, AWS_MQTT_QOS_EXACTLY_ONCE, packet_identifier);
+}
+
+static void s_remember_qos2_publish(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_qos qos,
+    uint16_t packet_identifier) {
+
+    if (qos == AWS_MQTT_QOS_EXACTLY_ONCE) {
+        aws_mqtt_packet_id_set_add(&connection->thread_data.qos2_publishes_received, packet_identifier);
+    }
+}
+
+static bool s_should_stream_publish(struct aws_mqtt_client_connection *connection, size_t payload_size) {
+    return connection->publish_stream_options.on_begin &&
+           payload_size >= connection->publish_stream_options.min_payload_size;
+}
+
+/**
+ * Starts passing the payload of publish to the publish stream handler. Everything of publish but its payload must be
+ * valid, payload_size is the size of the payload still to arrive.
+ */
+static void s_publish_stream_begin(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_packet_publish *publish,
+    size_t payload_size) {
+
+    AWS_ASSERT(!connection->thread_data.publish_stream.active);
+
+    bool dup = aws_mqtt_packet_publish_get_dup(publish);
+    enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(publish);
+    bool retain = aws_mqtt_packet_publish_get_retain(publish);
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: streaming publish with msg id=%" PRIu16 " dup=%d qos=%d retain=%d payload-size=%zu topic=" PRInSTR,
+        (void *)connection,
+        publish->packet_identifier,
+        dup,
+        qos,
+        retain,
+        payload_size,
+        AWS_BYTE_CURSOR_PRI(publish->topic_name));
+
+    connection->thread_data.publish_stream.active = true;
+    connection->thread_data.publish_stream.payload_remaining = payload_size;
+    connection->thread_data.publish_stream.packet_identifier = publish->packet_identifier;
+    connection->thread_data.publish_stream.qos = qos;
+    const bool redelivery = s_is_qos2_redelivery(connection, qos, publish->packet_identifier);
+    connection->thread_data.publish_stream.redelivery = redelivery;
+    if (redelivery) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: skipping resent QoS 2 publish with msg id=%" PRIu16 ", it was already delivered",
+            (void *)connection,
+            publish->packet_identifier);
+        return;
+    }
+    s_set_publish_ack_token(connection, qos, publish->packet_identifier);
+
+    const struct aws_mqtt_publish_stream_options *options = &connection->publish_stream_options;
+    options->on_begin(connection, &publish->topic_name, payload_size, dup, qos, retain, options->user_data);
+}
+
+/**
+ * Passes as much of data as belongs to the streamed publish to the publish stream handler. Once all of the payload has
+ * been passed, ends the stream and acks the publish.
+ */
+static int s_publish_stream_write(struct aws_mqtt_client_connection *connection, struct aws_byte_cursor *data) {
+    AWS_ASSERT(connection->thread_data.publish_stream.active);
+
+    const struct aws_mqtt_publish_stream_options *options = &connection->publish_stream_options;
+
+    size_t to_write = connection->thread_data.publish_stream.payload_remaining;
+    if (to_write > data->len) {
+        to_write = data->len;
+    }
+    const bool redelivery = connection->thread_data.publish_stream.redelivery;
+    if (to_write) {
+        struct aws_byte_cursor chunk = aws_byte_cursor_advance(data, to_write);
+        connection->thread_data.publish_stream.payload_remaining -= to_write;
+        if (!redelivery) {
+            s_hold_back_read_window(connection, to_write);
+            options->on_chunk(connection, &chunk, options->user_data);
         }
+    }
+
+    if (connection->thread_data.publish_stream.payload_remaining) {
+        return AWS_OP_SUCCESS;
+    }
+
+    AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: streamed publish complete", (void *)connection);
+    connection->thread_data.publish_stream.active = false;
+
+    const enum aws_mqtt_qos qos = connection->thread_data.publish_stream.qos;
+    const uint16_t packet_identifier = connection->thread_data.publish_stream.packet_identifier;
+    if (redelivery) {
+        return s_on_qos2_redelivered(connection, packet_identifier);
+    }
+
+    /* Only a publish streamed to the end counts as delivered, one cut short will be resent in full */
+    s_remember_qos2_publish(connection, qos, packet_identifier);
+    options->on_end(connection, AWS_ERROR_SUCCESS, options->user_data);
+
+    return s_on_publish_delivered(connection, qos, packet_identifier);
+}
+
+static int s_packet_handler_publish(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_byte_cursor message_cursor) {
+
+    struct aws_mqtt_packet_publish publish;
+    if (aws_mqtt_packet_publish_decode(&message_cursor, &publish)) {
+        return AWS_OP_ERR;
+    }
+
+    /* The whole payload is already here, so it's streamed in one chunk */
+    if (s_should_stream_publish(connection, publish.payload.len)) {
+        s_publish_stream_begin(connection, &publish, publish.payload.len);
+        return s_publish_stream_write(connection, &publish.payload);
+    }
+
+    bool dup = aws_mqtt_packet_publish_get_dup(&publish);
+    enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(&publish);
+    bool retain = aws_mqtt_packet_publish_get_retain(&publish);
 
-        if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
-            aws_mem_release(message->allocator, message);
+    /* The server resends a QoS 2 publish until it gets the PUBREC, which may have been lost along with a connection */
+    if (s_is_qos2_redelivery(connection, qos, publish.packet_identifier)) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: skipping resent QoS 2 publish with msg id=%" PRIu16 ", it was already delivered",
+            (void *)connection,
+            publish.packet_identifier);
+        return s_on_qos2_redelivered(connection, publish.packet_identifier);
+    }
+    s_remember_qos2_publish(connection, qos, publish.packet_identifier);
+
+    s_set_publish_ack_token(connection, qos, publish.packet_identifier);
+
+    if (connection->on_any_publish_batch) {
+        struct aws_mqtt_publish_view view = {
+            .topic = publish.topic_name,
+            .payload = publish.payload,
+            .dup = dup,
+            .qos = qos,
+            .retain = retain,
+            .ack_token = connection->thread_data.publish_ack_token,
+        };
+        if (aws_array_list_push_back(&connection->thread_data.publish_batch, &view)) {
             return AWS_OP_ERR;
         }
     }
 
-    return AWS_OP_SUCCESS;
+    aws_mqtt_topic_tree_publish(&connection->thread_data.subscriptions, &publish);
+    s_hold_back_read_window(connection, publish.payload.len);
+
+    MQTT_CLIENT_CALL_CALLBACK_ARGS(connection, on_any_publish, &publish.topic_name, &publish.payload, dup, qos, retain);
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: publish received with msg id=%" PRIu16 " dup=%d qos=%d retain=%d payload-size=%zu topic=" PRInSTR,
+        (void *)connection,
+        publish.packet_identifier,
+        dup,
+        qos,
+        retain,
+        publish.payload.len,
+        AWS_BYTE_CURSOR_PRI(publish.topic_name));
+
+    return s_on_publish_delivered(connection, qos, publish.packet_identifier);
 }
 
 static int s_packet_handler_ack(struct aws_mqtt_client_connection *connection, struct aws_byte_cursor message_cursor) {
@@ -293,11 +639,8 @@ static int s_packet_handler_suback(
 
     { /* BEGIN CRITICAL SECTION */
         mqtt_connection_lock_synced_data(connection);
-        struct aws_hash_element *elem = NULL;
-        aws_hash_table_find(&connection->synced_data.outstanding_requests_table, &suback.packet_identifier, &elem);
-        if (elem != NULL) {
-            request = elem->value;
-        }
+        request = aws_mqtt_packet_id_table_find(
+            &connection->synced_data.outstanding_requests_table, suback.packet_identifier);
         mqtt_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
 
@@ -345,28 +688,7 @@ static int s_packet_handler_pubrec(
 
     /* Send PUBREL */
     aws_mqtt_packet_pubrel_init(&ack, ack.packet_identifier);
-    struct aws_io_message *message = mqtt_get_message_for_packet(connection, &ack.fixed_header);
-    if (!message) {
-        return AWS_OP_ERR;
-    }
-
-    if (aws_mqtt_packet_ack_encode(&message->message_data, &ack)) {
-        goto on_error;
-    }
-
-    if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
-        goto on_error;
-    }
-
-    return AWS_OP_SUCCESS;
-
-on_error:
-
-    if (message) {
-        aws_mem_release(message->allocator, message);
-    }
-
-    return AWS_OP_ERR;
+    return s_send_ack(connection, &ack);
 }
 
 static int s_packet_handler_pubrel(
@@ -378,30 +700,18 @@ static int s_packet_handler_pubrel(
         return AWS_OP_ERR;
     }
 
-    /* Send PUBCOMP */
-    aws_mqtt_packet_pubcomp_init(&ack, ack.packet_identifier);
-    struct aws_io_message *message = mqtt_get_message_for_packet(connection, &ack.fixed_header);
-    if (!message) {
-        return AWS_OP_ERR;
-    }
-
-    if (aws_mqtt_packet_ack_encode(&message->message_data, &ack)) {
-        goto on_error;
-    }
-
-    if (aws_channel_slot_send_message(connection->slot, message, AWS_CHANNEL_DIR_WRITE)) {
-        goto on_error;
-    }
-
-    return AWS_OP_SUCCESS;
-
-on_error:
-
-    if (message) {
-        aws_mem_release(message->allocator, message);
+    /* The server won't resend the publish anymore, so its packet ID may be used for a new one */
+    if (aws_mqtt_packet_id_set_remove(&connection->thread_data.qos2_publishes_received, ack.packet_identifier)) {
+        AWS_LOGF_TRACE(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: QoS 2 publish with msg id=%" PRIu16 " released",
+            (void *)connection,
+            ack.packet_identifier);
     }
 
-    return AWS_OP_ERR;
+    /* Send PUBCOMP */
+    aws_mqtt_packet_pubcomp_init(&ack, ack.packet_identifier);
+    return s_send_ack(connection, &ack);
 }
 
 static int s_packet_handler_pingresp(
@@ -439,10 +749,10 @@ static packet_handler_fn *s_packet_handlers[] = {
  * Channel Handler
  ******************************************************************************/
 
-static int s_process_mqtt_packet(
+/* Fails the connection if a packet of packet_type can't be received in its current state. */
+static int s_check_packet_expected(
     struct aws_mqtt_client_connection *connection,
-    enum aws_mqtt_packet_type packet_type,
-    struct aws_byte_cursor packet) {
+    enum aws_mqtt_packet_type packet_type) {
     { /* BEGIN CRITICAL SECTION */
         mqtt_connection_lock_synced_data(connection);
         /* [MQTT-3.2.0-1] The first packet sent from the Server to the Client MUST be a CONNACK Packet */
@@ -459,6 +769,18 @@ static int s_process_mqtt_packet(
         mqtt_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
 
+    return AWS_OP_SUCCESS;
+}
+
+static int s_process_mqtt_packet(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_packet_type packet_type,
+    struct aws_byte_cursor packet) {
+
+    if (s_check_packet_expected(connection, packet_type)) {
+        return AWS_OP_ERR;
+    }
+
     if (AWS_UNLIKELY(packet_type > AWS_MQTT_PACKET_DISCONNECT || packet_type < AWS_MQTT_PACKET_CONNECT)) {
         AWS_LOGF_ERROR(
             AWS_LS_MQTT_CLIENT,
@@ -472,6 +794,250 @@ static int s_process_mqtt_packet(
     return s_packet_handlers[packet_type](connection, packet);
 }
 
+/**
+ * Decodes the full size of the packet at the start of data, which may be incomplete.
+ * packet_size is set to 0 if not even the fixed header is complete yet.
+ */
+static int s_decode_packet_size(struct aws_byte_cursor data, size_t *packet_size) {
+    struct aws_byte_cursor header_decode = data;
+    struct aws_mqtt_fixed_header packet_header;
+    AWS_ZERO_STRUCT(packet_header);
+    if (aws_mqtt_fixed_header_decode(&header_decode, &packet_header)) {
+        if (aws_last_error() != AWS_ERROR_SHORT_BUFFER) {
+            return AWS_OP_ERR;
+        }
+        aws_reset_error();
+
+        /* The decoder only checks the reserved bits of a packet that's all there, don't wait for the rest of it */
+        if (data.len && !aws_mqtt_packet_has_flags(&packet_header) && packet_header.flags != 0) {
+            return aws_raise_error(AWS_ERROR_MQTT_INVALID_RESERVED_BITS);
+        }
+
+        /* The remaining length is only decoded once all of its bytes are there, and a complete packet with a
+         * remaining length of 0 can't be short */
+        if (packet_header.remaining_length == 0) {
+            *packet_size = 0;
+            return AWS_OP_SUCCESS;
+        }
+    }
+
+    *packet_size = data.len - header_decode.len + packet_header.remaining_length;
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_reserve_pending_packet(struct aws_mqtt_client_connection *connection, size_t size) {
+    struct aws_byte_buf *pending_packet = &connection->thread_data.pending_packet;
+
+    /* Released by s_reset_pending_packet if it grew too big to keep around */
+    if (!pending_packet->allocator) {
+        return aws_byte_buf_init(pending_packet, connection->allocator, size);
+    }
+
+    return aws_byte_buf_reserve(pending_packet, size);
+}
+
+/**
+ * Passes the publishes dispatched so far to on_any_publish_batch. Must be called before the data they point into goes
+ * away: before the read message is released, and before pending_packet is written to or released.
+ */
+static void s_flush_publish_batch(struct aws_mqtt_client_connection *connection) {
+    struct aws_array_list *batch = &connection->thread_data.publish_batch;
+    const size_t publish_count = aws_array_list_length(batch);
+    if (!publish_count) {
+        return;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT, "id=%p: delivering a batch of %zu publishes", (void *)connection, publish_count);
+
+    const struct aws_mqtt_publish_view *publishes = batch->data;
+    if (connection->on_any_publish_batch) {
+        connection->on_any_publish_batch(connection, publishes, publish_count, connection->on_any_publish_batch_ud);
+    }
+    aws_array_list_clear(batch);
+}
+
+/* Empties pending_packet for the next packet, keeping its capacity unless that's above the retain size. */
+static void s_reset_pending_packet(struct aws_mqtt_client_connection *connection) {
+    struct aws_byte_buf *pending_packet = &connection->thread_data.pending_packet;
+
+    if (pending_packet->capacity > connection->reassembly_limits.retain_size) {
+        /* The batch may point into it */
+        s_flush_publish_batch(connection);
+        aws_byte_buf_clean_up(pending_packet);
+    }
+    pending_packet->len = 0;
+    connection->thread_data.pending_packet_size = 0;
+}
+
+/* Size of the fixed header at the start of packet, which must all be there. */
+static size_t s_fixed_header_size(const uint8_t *packet) {
+    /* The packet type and flags, then the remaining length's bytes up to the first without a continuation bit */
+    size_t size = 2;
+    while (packet[size - 1] & 0x80) {
+        ++size;
+    }
+    return size;
+}
+
+/**
+ * How much of the packet of packet_size at packet, of which len bytes are there, to buffer before handling it. That's
+ * all of it, unless it's a PUBLISH whose payload is to be streamed, in which case it's only its headers, as far as they
+ * are known from those len bytes.
+ */
+static size_t s_packet_buffer_size(
+    struct aws_mqtt_client_connection *connection,
+    const uint8_t *packet,
+    size_t len,
+    size_t packet_size) {
+
+    if (!connection->publish_stream_options.on_begin || aws_mqtt_get_packet_type(packet) != AWS_MQTT_PACKET_PUBLISH) {
+        return packet_size;
+    }
+
+    const size_t fixed_header_size = s_fixed_header_size(packet);
+
+    /* Until the topic's length has arrived, assume the topic is empty and there's no packet identifier */
+    enum aws_mqtt_qos qos = AWS_MQTT_QOS_AT_MOST_ONCE;
+    size_t headers_size = fixed_header_size + sizeof(uint16_t);
+    if (len >= headers_size) {
+        const uint8_t *topic_length = packet + fixed_header_size;
+        headers_size += ((size_t)topic_length[0] << 8) | topic_length[1];
+
+        struct aws_mqtt_packet_publish publish;
+        AWS_ZERO_STRUCT(publish);
+        publish.fixed_header.flags = packet[0] & 0xF;
+        qos = aws_mqtt_packet_publish_get_qos(&publish);
+        if (qos != AWS_MQTT_QOS_AT_MOST_ONCE) {
+            headers_size += sizeof(uint16_t);
+        }
+    }
+
+    /* Malformed packets are buffered whole, for the decoder to reject */
+    if (qos > AWS_MQTT_QOS_EXACTLY_ONCE || headers_size > packet_size ||
+        !s_should_stream_publish(connection, packet_size - headers_size)) {
+        return packet_size;
+    }
+
+    return headers_size;
+}
+
+/* s_packet_buffer_size() of the packet being reassembled in pending_packet. */
+static size_t s_pending_packet_buffer_size(struct aws_mqtt_client_connection *connection) {
+    const struct aws_byte_buf *pending_packet = &connection->thread_data.pending_packet;
+    return s_packet_buffer_size(
+        connection, pending_packet->buffer, pending_packet->len, connection->thread_data.pending_packet_size);
+}
+
+/**
+ * Fails if buffering buffer_size bytes of an incoming packet would go past the reassembly limit. A streamed PUBLISH
+ * only counts its headers, as its payload is never buffered.
+ */
+static int s_check_buffer_size(struct aws_mqtt_client_connection *connection, size_t buffer_size) {
+    const size_t max_size = connection->reassembly_limits.max_size;
+    if (max_size && buffer_size > max_size) {
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: incoming packet buffer of size %zu exceeds the limit of %zu",
+            (void *)connection,
+            buffer_size,
+            max_size);
+        return aws_raise_error(AWS_ERROR_MQTT_BUFFER_TOO_BIG);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Starts streaming the PUBLISH whose headers, and nothing more, are in pending_packet. */
+static int s_publish_stream_begin_from_pending_packet(struct aws_mqtt_client_connection *connection) {
+    if (s_check_packet_expected(connection, AWS_MQTT_PACKET_PUBLISH)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor headers = aws_byte_cursor_from_buf(&connection->thread_data.pending_packet);
+    const size_t fixed_header_size = s_fixed_header_size(headers.ptr);
+
+    struct aws_mqtt_packet_publish publish;
+    AWS_ZERO_STRUCT(publish);
+    publish.fixed_header.packet_type = AWS_MQTT_PACKET_PUBLISH;
+    publish.fixed_header.flags = headers.ptr[0] & 0xF;
+    publish.fixed_header.remaining_length = connection->thread_data.pending_packet_size - fixed_header_size;
+    aws_byte_cursor_advance(&headers, fixed_header_size);
+
+    uint16_t topic_length = 0;
+    aws_byte_cursor_read_be16(&headers, &topic_length);
+    publish.topic_name = aws_byte_cursor_advance(&headers, topic_length);
+    if (aws_mqtt_packet_publish_get_qos(&publish) != AWS_MQTT_QOS_AT_MOST_ONCE) {
+        aws_byte_cursor_read_be16(&headers, &publish.packet_identifier);
+    }
+    AWS_ASSERT(headers.len == 0);
+
+    s_publish_stream_begin(
+        connection,
+        &publish,
+        connection->thread_data.pending_packet_size - connection->thread_data.pending_packet.len);
+
+    return AWS_OP_SUCCESS;
+}
+
+/**
+ * Moves data from message_cursor into pending_packet, but not past the end of the packet being reassembled.
+ * packet_complete is set once all of the packet is there. If the packet is a PUBLISH to stream, its payload isn't
+ * buffered: the stream begins once its headers are there, and pending_packet is emptied.
+ */
+static int s_append_to_pending_packet(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_byte_cursor *message_cursor,
+    bool *packet_complete) {
+
+    struct aws_byte_buf *pending_packet = &connection->thread_data.pending_packet;
+    *packet_complete = false;
+
+    /* Until the fixed header is complete the packet's size isn't known, so take it a byte at a time */
+    while (!connection->thread_data.pending_packet_size && message_cursor->len) {
+        if (s_reserve_pending_packet(connection, pending_packet->len + 1)) {
+            return AWS_OP_ERR;
+        }
+        aws_byte_buf_write_from_whole_cursor(pending_packet, aws_byte_cursor_advance(message_cursor, 1));
+
+        if (s_decode_packet_size(
+                aws_byte_cursor_from_buf(pending_packet), &connection->thread_data.pending_packet_size)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    const size_t packet_size = connection->thread_data.pending_packet_size;
+    if (!packet_size) {
+        return AWS_OP_SUCCESS;
+    }
+
+    /* The buffer size grows as more of a streamed PUBLISH's headers become known */
+    size_t buffer_size = 0;
+    while ((buffer_size = s_pending_packet_buffer_size(connection)) > pending_packet->len && message_cursor->len) {
+        if (s_check_buffer_size(connection, buffer_size) || s_reserve_pending_packet(connection, buffer_size)) {
+            return AWS_OP_ERR;
+        }
+
+        size_t to_read = buffer_size - pending_packet->len;
+        if (to_read > message_cursor->len) {
+            to_read = message_cursor->len;
+        }
+        aws_byte_buf_write_from_whole_cursor(pending_packet, aws_byte_cursor_advance(message_cursor, to_read));
+    }
+
+    if (pending_packet->len == packet_size) {
+        *packet_complete = true;
+    } else if (pending_packet->len == buffer_size) {
+        if (s_publish_stream_begin_from_pending_packet(connection)) {
+            return AWS_OP_ERR;
+        }
+        s_reset_pending_packet(connection);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 /**
  * Handles incoming messages from the server.
  */
@@ -495,103 +1061,119 @@ static int s_process_read_message(
     /* This cursor will be updated as we read through the message. */
     struct aws_byte_cursor message_cursor = aws_byte_cursor_from_buf(&message->message_data);
 
-    /* If there's pending packet left over from last time, attempt to complete it. */
-    if (connection->thread_data.pending_packet.len) {
-        int result = AWS_OP_SUCCESS;
+    while (message_cursor.len) {
 
-        /* This determines how much to read from the message (min(expected_remaining, message.len)) */
-        size_t to_read = connection->thread_data.pending_packet.capacity - connection->thread_data.pending_packet.len;
-        /* This will be set to false if this message still won't complete the packet object. */
-        bool packet_complete = true;
-        if (to_read > message_cursor.len) {
-            to_read = message_cursor.len;
-            packet_complete = false;
+        /* If a PUBLISH is being streamed, the message continues its payload. */
+        if (connection->thread_data.publish_stream.active) {
+            if (s_publish_stream_write(connection, &message_cursor)) {
+                goto error;
+            }
+            continue;
         }
 
-        /* Write the chunk to the buffer.
-         * This will either complete the packet, or be the entirety of message if more data is required. */
-        struct aws_byte_cursor chunk = aws_byte_cursor_advance(&message_cursor, to_read);
-        AWS_ASSERT(chunk.ptr); /* Guaranteed to be in bounds */
-        result = (int)aws_byte_buf_write_from_whole_cursor(&connection->thread_data.pending_packet, chunk) - 1;
-        if (result) {
-            goto handle_error;
+        /* Unless there's a pending packet left over from last time, packets entirely in the message are dispatched
+         * straight from it. They're indexed a run at a time first, so that dispatching each costs no more than a
+         * lookup in the index. */
+        if (!connection->thread_data.pending_packet.len) {
+            struct aws_mqtt_frame frames[MQTT_READ_FRAME_INDEX_SIZE];
+            size_t frame_count = aws_mqtt_frame_index_scan(message_cursor, frames, AWS_ARRAY_SIZE(frames));
+
+            const size_t max_size = connection->reassembly_limits.max_size;
+            size_t indexed_len = 0;
+            for (size_t i = 0; i < frame_count; ++i) {
+                struct aws_byte_cursor packet_data = {
+                    .ptr = message_cursor.ptr + frames[i].offset,
+                    .len = frames[i].size,
+                };
+
+                /* Left for s_check_buffer_size() below to reject */
+                if (max_size && frames[i].size > max_size &&
+                    s_packet_buffer_size(connection, packet_data.ptr, packet_data.len, packet_data.len) > max_size) {
+                    break;
+                }
+
+                s_process_mqtt_packet(connection, (enum aws_mqtt_packet_type)frames[i].packet_type, packet_data);
+                indexed_len = frames[i].offset + frames[i].size;
+            }
+
+            if (indexed_len) {
+                AWS_LOGF_TRACE(
+                    AWS_LS_MQTT_CLIENT,
+                    "id=%p: %zu bytes of full mqtt packets read and dispatched.",
+                    (void *)connection,
+                    indexed_len);
+                aws_byte_cursor_advance(&message_cursor, indexed_len);
+                continue;
+            }
+
+            size_t packet_size = 0;
+            if (s_decode_packet_size(message_cursor, &packet_size)) {
+                goto error;
+            }
+
+            if (packet_size && packet_size <= message_cursor.len) {
+                if (s_check_buffer_size(
+                        connection, s_packet_buffer_size(connection, message_cursor.ptr, packet_size, packet_size))) {
+                    goto error;
+                }
+
+                struct aws_byte_cursor packet_data = aws_byte_cursor_advance(&message_cursor, packet_size);
+                AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: full mqtt packet read, dispatching.", (void *)connection);
+                s_process_mqtt_packet(connection, aws_mqtt_get_packet_type(packet_data.ptr), packet_data);
+                continue;
+            }
         }
 
-        /* If the packet is still incomplete, don't do anything with the data. */
+        /* The batch may point into pending_packet's previous contents */
+        s_flush_publish_batch(connection);
+
+        bool packet_complete = false;
+        if (s_append_to_pending_packet(connection, &message_cursor, &packet_complete)) {
+            s_reset_pending_packet(connection);
+            goto error;
+        }
+
+        /* Either the message ran out, or the packet is a PUBLISH whose payload is streamed from here on. */
         if (!packet_complete) {
             AWS_LOGF_TRACE(
-                AWS_LS_MQTT_CLIENT,
-                "id=%p: partial message is still incomplete, waiting on another read.",
-                (void *)connection);
-
-            goto cleanup;
+                AWS_LS_MQTT_CLIENT, "id=%p: message is incomplete, waiting on another read.", (void *)connection);
+            continue;
         }
 
         /* Handle the completed pending packet */
         struct aws_byte_cursor packet_data = aws_byte_cursor_from_buf(&connection->thread_data.pending_packet);
         AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: full mqtt packet re-assembled, dispatching.", (void *)connection);
-        result = s_process_mqtt_packet(connection, aws_mqtt_get_packet_type(packet_data.ptr), packet_data);
+        int result = s_process_mqtt_packet(connection, aws_mqtt_get_packet_type(packet_data.ptr), packet_data);
 
-    handle_error:
         /* Clean up the pending packet */
-        aws_byte_buf_clean_up(&connection->thread_data.pending_packet);
-        AWS_ZERO_STRUCT(connection->thread_data.pending_packet);
+        s_reset_pending_packet(connection);
 
         if (result) {
-            return AWS_OP_ERR;
+            goto error;
         }
     }
 
-    while (message_cursor.len) {
-
-        /* Temp byte cursor so we can decode the header without advancing message_cursor. */
-        struct aws_byte_cursor header_decode = message_cursor;
-
-        struct aws_mqtt_fixed_header packet_header;
-        AWS_ZERO_STRUCT(packet_header);
-        int result = aws_mqtt_fixed_header_decode(&header_decode, &packet_header);
+    s_flush_publish_batch(connection);
 
-        /* Calculate how much data was read. */
-        const size_t fixed_header_size = message_cursor.len - header_decode.len;
-
-        if (result) {
-            if (aws_last_error() == AWS_ERROR_SHORT_BUFFER) {
-                /* Message data too short, store data and come back later. */
-                AWS_LOGF_TRACE(
-                    AWS_LS_MQTT_CLIENT, "id=%p: message is incomplete, waiting on another read.", (void *)connection);
-                if (aws_byte_buf_init(
-                        &connection->thread_data.pending_packet,
-                        connection->allocator,
-                        fixed_header_size + packet_header.remaining_length)) {
-
-                    return AWS_OP_ERR;
-                }
-
-                /* Write the partial packet. */
-                if (!aws_byte_buf_write_from_whole_cursor(&connection->thread_data.pending_packet, message_cursor)) {
-                    aws_byte_buf_clean_up(&connection->thread_data.pending_packet);
-                    return AWS_OP_ERR;
-                }
-
-                aws_reset_error();
-                goto cleanup;
-            } else {
-                return AWS_OP_ERR;
-            }
-        }
-
-        struct aws_byte_cursor packet_data =
-            aws_byte_cursor_advance(&message_cursor, fixed_header_size + packet_header.remaining_length);
-        AWS_LOGF_TRACE(AWS_LS_MQTT_CLIENT, "id=%p: full mqtt packet read, dispatching.", (void *)connection);
-        s_process_mqtt_packet(connection, packet_header.packet_type, packet_data);
-    }
-
-cleanup:
     /* Do cleanup */
-    aws_channel_slot_increment_read_window(slot, message->message_data.len);
+    size_t window_increment = message->message_data.len;
+    if (connection->manual_window.enabled) {
+        /* Whatever was delivered of publish payloads stays out of the window until the user hands it back */
+        size_t held_back = aws_min_size(connection->thread_data.read_window_debt, window_increment);
+        connection->thread_data.read_window_debt -= held_back;
+        window_increment -= held_back;
+    }
+    if (window_increment) {
+        aws_channel_slot_increment_read_window(slot, window_increment);
+    }
     aws_mem_release(message->allocator, message);
 
     return AWS_OP_SUCCESS;
+
+error:
+    /* Publishes dispatched before the error went everywhere else already */
+    s_flush_publish_batch(connection);
+    return AWS_OP_ERR;
 }
 
 static int s_shutdown(
@@ -603,10 +1185,30 @@ static int s_shutdown(
 
     struct aws_mqtt_client_connection *connection = handler->impl;
 
+    if (dir == AWS_CHANNEL_DIR_READ) {
+        /* Whatever arrived of a packet will never be completed, the next channel starts from scratch */
+        s_reset_pending_packet(connection);
+        connection->thread_data.read_window_debt = 0;
+
+        if (connection->thread_data.publish_stream.active) {
+            connection->thread_data.publish_stream.active = false;
+            if (!connection->thread_data.publish_stream.redelivery) {
+                const struct aws_mqtt_publish_stream_options *options = &connection->publish_stream_options;
+                options->on_end(
+                    connection, error_code ? error_code : AWS_ERROR_MQTT_UNEXPECTED_HANGUP, options->user_data);
+                connection->thread_data.publish_ack_token.value = 0;
+            }
+        }
+    }
+
     if (dir == AWS_CHANNEL_DIR_WRITE) {
         /* On closing write direction, send out disconnect packet before closing connection. */
 
-        if (!free_scarce_resources_immediately) {
+        if (free_scarce_resources_immediately) {
+            s_release_pending_write(connection);
+        } else {
+            /* Anything coalesced this tick still goes out ahead of the DISCONNECT */
+            mqtt_connection_flush_pending_write(connection);
 
             if (error_code == AWS_OP_SUCCESS) {
                 AWS_LOGF_INFO(
@@ -631,7 +1233,7 @@ static int s_shutdown(
                     goto done;
                 }
 
-                if (aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_WRITE)) {
+                if (mqtt_connection_send_message(connection, message)) {
                     AWS_LOGF_DEBUG(
                         AWS_LS_MQTT_CLIENT,
                         "id=%p: failed to send courteous disconnect io message",
@@ -649,7 +1251,11 @@ done:
 
 static size_t s_initial_window_size(struct aws_channel_handler *handler) {
 
-    (void)handler;
+    struct aws_mqtt_client_connection *connection = handler->impl;
+
+    if (connection->manual_window.enabled) {
+        return connection->manual_window.initial_window_size;
+    }
 
     return SIZE_MAX;
 }
@@ -688,7 +1294,7 @@ struct aws_io_message *mqtt_get_message_for_packet(
     struct aws_mqtt_client_connection *connection,
     struct aws_mqtt_fixed_header *header) {
 
-    const size_t required_length = 3 + header->remaining_length;
+    const size_t required_length = aws_mqtt_packet_encoded_size(header);
 
     struct aws_io_message *message = aws_channel_acquire_message_from_pool(
         connection->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, required_length);
@@ -741,9 +1347,7 @@ static void s_request_outgoing_task(struct aws_channel_task *task, void *arg, en
             }
             { /* BEGIN CRITICAL SECTION */
                 mqtt_connection_lock_synced_data(connection);
-                aws_hash_table_remove(
-                    &connection->synced_data.outstanding_requests_table, &request->packet_id, NULL, NULL);
-                aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+                mqtt_connection_release_request_synced(connection, request);
                 mqtt_connection_unlock_synced_data(connection);
             } /* END CRITICAL SECTION */
         }
@@ -779,9 +1383,7 @@ static void s_request_outgoing_task(struct aws_channel_task *task, void *arg, en
             }
             { /* BEGIN CRITICAL SECTION */
                 mqtt_connection_lock_synced_data(connection);
-                aws_hash_table_remove(
-                    &connection->synced_data.outstanding_requests_table, &request->packet_id, NULL, NULL);
-                aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+                mqtt_connection_release_request_synced(connection, request);
                 mqtt_connection_unlock_synced_data(connection);
             } /* END CRITICAL SECTION */
             break;
@@ -798,6 +1400,210 @@ static void s_request_outgoing_task(struct aws_channel_task *task, void *arg, en
     }
 }
 
+/*
+ * Checks whether new requests may be created in the current connection state, raising an error if not.
+ * Note: needs to be called with lock held.
+ */
+static int s_check_can_create_request_synced(struct aws_mqtt_client_connection *connection, bool noRetry) {
+    ASSERT_SYNCED_DATA_LOCK_HELD(connection);
+
+    if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_DISCONNECTING) {
+        /* User requested disconnecting, ensure no new requests are made until the channel finished shutting
+         * down. */
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Disconnect requested, stop creating any new request until disconnect process finishes.",
+            (void *)connection);
+        return aws_raise_error(AWS_ERROR_MQTT_CONNECTION_DISCONNECTING);
+    }
+
+    if (noRetry && connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
+        /* Not offline queueing QoS 0 publish or PINGREQ. Fail the call. */
+        AWS_LOGF_DEBUG(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Not currently connected. No offline queueing for QoS 0 publish or pingreq.",
+            (void *)connection);
+        return aws_raise_error(AWS_ERROR_MQTT_NOT_CONNECTED);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Reserves a packet ID, acquires a request from the pool and registers it in the outstanding requests table.
+ * The request is neither queued nor scheduled. Returns NULL and raises an error on failure.
+ * Note: needs to be called with lock held.
+ */
+static struct aws_mqtt_request *s_register_request_synced(
+    struct aws_mqtt_client_connection *connection,
+    aws_mqtt_send_request_fn *send_request,
+    void *send_request_ud,
+    aws_mqtt_op_complete_fn *on_complete,
+    void *on_complete_ud,
+    bool noRetry) {
+
+    ASSERT_SYNCED_DATA_LOCK_HELD(connection);
+
+    /**
+     * Find a free packet ID, starting right after the last one assigned so that IDs aren't reused sooner than needed.
+     * QoS 0 PUBLISH packets don't actually need an ID on the wire,
+     * but we assign them internally anyway just so everything has a unique ID.
+     */
+    uint16_t packet_id = aws_mqtt_packet_id_set_find_free(
+        &connection->synced_data.packet_ids_in_use, (uint16_t)(connection->synced_data.packet_id + 1));
+    if (packet_id == 0) {
+        /* Every ID is taken */
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Queue is full. No more packet IDs are available at this time.",
+            (void *)connection);
+        aws_raise_error(AWS_ERROR_MQTT_QUEUE_FULL);
+        return NULL;
+    }
+
+    struct aws_mqtt_request *next_request = aws_memory_pool_acquire(&connection->synced_data.requests_pool);
+    if (!next_request) {
+        return NULL;
+    }
+    memset(next_request, 0, sizeof(struct aws_mqtt_request));
+
+    next_request->packet_id = packet_id;
+
+    if (aws_mqtt_packet_id_table_put(&connection->synced_data.outstanding_requests_table, packet_id, next_request)) {
+        /* failed to put the next request into the table */
+        aws_memory_pool_release(&connection->synced_data.requests_pool, next_request);
+        return NULL;
+    }
+    aws_mqtt_packet_id_set_add(&connection->synced_data.packet_ids_in_use, packet_id);
+    connection->synced_data.packet_id = packet_id;
+    /* Store the request by packet_id */
+    next_request->allocator = connection->allocator;
+    next_request->connection = connection;
+    next_request->initiated = false;
+    next_request->retryable = !noRetry;
+    next_request->send_request = send_request;
+    next_request->send_request_ud = send_request_ud;
+    next_request->on_complete = on_complete;
+    next_request->on_complete_ud = on_complete_ud;
+    aws_channel_task_init(
+        &next_request->outgoing_task, s_request_outgoing_task, next_request, "mqtt_outgoing_request_task");
+
+    return next_request;
+}
+
+void mqtt_connection_release_request_synced(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_request *request) {
+
+    ASSERT_SYNCED_DATA_LOCK_HELD(connection);
+
+    aws_mqtt_packet_id_table_remove(&connection->synced_data.outstanding_requests_table, request->packet_id);
+    aws_mqtt_packet_id_set_remove(&connection->synced_data.packet_ids_in_use, request->packet_id);
+    aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+}
+
+/* Sends every request in the submission queue, in the order they were submitted */
+static void s_submission_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_mqtt_client_connection *connection = arg;
+
+    if (status == AWS_TASK_STATUS_CANCELED) {
+        /**
+         * The task may have been scheduled on a channel that was already going away, while producers on the channel
+         * that replaced it found the queue non-empty and left their requests to it. Send them on the current channel
+         * rather than leaving them in the offline queue of a connection that's online.
+         */
+        struct aws_channel *channel = NULL;
+        struct aws_mqtt_mpsc_queue_node *node = NULL;
+        struct aws_linked_list canceled;
+        aws_linked_list_init(&canceled);
+        { /* BEGIN CRITICAL SECTION */
+            mqtt_connection_lock_synced_data(connection);
+            channel = mqtt_connection_acquire_rescheduling_channel_synced(connection, connection->submission_channel);
+            if (channel) {
+                connection->submission_channel = channel;
+            } else {
+                /* Offline-queued under the same lock CONNACK takes them from, so none are left behind */
+                node = aws_mqtt_mpsc_queue_pop_all(&connection->submission_queue);
+                while (node) {
+                    struct aws_mqtt_request *request =
+                        AWS_CONTAINER_OF(node, struct aws_mqtt_request, submission_node);
+                    node = node->next;
+                    if (request->retryable) {
+                        aws_linked_list_push_back(&connection->synced_data.pending_requests_list, &request->list_node);
+                    } else {
+                        aws_linked_list_push_back(&canceled, &request->list_node);
+                    }
+                }
+            }
+            mqtt_connection_unlock_synced_data(connection);
+        } /* END CRITICAL SECTION */
+
+        if (channel) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_MQTT_CLIENT,
+                "id=%p: Submission task canceled along with an old channel, rescheduling it on the current one.",
+                (void *)connection);
+            aws_channel_task_init(&connection->submission_task, s_submission_task, connection, "mqtt_submission_task");
+            aws_channel_schedule_task_now(channel, &connection->submission_task);
+            aws_channel_release_hold(channel);
+            return;
+        }
+
+        /* The ones that can't be retried fail */
+        while (!aws_linked_list_empty(&canceled)) {
+            struct aws_linked_list_node *list_node = aws_linked_list_pop_front(&canceled);
+            struct aws_mqtt_request *request = AWS_CONTAINER_OF(list_node, struct aws_mqtt_request, list_node);
+            s_request_outgoing_task(&request->outgoing_task, request, status);
+        }
+        AWS_LOGF_TRACE(
+            AWS_LS_MQTT_CLIENT, "id=%p: Submission task canceled, requests moved offline.", (void *)connection);
+        return;
+    }
+
+    /* Take the whole queue first: from here on, the next push finds it empty and schedules this task again */
+    struct aws_mqtt_mpsc_queue_node *node = aws_mqtt_mpsc_queue_pop_all(&connection->submission_queue);
+
+    size_t request_count = 0;
+    while (node) {
+        struct aws_mqtt_request *request = AWS_CONTAINER_OF(node, struct aws_mqtt_request, submission_node);
+        /* Move along before sending, a completed request goes back to the pool */
+        node = node->next;
+        s_request_outgoing_task(&request->outgoing_task, request, status);
+        ++request_count;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_MQTT_CLIENT,
+        "id=%p: Drained %zu requests from the submission queue, status %d.",
+        (void *)connection,
+        request_count,
+        (int)status);
+}
+
+/*
+ * Hands a request over to the event-loop thread. Only the first request pushed onto an empty queue schedules the
+ * submission task, everyone else rides along.
+ * The caller must hold the channel (aws_channel_acquire_hold) across this call.
+ */
+static void s_submit_request(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_channel *channel,
+    struct aws_mqtt_request *request) {
+
+    if (aws_mqtt_mpsc_queue_push(&connection->submission_queue, &request->submission_node)) {
+        AWS_LOGF_TRACE(
+            AWS_LS_MQTT_CLIENT,
+            "id=%p: Submission queue was empty, scheduling a task to send message id %" PRIu16 " onwards.",
+            (void *)connection,
+            request->packet_id);
+        /* Nobody else touches it until the task runs, the scheduling publishes it to the event-loop thread */
+        connection->submission_channel = channel;
+        aws_channel_task_init(&connection->submission_task, s_submission_task, connection, "mqtt_submission_task");
+        aws_channel_schedule_task_now(channel, &connection->submission_task);
+    }
+}
+
 uint16_t mqtt_create_request(
     struct aws_mqtt_client_connection *connection,
     aws_mqtt_send_request_fn *send_request,
@@ -813,118 +1619,115 @@ uint16_t mqtt_create_request(
     struct aws_channel *channel = NULL;
     { /* BEGIN CRITICAL SECTION */
         mqtt_connection_lock_synced_data(connection);
-        if (connection->synced_data.state == AWS_MQTT_CLIENT_STATE_DISCONNECTING) {
+        if (s_check_can_create_request_synced(connection, noRetry)) {
             mqtt_connection_unlock_synced_data(connection);
-            /* User requested disconnecting, ensure no new requests are made until the channel finished shutting
-             * down. */
-            AWS_LOGF_ERROR(
-                AWS_LS_MQTT_CLIENT,
-                "id=%p: Disconnect requested, stop creating any new request until disconnect process finishes.",
-                (void *)connection);
-            aws_raise_error(AWS_ERROR_MQTT_CONNECTION_DISCONNECTING);
             return 0;
         }
 
-        if (noRetry && connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
+        next_request =
+            s_register_request_synced(connection, send_request, send_request_ud, on_complete, on_complete_ud, noRetry);
+        if (!next_request) {
             mqtt_connection_unlock_synced_data(connection);
-            /* Not offline queueing QoS 0 publish or PINGREQ. Fail the call. */
-            AWS_LOGF_DEBUG(
-                AWS_LS_MQTT_CLIENT,
-                "id=%p: Not currently connected. No offline queueing for QoS 0 publish or pingreq.",
-                (void *)connection);
-            aws_raise_error(AWS_ERROR_MQTT_NOT_CONNECTED);
             return 0;
         }
-        /**
-         * Find a free packet ID.
-         * QoS 0 PUBLISH packets don't actually need an ID on the wire,
-         * but we assign them internally anyway just so everything has a unique ID.
-         *
-         * Yes, this is an O(N) search.
-         * We remember the last ID we assigned, so it's O(1) in the common case.
-         * But it's theoretically possible to reach O(N) where N is just above 64000
-         * if the user is letting a ton of un-ack'd messages queue up
-         */
-        uint16_t search_start = connection->synced_data.packet_id;
-        struct aws_hash_element *elem = NULL;
-        while (true) {
-            /* Increment ID, watch out for overflow, ID cannot be 0 */
-            if (connection->synced_data.packet_id == UINT16_MAX) {
-                connection->synced_data.packet_id = 1;
-            } else {
-                connection->synced_data.packet_id++;
-            }
 
-            /* Is there already an outstanding request using this ID? */
-            aws_hash_table_find(
-                &connection->synced_data.outstanding_requests_table, &connection->synced_data.packet_id, &elem);
-
-            if (elem == NULL) {
-                /* Found a free ID! Break out of loop */
-                break;
-            } else if (connection->synced_data.packet_id == search_start) {
-                /* Every ID is taken */
-                mqtt_connection_unlock_synced_data(connection);
-                AWS_LOGF_ERROR(
-                    AWS_LS_MQTT_CLIENT,
-                    "id=%p: Queue is full. No more packet IDs are available at this time.",
-                    (void *)connection);
-                aws_raise_error(AWS_ERROR_MQTT_QUEUE_FULL);
-                return 0;
-            }
+        if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
+            aws_linked_list_push_back(&connection->synced_data.pending_requests_list, &next_request->list_node);
+        } else {
+            AWS_ASSERT(connection->slot);
+            AWS_ASSERT(connection->slot->channel);
+            should_schedule_task = true;
+            channel = connection->slot->channel;
+            /* keep the channel alive until the task is scheduled */
+            aws_channel_acquire_hold(channel);
         }
+        mqtt_connection_unlock_synced_data(connection);
+    } /* END CRITICAL SECTION */
+    /* Read before submitting, the request may be sent and released by the time the push returns */
+    uint16_t packet_id = next_request->packet_id;
+    if (should_schedule_task) {
+        s_submit_request(connection, channel, next_request);
+        /* release the refcount we hold with the protection of lock */
+        aws_channel_release_hold(channel);
+    }
 
-        next_request = aws_memory_pool_acquire(&connection->synced_data.requests_pool);
-        if (!next_request) {
-            mqtt_connection_unlock_synced_data(connection);
-            return 0;
-        }
-        memset(next_request, 0, sizeof(struct aws_mqtt_request));
+    return packet_id;
+}
+
+int mqtt_create_request_batch(
+    struct aws_mqtt_client_connection *connection,
+    struct aws_mqtt_request_batch_entry *entries,
+    size_t entry_count) {
+
+    AWS_ASSERT(connection);
+    AWS_ASSERT(entries || entry_count == 0);
+
+    if (entry_count == 0) {
+        return AWS_OP_SUCCESS;
+    }
 
-        next_request->packet_id = connection->synced_data.packet_id;
+    struct aws_linked_list requests;
+    aws_linked_list_init(&requests);
+    struct aws_channel *channel = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        mqtt_connection_lock_synced_data(connection);
 
-        if (aws_hash_table_put(
-                &connection->synced_data.outstanding_requests_table, &next_request->packet_id, next_request, NULL)) {
-            /* failed to put the next request into the table */
-            aws_memory_pool_release(&connection->synced_data.requests_pool, next_request);
+        bool no_retry = false;
+        for (size_t i = 0; i < entry_count; ++i) {
+            no_retry |= entries[i].no_retry;
+        }
+        if (s_check_can_create_request_synced(connection, no_retry)) {
             mqtt_connection_unlock_synced_data(connection);
-            return 0;
+            return AWS_OP_ERR;
         }
-        /* Store the request by packet_id */
-        next_request->allocator = connection->allocator;
-        next_request->connection = connection;
-        next_request->initiated = false;
-        next_request->retryable = !noRetry;
-        next_request->send_request = send_request;
-        next_request->send_request_ud = send_request_ud;
-        next_request->on_complete = on_complete;
-        next_request->on_complete_ud = on_complete_ud;
-        aws_channel_task_init(
-            &next_request->outgoing_task, s_request_outgoing_task, next_request, "mqtt_outgoing_request_task");
+
+        for (size_t i = 0; i < entry_count; ++i) {
+            struct aws_mqtt_request *request = s_register_request_synced(
+                connection,
+                entries[i].send_request,
+                entries[i].send_request_ud,
+                entries[i].on_complete,
+                entries[i].on_complete_ud,
+                entries[i].no_retry);
+            if (!request) {
+                /* All or nothing: give back the IDs reserved so far */
+                while (!aws_linked_list_empty(&requests)) {
+                    struct aws_linked_list_node *node = aws_linked_list_pop_back(&requests);
+                    mqtt_connection_release_request_synced(
+                        connection, AWS_CONTAINER_OF(node, struct aws_mqtt_request, list_node));
+                }
+                mqtt_connection_unlock_synced_data(connection);
+                return AWS_OP_ERR;
+            }
+            entries[i].packet_id = request->packet_id;
+            aws_linked_list_push_back(&requests, &request->list_node);
+        }
+
         if (connection->synced_data.state != AWS_MQTT_CLIENT_STATE_CONNECTED) {
-            aws_linked_list_push_back(&connection->synced_data.pending_requests_list, &next_request->list_node);
+            aws_linked_list_move_all_back(&connection->synced_data.pending_requests_list, &requests);
         } else {
             AWS_ASSERT(connection->slot);
             AWS_ASSERT(connection->slot->channel);
-            should_schedule_task = true;
             channel = connection->slot->channel;
-            /* keep the channel alive until the task is scheduled */
+            /* keep the channel alive until the requests are submitted */
             aws_channel_acquire_hold(channel);
         }
         mqtt_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
-    if (should_schedule_task) {
+
+    if (channel) {
         AWS_LOGF_TRACE(
-            AWS_LS_MQTT_CLIENT,
-            "id=%p: Currently not in the event-loop thread, scheduling a task to send message id %" PRIu16 ".",
-            (void *)connection,
-            next_request->packet_id);
-        aws_channel_schedule_task_now(channel, &next_request->outgoing_task);
+            AWS_LS_MQTT_CLIENT, "id=%p: Submitting a batch of %zu requests.", (void *)connection, entry_count);
+        /* Requests are detached from the list before being submitted, as sending them re-uses their list node */
+        while (!aws_linked_list_empty(&requests)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&requests);
+            s_submit_request(connection, channel, AWS_CONTAINER_OF(node, struct aws_mqtt_request, list_node));
+        }
         /* release the refcount we hold with the protection of lock */
         aws_channel_release_hold(channel);
     }
 
-    return next_request->packet_id;
+    return AWS_OP_SUCCESS;
 }
 
 void mqtt_request_complete(struct aws_mqtt_client_connection *connection, int error_code, uint16_t packet_id) {
@@ -942,20 +1745,18 @@ void mqtt_request_complete(struct aws_mqtt_client_connection *connection, int er
 
     { /* BEGIN CRITICAL SECTION */
         mqtt_connection_lock_synced_data(connection);
-        struct aws_hash_element *elem = NULL;
-        aws_hash_table_find(&connection->synced_data.outstanding_requests_table, &packet_id, &elem);
-        if (elem != NULL) {
+        struct aws_mqtt_request *request =
+            aws_mqtt_packet_id_table_find(&connection->synced_data.outstanding_requests_table, packet_id);
+        if (request != NULL) {
             found_request = true;
 
-            struct aws_mqtt_request *request = elem->value;
             on_complete = request->on_complete;
             on_complete_ud = request->on_complete_ud;
 
-            /* clean up request resources */
-            aws_hash_table_remove_element(&connection->synced_data.outstanding_requests_table, elem);
             /* remove the request from the list, which is thread_data.ongoing_requests_list */
             aws_linked_list_remove(&request->list_node);
-            aws_memory_pool_release(&connection->synced_data.requests_pool, request);
+            /* clean up request resources */
+            mqtt_connection_release_request_synced(connection, request);
         }
         mqtt_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
@@ -11,9 +11,21 @@
  * Any number less than or equal to 127 (7 bit max) can be written into a single byte, where any number larger than 128
  * may be written into multiple bytes, using the most significant bit (128) as a continuation flag.
  */
-static int s_encode_remaining_length(struct aws_byte_buf *buf, size_t remaining_length) {
+static size_t s_sizeof_remaining_length(size_t remaining_length) {
 
-    AWS_PRECONDITION(buf);
+    size_t size = 1;
+    while (remaining_length >= 128) {
+        remaining_length /= 128;
+        ++size;
+    }
+
+    return size;
+}
+
+/* Writes exactly s_sizeof_remaining_length(remaining_length) bytes, the caller has made sure there's room for them */
+static uint8_t *s_encode_remaining_length_unchecked(uint8_t *out, size_t remaining_length) {
+
+    AWS_PRECONDITION(out);
     AWS_PRECONDITION(remaining_length < UINT32_MAX);
 
     do {
@@ -22,13 +34,12 @@ static int s_encode_remaining_length(struct aws_byte_buf *buf, size_t remaining_
         if (remaining_length) {
             encoded_byte |= 128;
         }
-        if (!aws_byte_buf_write_u8(buf, encoded_byte)) {
-            return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-        }
+        *out++ = encoded_byte;
     } while (remaining_length);
 
-    return AWS_OP_SUCCESS;
+    return out;
 }
+
 static int s_decode_remaining_length(struct aws_byte_cursor *cur, size_t *remaining_length_out) {
 
     AWS_PRECONDITION(cur);
@@ -90,6 +101,20 @@ bool aws_mqtt_packet_has_flags(const struct aws_mqtt_fixed_header *header) {
     }
 }
 
+size_t aws_mqtt_fixed_header_encoded_size(const struct aws_mqtt_fixed_header *header) {
+
+    AWS_PRECONDITION(header);
+
+    return 1 + s_sizeof_remaining_length(header->remaining_length);
+}
+
+size_t aws_mqtt_packet_encoded_size(const struct aws_mqtt_fixed_header *header) {
+
+    AWS_PRECONDITION(header);
+
+    return aws_mqtt_fixed_header_encoded_size(header) + header->remaining_length;
+}
+
 int aws_mqtt_fixed_header_encode(struct aws_byte_buf *buf, const struct aws_mqtt_fixed_header *header) {
 
     AWS_PRECONDITION(buf);
@@ -100,16 +125,19 @@ int aws_mqtt_fixed_header_encode(struct aws_byte_buf *buf, const struct aws_mqtt
         return aws_raise_error(AWS_ERROR_MQTT_INVALID_RESERVED_BITS);
     }
 
-    /* Write packet type and flags */
-    uint8_t byte_1 = (uint8_t)((header->packet_type << 4) | (header->flags & 0xF));
-    if (!aws_byte_buf_write_u8(buf, byte_1)) {
+    if (buf->capacity - buf->len < aws_mqtt_fixed_header_encoded_size(header)) {
         return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
     }
 
+    uint8_t *out = buf->buffer + buf->len;
+
+    /* Write packet type and flags */
+    *out++ = (uint8_t)((header->packet_type << 4) | (header->flags & 0xF));
+
     /* Write remaining length */
-    if (s_encode_remaining_length(buf, header->remaining_length)) {
-        return AWS_OP_ERR;
-    }
+    out = s_encode_remaining_length_unchecked(out, header->remaining_length);
+
+    buf->len = (size_t)(out - buf->buffer);
 
     return AWS_OP_SUCCESS;
 }
@@ -142,3 +170,81 @@ int aws_mqtt_fixed_header_decode(struct aws_byte_cursor *cur, struct aws_mqtt_fi
 
     return AWS_OP_SUCCESS;
 }
+
+/**
+ * Decodes the remaining length starting at encoded, of which available bytes are there, without going through a cursor.
+ * Returns false if it's malformed or not all there. Nearly all packets on a busy connection are small enough that their
+ * remaining length fits in its first byte, so that case comes first.
+ */
+static inline bool s_scan_remaining_length(
+    const uint8_t *encoded,
+    size_t available,
+    uint32_t *remaining_length_out,
+    size_t *encoded_size_out) {
+
+    if (available && !(encoded[0] & 128)) {
+        *remaining_length_out = encoded[0];
+        *encoded_size_out = 1;
+        return true;
+    }
+
+    const size_t max_size = available < 4 ? available : 4;
+    uint32_t remaining_length = 0;
+    for (size_t i = 0; i < max_size; ++i) {
+        remaining_length |= (uint32_t)(encoded[i] & 127) << (7 * i);
+        if (!(encoded[i] & 128)) {
+            *remaining_length_out = remaining_length;
+            *encoded_size_out = i + 1;
+            return true;
+        }
+    }
+
+    /* Either the rest is still to arrive, or the 4th byte has the continuation bit set */
+    return false;
+}
+
+size_t aws_mqtt_frame_index_scan(struct aws_byte_cursor data, struct aws_mqtt_frame *frames, size_t max_frames) {
+
+    AWS_PRECONDITION(frames || !max_frames);
+
+    /* Offsets must fit in a frame */
+    if (data.len > UINT32_MAX) {
+        data.len = UINT32_MAX;
+    }
+
+    size_t frame_count = 0;
+    size_t offset = 0;
+    while (frame_count < max_frames && data.len - offset >= 2) {
+        const uint8_t *packet = data.ptr + offset;
+
+        uint32_t remaining_length = 0;
+        size_t encoded_size = 0;
+        if (!s_scan_remaining_length(packet + 1, data.len - offset - 1, &remaining_length, &encoded_size)) {
+            break;
+        }
+
+        const size_t packet_size = 1 + encoded_size + remaining_length;
+        if (packet_size > data.len - offset) {
+            break;
+        }
+
+        /* Check that flags are 0 if they must not be present, the packet is left for the decoder to reject */
+        struct aws_mqtt_fixed_header header = {
+            .packet_type = aws_mqtt_get_packet_type(packet),
+            .flags = packet[0] & 0xF,
+        };
+        if (!aws_mqtt_packet_has_flags(&header) && header.flags != 0) {
+            break;
+        }
+
+        struct aws_mqtt_frame *frame = &frames[frame_count++];
+        frame->offset = (uint32_t)offset;
+        frame->size = (uint32_t)packet_size;
+        frame->packet_type = (uint8_t)header.packet_type;
+        frame->flags = header.flags;
+
+        offset += packet_size;
+    }
+
+    return frame_count;
+}
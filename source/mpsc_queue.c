@@ -0,0 +1,48 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/mpsc_queue.h>
+
+void aws_mqtt_mpsc_queue_init(struct aws_mqtt_mpsc_queue *queue) {
+    AWS_PRECONDITION(queue);
+
+    aws_atomic_init_ptr(&queue->head, NULL);
+}
+
+bool aws_mqtt_mpsc_queue_push(struct aws_mqtt_mpsc_queue *queue, struct aws_mqtt_mpsc_queue_node *node) {
+    AWS_PRECONDITION(queue);
+    AWS_PRECONDITION(node);
+
+    /* The consumer only ever takes the whole queue, never single nodes, so a plain CAS loop has no ABA issue */
+    void *head = aws_atomic_load_ptr(&queue->head);
+    do {
+        node->next = head;
+    } while (!aws_atomic_compare_exchange_ptr(&queue->head, &head, node));
+
+    return head == NULL;
+}
+
+struct aws_mqtt_mpsc_queue_node *aws_mqtt_mpsc_queue_pop_all(struct aws_mqtt_mpsc_queue *queue) {
+    AWS_PRECONDITION(queue);
+
+    struct aws_mqtt_mpsc_queue_node *node = aws_atomic_exchange_ptr(&queue->head, NULL);
+
+    /* Nodes come out most recent first, reverse them back into push order */
+    struct aws_mqtt_mpsc_queue_node *reversed = NULL;
+    while (node) {
+        struct aws_mqtt_mpsc_queue_node *next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+
+    return reversed;
+}
+
+bool aws_mqtt_mpsc_queue_is_empty(struct aws_mqtt_mpsc_queue *queue) {
+    AWS_PRECONDITION(queue);
+
+    return aws_atomic_load_ptr(&queue->head) == NULL;
+}
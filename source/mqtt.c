@@ -15,68 +15,123 @@
  * Topic Validation
  ******************************************************************************/
 
-static bool s_is_valid_topic(const struct aws_byte_cursor *topic, bool is_filter) {
+/* Bytes a topic is split on or checked for, everything else is part of a level name */
+#define S_TOPIC_SWAR_ONES 0x0101010101010101ULL
+#define S_TOPIC_SWAR_HIGHS 0x8080808080808080ULL
+
+/* Non-zero if any of the 8 bytes in word is 0. */
+static inline uint64_t s_swar_has_zero_byte(uint64_t word) {
+    return (word - S_TOPIC_SWAR_ONES) & ~word & S_TOPIC_SWAR_HIGHS;
+}
+
+/* Non-zero if any of the 8 bytes in word is '/', '+', '#' or the null character. */
+static inline uint64_t s_swar_has_special_byte(uint64_t word) {
+    return s_swar_has_zero_byte(word) | s_swar_has_zero_byte(word ^ (S_TOPIC_SWAR_ONES * '/')) |
+           s_swar_has_zero_byte(word ^ (S_TOPIC_SWAR_ONES * '+')) |
+           s_swar_has_zero_byte(word ^ (S_TOPIC_SWAR_ONES * '#'));
+}
+
+bool aws_mqtt_validate_topic_levels(
+    const struct aws_byte_cursor *topic,
+    bool is_filter,
+    uint16_t *level_offsets,
+    size_t max_levels,
+    size_t *level_count_out) {
+
+    AWS_PRECONDITION(topic);
+    AWS_PRECONDITION(level_offsets || !max_levels);
 
     /* [MQTT-4.7.3-1] Check existance and length */
     if (!topic->ptr || !topic->len) {
         return false;
     }
 
-    /* [MQTT-4.7.3-2] Check for the null character */
-    if (memchr(topic->ptr, 0, topic->len)) {
-        return false;
-    }
-
     /* [MQTT-4.7.3-3] Topic must not be too long */
     if (topic->len > 65535) {
         return false;
     }
 
-    bool saw_hash = false;
+    const uint8_t *bytes = topic->ptr;
+    const size_t len = topic->len;
 
-    struct aws_byte_cursor topic_part;
-    AWS_ZERO_STRUCT(topic_part);
-    while (aws_byte_cursor_next_split(topic, '/', &topic_part)) {
+    size_t level_count = 1;
+    if (max_levels) {
+        level_offsets[0] = 0;
+    }
+    size_t level_start = 0;
+    /* The wildcard that makes up the current level, if any, in which case nothing else may be in it */
+    uint8_t wildcard = 0;
 
-        if (saw_hash) {
-            /* [MQTT-4.7.1-2] If last part was a '#' and there's still another part, it's an invalid topic */
-            return false;
+    size_t i = 0;
+    while (i < len) {
+        /* Level names are skipped 8 bytes at a time, only bytes that mean something are looked at one by one */
+        if (len - i >= sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            if (!s_swar_has_special_byte(word)) {
+                if (wildcard) {
+                    /* topic part must be 1 character long */
+                    return false;
+                }
+                i += sizeof(word);
+                continue;
+            }
         }
 
-        if (topic_part.len == 0) {
-            /* 0 length parts are fine */
-            continue;
-        }
+        const size_t end = len - i >= sizeof(uint64_t) ? i + sizeof(uint64_t) : len;
+        for (; i < end; ++i) {
+            switch (bytes[i]) {
+                case '\0':
+                    /* [MQTT-4.7.3-2] Check for the null character */
+                    return false;
 
-        /* Check single level wildcard */
-        if (memchr(topic_part.ptr, '+', topic_part.len)) {
-            if (!is_filter) {
-                /* [MQTT-4.7.1-3] + only allowed on filters */
-                return false;
-            }
-            if (topic_part.len > 1) {
-                /* topic part must be 1 character long */
-                return false;
-            }
-        }
+                case '/':
+                    if (wildcard == '#') {
+                        /* [MQTT-4.7.1-2] If last part was a '#' and there's still another part, it's invalid */
+                        return false;
+                    }
+                    wildcard = 0;
+                    level_start = i + 1;
+                    if (level_count < max_levels) {
+                        level_offsets[level_count] = (uint16_t)level_start;
+                    }
+                    ++level_count;
+                    break;
 
-        /* Check multi level wildcard */
-        if (memchr(topic_part.ptr, '#', topic_part.len)) {
-            if (!is_filter) {
-                /* [MQTT-4.7.1-2] # only allowed on filters */
-                return false;
-            }
-            if (topic_part.len > 1) {
-                /* topic part must be 1 character long */
-                return false;
+                case '+':
+                case '#':
+                    if (!is_filter) {
+                        /* [MQTT-4.7.1-2] [MQTT-4.7.1-3] wildcards only allowed on filters */
+                        return false;
+                    }
+                    if (i != level_start) {
+                        /* topic part must be 1 character long */
+                        return false;
+                    }
+                    wildcard = bytes[i];
+                    break;
+
+                default:
+                    if (wildcard) {
+                        /* topic part must be 1 character long */
+                        return false;
+                    }
+                    break;
             }
-            saw_hash = true;
         }
     }
 
+    if (level_count_out) {
+        *level_count_out = level_count;
+    }
     return true;
 }
 
+static bool s_is_valid_topic(const struct aws_byte_cursor *topic, bool is_filter) {
+
+    return aws_mqtt_validate_topic_levels(topic, is_filter, NULL, 0, NULL);
+}
+
 bool aws_mqtt_is_valid_topic(const struct aws_byte_cursor *topic) {
 
     return s_is_valid_topic(topic, false);
@@ -0,0 +1,99 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/packet_id_set.h>
+
+/**
+ * Index of the lowest set bit of a non-zero word, in constant time: isolating the bit gives a power of two, and
+ * multiplying by a de Bruijn sequence moves a distinct 6 bit pattern into the top bits for each of the 64 powers.
+ */
+static size_t s_lowest_set_bit(uint64_t word) {
+    static const uint8_t s_de_bruijn_index[64] = {
+        0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,  62, 55, 59, 36, 53, 51,
+        43, 22, 45, 39, 33, 30, 24, 18, 12, 5,  63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21,
+        44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6,
+    };
+
+    AWS_ASSERT(word != 0);
+    const uint64_t lowest_bit = word & (~word + 1);
+    return s_de_bruijn_index[(lowest_bit * UINT64_C(0x03F79D71B4CB0A89)) >> 58];
+}
+
+/* The bits of a word that are unavailable; id 0 is never available */
+static uint64_t s_taken_bits(const struct aws_mqtt_packet_id_set *set, size_t word_index) {
+    return word_index == 0 ? set->words[0] | 1 : set->words[word_index];
+}
+
+void aws_mqtt_packet_id_set_clear(struct aws_mqtt_packet_id_set *set) {
+    AWS_PRECONDITION(set);
+
+    AWS_ZERO_STRUCT(*set);
+}
+
+bool aws_mqtt_packet_id_set_contains(const struct aws_mqtt_packet_id_set *set, uint16_t packet_id) {
+    AWS_PRECONDITION(set);
+
+    return (set->words[packet_id / 64] >> (packet_id % 64)) & 1;
+}
+
+bool aws_mqtt_packet_id_set_add(struct aws_mqtt_packet_id_set *set, uint16_t packet_id) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(packet_id != 0);
+
+    const uint64_t bit = UINT64_C(1) << (packet_id % 64);
+    uint64_t *word = &set->words[packet_id / 64];
+    if (*word & bit) {
+        return false;
+    }
+
+    *word |= bit;
+    ++set->count;
+    return true;
+}
+
+bool aws_mqtt_packet_id_set_remove(struct aws_mqtt_packet_id_set *set, uint16_t packet_id) {
+    AWS_PRECONDITION(set);
+
+    const uint64_t bit = UINT64_C(1) << (packet_id % 64);
+    uint64_t *word = &set->words[packet_id / 64];
+    if (!(*word & bit)) {
+        return false;
+    }
+
+    *word &= ~bit;
+    --set->count;
+    return true;
+}
+
+size_t aws_mqtt_packet_id_set_count(const struct aws_mqtt_packet_id_set *set) {
+    AWS_PRECONDITION(set);
+
+    return set->count;
+}
+
+uint16_t aws_mqtt_packet_id_set_find_free(const struct aws_mqtt_packet_id_set *set, uint16_t start) {
+    AWS_PRECONDITION(set);
+
+    if (set->count == UINT16_MAX) {
+        return 0;
+    }
+
+    /* The ids below start in its word count as taken for now, they're looked at again after wrapping around */
+    size_t word_index = start / 64;
+    uint64_t taken = s_taken_bits(set, word_index) | ((UINT64_C(1) << (start % 64)) - 1);
+
+    for (size_t i = 0; i <= AWS_MQTT_PACKET_ID_SET_WORD_COUNT; ++i) {
+        if (taken != UINT64_MAX) {
+            return (uint16_t)(word_index * 64 + s_lowest_set_bit(~taken));
+        }
+
+        word_index = (word_index + 1) % AWS_MQTT_PACKET_ID_SET_WORD_COUNT;
+        taken = s_taken_bits(set, word_index);
+    }
+
+    /* Unreachable as long as count is accurate */
+    AWS_ASSERT(false);
+    return 0;
+}
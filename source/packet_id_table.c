@@ -0,0 +1,97 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/packet_id_table.h>
+
+void aws_mqtt_packet_id_table_init(struct aws_mqtt_packet_id_table *table, struct aws_allocator *allocator) {
+    AWS_PRECONDITION(table);
+    AWS_PRECONDITION(allocator);
+
+    AWS_ZERO_STRUCT(*table);
+    table->allocator = allocator;
+}
+
+void aws_mqtt_packet_id_table_clean_up(struct aws_mqtt_packet_id_table *table) {
+    AWS_PRECONDITION(table);
+
+    for (size_t i = 0; i < AWS_MQTT_PACKET_ID_TABLE_PAGE_COUNT; ++i) {
+        if (table->pages[i]) {
+            aws_mem_release(table->allocator, table->pages[i]);
+        }
+    }
+    if (table->spare_page) {
+        aws_mem_release(table->allocator, table->spare_page);
+    }
+
+    struct aws_allocator *allocator = table->allocator;
+    AWS_ZERO_STRUCT(*table);
+    table->allocator = allocator;
+}
+
+void *aws_mqtt_packet_id_table_find(const struct aws_mqtt_packet_id_table *table, uint16_t packet_id) {
+    AWS_PRECONDITION(table);
+
+    void **page = table->pages[packet_id / AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE];
+    return page ? page[packet_id % AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE] : NULL;
+}
+
+int aws_mqtt_packet_id_table_put(struct aws_mqtt_packet_id_table *table, uint16_t packet_id, void *value) {
+    AWS_PRECONDITION(table);
+    AWS_PRECONDITION(value);
+
+    const size_t page_index = packet_id / AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE;
+    void **page = table->pages[page_index];
+    if (!page) {
+        if (table->spare_page) {
+            page = table->spare_page;
+            table->spare_page = NULL;
+        } else {
+            page = aws_mem_calloc(table->allocator, AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE, sizeof(void *));
+            if (!page) {
+                return AWS_OP_ERR;
+            }
+        }
+        table->pages[page_index] = page;
+    }
+
+    void **entry = &page[packet_id % AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE];
+    if (*entry == NULL) {
+        ++table->page_counts[page_index];
+        ++table->count;
+    }
+    *entry = value;
+
+    return AWS_OP_SUCCESS;
+}
+
+void *aws_mqtt_packet_id_table_remove(struct aws_mqtt_packet_id_table *table, uint16_t packet_id) {
+    AWS_PRECONDITION(table);
+
+    const size_t page_index = packet_id / AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE;
+    void **page = table->pages[page_index];
+    if (!page) {
+        return NULL;
+    }
+
+    void **entry = &page[packet_id % AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE];
+    void *value = *entry;
+    if (value == NULL) {
+        return NULL;
+    }
+
+    *entry = NULL;
+    --table->count;
+    if (--table->page_counts[page_index] == 0) {
+        /* Every entry is NULL again, so the page can be handed out as is */
+        if (table->spare_page) {
+            aws_mem_release(table->allocator, page);
+        } else {
+            table->spare_page = page;
+        }
+        table->pages[page_index] = NULL;
+    }
+
+    return value;
+}
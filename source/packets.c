@@ -57,6 +57,75 @@ static int s_decode_buffer(struct aws_byte_cursor *cur, struct aws_byte_cursor *
     return AWS_OP_SUCCESS;
 }
 
+/*
+ * Unchecked writers for the encoders of the packets sent most often. Those first compute the exact size of what they're
+ * about to write and check once that buf has room for it (see s_encode_fixed_header_with_room), then write each field
+ * without checking again.
+ */
+static uint8_t *s_write_be16_unchecked(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)(value & 0xFF);
+    return out + sizeof(uint16_t);
+}
+
+static uint8_t *s_write_unchecked(uint8_t *out, struct aws_byte_cursor cur) {
+    if (cur.len) {
+        memcpy(out, cur.ptr, cur.len);
+    }
+    return out + cur.len;
+}
+
+static uint8_t *s_encode_buffer_unchecked(uint8_t *out, struct aws_byte_cursor cur) {
+    AWS_PRECONDITION(cur.len <= UINT16_MAX);
+
+    out = s_write_be16_unchecked(out, (uint16_t)cur.len);
+    return s_write_unchecked(out, cur);
+}
+
+/*
+ * Makes sure buf has room for the fixed header plus body_size more bytes, and encodes the fixed header. Returns where
+ * the body goes, or NULL with an error raised. Once the body is written, the encoder sets buf->len to the end of it.
+ */
+static uint8_t *s_encode_fixed_header_with_room(
+    struct aws_byte_buf *buf,
+    const struct aws_mqtt_fixed_header *header,
+    size_t body_size) {
+
+    if (buf->capacity - buf->len < aws_mqtt_fixed_header_encoded_size(header) + body_size) {
+        aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+        return NULL;
+    }
+
+    if (aws_mqtt_fixed_header_encode(buf, header)) {
+        return NULL;
+    }
+
+    return buf->buffer + buf->len;
+}
+
+/*
+ * The lists of SUBSCRIBE, SUBACK and UNSUBSCRIBE packets start out as static lists over storage inline in the packet,
+ * and only move to the heap once they outgrow it. A subscribe storm is mostly packets with a handful of entries, which
+ * then never allocate.
+ */
+static int s_inline_list_push_back(struct aws_array_list *list, struct aws_allocator *allocator, const void *item) {
+
+    if (list->alloc == NULL && aws_array_list_length(list) == aws_array_list_capacity(list)) {
+        struct aws_array_list heap_list;
+        if (aws_array_list_init_dynamic(&heap_list, allocator, 2 * aws_array_list_capacity(list), list->item_size)) {
+            return AWS_OP_ERR;
+        }
+
+        if (list->length) {
+            memcpy(heap_list.data, list->data, list->length * list->item_size);
+        }
+        heap_list.length = list->length;
+        *list = heap_list;
+    }
+
+    return aws_array_list_push_back(list, item);
+}
+
 /*****************************************************************************/
 /* Ack without payload                                                       */
 
@@ -80,7 +149,8 @@ int aws_mqtt_packet_ack_encode(struct aws_byte_buf *buf, const struct aws_mqtt_p
     /*************************************************************************/
     /* Fixed Header */
 
-    if (aws_mqtt_fixed_header_encode(buf, &packet->fixed_header)) {
+    uint8_t *out = s_encode_fixed_header_with_room(buf, &packet->fixed_header, sizeof(uint16_t));
+    if (!out) {
         return AWS_OP_ERR;
     }
 
@@ -88,9 +158,9 @@ int aws_mqtt_packet_ack_encode(struct aws_byte_buf *buf, const struct aws_mqtt_p
     /* Variable Header                                                       */
 
     /* Write packet identifier */
-    if (!aws_byte_buf_write_be16(buf, packet->packet_identifier)) {
-        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-    }
+    out = s_write_be16_unchecked(out, packet->packet_identifier);
+
+    buf->len = (size_t)(out - buf->buffer);
 
     return AWS_OP_SUCCESS;
 }
@@ -498,6 +568,11 @@ int aws_mqtt_packet_publish_init(
 
 int aws_mqtt_packet_publish_encode(struct aws_byte_buf *buf, const struct aws_mqtt_packet_publish *packet) {
 
+    /* Don't leave the headers behind if the payload won't fit after them */
+    if (buf->capacity - buf->len < aws_mqtt_packet_encoded_size(&packet->fixed_header)) {
+        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+    }
+
     if (aws_mqtt_packet_publish_encode_headers(buf, packet)) {
         return AWS_OP_ERR;
     }
@@ -517,10 +592,18 @@ int aws_mqtt_packet_publish_encode_headers(struct aws_byte_buf *buf, const struc
     AWS_PRECONDITION(buf);
     AWS_PRECONDITION(packet);
 
+    if (packet->topic_name.len > UINT16_MAX) {
+        return aws_raise_error(AWS_ERROR_MQTT_BUFFER_TOO_BIG);
+    }
+
+    enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(packet);
+    const size_t variable_header_size = sizeof(uint16_t) + packet->topic_name.len + (qos > 0 ? sizeof(uint16_t) : 0);
+
     /*************************************************************************/
     /* Fixed Header */
 
-    if (aws_mqtt_fixed_header_encode(buf, &packet->fixed_header)) {
+    uint8_t *out = s_encode_fixed_header_with_room(buf, &packet->fixed_header, variable_header_size);
+    if (!out) {
         return AWS_OP_ERR;
     }
 
@@ -528,18 +611,20 @@ int aws_mqtt_packet_publish_encode_headers(struct aws_byte_buf *buf, const struc
     /* Variable Header                                                       */
 
     /* Write topic name */
-    if (s_encode_buffer(buf, packet->topic_name)) {
-        return AWS_OP_ERR;
+    if (packet->encoded_topic_name.len) {
+        AWS_ASSERT(packet->encoded_topic_name.len == sizeof(uint16_t) + packet->topic_name.len);
+        out = s_write_unchecked(out, packet->encoded_topic_name);
+    } else {
+        out = s_encode_buffer_unchecked(out, packet->topic_name);
     }
 
-    enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(packet);
     if (qos > 0) {
         /* Write packet identifier */
-        if (!aws_byte_buf_write_be16(buf, packet->packet_identifier)) {
-            return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-        }
+        out = s_write_be16_unchecked(out, packet->packet_identifier);
     }
 
+    buf->len = (size_t)(out - buf->buffer);
+
     return AWS_OP_SUCCESS;
 }
 
@@ -662,9 +747,12 @@ int aws_mqtt_packet_subscribe_init(
 
     packet->packet_identifier = packet_identifier;
 
-    if (aws_array_list_init_dynamic(&packet->topic_filters, allocator, 1, sizeof(struct aws_mqtt_subscription))) {
-        return AWS_OP_ERR;
-    }
+    packet->allocator = allocator;
+    aws_array_list_init_static(
+        &packet->topic_filters,
+        packet->inline_topic_filters,
+        AWS_MQTT_PACKET_INLINE_LIST_SIZE,
+        sizeof(struct aws_mqtt_subscription));
 
     return AWS_OP_SUCCESS;
 }
@@ -689,7 +777,7 @@ int aws_mqtt_packet_subscribe_add_topic(
     struct aws_mqtt_subscription subscription;
     subscription.topic_filter = topic_filter;
     subscription.qos = qos;
-    if (aws_array_list_push_back(&packet->topic_filters, &subscription)) {
+    if (s_inline_list_push_back(&packet->topic_filters, packet->allocator, &subscription)) {
         return AWS_OP_ERR;
     }
 
@@ -704,10 +792,22 @@ int aws_mqtt_packet_subscribe_encode(struct aws_byte_buf *buf, const struct aws_
     AWS_PRECONDITION(buf);
     AWS_PRECONDITION(packet);
 
+    /* Size everything up first, so the filters can be written without checking for room one field at a time */
+    const size_t num_filters = aws_array_list_length(&packet->topic_filters);
+    const struct aws_mqtt_subscription *subscriptions = packet->topic_filters.data;
+    size_t body_size = sizeof(uint16_t);
+    for (size_t i = 0; i < num_filters; ++i) {
+        if (subscriptions[i].topic_filter.len > UINT16_MAX) {
+            return aws_raise_error(AWS_ERROR_MQTT_BUFFER_TOO_BIG);
+        }
+        body_size += sizeof(uint16_t) + subscriptions[i].topic_filter.len + 1;
+    }
+
     /*************************************************************************/
     /* Fixed Header */
 
-    if (aws_mqtt_fixed_header_encode(buf, &packet->fixed_header)) {
+    uint8_t *out = s_encode_fixed_header_with_room(buf, &packet->fixed_header, body_size);
+    if (!out) {
         return AWS_OP_ERR;
     }
 
@@ -715,27 +815,16 @@ int aws_mqtt_packet_subscribe_encode(struct aws_byte_buf *buf, const struct aws_
     /* Variable Header                                                       */
 
     /* Write packet identifier */
-    if (!aws_byte_buf_write_be16(buf, packet->packet_identifier)) {
-        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-    }
+    out = s_write_be16_unchecked(out, packet->packet_identifier);
 
     /* Write topic filters */
-    const size_t num_filters = aws_array_list_length(&packet->topic_filters);
     for (size_t i = 0; i < num_filters; ++i) {
-
-        struct aws_mqtt_subscription *subscription;
-        if (aws_array_list_get_at_ptr(&packet->topic_filters, (void **)&subscription, i)) {
-
-            return AWS_OP_ERR;
-        }
-        s_encode_buffer(buf, subscription->topic_filter);
-
-        uint8_t eos_byte = subscription->qos & 0x3;
-        if (!aws_byte_buf_write_u8(buf, eos_byte)) {
-            return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-        }
+        out = s_encode_buffer_unchecked(out, subscriptions[i].topic_filter);
+        *out++ = subscriptions[i].qos & 0x3;
     }
 
+    buf->len = (size_t)(out - buf->buffer);
+
     return AWS_OP_SUCCESS;
 }
 
@@ -787,7 +876,9 @@ int aws_mqtt_packet_subscribe_decode(struct aws_byte_cursor *cur, struct aws_mqt
         }
         subscription.qos = eos_byte & 0x3;
 
-        aws_array_list_push_back(&packet->topic_filters, &subscription);
+        if (s_inline_list_push_back(&packet->topic_filters, packet->allocator, &subscription)) {
+            return AWS_OP_ERR;
+        }
 
         remaining_length -= s_sizeof_encoded_buffer(&subscription.topic_filter) + 1;
     }
@@ -812,9 +903,10 @@ int aws_mqtt_packet_suback_init(
 
     packet->packet_identifier = packet_identifier;
 
-    if (aws_array_list_init_dynamic(&packet->return_codes, allocator, 1, sizeof(uint8_t))) {
-        return AWS_OP_ERR;
-    }
+    packet->allocator = allocator;
+    aws_array_list_init_static(
+        &packet->return_codes, packet->inline_return_codes, AWS_MQTT_PACKET_INLINE_LIST_SIZE, sizeof(uint8_t));
+
     return AWS_OP_SUCCESS;
 }
 
@@ -843,7 +935,7 @@ int aws_mqtt_packet_suback_add_return_code(struct aws_mqtt_packet_suback *packet
     }
 
     /* Add to the array list */
-    if (aws_array_list_push_back(&packet->return_codes, &return_code)) {
+    if (s_inline_list_push_back(&packet->return_codes, packet->allocator, &return_code)) {
         return AWS_OP_ERR;
     }
 
@@ -920,21 +1012,23 @@ int aws_mqtt_packet_suback_decode(struct aws_byte_cursor *cur, struct aws_mqtt_p
     /*************************************************************************/
     /* Payload                                                               */
 
-    /* Read return codes */
+    /* Read return codes, one byte each, which the list then views in place rather than copying them */
     size_t remaining_length = packet->fixed_header.remaining_length - sizeof(uint16_t);
-    while (remaining_length) {
+    struct aws_byte_cursor return_codes = aws_byte_cursor_advance(cur, remaining_length);
+    if (return_codes.len != remaining_length) {
+        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+    }
 
-        uint8_t return_code = 0;
-        if (!aws_byte_cursor_read_u8(cur, &return_code)) {
-            return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-        }
-        if (!(s_return_code_check(return_code))) {
+    for (size_t i = 0; i < return_codes.len; ++i) {
+        if (!(s_return_code_check(return_codes.ptr[i]))) {
             return aws_raise_error(AWS_ERROR_MQTT_PROTOCOL_ERROR);
         }
+    }
 
-        aws_array_list_push_back(&packet->return_codes, &return_code);
-
-        remaining_length -= 1;
+    if (return_codes.len) {
+        aws_array_list_clean_up(&packet->return_codes);
+        aws_array_list_init_static(&packet->return_codes, return_codes.ptr, return_codes.len, sizeof(uint8_t));
+        packet->return_codes.length = return_codes.len;
     }
 
     return AWS_OP_SUCCESS;
@@ -959,9 +1053,12 @@ int aws_mqtt_packet_unsubscribe_init(
 
     packet->packet_identifier = packet_identifier;
 
-    if (aws_array_list_init_dynamic(&packet->topic_filters, allocator, 1, sizeof(struct aws_byte_cursor))) {
-        return AWS_OP_ERR;
-    }
+    packet->allocator = allocator;
+    aws_array_list_init_static(
+        &packet->topic_filters,
+        packet->inline_topic_filters,
+        AWS_MQTT_PACKET_INLINE_LIST_SIZE,
+        sizeof(struct aws_byte_cursor));
 
     return AWS_OP_SUCCESS;
 }
@@ -982,7 +1079,7 @@ int aws_mqtt_packet_unsubscribe_add_topic(
     AWS_PRECONDITION(packet);
 
     /* Add to the array list */
-    if (aws_array_list_push_back(&packet->topic_filters, &topic_filter)) {
+    if (s_inline_list_push_back(&packet->topic_filters, packet->allocator, &topic_filter)) {
         return AWS_OP_ERR;
     }
 
@@ -997,10 +1094,22 @@ int aws_mqtt_packet_unsubscribe_encode(struct aws_byte_buf *buf, const struct aw
     AWS_PRECONDITION(buf);
     AWS_PRECONDITION(packet);
 
+    /* Size everything up first, so the filters can be written without checking for room one field at a time */
+    const size_t num_filters = aws_array_list_length(&packet->topic_filters);
+    const struct aws_byte_cursor *topic_filters = packet->topic_filters.data;
+    size_t body_size = sizeof(uint16_t);
+    for (size_t i = 0; i < num_filters; ++i) {
+        if (topic_filters[i].len > UINT16_MAX) {
+            return aws_raise_error(AWS_ERROR_MQTT_BUFFER_TOO_BIG);
+        }
+        body_size += sizeof(uint16_t) + topic_filters[i].len;
+    }
+
     /*************************************************************************/
     /* Fixed Header */
 
-    if (aws_mqtt_fixed_header_encode(buf, &packet->fixed_header)) {
+    uint8_t *out = s_encode_fixed_header_with_room(buf, &packet->fixed_header, body_size);
+    if (!out) {
         return AWS_OP_ERR;
     }
 
@@ -1008,22 +1117,15 @@ int aws_mqtt_packet_unsubscribe_encode(struct aws_byte_buf *buf, const struct aw
     /* Variable Header                                                       */
 
     /* Write packet identifier */
-    if (!aws_byte_buf_write_be16(buf, packet->packet_identifier)) {
-        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
-    }
+    out = s_write_be16_unchecked(out, packet->packet_identifier);
 
     /* Write topic filters */
-    const size_t num_filters = aws_array_list_length(&packet->topic_filters);
     for (size_t i = 0; i < num_filters; ++i) {
-
-        struct aws_byte_cursor topic_filter = {.ptr = NULL, .len = 0};
-        if (aws_array_list_get_at(&packet->topic_filters, (void *)&topic_filter, i)) {
-
-            return AWS_OP_ERR;
-        }
-        s_encode_buffer(buf, topic_filter);
+        out = s_encode_buffer_unchecked(out, topic_filters[i]);
     }
 
+    buf->len = (size_t)(out - buf->buffer);
+
     return AWS_OP_SUCCESS;
 }
 
@@ -1061,7 +1163,9 @@ int aws_mqtt_packet_unsubscribe_decode(struct aws_byte_cursor *cur, struct aws_m
             return AWS_OP_ERR;
         }
 
-        aws_array_list_push_back(&packet->topic_filters, &topic_filter);
+        if (s_inline_list_push_back(&packet->topic_filters, packet->allocator, &topic_filter)) {
+            return AWS_OP_ERR;
+        }
 
         remaining_length -= s_sizeof_encoded_buffer(&topic_filter);
     }
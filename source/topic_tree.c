@@ -5,6 +5,8 @@
 
 #include <aws/mqtt/private/topic_tree.h>
 
+#include <aws/mqtt/private/arena.h>
+
 #include <aws/io/logging.h>
 
 #include <aws/common/byte_buf.h>
@@ -120,6 +122,10 @@ static bool byte_cursor_eq(const void *a, const void *b) {
  * Init
  ******************************************************************************/
 
+static struct aws_mqtt_topic_tree_matcher *s_topic_tree_matcher_new(struct aws_allocator *allocator);
+static void s_topic_tree_matcher_destroy(struct aws_mqtt_topic_tree_matcher *matcher);
+static void s_topic_tree_dispatch_cache_destroy(struct aws_mqtt_topic_tree_dispatch_cache *cache);
+
 static struct aws_mqtt_topic_node *s_topic_node_new(
     struct aws_allocator *allocator,
     const struct aws_byte_cursor *topic_filter,
@@ -193,20 +199,58 @@ int aws_mqtt_topic_tree_init(struct aws_mqtt_topic_tree *tree, struct aws_alloca
 
     AWS_LOGF_DEBUG(AWS_LS_MQTT_TOPIC_TREE, "tree=%p: Creating new topic tree", (void *)tree);
 
-    tree->root = s_topic_node_new(allocator, NULL, NULL);
+    tree->arena = aws_mqtt_arena_new(allocator, 0);
+    if (!tree->arena) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "tree=%p: Failed to allocate node arena", (void *)tree);
+        return AWS_OP_ERR;
+    }
+
+    tree->root = s_topic_node_new(&tree->arena->allocator, NULL, NULL);
     if (!tree->root) {
         /* Error raised by s_topic_node_new */
-        return AWS_OP_ERR;
+        goto root_new_failed;
+    }
+
+    tree->matcher = s_topic_tree_matcher_new(allocator);
+    if (!tree->matcher) {
+        goto matcher_new_failed;
     }
     tree->allocator = allocator;
+    /* The matcher starts out at epoch 0, so it's built once publishes have found the tree settled */
+    tree->epoch = 1;
+    tree->dispatch_cache = NULL;
 
     return AWS_OP_SUCCESS;
+
+matcher_new_failed:
+    s_topic_node_destroy(tree->root, &tree->arena->allocator);
+    tree->root = NULL;
+
+root_new_failed:
+    aws_mqtt_arena_destroy(tree->arena);
+    tree->arena = NULL;
+
+    return AWS_OP_ERR;
 }
 
 /*******************************************************************************
  * Clean Up
  ******************************************************************************/
 
+/* Calls the cleanup callback of node and all of its children, without freeing anything. */
+static void s_topic_node_clean_up_userdata(struct aws_mqtt_topic_node *node) {
+
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&node->subtopics); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+
+        s_topic_node_clean_up_userdata(iter.element.value);
+    }
+
+    if (node->cleanup && node->userdata) {
+        node->cleanup(node->userdata);
+    }
+}
+
 void aws_mqtt_topic_tree_clean_up(struct aws_mqtt_topic_tree *tree) {
 
     AWS_PRECONDITION(tree);
@@ -214,7 +258,11 @@ void aws_mqtt_topic_tree_clean_up(struct aws_mqtt_topic_tree *tree) {
     AWS_LOGF_DEBUG(AWS_LS_MQTT_TOPIC_TREE, "tree=%p: Cleaning up topic tree", (void *)tree);
 
     if (tree->allocator && tree->root) {
-        s_topic_node_destroy(tree->root, tree->allocator);
+        /* The nodes, their tables and filters all live in the arena, no need to free them one at a time */
+        s_topic_node_clean_up_userdata(tree->root);
+        aws_mqtt_arena_destroy(tree->arena);
+        s_topic_tree_matcher_destroy(tree->matcher);
+        s_topic_tree_dispatch_cache_destroy(tree->dispatch_cache);
 
         AWS_ZERO_STRUCT(*tree);
     }
@@ -355,9 +403,6 @@ static void s_topic_tree_action_commit(struct topic_tree_action *action, struct
             action->node_to_update->cleanup = action->cleanup;
             action->node_to_update->userdata = action->userdata;
             action->node_to_update->qos = action->qos;
-            if (action->topic.ptr) {
-                action->node_to_update->topic = action->topic;
-            }
             if (action->topic_filter) {
                 if (action->node_to_update->owns_topic_filter && action->node_to_update->topic_filter) {
                     /* The topic filer is already there, destory the new filter to keep all the byte cursor valid */
@@ -365,6 +410,10 @@ static void s_topic_tree_action_commit(struct topic_tree_action *action, struct
                 } else {
                     action->node_to_update->topic_filter = action->topic_filter;
                     action->node_to_update->owns_topic_filter = true;
+                    /* Only point topic into the new filter once it's certain to be kept */
+                    if (action->topic.ptr) {
+                        action->node_to_update->topic = action->topic;
+                    }
                 }
             }
             break;
@@ -431,7 +480,7 @@ static void s_topic_tree_action_commit(struct topic_tree_action *action, struct
                         if (i != sub_parts_len) {
 
                             /* Clean up and delete */
-                            s_topic_node_destroy(node, tree->allocator);
+                            s_topic_node_destroy(node, &tree->arena->allocator);
                         } else {
                             destroy_current = true;
                         }
@@ -510,7 +559,7 @@ static void s_topic_tree_action_commit(struct topic_tree_action *action, struct
 
                 /* Now that the strings are update, remove current. */
                 if (destroy_current) {
-                    s_topic_node_destroy(current, tree->allocator);
+                    s_topic_node_destroy(current, &tree->arena->allocator);
                 }
                 current = NULL;
             }
@@ -541,7 +590,7 @@ static void s_topic_tree_action_roll_back(struct topic_tree_action *action, stru
             /* Remove the first new node from it's parent's map */
             aws_hash_table_remove(&action->last_found->subtopics, &action->first_created->topic, NULL, NULL);
             /* Recursively destroy all other created nodes */
-            s_topic_node_destroy(action->first_created, tree->allocator);
+            s_topic_node_destroy(action->first_created, &tree->arena->allocator);
 
             if (action->topic_filter) {
                 aws_string_destroy((void *)action->topic_filter);
@@ -584,7 +633,7 @@ int aws_mqtt_topic_tree_transaction_insert(
     AWS_PRECONDITION(callback);
 
     /* let topic tree take the ownership of the new string and leave the caller string alone. */
-    struct aws_string *topic_filter = aws_string_new_from_string(tree->allocator, topic_filter_ori);
+    struct aws_string *topic_filter = aws_string_new_from_string(&tree->arena->allocator, topic_filter_ori);
 
     AWS_LOGF_DEBUG(
         AWS_LS_MQTT_TOPIC_TREE,
@@ -627,7 +676,7 @@ int aws_mqtt_topic_tree_transaction_insert(
             }
 
             /* Node does not exist, add new one */
-            current = s_topic_node_new(tree->allocator, &sub_part, topic_filter);
+            current = s_topic_node_new(&tree->arena->allocator, &sub_part, topic_filter);
             if (!current) {
                 /* Don't do handle_error logic, the action needs to persist to be rolled back */
                 return AWS_OP_ERR;
@@ -787,7 +836,12 @@ handle_error:
 
 void aws_mqtt_topic_tree_transaction_commit(struct aws_mqtt_topic_tree *tree, struct aws_array_list *transaction) {
 
+    /* Nodes added ahead of the commit aren't subscriptions until now, so one bump covers the whole transaction */
     const size_t num_actions = aws_array_list_length(transaction);
+    if (num_actions) {
+        ++tree->epoch;
+    }
+
     for (size_t i = 0; i < num_actions; ++i) {
         struct topic_tree_action *action = NULL;
         aws_array_list_get_at_ptr(transaction, (void **)&action, i);
@@ -805,6 +859,10 @@ void aws_mqtt_topic_tree_transaction_commit(struct aws_mqtt_topic_tree *tree, st
 void aws_mqtt_topic_tree_transaction_roll_back(struct aws_mqtt_topic_tree *tree, struct aws_array_list *transaction) {
 
     const size_t num_actions = aws_array_list_length(transaction);
+    if (num_actions) {
+        ++tree->epoch;
+    }
+
     for (size_t i = 1; i <= num_actions; ++i) {
         struct topic_tree_action *action = NULL;
         aws_array_list_get_at_ptr(transaction, (void **)&action, num_actions - i);
@@ -856,10 +914,592 @@ int aws_mqtt_topic_tree_remove(struct aws_mqtt_topic_tree *tree, const struct aw
     return AWS_OP_SUCCESS;
 }
 
+/*******************************************************************************
+ * Compiled Matcher
+ ******************************************************************************/
+
+/* Stack space for this many levels of a publish topic, deeper topics allocate. */
+#define AWS_MQTT_TOPIC_TREE_MATCHER_STACK_LEVELS 32
+
+/* Once stale, the matcher is only rebuilt after this many publishes in a row have found the tree unchanged. */
+#define AWS_MQTT_TOPIC_TREE_MATCHER_QUIET_PUBLISHES 64
+
+struct topic_tree_matcher_node {
+    /* The tree node, if it is a subscription. NULL otherwise. */
+    const struct aws_mqtt_topic_node *subscription;
+
+    /* The topic level this node matches, points into the tree */
+    struct aws_byte_cursor topic;
+
+    /* Indices of the '+' and '#' children. The root is at index 0 and is nobody's child, so 0 means none. */
+    uint32_t single_level_wildcard;
+    uint32_t multi_level_wildcard;
+
+    /**
+     * The literal children live in edges[first_literal, first_literal + literal_slot_count), an open-addressed table
+     * indexed by the hash of their topic level. The slot count is a power of two at least twice the number of literal
+     * children, 0 if there are none.
+     */
+    uint32_t first_literal;
+    uint32_t literal_slot_count;
+};
+
+struct topic_tree_matcher_edge {
+    uint32_t hash;
+    /* 0 for an empty slot */
+    uint32_t child;
+};
+
+struct aws_mqtt_topic_tree_matcher {
+    struct aws_allocator *allocator;
+
+    /* The tree's epoch as of the last rebuild. Once the tree moves on, the cursors in nodes may dangle. */
+    uint64_t epoch;
+
+    /* While stale, the tree's epoch as last seen and how many publishes have seen it since */
+    uint64_t stale_epoch;
+    size_t quiet_publishes;
+
+    struct aws_array_list nodes; /* topic_tree_matcher_node, the root first */
+    struct aws_array_list edges; /* topic_tree_matcher_edge */
+};
+
+/* One level of a publish topic */
+struct topic_tree_matcher_level {
+    const uint8_t *ptr;
+    uint32_t len;
+    uint32_t hash;
+};
+
+static struct aws_mqtt_topic_tree_matcher *s_topic_tree_matcher_new(struct aws_allocator *allocator) {
+
+    struct aws_mqtt_topic_tree_matcher *matcher =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_mqtt_topic_tree_matcher));
+    if (!matcher) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "Failed to allocate topic tree matcher");
+        return NULL;
+    }
+
+    matcher->allocator = allocator;
+
+    if (aws_array_list_init_dynamic(&matcher->nodes, allocator, 1, sizeof(struct topic_tree_matcher_node))) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "matcher=%p: Failed to initialize nodes list", (void *)matcher);
+        goto nodes_init_failed;
+    }
+
+    if (aws_array_list_init_dynamic(&matcher->edges, allocator, 0, sizeof(struct topic_tree_matcher_edge))) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "matcher=%p: Failed to initialize edges list", (void *)matcher);
+        goto edges_init_failed;
+    }
+
+    return matcher;
+
+edges_init_failed:
+    aws_array_list_clean_up(&matcher->nodes);
+
+nodes_init_failed:
+    aws_mem_release(allocator, matcher);
+
+    return NULL;
+}
+
+static void s_topic_tree_matcher_destroy(struct aws_mqtt_topic_tree_matcher *matcher) {
+
+    if (!matcher) {
+        return;
+    }
+
+    aws_array_list_clean_up(&matcher->edges);
+    aws_array_list_clean_up(&matcher->nodes);
+    aws_mem_release(matcher->allocator, matcher);
+}
+
+/* FNV-1a, the same function has to be used for the tree's levels and the publish topic's */
+static uint32_t s_topic_level_hash(const uint8_t *ptr, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ ptr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool s_topic_node_is_wildcard(const struct aws_mqtt_topic_node *node) {
+    return aws_string_eq_byte_cursor(s_single_level_wildcard, &node->topic) ||
+           aws_string_eq_byte_cursor(s_multi_level_wildcard, &node->topic);
+}
+
+/* Appends node, then all of its children, to the matcher. */
+static int s_topic_tree_matcher_add_node(
+    struct aws_mqtt_topic_tree_matcher *matcher,
+    const struct aws_mqtt_topic_node *node,
+    uint32_t *out_index) {
+
+    struct topic_tree_matcher_node matcher_node;
+    AWS_ZERO_STRUCT(matcher_node);
+    if (s_topic_node_is_subscription(node)) {
+        matcher_node.subscription = node;
+    }
+    matcher_node.topic = node->topic;
+    matcher_node.first_literal = (uint32_t)aws_array_list_length(&matcher->edges);
+
+    size_t literal_count = 0;
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&node->subtopics); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+
+        literal_count += !s_topic_node_is_wildcard(iter.element.value);
+    }
+    if (literal_count > 0) {
+        matcher_node.literal_slot_count = 2;
+        while (matcher_node.literal_slot_count < 2 * literal_count) {
+            matcher_node.literal_slot_count *= 2;
+        }
+    }
+
+    /* Reserve the slots up front so that they stay contiguous while the children append theirs */
+    struct topic_tree_matcher_edge empty_edge;
+    AWS_ZERO_STRUCT(empty_edge);
+    for (size_t i = 0; i < matcher_node.literal_slot_count; ++i) {
+        if (aws_array_list_push_back(&matcher->edges, &empty_edge)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    const uint32_t index = (uint32_t)aws_array_list_length(&matcher->nodes);
+    if (aws_array_list_push_back(&matcher->nodes, &matcher_node)) {
+        return AWS_OP_ERR;
+    }
+
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&node->subtopics); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+
+        const struct aws_mqtt_topic_node *child = iter.element.value;
+        uint32_t child_index = 0;
+        if (s_topic_tree_matcher_add_node(matcher, child, &child_index)) {
+            return AWS_OP_ERR;
+        }
+
+        /* Fetched again every time, the children may have grown the list */
+        struct topic_tree_matcher_node *parent = NULL;
+        aws_array_list_get_at_ptr(&matcher->nodes, (void **)&parent, index);
+
+        if (aws_string_eq_byte_cursor(s_multi_level_wildcard, &child->topic)) {
+            parent->multi_level_wildcard = child_index;
+        } else if (aws_string_eq_byte_cursor(s_single_level_wildcard, &child->topic)) {
+            parent->single_level_wildcard = child_index;
+        } else {
+            struct topic_tree_matcher_edge *edges = NULL;
+            aws_array_list_get_at_ptr(&matcher->edges, (void **)&edges, parent->first_literal);
+
+            const uint32_t hash = s_topic_level_hash(child->topic.ptr, child->topic.len);
+            const uint32_t mask = parent->literal_slot_count - 1;
+            uint32_t slot = hash & mask;
+            while (edges[slot].child) {
+                slot = (slot + 1) & mask;
+            }
+            edges[slot].hash = hash;
+            edges[slot].child = child_index;
+        }
+    }
+
+    *out_index = index;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_topic_tree_matcher_rebuild(const struct aws_mqtt_topic_tree *tree) {
+
+    struct aws_mqtt_topic_tree_matcher *matcher = tree->matcher;
+
+    aws_array_list_clear(&matcher->nodes);
+    aws_array_list_clear(&matcher->edges);
+
+    uint32_t root_index = 0;
+    if (s_topic_tree_matcher_add_node(matcher, tree->root, &root_index)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_MQTT_TOPIC_TREE,
+            "tree=%p: Failed to rebuild topic tree matcher, error %d (%s)",
+            (void *)tree,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+    AWS_ASSERT(root_index == 0);
+
+    matcher->epoch = tree->epoch;
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_MQTT_TOPIC_TREE,
+        "tree=%p: Rebuilt topic tree matcher with %zu nodes",
+        (void *)tree,
+        aws_array_list_length(&matcher->nodes));
+
+    return AWS_OP_SUCCESS;
+}
+
+typedef void(topic_tree_on_match_fn)(const struct aws_mqtt_topic_node *subscription, void *user_data);
+
+struct topic_tree_matcher_match_context {
+    const struct topic_tree_matcher_node *nodes;
+    const struct topic_tree_matcher_edge *edges;
+
+    const struct topic_tree_matcher_level *levels;
+    size_t level_count;
+
+    topic_tree_on_match_fn *on_match;
+    void *user_data;
+};
+
+static void s_topic_tree_matcher_match_do_recurse(
+    const struct topic_tree_matcher_match_context *ctx,
+    uint32_t index,
+    size_t level) {
+
+    const struct topic_tree_matcher_node *node = &ctx->nodes[index];
+
+    if (level == ctx->level_count) {
+        /* If this is the last node and is a sub, call it */
+        if (node->subscription) {
+            ctx->on_match(node->subscription, ctx->user_data);
+        }
+        return;
+    }
+
+    /* Check multi-level wildcard */
+    if (node->multi_level_wildcard) {
+        const struct aws_mqtt_topic_node *multi_wildcard = ctx->nodes[node->multi_level_wildcard].subscription;
+        /* Must be a subscription */
+        AWS_ASSERT(multi_wildcard);
+        if (multi_wildcard) {
+            ctx->on_match(multi_wildcard, ctx->user_data);
+        }
+    }
+
+    /* Check single level wildcard */
+    if (node->single_level_wildcard) {
+        s_topic_tree_matcher_match_do_recurse(ctx, node->single_level_wildcard, level + 1);
+    }
+
+    /* Check actual topic name, the hash picks the slot and the bytes confirm it */
+    if (node->literal_slot_count) {
+        const struct topic_tree_matcher_level *sub_part = &ctx->levels[level];
+        const struct topic_tree_matcher_edge *edges = ctx->edges + node->first_literal;
+        const uint32_t mask = node->literal_slot_count - 1;
+        for (uint32_t slot = sub_part->hash & mask; edges[slot].child; slot = (slot + 1) & mask) {
+            if (edges[slot].hash != sub_part->hash) {
+                continue;
+            }
+
+            const struct aws_byte_cursor *child_topic = &ctx->nodes[edges[slot].child].topic;
+            if (child_topic->len == sub_part->len && !memcmp(child_topic->ptr, sub_part->ptr, sub_part->len)) {
+                s_topic_tree_matcher_match_do_recurse(ctx, edges[slot].child, level + 1);
+                break;
+            }
+        }
+    }
+}
+
+/* Splits topic into levels and hashes each one. Returns the number of levels, even if it's more than max_levels. */
+static size_t s_topic_tree_matcher_split_levels(
+    const struct aws_byte_cursor *topic,
+    struct topic_tree_matcher_level *levels,
+    size_t max_levels) {
+
+    size_t level_count = 0;
+    size_t level_start = 0;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i <= topic->len; ++i) {
+        if (i == topic->len || topic->ptr[i] == '/') {
+            if (level_count < max_levels) {
+                levels[level_count].ptr = topic->ptr + level_start;
+                levels[level_count].len = (uint32_t)(i - level_start);
+                levels[level_count].hash = hash;
+            }
+            ++level_count;
+            level_start = i + 1;
+            hash = 2166136261u;
+        } else {
+            hash = (hash ^ topic->ptr[i]) * 16777619u;
+        }
+    }
+
+    return level_count;
+}
+
+/**
+ * Calls on_match for every subscription matching topic. Returns AWS_OP_ERR without calling it if the matcher is stale
+ * or couldn't be used, in which case the caller should walk the tree itself.
+ */
+static int s_topic_tree_matcher_match(
+    const struct aws_mqtt_topic_tree *tree,
+    const struct aws_byte_cursor *topic,
+    topic_tree_on_match_fn *on_match,
+    void *user_data) {
+
+    struct aws_mqtt_topic_tree_matcher *matcher = tree->matcher;
+    if (matcher->epoch != tree->epoch) {
+        /* Subscriptions tend to change in bursts, rebuilding after each change would mostly be thrown away. Leave
+         * publishes to the tree walk until the tree has settled. */
+        if (matcher->stale_epoch != tree->epoch) {
+            matcher->stale_epoch = tree->epoch;
+            matcher->quiet_publishes = 0;
+        }
+        if (++matcher->quiet_publishes < AWS_MQTT_TOPIC_TREE_MATCHER_QUIET_PUBLISHES ||
+            s_topic_tree_matcher_rebuild(tree)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    /* Hash each level of the topic once, rather than once per candidate node */
+    struct topic_tree_matcher_level stack_levels[AWS_MQTT_TOPIC_TREE_MATCHER_STACK_LEVELS];
+    struct topic_tree_matcher_level *levels = stack_levels;
+    size_t level_count =
+        s_topic_tree_matcher_split_levels(topic, stack_levels, AWS_MQTT_TOPIC_TREE_MATCHER_STACK_LEVELS);
+    if (level_count > AWS_MQTT_TOPIC_TREE_MATCHER_STACK_LEVELS) {
+        levels = aws_mem_calloc(matcher->allocator, level_count, sizeof(struct topic_tree_matcher_level));
+        if (!levels) {
+            return AWS_OP_ERR;
+        }
+        s_topic_tree_matcher_split_levels(topic, levels, level_count);
+    }
+
+    struct topic_tree_matcher_match_context ctx = {
+        .nodes = matcher->nodes.data,
+        .edges = matcher->edges.data,
+        .levels = levels,
+        .level_count = level_count,
+        .on_match = on_match,
+        .user_data = user_data,
+    };
+    s_topic_tree_matcher_match_do_recurse(&ctx, 0, 0);
+
+    if (levels != stack_levels) {
+        aws_mem_release(matcher->allocator, levels);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*******************************************************************************
+ * Dispatch Cache
+ ******************************************************************************/
+
+struct topic_tree_dispatch_cache_entry {
+    struct aws_linked_list_node lru_node;
+
+    /* Points into the same allocation as the entry */
+    struct aws_byte_cursor topic;
+
+    /* The tree's epoch when the subscriptions were resolved, they may have been destroyed since if it moved on */
+    uint64_t epoch;
+    const struct aws_mqtt_topic_node **subscriptions;
+    size_t subscription_count;
+};
+
+struct aws_mqtt_topic_tree_dispatch_cache {
+    struct aws_allocator *allocator;
+    size_t max_topics;
+
+    /* aws_byte_cursor * (the entry's topic) -> topic_tree_dispatch_cache_entry * */
+    struct aws_hash_table entries;
+
+    /* topic_tree_dispatch_cache_entry, the most recently used first */
+    struct aws_linked_list lru;
+
+    /* const aws_mqtt_topic_node *, the subscriptions of the entry being resolved */
+    struct aws_array_list resolved;
+    bool resolve_failed;
+};
+
+static void s_topic_tree_dispatch_cache_remove(
+    struct aws_mqtt_topic_tree_dispatch_cache *cache,
+    struct topic_tree_dispatch_cache_entry *entry) {
+
+    aws_hash_table_remove(&cache->entries, &entry->topic, NULL, NULL);
+    aws_linked_list_remove(&entry->lru_node);
+    aws_mem_release(cache->allocator, entry);
+}
+
+static void s_topic_tree_dispatch_cache_destroy(struct aws_mqtt_topic_tree_dispatch_cache *cache) {
+
+    if (!cache) {
+        return;
+    }
+
+    while (!aws_linked_list_empty(&cache->lru)) {
+        struct aws_linked_list_node *node = aws_linked_list_front(&cache->lru);
+        s_topic_tree_dispatch_cache_remove(
+            cache, AWS_CONTAINER_OF(node, struct topic_tree_dispatch_cache_entry, lru_node));
+    }
+
+    aws_array_list_clean_up(&cache->resolved);
+    aws_hash_table_clean_up(&cache->entries);
+    aws_mem_release(cache->allocator, cache);
+}
+
+static struct aws_mqtt_topic_tree_dispatch_cache *s_topic_tree_dispatch_cache_new(
+    struct aws_allocator *allocator,
+    size_t max_topics) {
+
+    struct aws_mqtt_topic_tree_dispatch_cache *cache =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_mqtt_topic_tree_dispatch_cache));
+    if (!cache) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "Failed to allocate topic tree dispatch cache");
+        return NULL;
+    }
+
+    cache->allocator = allocator;
+    cache->max_topics = max_topics;
+    aws_linked_list_init(&cache->lru);
+
+    if (aws_hash_table_init(
+            &cache->entries, allocator, max_topics, aws_hash_byte_cursor_ptr, byte_cursor_eq, NULL, NULL)) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "cache=%p: Failed to initialize entries table", (void *)cache);
+        goto entries_init_failed;
+    }
+
+    if (aws_array_list_init_dynamic(&cache->resolved, allocator, 4, sizeof(void *))) {
+        AWS_LOGF_ERROR(AWS_LS_MQTT_TOPIC_TREE, "cache=%p: Failed to initialize resolved list", (void *)cache);
+        goto resolved_init_failed;
+    }
+
+    return cache;
+
+resolved_init_failed:
+    aws_hash_table_clean_up(&cache->entries);
+
+entries_init_failed:
+    aws_mem_release(allocator, cache);
+
+    return NULL;
+}
+
+int aws_mqtt_topic_tree_set_dispatch_cache_size(struct aws_mqtt_topic_tree *tree, size_t max_topics) {
+
+    AWS_PRECONDITION(tree);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_MQTT_TOPIC_TREE, "tree=%p: Setting dispatch cache size to %zu topics", (void *)tree, max_topics);
+
+    struct aws_mqtt_topic_tree_dispatch_cache *cache = NULL;
+    if (max_topics > 0) {
+        cache = s_topic_tree_dispatch_cache_new(tree->allocator, max_topics);
+        if (!cache) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    s_topic_tree_dispatch_cache_destroy(tree->dispatch_cache);
+    tree->dispatch_cache = cache;
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_topic_tree_dispatch_cache_on_match(const struct aws_mqtt_topic_node *subscription, void *user_data) {
+
+    struct aws_mqtt_topic_tree_dispatch_cache *cache = user_data;
+    if (aws_array_list_push_back(&cache->resolved, &subscription)) {
+        cache->resolve_failed = true;
+    }
+}
+
+/* Resolves topic with the matcher and caches the result, evicting the least recently used entry if full. */
+static struct topic_tree_dispatch_cache_entry *s_topic_tree_dispatch_cache_add(
+    const struct aws_mqtt_topic_tree *tree,
+    const struct aws_byte_cursor *topic) {
+
+    struct aws_mqtt_topic_tree_dispatch_cache *cache = tree->dispatch_cache;
+
+    aws_array_list_clear(&cache->resolved);
+    cache->resolve_failed = false;
+    if (s_topic_tree_matcher_match(tree, topic, s_topic_tree_dispatch_cache_on_match, cache) ||
+        cache->resolve_failed) {
+        return NULL;
+    }
+
+    if (aws_hash_table_get_entry_count(&cache->entries) >= cache->max_topics) {
+        struct aws_linked_list_node *node = aws_linked_list_back(&cache->lru);
+        s_topic_tree_dispatch_cache_remove(
+            cache, AWS_CONTAINER_OF(node, struct topic_tree_dispatch_cache_entry, lru_node));
+    }
+
+    const size_t subscription_count = aws_array_list_length(&cache->resolved);
+    struct topic_tree_dispatch_cache_entry *entry = NULL;
+    const struct aws_mqtt_topic_node **subscriptions = NULL;
+    uint8_t *topic_buffer = NULL;
+    if (!aws_mem_acquire_many(
+            cache->allocator,
+            3,
+            &entry,
+            sizeof(struct topic_tree_dispatch_cache_entry),
+            &subscriptions,
+            subscription_count * sizeof(void *),
+            &topic_buffer,
+            topic->len)) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*entry);
+    if (subscription_count > 0) {
+        memcpy((void *)subscriptions, cache->resolved.data, subscription_count * sizeof(void *));
+    }
+    if (topic->len > 0) {
+        memcpy(topic_buffer, topic->ptr, topic->len);
+    }
+    entry->topic = aws_byte_cursor_from_array(topic_buffer, topic->len);
+    entry->epoch = tree->epoch;
+    entry->subscriptions = subscriptions;
+    entry->subscription_count = subscription_count;
+
+    if (aws_hash_table_put(&cache->entries, &entry->topic, entry, NULL)) {
+        aws_mem_release(cache->allocator, entry);
+        return NULL;
+    }
+    aws_linked_list_push_front(&cache->lru, &entry->lru_node);
+
+    return entry;
+}
+
+/* Returns the subscriptions matching topic, resolving them if they aren't cached yet. NULL if that failed. */
+static const struct topic_tree_dispatch_cache_entry *s_topic_tree_dispatch_cache_find(
+    const struct aws_mqtt_topic_tree *tree,
+    const struct aws_byte_cursor *topic) {
+
+    struct aws_mqtt_topic_tree_dispatch_cache *cache = tree->dispatch_cache;
+
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&cache->entries, topic, &elem);
+    if (elem) {
+        struct topic_tree_dispatch_cache_entry *entry = elem->value;
+        if (entry->epoch == tree->epoch) {
+            aws_linked_list_remove(&entry->lru_node);
+            aws_linked_list_push_front(&cache->lru, &entry->lru_node);
+            return entry;
+        }
+
+        /* The subscriptions have changed since, resolve the topic again */
+        s_topic_tree_dispatch_cache_remove(cache, entry);
+    }
+
+    return s_topic_tree_dispatch_cache_add(tree, topic);
+}
+
 /*******************************************************************************
  * Publish
  ******************************************************************************/
 
+struct topic_tree_publish_args {
+    const struct aws_mqtt_packet_publish *pub;
+    bool dup;
+    enum aws_mqtt_qos qos;
+    bool retain;
+};
+
+static void s_topic_tree_publish_on_match(const struct aws_mqtt_topic_node *subscription, void *user_data) {
+
+    const struct topic_tree_publish_args *args = user_data;
+    subscription->callback(
+        &args->pub->topic_name, &args->pub->payload, args->dup, args->qos, args->retain, subscription->userdata);
+}
+
 static void s_topic_tree_publish_do_recurse(
     const struct aws_byte_cursor *current_sub_part,
     const struct aws_mqtt_topic_node *current,
@@ -923,6 +1563,28 @@ void aws_mqtt_topic_tree_publish(const struct aws_mqtt_topic_tree *tree, struct
         (void *)tree,
         AWS_BYTE_CURSOR_PRI(pub->topic_name));
 
+    struct topic_tree_publish_args args = {
+        .pub = pub,
+        .dup = aws_mqtt_packet_publish_get_dup(pub),
+        .qos = aws_mqtt_packet_publish_get_qos(pub),
+        .retain = aws_mqtt_packet_publish_get_retain(pub),
+    };
+
+    if (tree->dispatch_cache) {
+        const struct topic_tree_dispatch_cache_entry *entry = s_topic_tree_dispatch_cache_find(tree, &pub->topic_name);
+        if (entry) {
+            for (size_t i = 0; i < entry->subscription_count; ++i) {
+                s_topic_tree_publish_on_match(entry->subscriptions[i], &args);
+            }
+            return;
+        }
+    }
+
+    if (s_topic_tree_matcher_match(tree, &pub->topic_name, s_topic_tree_publish_on_match, &args) == AWS_OP_SUCCESS) {
+        return;
+    }
+
+    /* The matcher is stale, or couldn't allocate what it needs, fall back to walking the tree itself */
     struct aws_byte_cursor sub_part;
     AWS_ZERO_STRUCT(sub_part);
     s_topic_tree_publish_do_recurse(&sub_part, tree->root, pub);
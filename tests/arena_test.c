@@ -0,0 +1,82 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/arena.h>
+
+#include <aws/common/hash_table.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+static int s_mqtt_arena_acquire_release_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_arena *arena = aws_mqtt_arena_new(allocator, 4096);
+    ASSERT_NOT_NULL(arena);
+
+    /* Small blocks come out of one chunk, aligned and side by side */
+    uint8_t *blocks[16];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(blocks); ++i) {
+        blocks[i] = aws_mem_acquire(&arena->allocator, 40);
+        ASSERT_NOT_NULL(blocks[i]);
+        ASSERT_UINT_EQUALS(0, (uintptr_t)blocks[i] % 16);
+        memset(blocks[i], 0xAB, 40);
+    }
+    ASSERT_PTR_EQUALS(blocks[0] + 64, blocks[1]);
+
+    /* Released blocks are handed out again before new space is carved */
+    aws_mem_release(&arena->allocator, blocks[3]);
+    aws_mem_release(&arena->allocator, blocks[7]);
+    ASSERT_PTR_EQUALS(blocks[7], aws_mem_acquire(&arena->allocator, 33));
+    ASSERT_PTR_EQUALS(blocks[3], aws_mem_acquire(&arena->allocator, 48));
+
+    /* But only to allocations of the same size class */
+    aws_mem_release(&arena->allocator, blocks[5]);
+    uint8_t *smaller = aws_mem_acquire(&arena->allocator, 8);
+    ASSERT_NOT_NULL(smaller);
+    ASSERT_FALSE(smaller == blocks[5]);
+
+    /* Blocks too big for any size class go to the parent allocator on their own */
+    uint8_t *large = aws_mem_acquire(&arena->allocator, 10000);
+    ASSERT_NOT_NULL(large);
+    memset(large, 0xCD, 10000);
+    aws_mem_release(&arena->allocator, large);
+    large = aws_mem_calloc(&arena->allocator, 1, 5000);
+    ASSERT_NOT_NULL(large);
+    ASSERT_UINT_EQUALS(0, large[4999]);
+
+    /* Whatever is still allocated is freed with the arena */
+    aws_mqtt_arena_destroy(arena);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_arena_acquire_release, s_mqtt_arena_acquire_release_fn)
+
+static int s_mqtt_arena_backs_hash_table_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_arena *arena = aws_mqtt_arena_new(allocator, 0);
+    ASSERT_NOT_NULL(arena);
+
+    /* Growing the table reallocates it through the arena, from size classes up to large blocks */
+    struct aws_hash_table table;
+    ASSERT_SUCCESS(aws_hash_table_init(&table, &arena->allocator, 0, aws_hash_ptr, aws_ptr_eq, NULL, NULL));
+    for (uintptr_t i = 1; i <= 1000; ++i) {
+        ASSERT_SUCCESS(aws_hash_table_put(&table, (void *)i, (void *)(i * 2), NULL));
+    }
+    for (uintptr_t i = 1; i <= 1000; ++i) {
+        struct aws_hash_element *elem = NULL;
+        ASSERT_SUCCESS(aws_hash_table_find(&table, (void *)i, &elem));
+        ASSERT_NOT_NULL(elem);
+        ASSERT_UINT_EQUALS(i * 2, (uintptr_t)elem->value);
+    }
+
+    /* No need to clean the table up first */
+    aws_mqtt_arena_destroy(arena);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_arena_backs_hash_table, s_mqtt_arena_backs_hash_table_fn)
@@ -0,0 +1,208 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "benchmark_helpers.h"
+
+#include <aws/common/clock.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ * Allocator
+ ******************************************************************************/
+
+/* Every allocation is prefixed with its size, so that what's still outstanding can be tracked */
+static const size_t s_allocation_header_size = 16;
+
+static void *s_acquire(struct aws_allocator *allocator, size_t size) {
+    struct benchmark_allocator *benchmark_allocator = allocator->impl;
+
+    uint8_t *mem = aws_mem_acquire(benchmark_allocator->wrapped, s_allocation_header_size + size);
+    if (!mem) {
+        return NULL;
+    }
+    *(size_t *)mem = size;
+
+    aws_atomic_fetch_add(&benchmark_allocator->allocations, 1);
+    aws_atomic_fetch_add(&benchmark_allocator->bytes, size);
+    aws_atomic_fetch_add(&benchmark_allocator->outstanding_bytes, size);
+
+    return mem + s_allocation_header_size;
+}
+
+static void s_release(struct aws_allocator *allocator, void *ptr) {
+    struct benchmark_allocator *benchmark_allocator = allocator->impl;
+
+    uint8_t *mem = (uint8_t *)ptr - s_allocation_header_size;
+    aws_atomic_fetch_sub(&benchmark_allocator->outstanding_bytes, *(size_t *)mem);
+
+    aws_mem_release(benchmark_allocator->wrapped, mem);
+}
+
+void benchmark_allocator_init(struct benchmark_allocator *allocator, struct aws_allocator *wrapped) {
+    AWS_ZERO_STRUCT(*allocator);
+    /* Without mem_realloc and mem_calloc, aws_mem_realloc() and aws_mem_calloc() go through the two below */
+    allocator->base.mem_acquire = s_acquire;
+    allocator->base.mem_release = s_release;
+    allocator->base.impl = allocator;
+    allocator->wrapped = wrapped;
+    aws_atomic_init_int(&allocator->allocations, 0);
+    aws_atomic_init_int(&allocator->bytes, 0);
+    aws_atomic_init_int(&allocator->outstanding_bytes, 0);
+}
+
+void benchmark_allocator_reset(struct benchmark_allocator *allocator) {
+    aws_atomic_store_int(&allocator->allocations, 0);
+    aws_atomic_store_int(&allocator->bytes, 0);
+}
+
+size_t benchmark_allocator_allocations(struct benchmark_allocator *allocator) {
+    return aws_atomic_load_int(&allocator->allocations);
+}
+
+size_t benchmark_allocator_bytes(struct benchmark_allocator *allocator) {
+    return aws_atomic_load_int(&allocator->bytes);
+}
+
+size_t benchmark_allocator_outstanding_bytes(struct benchmark_allocator *allocator) {
+    return aws_atomic_load_int(&allocator->outstanding_bytes);
+}
+
+/*******************************************************************************
+ * Random
+ ******************************************************************************/
+
+void benchmark_random_init(struct benchmark_random *random, uint64_t seed) {
+    /* xorshift gets stuck on 0 */
+    random->state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+uint64_t benchmark_random_next(struct benchmark_random *random) {
+    /* xorshift64* */
+    uint64_t x = random->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    random->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+size_t benchmark_random_range(struct benchmark_random *random, size_t min, size_t max) {
+    AWS_ASSERT(min <= max);
+    return min + (size_t)(benchmark_random_next(random) % ((uint64_t)(max - min) + 1));
+}
+
+void benchmark_random_fill_letters(struct benchmark_random *random, uint8_t *buffer, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        buffer[i] = (uint8_t)('a' + benchmark_random_next(random) % 26);
+    }
+}
+
+/*******************************************************************************
+ * Clock
+ ******************************************************************************/
+
+uint64_t benchmark_now_ns(void) {
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    return now;
+}
+
+/*******************************************************************************
+ * Percentiles
+ ******************************************************************************/
+
+static int s_compare_samples(const void *a, const void *b) {
+    const uint64_t lhs = *(const uint64_t *)a;
+    const uint64_t rhs = *(const uint64_t *)b;
+    return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+}
+
+void benchmark_sort(uint64_t *samples, size_t count) {
+    if (count > 1) {
+        qsort(samples, count, sizeof(uint64_t), s_compare_samples);
+    }
+}
+
+uint64_t benchmark_percentile(const uint64_t *sorted_samples, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+
+    /* Nearest rank: the smallest sample that at least percentile% of the samples are less than or equal to */
+    const double rank = percentile / 100.0 * (double)count;
+    size_t index = (size_t)rank;
+    if ((double)index < rank) {
+        ++index;
+    }
+    index = index > 0 ? index - 1 : 0;
+    return sorted_samples[index < count ? index : count - 1];
+}
+
+/*******************************************************************************
+ * Report
+ ******************************************************************************/
+
+static void s_write_json_string(FILE *out, const char *value) {
+    fputc('"', out);
+    for (const char *c = value; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned)*c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void s_write_key(struct benchmark_report *report, const char *key) {
+    if (!report->first_field) {
+        fputc(',', report->out);
+    }
+    report->first_field = false;
+    s_write_json_string(report->out, key);
+    fputc(':', report->out);
+}
+
+void benchmark_report_init(struct benchmark_report *report, FILE *out) {
+    report->out = out;
+    report->first_field = true;
+}
+
+void benchmark_report_begin(struct benchmark_report *report, const char *benchmark, const char *name) {
+    fputc('{', report->out);
+    report->first_field = true;
+    benchmark_report_add_string(report, "benchmark", benchmark);
+    benchmark_report_add_string(report, "name", name);
+}
+
+void benchmark_report_add_string(struct benchmark_report *report, const char *key, const char *value) {
+    s_write_key(report, key);
+    s_write_json_string(report->out, value);
+}
+
+void benchmark_report_add_uint(struct benchmark_report *report, const char *key, uint64_t value) {
+    s_write_key(report, key);
+    fprintf(report->out, "%" PRIu64, value);
+}
+
+void benchmark_report_add_double(struct benchmark_report *report, const char *key, double value) {
+    s_write_key(report, key);
+    /* JSON has no representation for infinities or NaN */
+    if (value != value || value > 1e300 || value < -1e300) {
+        fputs("null", report->out);
+    } else {
+        fprintf(report->out, "%.3f", value);
+    }
+}
+
+void benchmark_report_end(struct benchmark_report *report) {
+    fputs("}\n", report->out);
+    fflush(report->out);
+}
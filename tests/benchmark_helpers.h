@@ -0,0 +1,87 @@
+#ifndef MQTT_BENCHMARK_HELPERS_H
+#define MQTT_BENCHMARK_HELPERS_H
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/allocator.h>
+#include <aws/common/atomics.h>
+
+#include <stdio.h>
+
+/**
+ * Allocator that counts what goes through it before passing it on to the allocator it wraps.
+ * The counters are atomic, so it may be shared with the event loop threads.
+ */
+struct benchmark_allocator {
+    struct aws_allocator base;
+    struct aws_allocator *wrapped;
+    struct aws_atomic_var allocations;
+    struct aws_atomic_var bytes;
+    struct aws_atomic_var outstanding_bytes;
+};
+
+/**
+ * Small, fast generator of reproducible pseudo-random numbers, so that every run of a benchmark with the same seed
+ * works on the same data.
+ */
+struct benchmark_random {
+    uint64_t state;
+};
+
+/**
+ * Writes results as JSON, one object per line, so that runs can be collected and compared by scripts.
+ */
+struct benchmark_report {
+    FILE *out;
+    bool first_field;
+};
+
+void benchmark_allocator_init(struct benchmark_allocator *allocator, struct aws_allocator *wrapped);
+
+/* Resets the counters to 0 */
+void benchmark_allocator_reset(struct benchmark_allocator *allocator);
+
+/* Number of allocations (including reallocations) since the last reset */
+size_t benchmark_allocator_allocations(struct benchmark_allocator *allocator);
+
+/* Number of bytes requested since the last reset */
+size_t benchmark_allocator_bytes(struct benchmark_allocator *allocator);
+
+/* Number of bytes allocated and not yet released, which a reset doesn't affect */
+size_t benchmark_allocator_outstanding_bytes(struct benchmark_allocator *allocator);
+
+void benchmark_random_init(struct benchmark_random *random, uint64_t seed);
+
+uint64_t benchmark_random_next(struct benchmark_random *random);
+
+/* Returns a number in [min, max] */
+size_t benchmark_random_range(struct benchmark_random *random, size_t min, size_t max);
+
+/* Fills len bytes of buffer with lowercase letters */
+void benchmark_random_fill_letters(struct benchmark_random *random, uint8_t *buffer, size_t len);
+
+/* Monotonic time in nanoseconds */
+uint64_t benchmark_now_ns(void);
+
+/* Sorts count samples in place, in increasing order, for benchmark_percentile() */
+void benchmark_sort(uint64_t *samples, size_t count);
+
+/* Returns the sample at percentile (between 0 and 100) of count sorted samples, or 0 if there are none */
+uint64_t benchmark_percentile(const uint64_t *sorted_samples, size_t count, double percentile);
+
+void benchmark_report_init(struct benchmark_report *report, FILE *out);
+
+/* Starts a result, which is then filled in with the benchmark_report_add_*() functions */
+void benchmark_report_begin(struct benchmark_report *report, const char *benchmark, const char *name);
+
+void benchmark_report_add_string(struct benchmark_report *report, const char *key, const char *value);
+
+void benchmark_report_add_uint(struct benchmark_report *report, const char *key, uint64_t value);
+
+void benchmark_report_add_double(struct benchmark_report *report, const char *key, double value);
+
+void benchmark_report_end(struct benchmark_report *report);
+
+#endif /* MQTT_BENCHMARK_HELPERS_H */
@@ -6,6 +6,7 @@
 #include "mqtt_mock_server_handler.h"
 
 #include <aws/mqtt/private/client_impl.h>
+#include <aws/mqtt/private/packets.h>
 
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/event_loop.h>
@@ -33,6 +34,12 @@ struct received_publish_packet {
     bool retain;
 };
 
+/* The packets in a message the client wrote to the channel */
+struct written_message {
+    size_t packet_count;
+    enum aws_mqtt_packet_type packet_types[16];
+};
+
 struct mqtt_connection_state_test {
     struct aws_allocator *allocator;
     struct aws_channel *server_channel;
@@ -73,6 +80,9 @@ struct mqtt_connection_state_test {
     struct aws_array_list qos_returned; /* list of uint_8 */
     size_t ops_completed;
     size_t expected_ops_completed;
+    size_t payloads_released;
+    /* the messages the client wrote, once s_install_write_capture() was called */
+    struct aws_array_list written_messages; /* list of struct written_message */
 };
 
 static struct mqtt_connection_state_test test_data = {0};
@@ -287,6 +297,8 @@ static int s_setup_mqtt_server_fn(struct aws_allocator *allocator, void *ctx) {
     ASSERT_SUCCESS(aws_array_list_init_dynamic(
         &state_test_data->any_published_messages, allocator, 4, sizeof(struct received_publish_packet)));
     ASSERT_SUCCESS(aws_array_list_init_dynamic(&state_test_data->qos_returned, allocator, 2, sizeof(uint8_t)));
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(
+        &state_test_data->written_messages, allocator, 4, sizeof(struct written_message)));
     return AWS_OP_SUCCESS;
 }
 
@@ -309,6 +321,7 @@ static int s_clean_up_mqtt_server_fn(struct aws_allocator *allocator, int setup_
         s_received_publish_packet_list_clean_up(&state_test_data->published_messages);
         s_received_publish_packet_list_clean_up(&state_test_data->any_published_messages);
         aws_array_list_clean_up(&state_test_data->qos_returned);
+        aws_array_list_clean_up(&state_test_data->written_messages);
         aws_mqtt_client_connection_release(state_test_data->mqtt_connection);
         aws_mqtt_client_release(state_test_data->mqtt_client);
         aws_client_bootstrap_release(state_test_data->client_bootstrap);
@@ -1082,9 +1095,9 @@ AWS_TEST_CASE_FIXTURE(
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/* Subscribe to a topic and broker returns a SUBACK with failure return code, the subscribe should fail */
-static int s_test_mqtt_connect_subscribe_fail_from_broker_fn(struct aws_allocator *allocator, void *ctx) {
-    (void)allocator;
+/* Have the server send PUBLISH messages split across many reads, from a byte at a time to packets bigger than the
+ * retained reassembly buffer, and make sure they're all reassembled intact. */
+static int s_test_mqtt_reassemble_split_publishes_fn(struct aws_allocator *allocator, void *ctx) {
     struct mqtt_connection_state_test *state_test_data = ctx;
 
     struct aws_mqtt_connection_options connection_options = {
@@ -1096,18 +1109,15 @@ static int s_test_mqtt_connect_subscribe_fail_from_broker_fn(struct aws_allocato
         .on_connection_complete = s_on_connection_complete_fn,
     };
 
-    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
-    s_wait_for_connection_to_complete(state_test_data);
-
-    /* Disable the auto ACK packets sent by the server, we will send failure SUBACK */
-    mqtt_mock_server_disable_auto_ack(state_test_data->mock_server);
-
     struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
 
+    /* Anything bigger than 4KiB is released once it's been dispatched */
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_reassembly_limits(state_test_data->mqtt_connection, 4096, 0));
+
     uint16_t packet_id = aws_mqtt_client_connection_subscribe(
         state_test_data->mqtt_connection,
         &sub_topic,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        AWS_MQTT_QOS_AT_MOST_ONCE,
         s_on_publish_received,
         state_test_data,
         NULL,
@@ -1115,33 +1125,121 @@ static int s_test_mqtt_connect_subscribe_fail_from_broker_fn(struct aws_allocato
         state_test_data);
     ASSERT_TRUE(packet_id > 0);
 
-    ASSERT_SUCCESS(mqtt_mock_server_send_single_suback(state_test_data->mock_server, packet_id, AWS_MQTT_QOS_FAILURE));
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
     s_wait_for_subscribe_to_complete(state_test_data);
-    /* Check the subscribe returned QoS is failure */
-    size_t length = aws_array_list_length(&state_test_data->qos_returned);
-    ASSERT_UINT_EQUALS(1, length);
-    uint8_t qos = 0;
-    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 0));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_FAILURE, qos);
+
+    const size_t payload_sizes[] = {100, 64 * 1024, 1000, 20000};
+    const size_t fragment_sizes[] = {1, 1500, 3, 4096};
+
+    struct aws_byte_buf payloads[AWS_ARRAY_SIZE(payload_sizes)];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(payloads); ++i) {
+        ASSERT_SUCCESS(aws_byte_buf_init(&payloads[i], allocator, payload_sizes[i]));
+        for (size_t j = 0; j < payload_sizes[i]; ++j) {
+            aws_byte_buf_write_u8(&payloads[i], (uint8_t)(i * 31 + j * 7));
+        }
+    }
+
+    state_test_data->expected_publishes = AWS_ARRAY_SIZE(payloads);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(payloads); ++i) {
+        struct aws_byte_cursor payload = aws_byte_cursor_from_buf(&payloads[i]);
+        ASSERT_SUCCESS(mqtt_mock_server_send_publish_split(
+            state_test_data->mock_server, &sub_topic, &payload, AWS_MQTT_QOS_AT_MOST_ONCE, fragment_sizes[i]));
+    }
+
+    s_wait_for_publish(state_test_data);
 
     ASSERT_SUCCESS(
         aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
     s_wait_for_disconnect_to_complete(state_test_data);
 
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(payloads), aws_array_list_length(&state_test_data->published_messages));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(payloads); ++i) {
+        struct received_publish_packet *publish_msg = NULL;
+        ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, i));
+        ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic, &publish_msg->topic));
+        ASSERT_BIN_ARRAYS_EQUALS(
+            payloads[i].buffer, payloads[i].len, publish_msg->payload.buffer, publish_msg->payload.len);
+        aws_byte_buf_clean_up(&payloads[i]);
+    }
+
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_subscribe_fail_from_broker,
+    mqtt_connect_reassemble_split_publishes,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_connect_subscribe_fail_from_broker_fn,
+    s_test_mqtt_reassemble_split_publishes_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/* Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages,
- * make sure they're received, then send a DISCONNECT. */
-static int s_test_mqtt_subscribe_multi_fn(struct aws_allocator *allocator, void *ctx) {
-    (void)allocator;
+struct publish_stream_test_data {
+    struct mqtt_connection_state_test *state_test_data;
+    struct aws_byte_buf topic;
+    struct aws_byte_buf payload;
+    size_t payload_size;
+    size_t chunk_count;
+    enum aws_mqtt_qos qos;
+    int end_error_code;
+    bool ended;
+};
+
+static void s_on_publish_stream_begin(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    size_t payload_size,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *userdata) {
+
+    (void)connection;
+    (void)dup;
+    (void)retain;
+    struct publish_stream_test_data *stream_data = userdata;
+
+    aws_mutex_lock(&stream_data->state_test_data->lock);
+    aws_byte_buf_init_copy_from_cursor(&stream_data->topic, stream_data->state_test_data->allocator, *topic);
+    aws_byte_buf_init(&stream_data->payload, stream_data->state_test_data->allocator, payload_size);
+    stream_data->payload_size = payload_size;
+    stream_data->qos = qos;
+    aws_mutex_unlock(&stream_data->state_test_data->lock);
+}
+
+static void s_on_publish_stream_chunk(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *chunk,
+    void *userdata) {
+
+    (void)connection;
+    struct publish_stream_test_data *stream_data = userdata;
+
+    aws_mutex_lock(&stream_data->state_test_data->lock);
+    aws_byte_buf_write_from_whole_cursor(&stream_data->payload, *chunk);
+    stream_data->chunk_count++;
+    aws_mutex_unlock(&stream_data->state_test_data->lock);
+}
+
+static void s_on_publish_stream_end(struct aws_mqtt_client_connection *connection, int error_code, void *userdata) {
+    (void)connection;
+    struct publish_stream_test_data *stream_data = userdata;
+
+    aws_mutex_lock(&stream_data->state_test_data->lock);
+    stream_data->end_error_code = error_code;
+    stream_data->ended = true;
+    aws_mutex_unlock(&stream_data->state_test_data->lock);
+    aws_condition_variable_notify_one(&stream_data->state_test_data->cvar);
+}
+
+static bool s_is_publish_stream_ended(void *arg) {
+    struct publish_stream_test_data *stream_data = arg;
+    return stream_data->ended;
+}
+
+/* Have the server send a large PUBLISH split across many reads, with streaming enabled, and make sure its payload
+ * arrives through the stream callbacks in several chunks, while a small PUBLISH is still delivered whole. */
+static int s_test_mqtt_stream_large_publish_fn(struct aws_allocator *allocator, void *ctx) {
     struct mqtt_connection_state_test *state_test_data = ctx;
 
     struct aws_mqtt_connection_options connection_options = {
@@ -1153,146 +1251,108 @@ static int s_test_mqtt_subscribe_multi_fn(struct aws_allocator *allocator, void
         .on_connection_complete = s_on_connection_complete_fn,
     };
 
-    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
-    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
 
-    struct aws_mqtt_topic_subscription sub1 = {
-        .topic = sub_topic_1,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
+    struct publish_stream_test_data stream_data = {
+        .state_test_data = state_test_data,
     };
-    struct aws_mqtt_topic_subscription sub2 = {
-        .topic = sub_topic_2,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
+    struct aws_mqtt_publish_stream_options stream_options = {
+        .min_payload_size = 4096,
+        .on_begin = s_on_publish_stream_begin,
+        .on_chunk = s_on_publish_stream_chunk,
+        .on_end = s_on_publish_stream_end,
+        .user_data = &stream_data,
     };
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_set_publish_stream_handler(state_test_data->mqtt_connection, &stream_options));
 
-    struct aws_array_list topic_filters;
-    size_t list_len = 2;
-    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
-    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
-
-    aws_array_list_push_back(&topic_filters, &sub1);
-    aws_array_list_push_back(&topic_filters, &sub2);
+    /* Only the headers of a streamed PUBLISH are buffered, so a payload far past the limit is fine */
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_reassembly_limits(state_test_data->mqtt_connection, 4096, 8192));
 
-    uint16_t packet_id = aws_mqtt_client_connection_subscribe_multiple(
-        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        s_on_publish_received,
+        state_test_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
     ASSERT_TRUE(packet_id > 0);
 
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
 
     s_wait_for_subscribe_to_complete(state_test_data);
-    /* Check the subscribe returned QoS is expected */
-    size_t length = aws_array_list_length(&state_test_data->qos_returned);
-    ASSERT_UINT_EQUALS(2, length);
-    uint8_t qos = 0;
-    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 0));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_EXACTLY_ONCE, qos);
-    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 1));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_EXACTLY_ONCE, qos);
 
-    state_test_data->expected_publishes = 2;
-    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_1,
-        &payload_1,
-        false /*dup*/,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_2,
-        &payload_2,
-        false /*dup*/,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    s_wait_for_publish(state_test_data);
+    /* Can't change the handler while publishes may arrive */
+    ASSERT_INT_EQUALS(
+        AWS_OP_ERR,
+        aws_mqtt_client_connection_set_publish_stream_handler(state_test_data->mqtt_connection, &stream_options));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_STATE, aws_last_error());
 
-    /* Let's do another publish on a topic that is not subscribed by client.
-     * This can happen if the Server automatically assigned a subscription to the Client */
-    state_test_data->expected_any_publishes = 3;
-    struct aws_byte_cursor payload_3 = aws_byte_cursor_from_c_str("Test Message 3");
-    struct aws_byte_cursor topic_3 = aws_byte_cursor_from_c_str("/test/topic3");
+    struct aws_byte_buf large_payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&large_payload, allocator, 64 * 1024));
+    for (size_t i = 0; i < large_payload.capacity; ++i) {
+        aws_byte_buf_write_u8(&large_payload, (uint8_t)(i * 7));
+    }
+    struct aws_byte_cursor large_payload_cursor = aws_byte_cursor_from_buf(&large_payload);
+    struct aws_byte_cursor small_payload = aws_byte_cursor_from_c_str("Test Message");
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_split(
+        state_test_data->mock_server, &sub_topic, &large_payload_cursor, AWS_MQTT_QOS_AT_LEAST_ONCE, 1500));
     ASSERT_SUCCESS(mqtt_mock_server_send_publish(
         state_test_data->mock_server,
-        &topic_3,
-        &payload_3,
+        &sub_topic,
+        &small_payload,
         false /*dup*/,
         AWS_MQTT_QOS_AT_LEAST_ONCE,
         false /*retain*/));
-    s_wait_for_any_publish(state_test_data);
 
-    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 3);
+    aws_mutex_lock(&state_test_data->lock);
+    aws_condition_variable_wait_pred(
+        &state_test_data->cvar, &state_test_data->lock, s_is_publish_stream_ended, &stream_data);
+    aws_mutex_unlock(&state_test_data->lock);
+    s_wait_for_publish(state_test_data);
+    /* The streamed PUBLISH is acked once its payload is complete, just like the other */
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 2);
 
     ASSERT_SUCCESS(
         aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
     s_wait_for_disconnect_to_complete(state_test_data);
 
-    /* Decode all received packets by mock server */
-    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
-
-    ASSERT_UINT_EQUALS(6, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
-    struct mqtt_decoded_packet *received_packet =
-        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
-
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
-    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
-    struct aws_mqtt_subscription val;
-    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_1));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_UINT_EQUALS(packet_id, received_packet->packet_identifier);
-
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 4);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
-
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 5);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
-
-    /* Only two packets should be recorded by the published_messages, but all the three packets will be recorded by
-     * any_published_messages */
-    ASSERT_UINT_EQUALS(2, aws_array_list_length(&state_test_data->published_messages));
-    ASSERT_UINT_EQUALS(3, aws_array_list_length(&state_test_data->any_published_messages));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_data.end_error_code);
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic, &stream_data.topic));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, stream_data.qos);
+    ASSERT_UINT_EQUALS(large_payload.len, stream_data.payload_size);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        large_payload.buffer, large_payload.len, stream_data.payload.buffer, stream_data.payload.len);
+    ASSERT_TRUE(stream_data.chunk_count > 1);
 
+    /* Only the small PUBLISH went to the subscription */
+    ASSERT_UINT_EQUALS(1, aws_array_list_length(&state_test_data->published_messages));
     struct received_publish_packet *publish_msg = NULL;
     ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 0));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_1, &publish_msg->topic));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_1, &publish_msg->payload));
-    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 1));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&small_payload, &publish_msg->payload));
+
+    aws_byte_buf_clean_up(&large_payload);
+    aws_byte_buf_clean_up(&stream_data.topic);
+    aws_byte_buf_clean_up(&stream_data.payload);
 
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_subscribe_multi,
+    mqtt_connect_stream_large_publish,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_subscribe_multi_fn,
+    s_test_mqtt_stream_large_publish_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/* Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages, unsubscribe
- * to a topic, have the server send PUBLISH messages again, make sure the unsubscribed topic callback will not be fired
- */
-static int s_test_mqtt_unsubscribe_fn(struct aws_allocator *allocator, void *ctx) {
-    (void)allocator;
+/* With manual window management on, have the server send more publish payload than the initial window, make sure the
+ * client stops reading until the window is re-opened, then that everything arrives once it is. */
+static int s_test_mqtt_manual_window_management_fn(struct aws_allocator *allocator, void *ctx) {
     struct mqtt_connection_state_test *state_test_data = ctx;
 
     struct aws_mqtt_connection_options connection_options = {
@@ -1304,86 +1364,1272 @@ static int s_test_mqtt_unsubscribe_fn(struct aws_allocator *allocator, void *ctx
         .on_connection_complete = s_on_connection_complete_fn,
     };
 
-    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
-    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
-
-    struct aws_mqtt_topic_subscription sub1 = {
-        .topic = sub_topic_1,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
-    };
-    struct aws_mqtt_topic_subscription sub2 = {
-        .topic = sub_topic_2,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
-    };
-
-    struct aws_array_list topic_filters;
-    size_t list_len = 2;
-    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
-    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
 
-    aws_array_list_push_back(&topic_filters, &sub1);
-    aws_array_list_push_back(&topic_filters, &sub2);
+    ASSERT_INT_EQUALS(
+        AWS_OP_ERR,
+        aws_mqtt_client_connection_set_manual_window_management(state_test_data->mqtt_connection, true, 0));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_set_manual_window_management(state_test_data->mqtt_connection, true, 1024));
 
-    uint16_t sub_packet_id = aws_mqtt_client_connection_subscribe_multiple(
-        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
-    ASSERT_TRUE(sub_packet_id > 0);
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_MOST_ONCE,
+        s_on_publish_received,
+        state_test_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
 
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
 
     s_wait_for_subscribe_to_complete(state_test_data);
 
-    state_test_data->expected_any_publishes = 2;
-    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_1,
-        &payload_1,
-        false /*dup*/,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_2,
-        &payload_2,
-        false /*dup*/,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    s_wait_for_any_publish(state_test_data);
-    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 2);
+    /* 8 payloads of 512 bytes don't fit in the 1024 byte window, no matter how the reads split them */
+    const size_t publish_count = 8;
+    struct aws_byte_buf payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&payload, allocator, 512));
+    for (size_t i = 0; i < payload.capacity; ++i) {
+        aws_byte_buf_write_u8(&payload, (uint8_t)i);
+    }
+    struct aws_byte_cursor payload_cursor = aws_byte_cursor_from_buf(&payload);
 
-    aws_mutex_lock(&state_test_data->lock);
-    state_test_data->expected_ops_completed = 1;
-    aws_mutex_unlock(&state_test_data->lock);
+    state_test_data->expected_publishes = 2;
+    for (size_t i = 0; i < publish_count; ++i) {
+        ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+            state_test_data->mock_server,
+            &sub_topic,
+            &payload_cursor,
+            false /*dup*/,
+            AWS_MQTT_QOS_AT_MOST_ONCE,
+            false /*retain*/));
+    }
+    s_wait_for_publish(state_test_data);
+
+    /* Give the client every chance to read past the window */
+    aws_thread_current_sleep(ONE_SEC / 10);
+    aws_mutex_lock(&state_test_data->lock);
+    size_t received_count = aws_array_list_length(&state_test_data->published_messages);
+    state_test_data->expected_publishes = publish_count - 2;
+    aws_mutex_unlock(&state_test_data->lock);
+    ASSERT_TRUE(received_count < publish_count);
+
+    /* Hand back what was delivered and what's still to come */
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_update_window(state_test_data->mqtt_connection, publish_count * payload.len));
+    s_wait_for_publish(state_test_data);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    ASSERT_UINT_EQUALS(publish_count, aws_array_list_length(&state_test_data->published_messages));
+    for (size_t i = 0; i < publish_count; ++i) {
+        struct received_publish_packet *publish_msg = NULL;
+        ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, i));
+        ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_cursor, &publish_msg->payload));
+    }
+
+    aws_byte_buf_clean_up(&payload);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_manual_window_management,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_manual_window_management_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+struct manual_ack_test_data {
+    struct mqtt_connection_state_test *state_test_data;
+    struct aws_mqtt_publish_ack_token tokens[3];
+    size_t token_count;
+};
+
+static void s_on_publish_received_take_ack_token(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *userdata) {
+
+    (void)topic;
+    (void)payload;
+    (void)dup;
+    (void)qos;
+    (void)retain;
+    struct manual_ack_test_data *ack_data = userdata;
+    struct mqtt_connection_state_test *state_test_data = ack_data->state_test_data;
+
+    aws_mutex_lock(&state_test_data->lock);
+    AWS_FATAL_ASSERT(ack_data->token_count < AWS_ARRAY_SIZE(ack_data->tokens));
+    ack_data->tokens[ack_data->token_count++] = aws_mqtt_client_connection_get_publish_ack_token(connection);
+    state_test_data->publishes_received++;
+    aws_mutex_unlock(&state_test_data->lock);
+    aws_condition_variable_notify_one(&state_test_data->cvar);
+}
+
+/* With manual publish acks on, have the server send QoS 1 PUBLISH messages, make sure no PUBACK goes out until the
+ * test acks them from its own thread, and that they all go out then. */
+static int s_test_mqtt_manual_publish_acks_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+
+    struct manual_ack_test_data ack_data = {
+        .state_test_data = state_test_data,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_manual_publish_acks(state_test_data->mqtt_connection, true));
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        s_on_publish_received_take_ack_token,
+        &ack_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = AWS_ARRAY_SIZE(ack_data.tokens);
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("Test Message");
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(ack_data.tokens); ++i) {
+        ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+            state_test_data->mock_server,
+            &sub_topic,
+            &payload,
+            false /*dup*/,
+            AWS_MQTT_QOS_AT_LEAST_ONCE,
+            false /*retain*/));
+    }
+    s_wait_for_publish(state_test_data);
+
+    /* Give the client every chance to ack on its own */
+    aws_thread_current_sleep(ONE_SEC / 10);
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    ASSERT_NULL(mqtt_mock_server_find_decoded_packet_by_type(
+        state_test_data->mock_server, 0, AWS_MQTT_PACKET_PUBACK, NULL));
+
+    /* Ack out of order, a token of 0 is nothing to ack */
+    for (size_t i = AWS_ARRAY_SIZE(ack_data.tokens); i > 0; --i) {
+        ASSERT_TRUE(ack_data.tokens[i - 1].value != 0);
+        ASSERT_SUCCESS(
+            aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, ack_data.tokens[i - 1]));
+    }
+    struct aws_mqtt_publish_ack_token no_token = {0};
+    ASSERT_SUCCESS(aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, no_token));
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, AWS_ARRAY_SIZE(ack_data.tokens));
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Exactly one PUBACK per PUBLISH */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    size_t packet_count = mqtt_mock_server_decoded_packets_count(state_test_data->mock_server);
+    size_t puback_count = 0;
+    for (size_t index = 0; index < packet_count; ++index) {
+        if (!mqtt_mock_server_find_decoded_packet_by_type(
+                state_test_data->mock_server, index, AWS_MQTT_PACKET_PUBACK, &index)) {
+            break;
+        }
+        ++puback_count;
+    }
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(ack_data.tokens), puback_count);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_manual_publish_acks,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_manual_publish_acks_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* With manual publish acks on, receive a QoS 1 PUBLISH and lose the connection before acking it. Make sure the ack made
+ * after reconnecting to the same session is dropped, and the ack of the resent PUBLISH goes out over the new
+ * connection. */
+static int s_test_mqtt_manual_publish_acks_reconnect_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("Test Message");
+
+    struct manual_ack_test_data ack_data = {
+        .state_test_data = state_test_data,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_manual_publish_acks(state_test_data->mqtt_connection, true));
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        s_on_publish_received_take_ack_token,
+        &ack_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 5, &sub_topic, &payload, false, AWS_MQTT_QOS_AT_LEAST_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* The server keeps the session across the hang up */
+    mqtt_mock_server_set_session_present(state_test_data->mock_server, true);
+    aws_channel_shutdown(state_test_data->server_channel, AWS_OP_SUCCESS);
+    s_wait_for_reconnect_to_complete(state_test_data);
+
+    /* Too late, the server resends the PUBLISH */
+    ASSERT_SUCCESS(aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, ack_data.tokens[0]));
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 5, &sub_topic, &payload, true, AWS_MQTT_QOS_AT_LEAST_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    ASSERT_UINT_EQUALS(2, ack_data.token_count);
+    ASSERT_TRUE(ack_data.tokens[0].value != ack_data.tokens[1].value);
+    ASSERT_SUCCESS(aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, ack_data.tokens[1]));
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 1);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Exactly one PUBACK, over the second connection */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    size_t reconnect_index = 0;
+    ASSERT_NOT_NULL(mqtt_mock_server_find_decoded_packet_by_type(
+        state_test_data->mock_server, 1, AWS_MQTT_PACKET_CONNECT, &reconnect_index));
+    size_t puback_index = 0;
+    struct mqtt_decoded_packet *puback = mqtt_mock_server_find_decoded_packet_by_type(
+        state_test_data->mock_server, 0, AWS_MQTT_PACKET_PUBACK, &puback_index);
+    ASSERT_NOT_NULL(puback);
+    ASSERT_UINT_EQUALS(5, puback->packet_identifier);
+    ASSERT_TRUE(puback_index > reconnect_index);
+    ASSERT_NULL(mqtt_mock_server_find_decoded_packet_by_type(
+        state_test_data->mock_server, puback_index + 1, AWS_MQTT_PACKET_PUBACK, NULL));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_manual_publish_acks_reconnect,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_manual_publish_acks_reconnect_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Have the server resend QoS 2 PUBLISH messages before releasing them, before and after reconnecting to the same
+ * session, and make sure each is delivered once and still acked. */
+static int s_test_mqtt_qos2_duplicate_suppression_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payloads[] = {
+        aws_byte_cursor_from_c_str("one"),
+        aws_byte_cursor_from_c_str("two"),
+        aws_byte_cursor_from_c_str("three"),
+        aws_byte_cursor_from_c_str("four"),
+    };
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_EXACTLY_ONCE,
+        s_on_publish_received,
+        state_test_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payloads[0], false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* Resent before PUBREL, not delivered again */
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payloads[0], true, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 8, &sub_topic, &payloads[1], false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* Once released, the packet ID is for a new publish */
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_pubrel(state_test_data->mock_server, 7));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payloads[2], false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* The server keeps the session across the hang up, 8 is still not released */
+    mqtt_mock_server_set_session_present(state_test_data->mock_server, true);
+    aws_channel_shutdown(state_test_data->server_channel, AWS_OP_SUCCESS);
+    s_wait_for_reconnect_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 8, &sub_topic, &payloads[1], true, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 9, &sub_topic, &payloads[3], false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(payloads), aws_array_list_length(&state_test_data->published_messages));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(payloads); ++i) {
+        struct received_publish_packet *publish_msg = NULL;
+        ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, i));
+        ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payloads[i], &publish_msg->payload));
+    }
+
+    /* The resend of 8 over the new connection was still acked, ahead of 9 */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    size_t packet_count = mqtt_mock_server_decoded_packets_count(state_test_data->mock_server);
+    struct mqtt_decoded_packet *pubrecs[2] = {NULL, NULL};
+    for (size_t index = 0; index < packet_count; ++index) {
+        struct mqtt_decoded_packet *received_packet = mqtt_mock_server_find_decoded_packet_by_type(
+            state_test_data->mock_server, index, AWS_MQTT_PACKET_PUBREC, &index);
+        if (!received_packet) {
+            break;
+        }
+        pubrecs[0] = pubrecs[1];
+        pubrecs[1] = received_packet;
+    }
+    ASSERT_NOT_NULL(pubrecs[0]);
+    ASSERT_UINT_EQUALS(8, pubrecs[0]->packet_identifier);
+    ASSERT_UINT_EQUALS(9, pubrecs[1]->packet_identifier);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_qos2_duplicate_suppression,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_qos2_duplicate_suppression_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* With manual publish acks on, have the server resend QoS 2 PUBLISH messages before the test acks them, before and
+ * after reconnecting to the same session. Make sure no PUBREC goes out until the test acks the original, and that a
+ * resend after the ack is acked right away. */
+static int s_test_mqtt_qos2_manual_publish_acks_redelivery_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("Test Message");
+
+    struct manual_ack_test_data ack_data = {
+        .state_test_data = state_test_data,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_manual_publish_acks(state_test_data->mqtt_connection, true));
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_EXACTLY_ONCE,
+        s_on_publish_received_take_ack_token,
+        &ack_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payload, false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* Resent before the test acks it: neither delivered again nor acked. 8 is only there to know 7 was handled. */
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payload, true, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 8, &sub_topic, &payload, false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* Give the client every chance to ack on its own */
+    aws_thread_current_sleep(ONE_SEC / 10);
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    ASSERT_NULL(mqtt_mock_server_find_decoded_packet_by_type(
+        state_test_data->mock_server, 0, AWS_MQTT_PACKET_PUBREC, NULL));
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, ack_data.tokens[0]));
+    mqtt_mock_server_wait_for_pubrecs(state_test_data->mock_server, 1);
+
+    /* Once acked, a resend means the PUBREC was lost, so it's acked again */
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 7, &sub_topic, &payload, true, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    mqtt_mock_server_wait_for_pubrecs(state_test_data->mock_server, 2);
+
+    /* The server keeps the session across the hang up, 8 is still waiting on the test */
+    mqtt_mock_server_set_session_present(state_test_data->mock_server, true);
+    aws_channel_shutdown(state_test_data->server_channel, AWS_OP_SUCCESS);
+    s_wait_for_reconnect_to_complete(state_test_data);
+
+    state_test_data->expected_publishes = 1;
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 8, &sub_topic, &payload, true, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish_by_id(
+        state_test_data->mock_server, 9, &sub_topic, &payload, false, AWS_MQTT_QOS_EXACTLY_ONCE, false));
+    s_wait_for_publish(state_test_data);
+
+    /* The resend of 8 wasn't delivered again, so the ack of the original still stands */
+    ASSERT_SUCCESS(aws_mqtt_client_connection_ack_publish(state_test_data->mqtt_connection, ack_data.tokens[1]));
+    mqtt_mock_server_wait_for_pubrecs(state_test_data->mock_server, 3);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    ASSERT_UINT_EQUALS(3, ack_data.token_count);
+
+    /* One PUBREC per ack and per resend after it, none for 9 */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    size_t packet_count = mqtt_mock_server_decoded_packets_count(state_test_data->mock_server);
+    uint16_t expected_pubrecs[] = {7, 7, 8};
+    size_t pubrec_count = 0;
+    for (size_t index = 0; index < packet_count; ++index) {
+        struct mqtt_decoded_packet *received_packet = mqtt_mock_server_find_decoded_packet_by_type(
+            state_test_data->mock_server, index, AWS_MQTT_PACKET_PUBREC, &index);
+        if (!received_packet) {
+            break;
+        }
+        ASSERT_TRUE(pubrec_count < AWS_ARRAY_SIZE(expected_pubrecs));
+        ASSERT_UINT_EQUALS(expected_pubrecs[pubrec_count], received_packet->packet_identifier);
+        ++pubrec_count;
+    }
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(expected_pubrecs), pubrec_count);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_qos2_manual_publish_acks_redelivery,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_qos2_manual_publish_acks_redelivery_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+struct publish_batch_test_data {
+    struct mqtt_connection_state_test *state_test_data;
+    const struct aws_byte_cursor *expected_payloads;
+    size_t expected_count;
+    size_t publish_count;
+    size_t batch_count;
+    bool mismatch;
+};
+
+static void s_on_publish_batch_received(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_mqtt_publish_view *publishes,
+    size_t publish_count,
+    void *userdata) {
+
+    (void)connection;
+    struct publish_batch_test_data *batch_data = userdata;
+    struct mqtt_connection_state_test *state_test_data = batch_data->state_test_data;
+
+    aws_mutex_lock(&state_test_data->lock);
+    batch_data->batch_count++;
+    for (size_t i = 0; i < publish_count; ++i) {
+        if (batch_data->publish_count >= batch_data->expected_count ||
+            !aws_byte_cursor_eq(&publishes[i].payload, &batch_data->expected_payloads[batch_data->publish_count]) ||
+            publishes[i].qos != AWS_MQTT_QOS_AT_MOST_ONCE || publishes[i].ack_token.value != 0) {
+            batch_data->mismatch = true;
+        }
+        batch_data->publish_count++;
+    }
+    aws_mutex_unlock(&state_test_data->lock);
+    aws_condition_variable_notify_one(&state_test_data->cvar);
+}
+
+static bool s_is_publish_batch_received(void *arg) {
+    struct publish_batch_test_data *batch_data = arg;
+    return batch_data->publish_count >= batch_data->expected_count;
+}
+
+/* Have the server send a run of QoS 0 PUBLISH messages at once, make sure they reach the batch handler in order, and
+ * in fewer calls than there are publishes, as well as the subscription callback one by one. */
+static int s_test_mqtt_publish_batch_received_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payloads[] = {
+        aws_byte_cursor_from_c_str("one"),
+        aws_byte_cursor_from_c_str("two"),
+        aws_byte_cursor_from_c_str("three"),
+        aws_byte_cursor_from_c_str("four"),
+        aws_byte_cursor_from_c_str("five"),
+        aws_byte_cursor_from_c_str("six"),
+        aws_byte_cursor_from_c_str("seven"),
+        aws_byte_cursor_from_c_str("eight"),
+    };
+
+    struct publish_batch_test_data batch_data = {
+        .state_test_data = state_test_data,
+        .expected_payloads = payloads,
+        .expected_count = AWS_ARRAY_SIZE(payloads),
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_set_on_any_publish_batch_handler(
+        state_test_data->mqtt_connection, s_on_publish_batch_received, &batch_data));
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_MOST_ONCE,
+        s_on_publish_received,
+        state_test_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    ASSERT_INT_EQUALS(
+        AWS_OP_ERR,
+        aws_mqtt_client_connection_set_on_any_publish_batch_handler(state_test_data->mqtt_connection, NULL, NULL));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_STATE, aws_last_error());
+
+    state_test_data->expected_publishes = AWS_ARRAY_SIZE(payloads);
+    ASSERT_SUCCESS(mqtt_mock_server_send_publishes(
+        state_test_data->mock_server, &sub_topic, payloads, AWS_ARRAY_SIZE(payloads), AWS_MQTT_QOS_AT_MOST_ONCE));
+    s_wait_for_publish(state_test_data);
+
+    /* The batch comes after the subscription callbacks of the same read */
+    aws_mutex_lock(&state_test_data->lock);
+    aws_condition_variable_wait_pred(
+        &state_test_data->cvar, &state_test_data->lock, s_is_publish_batch_received, &batch_data);
+    aws_mutex_unlock(&state_test_data->lock);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    ASSERT_FALSE(batch_data.mismatch);
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(payloads), batch_data.publish_count);
+    ASSERT_TRUE(batch_data.batch_count < AWS_ARRAY_SIZE(payloads));
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(payloads), aws_array_list_length(&state_test_data->published_messages));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_publish_batch_received,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_publish_batch_received_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Subscribe to a topic and broker returns a SUBACK with failure return code, the subscribe should fail */
+static int s_test_mqtt_connect_subscribe_fail_from_broker_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    /* Disable the auto ACK packets sent by the server, we will send failure SUBACK */
+    mqtt_mock_server_disable_auto_ack(state_test_data->mock_server);
+
+    struct aws_byte_cursor sub_topic = aws_byte_cursor_from_c_str("/test/topic");
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe(
+        state_test_data->mqtt_connection,
+        &sub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        s_on_publish_received,
+        state_test_data,
+        NULL,
+        s_on_suback,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(mqtt_mock_server_send_single_suback(state_test_data->mock_server, packet_id, AWS_MQTT_QOS_FAILURE));
+    s_wait_for_subscribe_to_complete(state_test_data);
+    /* Check the subscribe returned QoS is failure */
+    size_t length = aws_array_list_length(&state_test_data->qos_returned);
+    ASSERT_UINT_EQUALS(1, length);
+    uint8_t qos = 0;
+    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 0));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_FAILURE, qos);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_subscribe_fail_from_broker,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_connect_subscribe_fail_from_broker_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages,
+ * make sure they're received, then send a DISCONNECT. */
+static int s_test_mqtt_subscribe_multi_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
+    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
+
+    struct aws_mqtt_topic_subscription sub1 = {
+        .topic = sub_topic_1,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+    struct aws_mqtt_topic_subscription sub2 = {
+        .topic = sub_topic_2,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+
+    struct aws_array_list topic_filters;
+    size_t list_len = 2;
+    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
+    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
+
+    aws_array_list_push_back(&topic_filters, &sub1);
+    aws_array_list_push_back(&topic_filters, &sub2);
+
+    uint16_t packet_id = aws_mqtt_client_connection_subscribe_multiple(
+        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+    /* Check the subscribe returned QoS is expected */
+    size_t length = aws_array_list_length(&state_test_data->qos_returned);
+    ASSERT_UINT_EQUALS(2, length);
+    uint8_t qos = 0;
+    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 0));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_EXACTLY_ONCE, qos);
+    ASSERT_SUCCESS(aws_array_list_get_at(&state_test_data->qos_returned, &qos, 1));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_EXACTLY_ONCE, qos);
+
+    state_test_data->expected_publishes = 2;
+    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_1,
+        &payload_1,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_2,
+        &payload_2,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    s_wait_for_publish(state_test_data);
+
+    /* Let's do another publish on a topic that is not subscribed by client.
+     * This can happen if the Server automatically assigned a subscription to the Client */
+    state_test_data->expected_any_publishes = 3;
+    struct aws_byte_cursor payload_3 = aws_byte_cursor_from_c_str("Test Message 3");
+    struct aws_byte_cursor topic_3 = aws_byte_cursor_from_c_str("/test/topic3");
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &topic_3,
+        &payload_3,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    s_wait_for_any_publish(state_test_data);
+
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 3);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Decode all received packets by mock server */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+
+    ASSERT_UINT_EQUALS(6, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
+    struct aws_mqtt_subscription val;
+    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_1));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_UINT_EQUALS(packet_id, received_packet->packet_identifier);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 4);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 5);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+
+    /* Only two packets should be recorded by the published_messages, but all the three packets will be recorded by
+     * any_published_messages */
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&state_test_data->published_messages));
+    ASSERT_UINT_EQUALS(3, aws_array_list_length(&state_test_data->any_published_messages));
+
+    struct received_publish_packet *publish_msg = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 0));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_1, &publish_msg->topic));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_1, &publish_msg->payload));
+    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 1));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_subscribe_multi,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_subscribe_multi_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages, unsubscribe
+ * to a topic, have the server send PUBLISH messages again, make sure the unsubscribed topic callback will not be fired
+ */
+static int s_test_mqtt_unsubscribe_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
+    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
+
+    struct aws_mqtt_topic_subscription sub1 = {
+        .topic = sub_topic_1,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+    struct aws_mqtt_topic_subscription sub2 = {
+        .topic = sub_topic_2,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+
+    struct aws_array_list topic_filters;
+    size_t list_len = 2;
+    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
+    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
+
+    aws_array_list_push_back(&topic_filters, &sub1);
+    aws_array_list_push_back(&topic_filters, &sub2);
+
+    uint16_t sub_packet_id = aws_mqtt_client_connection_subscribe_multiple(
+        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
+    ASSERT_TRUE(sub_packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    state_test_data->expected_any_publishes = 2;
+    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_1,
+        &payload_1,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_2,
+        &payload_2,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    s_wait_for_any_publish(state_test_data);
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 2);
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 1;
+    aws_mutex_unlock(&state_test_data->lock);
+    /* unsubscribe to the first topic */
+    uint16_t unsub_packet_id = aws_mqtt_client_connection_unsubscribe(
+        state_test_data->mqtt_connection, &sub_topic_1, s_on_op_complete, state_test_data);
+    ASSERT_TRUE(unsub_packet_id > 0);
+    /* Even when the UNSUBACK has not received, the client will not invoke the on_pub callback for that topic */
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_1,
+        &payload_1,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
+        state_test_data->mock_server,
+        &sub_topic_2,
+        &payload_2,
+        false /*dup*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*retain*/));
+    state_test_data->expected_any_publishes = 2;
+    s_wait_for_any_publish(state_test_data);
+    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 2);
+    s_wait_for_ops_completed(state_test_data);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Decode all received packets by mock server */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
+    struct aws_mqtt_subscription val;
+    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_1));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_UINT_EQUALS(sub_packet_id, received_packet->packet_identifier);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 4);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_UNSUBSCRIBE, received_packet->type);
+    ASSERT_UINT_EQUALS(1, aws_array_list_length(&received_packet->unsub_topic_filters));
+    struct aws_byte_cursor val_cur;
+    ASSERT_SUCCESS(aws_array_list_front(&received_packet->unsub_topic_filters, &val_cur));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val_cur, &sub_topic_1));
+    ASSERT_UINT_EQUALS(unsub_packet_id, received_packet->packet_identifier);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 5);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 6);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 7);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+
+    /* Only three packets should be recorded by the published_messages, but all the four packets will be recorded by
+     * any_published_messages */
+    ASSERT_UINT_EQUALS(3, aws_array_list_length(&state_test_data->published_messages));
+    ASSERT_UINT_EQUALS(4, aws_array_list_length(&state_test_data->any_published_messages));
+
+    struct received_publish_packet *publish_msg = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 0));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_1, &publish_msg->topic));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_1, &publish_msg->payload));
+    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 1));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
+    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 2));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
+    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_unsubscribe,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_unsubscribe_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/**
+ * Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages, unsubscribe
+ * to a topic, disconnect with the broker, make a connection with clean_session true, then call resubscribe, client will
+ * successfully resubscribe to the old topics.
+ */
+static int s_test_mqtt_resubscribe_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
+    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
+    struct aws_byte_cursor sub_topic_3 = aws_byte_cursor_from_c_str("/test/topic3");
+
+    struct aws_mqtt_topic_subscription sub1 = {
+        .topic = sub_topic_1,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+    struct aws_mqtt_topic_subscription sub2 = {
+        .topic = sub_topic_2,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+    struct aws_mqtt_topic_subscription sub3 = {
+        .topic = sub_topic_3,
+        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+        .on_publish = s_on_publish_received,
+        .on_cleanup = NULL,
+        .on_publish_ud = state_test_data,
+    };
+
+    struct aws_array_list topic_filters;
+    size_t list_len = 3;
+    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
+    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
+
+    aws_array_list_push_back(&topic_filters, &sub1);
+    aws_array_list_push_back(&topic_filters, &sub2);
+    aws_array_list_push_back(&topic_filters, &sub3);
+
+    uint16_t sub_packet_id = aws_mqtt_client_connection_subscribe_multiple(
+        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
+    ASSERT_TRUE(sub_packet_id > 0);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    s_wait_for_subscribe_to_complete(state_test_data);
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 1;
+    aws_mutex_unlock(&state_test_data->lock);
     /* unsubscribe to the first topic */
     uint16_t unsub_packet_id = aws_mqtt_client_connection_unsubscribe(
         state_test_data->mqtt_connection, &sub_topic_1, s_on_op_complete, state_test_data);
     ASSERT_TRUE(unsub_packet_id > 0);
-    /* Even when the UNSUBACK has not received, the client will not invoke the on_pub callback for that topic */
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_1,
+
+    s_wait_for_ops_completed(state_test_data);
+    /* client still subscribes to topic_2 & topic_3 */
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* reconnection to the same server */
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    /* Get all the packets out of the way */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    size_t packets_count = mqtt_mock_server_decoded_packets_count(state_test_data->mock_server);
+    struct mqtt_decoded_packet *t_received_packet =
+        mqtt_mock_server_get_latest_decoded_packet(state_test_data->mock_server);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, t_received_packet->type);
+
+    /* resubscribes to topic_2 & topic_3 */
+    uint16_t resub_packet_id =
+        aws_mqtt_resubscribe_existing_topics(state_test_data->mqtt_connection, s_on_multi_suback, state_test_data);
+    ASSERT_TRUE(resub_packet_id > 0);
+    s_wait_for_subscribe_to_complete(state_test_data);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, packets_count);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
+
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
+    struct aws_mqtt_subscription val;
+    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_3));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
+    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
+    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
+    ASSERT_UINT_EQUALS(resub_packet_id, received_packet->packet_identifier);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_resubscribe,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_resubscribe_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Make a CONNECT, PUBLISH to a topic, make sure server received, then send a DISCONNECT. */
+static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
+    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 2;
+    aws_mutex_unlock(&state_test_data->lock);
+    uint16_t packet_id_1 = aws_mqtt_client_connection_publish(
+        state_test_data->mqtt_connection,
+        &pub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false,
         &payload_1,
-        false /*dup*/,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id_1 > 0);
+    uint16_t packet_id_2 = aws_mqtt_client_connection_publish(
+        state_test_data->mqtt_connection,
+        &pub_topic,
         AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    ASSERT_SUCCESS(mqtt_mock_server_send_publish(
-        state_test_data->mock_server,
-        &sub_topic_2,
+        false,
         &payload_2,
-        false /*dup*/,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id_2 > 0);
+
+    s_wait_for_ops_completed(state_test_data);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Decode all received packets by mock server */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+
+    ASSERT_UINT_EQUALS(4, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->client_identifier, &connection_options.client_id));
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_1));
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_2));
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_publish,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_publish_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Make a CONNECT, PUBLISH to a topic, free the payload before the publish completes to make sure it's safe */
+static int s_test_mqtt_publish_payload_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_buf buf_payload;
+    struct aws_byte_cursor ori_payload = aws_byte_cursor_from_c_str("Test Message 1");
+    ASSERT_SUCCESS(aws_byte_buf_init_copy_from_cursor(&buf_payload, allocator, ori_payload));
+    struct aws_byte_cursor payload_curser = aws_byte_cursor_from_buf(&buf_payload);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 1;
+    aws_mutex_unlock(&state_test_data->lock);
+    uint16_t packet_id = aws_mqtt_client_connection_publish(
+        state_test_data->mqtt_connection,
+        &pub_topic,
         AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false /*retain*/));
-    state_test_data->expected_any_publishes = 2;
-    s_wait_for_any_publish(state_test_data);
-    mqtt_mock_server_wait_for_pubacks(state_test_data->mock_server, 2);
+        false,
+        &payload_curser,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    /* clean up the payload buf, as user don't need to manage the buf and keep it valid until publish completes */
+    aws_byte_buf_clean_up(&buf_payload);
     s_wait_for_ops_completed(state_test_data);
 
     ASSERT_SUCCESS(
@@ -1393,75 +2639,124 @@ static int s_test_mqtt_unsubscribe_fn(struct aws_allocator *allocator, void *ctx
     /* Decode all received packets by mock server */
     ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
 
+    ASSERT_UINT_EQUALS(3, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
     struct mqtt_decoded_packet *received_packet =
         mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
     ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->client_identifier, &connection_options.client_id));
 
     received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
-    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
-    struct aws_mqtt_subscription val;
-    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_1));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_UINT_EQUALS(sub_packet_id, received_packet->packet_identifier);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &ori_payload));
 
     received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 4);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_UNSUBSCRIBE, received_packet->type);
-    ASSERT_UINT_EQUALS(1, aws_array_list_length(&received_packet->unsub_topic_filters));
-    struct aws_byte_cursor val_cur;
-    ASSERT_SUCCESS(aws_array_list_front(&received_packet->unsub_topic_filters, &val_cur));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val_cur, &sub_topic_1));
-    ASSERT_UINT_EQUALS(unsub_packet_id, received_packet->packet_identifier);
+    return AWS_OP_SUCCESS;
+}
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 5);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 6);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, received_packet->type);
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_publish_payload,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_publish_payload_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 7);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+static void s_on_payload_released(void *userdata) {
+    struct aws_byte_buf *buf_payload = userdata;
+    aws_mutex_lock(&test_data.lock);
+    aws_byte_buf_clean_up(buf_payload);
+    test_data.payloads_released++;
+    aws_mutex_unlock(&test_data.lock);
+}
 
-    /* Only three packets should be recorded by the published_messages, but all the four packets will be recorded by
-     * any_published_messages */
-    ASSERT_UINT_EQUALS(3, aws_array_list_length(&state_test_data->published_messages));
-    ASSERT_UINT_EQUALS(4, aws_array_list_length(&state_test_data->any_published_messages));
+/* Make a CONNECT, PUBLISH a borrowed payload, make sure it's sent intact and released once the publish completes */
+static int s_test_mqtt_publish_no_copy_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
 
-    struct received_publish_packet *publish_msg = NULL;
-    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 0));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_1, &publish_msg->topic));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_1, &publish_msg->payload));
-    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 1));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
-    ASSERT_SUCCESS(aws_array_list_get_at_ptr(&state_test_data->published_messages, (void **)&publish_msg, 2));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&sub_topic_2, &publish_msg->topic));
-    ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload_2, &publish_msg->payload));
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_buf buf_payload;
+    struct aws_byte_cursor ori_payload = aws_byte_cursor_from_c_str("Test Message 1");
+    ASSERT_SUCCESS(aws_byte_buf_init_copy_from_cursor(&buf_payload, allocator, ori_payload));
+    struct aws_byte_cursor payload_cursor = aws_byte_cursor_from_buf(&buf_payload);
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+
+    /* A borrowed payload can't be published without a way to hand it back */
+    ASSERT_UINT_EQUALS(
+        0,
+        aws_mqtt_client_connection_publish_no_copy(
+            state_test_data->mqtt_connection,
+            &pub_topic,
+            AWS_MQTT_QOS_AT_LEAST_ONCE,
+            false,
+            &payload_cursor,
+            NULL,
+            NULL,
+            s_on_op_complete,
+            state_test_data));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 1;
+    aws_mutex_unlock(&state_test_data->lock);
+    uint16_t packet_id = aws_mqtt_client_connection_publish_no_copy(
+        state_test_data->mqtt_connection,
+        &pub_topic,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false,
+        &payload_cursor,
+        s_on_payload_released,
+        &buf_payload,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id > 0);
+
+    s_wait_for_ops_completed(state_test_data);
+    ASSERT_UINT_EQUALS(0, aws_mqtt_client_connection_get_packet_ids_in_use(state_test_data->mqtt_connection));
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    aws_mutex_lock(&state_test_data->lock);
+    ASSERT_UINT_EQUALS(1, state_test_data->payloads_released);
+    aws_mutex_unlock(&state_test_data->lock);
+
+    /* Decode all received packets by mock server */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+
+    ASSERT_UINT_EQUALS(3, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &ori_payload));
 
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_unsubscribe,
+    mqtt_connect_publish_no_copy,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_unsubscribe_fn,
+    s_test_mqtt_publish_no_copy_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/**
- * Subscribe to multiple topics prior to connection, make a CONNECT, have the server send PUBLISH messages, unsubscribe
- * to a topic, disconnect with the broker, make a connection with clean_session true, then call resubscribe, client will
- * successfully resubscribe to the old topics.
- */
-static int s_test_mqtt_resubscribe_fn(struct aws_allocator *allocator, void *ctx) {
+/* Register a topic, PUBLISH to it twice and release the handle straight away, make sure both arrive on that topic */
+static int s_test_mqtt_publish_topic_handle_fn(struct aws_allocator *allocator, void *ctx) {
     (void)allocator;
     struct mqtt_connection_state_test *state_test_data = ctx;
 
@@ -1474,112 +2769,159 @@ static int s_test_mqtt_resubscribe_fn(struct aws_allocator *allocator, void *ctx
         .on_connection_complete = s_on_connection_complete_fn,
     };
 
-    struct aws_byte_cursor sub_topic_1 = aws_byte_cursor_from_c_str("/test/topic1");
-    struct aws_byte_cursor sub_topic_2 = aws_byte_cursor_from_c_str("/test/topic2");
-    struct aws_byte_cursor sub_topic_3 = aws_byte_cursor_from_c_str("/test/topic3");
-
-    struct aws_mqtt_topic_subscription sub1 = {
-        .topic = sub_topic_1,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
-    };
-    struct aws_mqtt_topic_subscription sub2 = {
-        .topic = sub_topic_2,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
-    };
-    struct aws_mqtt_topic_subscription sub3 = {
-        .topic = sub_topic_3,
-        .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
-        .on_publish = s_on_publish_received,
-        .on_cleanup = NULL,
-        .on_publish_ud = state_test_data,
-    };
-
-    struct aws_array_list topic_filters;
-    size_t list_len = 3;
-    AWS_VARIABLE_LENGTH_ARRAY(uint8_t, static_buf, list_len * sizeof(struct aws_mqtt_topic_subscription));
-    aws_array_list_init_static(&topic_filters, static_buf, list_len, sizeof(struct aws_mqtt_topic_subscription));
+    struct aws_byte_cursor invalid_topic = aws_byte_cursor_from_c_str("/test/#");
+    ASSERT_NULL(aws_mqtt_topic_handle_new(allocator, &invalid_topic));
+    ASSERT_INT_EQUALS(AWS_ERROR_MQTT_INVALID_TOPIC, aws_last_error());
 
-    aws_array_list_push_back(&topic_filters, &sub1);
-    aws_array_list_push_back(&topic_filters, &sub2);
-    aws_array_list_push_back(&topic_filters, &sub3);
+    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_mqtt_topic_handle *topic_handle = aws_mqtt_topic_handle_new(allocator, &pub_topic);
+    ASSERT_NOT_NULL(topic_handle);
+    struct aws_byte_cursor handle_topic = aws_mqtt_topic_handle_get_topic(topic_handle);
+    ASSERT_TRUE(aws_byte_cursor_eq(&handle_topic, &pub_topic));
 
-    uint16_t sub_packet_id = aws_mqtt_client_connection_subscribe_multiple(
-        state_test_data->mqtt_connection, &topic_filters, s_on_multi_suback, state_test_data);
-    ASSERT_TRUE(sub_packet_id > 0);
+    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
+    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
 
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
 
-    s_wait_for_subscribe_to_complete(state_test_data);
     aws_mutex_lock(&state_test_data->lock);
-    state_test_data->expected_ops_completed = 1;
+    state_test_data->expected_ops_completed = 2;
     aws_mutex_unlock(&state_test_data->lock);
-    /* unsubscribe to the first topic */
-    uint16_t unsub_packet_id = aws_mqtt_client_connection_unsubscribe(
-        state_test_data->mqtt_connection, &sub_topic_1, s_on_op_complete, state_test_data);
-    ASSERT_TRUE(unsub_packet_id > 0);
+    uint16_t packet_id_1 = aws_mqtt_client_connection_publish_with_topic_handle(
+        state_test_data->mqtt_connection,
+        topic_handle,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false,
+        &payload_1,
+        NULL,
+        NULL,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id_1 > 0);
+    uint16_t packet_id_2 = aws_mqtt_client_connection_publish_with_topic_handle(
+        state_test_data->mqtt_connection,
+        topic_handle,
+        AWS_MQTT_QOS_AT_MOST_ONCE,
+        false,
+        &payload_2,
+        NULL,
+        NULL,
+        s_on_op_complete,
+        state_test_data);
+    ASSERT_TRUE(packet_id_2 > 0);
+
+    /* The publishes hold their own references */
+    aws_mqtt_topic_handle_release(topic_handle);
 
     s_wait_for_ops_completed(state_test_data);
-    /* client still subscribes to topic_2 & topic_3 */
 
     ASSERT_SUCCESS(
         aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
     s_wait_for_disconnect_to_complete(state_test_data);
 
-    /* reconnection to the same server */
+    /* Decode all received packets by mock server */
+    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
+
+    ASSERT_UINT_EQUALS(4, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    struct mqtt_decoded_packet *received_packet =
+        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_UINT_EQUALS(packet_id_1, received_packet->packet_identifier);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_1));
+
+    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_2));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_publish_topic_handle,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_publish_topic_handle_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Prepare a QoS 1 PUBLISH, send it twice and release it straight away, make sure both copies arrive intact with their
+ * own packet ids */
+static int s_test_mqtt_publish_prepared_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("Test Message 1");
+
+    struct aws_byte_cursor invalid_topic = aws_byte_cursor_from_c_str("/test/+");
+    ASSERT_NULL(
+        aws_mqtt_prepared_publish_new(allocator, &invalid_topic, AWS_MQTT_QOS_AT_LEAST_ONCE, false, &payload));
+    ASSERT_INT_EQUALS(AWS_ERROR_MQTT_INVALID_TOPIC, aws_last_error());
+
+    struct aws_mqtt_prepared_publish *prepared =
+        aws_mqtt_prepared_publish_new(allocator, &pub_topic, AWS_MQTT_QOS_AT_LEAST_ONCE, false, &payload);
+    ASSERT_NOT_NULL(prepared);
+
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
 
-    /* Get all the packets out of the way */
-    ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
-    size_t packets_count = mqtt_mock_server_decoded_packets_count(state_test_data->mock_server);
-    struct mqtt_decoded_packet *t_received_packet =
-        mqtt_mock_server_get_latest_decoded_packet(state_test_data->mock_server);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, t_received_packet->type);
-
-    /* resubscribes to topic_2 & topic_3 */
-    uint16_t resub_packet_id =
-        aws_mqtt_resubscribe_existing_topics(state_test_data->mqtt_connection, s_on_multi_suback, state_test_data);
-    ASSERT_TRUE(resub_packet_id > 0);
-    s_wait_for_subscribe_to_complete(state_test_data);
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 2;
+    aws_mutex_unlock(&state_test_data->lock);
+    uint16_t packet_id_1 = aws_mqtt_client_connection_publish_prepared(
+        state_test_data->mqtt_connection, prepared, s_on_op_complete, state_test_data);
+    ASSERT_TRUE(packet_id_1 > 0);
+    uint16_t packet_id_2 = aws_mqtt_client_connection_publish_prepared(
+        state_test_data->mqtt_connection, prepared, s_on_op_complete, state_test_data);
+    ASSERT_TRUE(packet_id_2 > 0);
+    ASSERT_TRUE(packet_id_1 != packet_id_2);
+
+    /* The publishes hold their own references */
+    aws_mqtt_prepared_publish_release(prepared);
+
+    s_wait_for_ops_completed(state_test_data);
 
     ASSERT_SUCCESS(
         aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
     s_wait_for_disconnect_to_complete(state_test_data);
 
+    /* Decode all received packets by mock server */
     ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
-    struct mqtt_decoded_packet *received_packet =
-        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, packets_count);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_SUBSCRIBE, received_packet->type);
 
-    ASSERT_UINT_EQUALS(2, aws_array_list_length(&received_packet->sub_topic_filters));
-    struct aws_mqtt_subscription val;
-    ASSERT_SUCCESS(aws_array_list_front(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_3));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_SUCCESS(aws_array_list_back(&received_packet->sub_topic_filters, &val));
-    ASSERT_TRUE(aws_byte_cursor_eq(&val.topic_filter, &sub_topic_2));
-    ASSERT_UINT_EQUALS(AWS_MQTT_QOS_AT_LEAST_ONCE, val.qos);
-    ASSERT_UINT_EQUALS(resub_packet_id, received_packet->packet_identifier);
+    ASSERT_UINT_EQUALS(4, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    uint16_t expected_packet_ids[] = {packet_id_1, packet_id_2};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(expected_packet_ids); ++i) {
+        struct mqtt_decoded_packet *received_packet =
+            mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1 + i);
+        ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+        ASSERT_UINT_EQUALS(expected_packet_ids[i], received_packet->packet_identifier);
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload));
+    }
 
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_resubscribe,
+    mqtt_connect_publish_prepared,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_resubscribe_fn,
+    s_test_mqtt_publish_prepared_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/* Make a CONNECT, PUBLISH to a topic, make sure server received, then send a DISCONNECT. */
-static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
+/* Make a CONNECT, PUBLISH a payload too large for a single channel message, make sure it arrives intact */
+static int s_test_mqtt_publish_large_payload_fn(struct aws_allocator *allocator, void *ctx) {
     (void)allocator;
     struct mqtt_connection_state_test *state_test_data = ctx;
 
@@ -1593,8 +2935,12 @@ static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
     };
 
     struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
-    struct aws_byte_cursor payload_1 = aws_byte_cursor_from_c_str("Test Message 1");
-    struct aws_byte_cursor payload_2 = aws_byte_cursor_from_c_str("Test Message 2");
+    struct aws_byte_buf buf_payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buf_payload, allocator, 256 * 1024));
+    for (size_t i = 0; i < buf_payload.capacity; ++i) {
+        aws_byte_buf_write_u8(&buf_payload, (uint8_t)i);
+    }
+    struct aws_byte_cursor payload_cursor = aws_byte_cursor_from_buf(&buf_payload);
 
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
@@ -1605,9 +2951,9 @@ static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
     uint16_t packet_id_1 = aws_mqtt_client_connection_publish(
         state_test_data->mqtt_connection,
         &pub_topic,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        AWS_MQTT_QOS_AT_MOST_ONCE,
         false,
-        &payload_1,
+        &payload_cursor,
         s_on_op_complete,
         state_test_data);
     ASSERT_TRUE(packet_id_1 > 0);
@@ -1616,7 +2962,7 @@ static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
         &pub_topic,
         AWS_MQTT_QOS_AT_LEAST_ONCE,
         false,
-        &payload_2,
+        &payload_cursor,
         s_on_op_complete,
         state_test_data);
     ASSERT_TRUE(packet_id_2 > 0);
@@ -1631,36 +2977,28 @@ static int s_test_mqtt_publish_fn(struct aws_allocator *allocator, void *ctx) {
     ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
 
     ASSERT_UINT_EQUALS(4, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
-    struct mqtt_decoded_packet *received_packet =
-        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->client_identifier, &connection_options.client_id));
-
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_1));
-
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_2));
+    for (size_t i = 1; i <= 2; ++i) {
+        struct mqtt_decoded_packet *received_packet =
+            mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, i);
+        ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &payload_cursor));
+    }
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 3);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+    aws_byte_buf_clean_up(&buf_payload);
 
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_publish,
+    mqtt_connect_publish_large_payload,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_publish_fn,
+    s_test_mqtt_publish_large_payload_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
-/* Make a CONNECT, PUBLISH to a topic, free the payload before the publish completes to make sure it's safe */
-static int s_test_mqtt_publish_payload_fn(struct aws_allocator *allocator, void *ctx) {
+/* Make a CONNECT, PUBLISH a batch of messages, make sure they're all sent in order with the reported packet ids */
+static int s_test_mqtt_publish_batch_fn(struct aws_allocator *allocator, void *ctx) {
     (void)allocator;
     struct mqtt_connection_state_test *state_test_data = ctx;
 
@@ -1673,30 +3011,56 @@ static int s_test_mqtt_publish_payload_fn(struct aws_allocator *allocator, void
         .on_connection_complete = s_on_connection_complete_fn,
     };
 
-    struct aws_byte_cursor pub_topic = aws_byte_cursor_from_c_str("/test/topic");
-    struct aws_byte_buf buf_payload;
-    struct aws_byte_cursor ori_payload = aws_byte_cursor_from_c_str("Test Message 1");
-    ASSERT_SUCCESS(aws_byte_buf_init_copy_from_cursor(&buf_payload, allocator, ori_payload));
-    struct aws_byte_cursor payload_curser = aws_byte_cursor_from_buf(&buf_payload);
+    struct aws_mqtt_publish_batch_entry entries[] = {
+        {
+            .topic = aws_byte_cursor_from_c_str("/test/topic/1"),
+            .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+            .payload = aws_byte_cursor_from_c_str("Test Message 1"),
+            .on_complete = s_on_op_complete,
+            .userdata = state_test_data,
+        },
+        {
+            .topic = aws_byte_cursor_from_c_str("/test/topic/2"),
+            .qos = AWS_MQTT_QOS_AT_MOST_ONCE,
+            .payload = aws_byte_cursor_from_c_str("Test Message 2"),
+            .on_complete = s_on_op_complete,
+            .userdata = state_test_data,
+        },
+        {
+            .topic = aws_byte_cursor_from_c_str("/test/topic/3"),
+            .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+            .payload = aws_byte_cursor_from_c_str("Test Message 3"),
+            .on_complete = s_on_op_complete,
+            .userdata = state_test_data,
+        },
+    };
+    const size_t entry_count = AWS_ARRAY_SIZE(entries);
+    uint16_t packet_ids[AWS_ARRAY_SIZE(entries)];
+
+    /* An invalid topic anywhere in the batch fails the whole batch */
+    struct aws_mqtt_publish_batch_entry invalid_entries[] = {
+        entries[0],
+        {
+            .topic = aws_byte_cursor_from_c_str("/test/#"),
+            .payload = aws_byte_cursor_from_c_str("Test Message"),
+        },
+    };
+    ASSERT_FAILS(aws_mqtt_client_connection_publish_batch(
+        state_test_data->mqtt_connection, invalid_entries, AWS_ARRAY_SIZE(invalid_entries), NULL));
+    ASSERT_INT_EQUALS(AWS_ERROR_MQTT_INVALID_TOPIC, aws_last_error());
 
     ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
     s_wait_for_connection_to_complete(state_test_data);
 
     aws_mutex_lock(&state_test_data->lock);
-    state_test_data->expected_ops_completed = 1;
+    state_test_data->expected_ops_completed = entry_count;
     aws_mutex_unlock(&state_test_data->lock);
-    uint16_t packet_id = aws_mqtt_client_connection_publish(
-        state_test_data->mqtt_connection,
-        &pub_topic,
-        AWS_MQTT_QOS_AT_LEAST_ONCE,
-        false,
-        &payload_curser,
-        s_on_op_complete,
-        state_test_data);
-    ASSERT_TRUE(packet_id > 0);
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_publish_batch(state_test_data->mqtt_connection, entries, entry_count, packet_ids));
+    for (size_t i = 0; i < entry_count; ++i) {
+        ASSERT_TRUE(packet_ids[i] > 0);
+    }
 
-    /* clean up the payload buf, as user don't need to manage the buf and keep it valid until publish completes */
-    aws_byte_buf_clean_up(&buf_payload);
     s_wait_for_ops_completed(state_test_data);
 
     ASSERT_SUCCESS(
@@ -1706,27 +3070,404 @@ static int s_test_mqtt_publish_payload_fn(struct aws_allocator *allocator, void
     /* Decode all received packets by mock server */
     ASSERT_SUCCESS(mqtt_mock_server_decode_packets(state_test_data->mock_server));
 
-    ASSERT_UINT_EQUALS(3, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
-    struct mqtt_decoded_packet *received_packet =
-        mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 0);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_CONNECT, received_packet->type);
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->client_identifier, &connection_options.client_id));
+    ASSERT_UINT_EQUALS(2 + entry_count, mqtt_mock_server_decoded_packets_count(state_test_data->mock_server));
+    size_t packet_idx = 0;
+    for (size_t i = 0; i < entry_count; ++i) {
+        struct mqtt_decoded_packet *received_packet = mqtt_mock_server_find_decoded_packet_by_type(
+            state_test_data->mock_server, packet_idx, AWS_MQTT_PACKET_PUBLISH, &packet_idx);
+        ASSERT_NOT_NULL(received_packet);
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &entries[i].topic));
+        ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &entries[i].payload));
+        if (entries[i].qos != AWS_MQTT_QOS_AT_MOST_ONCE) {
+            ASSERT_UINT_EQUALS(packet_ids[i], received_packet->packet_identifier);
+        }
+        ++packet_idx;
+    }
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 1);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, received_packet->type);
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->topic_name, &pub_topic));
-    ASSERT_TRUE(aws_byte_cursor_eq(&received_packet->publish_payload, &ori_payload));
+    return AWS_OP_SUCCESS;
+}
 
-    received_packet = mqtt_mock_server_get_decoded_packet_by_index(state_test_data->mock_server, 2);
-    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, received_packet->type);
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_publish_batch,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_publish_batch_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Sits right below the client's MQTT handler and records the messages it writes, passing everything through */
+struct write_capture_handler {
+    struct aws_channel_handler handler;
+    struct aws_allocator *allocator;
+    struct mqtt_connection_state_test *state_test_data;
+};
+
+static int s_write_capture_process_read_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+    (void)handler;
+    return aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_READ);
+}
+
+static int s_write_capture_process_write_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+    struct write_capture_handler *capture = handler->impl;
+    struct mqtt_connection_state_test *state_test_data = capture->state_test_data;
+
+    struct written_message written;
+    AWS_ZERO_STRUCT(written);
+    struct aws_byte_cursor packets = aws_byte_cursor_from_buf(&message->message_data);
+    while (packets.len && written.packet_count < AWS_ARRAY_SIZE(written.packet_types)) {
+        struct aws_byte_cursor header_decode = packets;
+        struct aws_mqtt_fixed_header packet_header;
+        AWS_ZERO_STRUCT(packet_header);
+        if (aws_mqtt_fixed_header_decode(&header_decode, &packet_header)) {
+            break;
+        }
+        written.packet_types[written.packet_count++] = packet_header.packet_type;
+        aws_byte_cursor_advance(&packets, packets.len - header_decode.len + packet_header.remaining_length);
+    }
+
+    aws_mutex_lock(&state_test_data->lock);
+    aws_array_list_push_back(&state_test_data->written_messages, &written);
+    aws_mutex_unlock(&state_test_data->lock);
+
+    return aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_WRITE);
+}
+
+static int s_write_capture_increment_read_window(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    size_t size) {
+    (void)handler;
+    return aws_channel_slot_increment_read_window(slot, size);
+}
+
+static int s_write_capture_shutdown(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    enum aws_channel_direction dir,
+    int error_code,
+    bool free_scarce_resources_immediately) {
+    (void)handler;
+    return aws_channel_slot_on_handler_shutdown_complete(slot, dir, error_code, free_scarce_resources_immediately);
+}
+
+static size_t s_write_capture_initial_window_size(struct aws_channel_handler *handler) {
+    (void)handler;
+    return SIZE_MAX;
+}
+
+static size_t s_write_capture_message_overhead(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static void s_write_capture_destroy(struct aws_channel_handler *handler) {
+    struct write_capture_handler *capture = handler->impl;
+    aws_mem_release(capture->allocator, capture);
+}
+
+static struct aws_channel_handler_vtable s_write_capture_vtable = {
+    .process_read_message = s_write_capture_process_read_message,
+    .process_write_message = s_write_capture_process_write_message,
+    .increment_read_window = s_write_capture_increment_read_window,
+    .shutdown = s_write_capture_shutdown,
+    .initial_window_size = s_write_capture_initial_window_size,
+    .message_overhead = s_write_capture_message_overhead,
+    .destroy = s_write_capture_destroy,
+};
+
+typedef void(client_channel_task_fn)(struct mqtt_connection_state_test *state_test_data, void *user_data);
+
+struct client_channel_task {
+    struct aws_channel_task task;
+    struct mqtt_connection_state_test *state_test_data;
+    client_channel_task_fn *fn;
+    void *user_data;
+    bool done;
+};
+
+static void s_client_channel_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct client_channel_task *channel_task = arg;
+    struct mqtt_connection_state_test *state_test_data = channel_task->state_test_data;
+
+    if (status == AWS_TASK_STATUS_RUN_READY) {
+        channel_task->fn(state_test_data, channel_task->user_data);
+    }
+
+    aws_mutex_lock(&state_test_data->lock);
+    channel_task->done = true;
+    aws_mutex_unlock(&state_test_data->lock);
+    aws_condition_variable_notify_one(&state_test_data->cvar);
+}
+
+static bool s_is_client_channel_task_done(void *arg) {
+    struct client_channel_task *channel_task = arg;
+    return channel_task->done;
+}
+
+/* Runs fn on the client channel's thread, all within a single event-loop tick, and waits for it to have run. */
+static void s_run_on_client_channel(
+    struct mqtt_connection_state_test *state_test_data,
+    client_channel_task_fn *fn,
+    void *user_data) {
+
+    struct client_channel_task channel_task = {
+        .state_test_data = state_test_data,
+        .fn = fn,
+        .user_data = user_data,
+    };
+    aws_channel_task_init(&channel_task.task, s_client_channel_task, &channel_task, "mqtt_test_client_channel_task");
+    aws_channel_schedule_task_now(state_test_data->mqtt_connection->slot->channel, &channel_task.task);
+
+    aws_mutex_lock(&state_test_data->lock);
+    aws_condition_variable_wait_pred(
+        &state_test_data->cvar, &state_test_data->lock, s_is_client_channel_task_done, &channel_task);
+    aws_mutex_unlock(&state_test_data->lock);
+}
+
+static void s_install_write_capture_task_fn(struct mqtt_connection_state_test *state_test_data, void *user_data) {
+    struct write_capture_handler *capture = user_data;
+    struct aws_channel_slot *mqtt_slot = state_test_data->mqtt_connection->slot;
+
+    struct aws_channel_slot *capture_slot = aws_channel_slot_new(mqtt_slot->channel);
+    aws_channel_slot_insert_left(mqtt_slot, capture_slot);
+    aws_channel_slot_set_handler(capture_slot, &capture->handler);
+}
+
+/* Starts recording the messages the connected client writes into state_test_data->written_messages. */
+static int s_install_write_capture(struct mqtt_connection_state_test *state_test_data) {
+    struct aws_allocator *allocator = state_test_data->allocator;
+    struct write_capture_handler *capture = aws_mem_calloc(allocator, 1, sizeof(struct write_capture_handler));
+    ASSERT_NOT_NULL(capture);
+    capture->allocator = allocator;
+    capture->state_test_data = state_test_data;
+    capture->handler.alloc = allocator;
+    capture->handler.vtable = &s_write_capture_vtable;
+    capture->handler.impl = capture;
+
+    s_run_on_client_channel(state_test_data, s_install_write_capture_task_fn, capture);
+
+    return AWS_OP_SUCCESS;
+}
+
+static size_t s_written_message_count(struct mqtt_connection_state_test *state_test_data) {
+    aws_mutex_lock(&state_test_data->lock);
+    size_t count = aws_array_list_length(&state_test_data->written_messages);
+    aws_mutex_unlock(&state_test_data->lock);
+    return count;
+}
+
+static struct written_message s_get_written_message(struct mqtt_connection_state_test *state_test_data, size_t i) {
+    struct written_message written;
+    AWS_ZERO_STRUCT(written);
+    aws_mutex_lock(&state_test_data->lock);
+    aws_array_list_get_at(&state_test_data->written_messages, &written, i);
+    aws_mutex_unlock(&state_test_data->lock);
+    return written;
+}
+
+struct coalesced_publishes {
+    struct aws_byte_cursor topic;
+    struct aws_byte_cursor payloads[3];
+};
+
+static void s_publish_task_fn(struct mqtt_connection_state_test *state_test_data, void *user_data) {
+    struct coalesced_publishes *publishes = user_data;
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(publishes->payloads); ++i) {
+        aws_mqtt_client_connection_publish(
+            state_test_data->mqtt_connection,
+            &publishes->topic,
+            AWS_MQTT_QOS_AT_LEAST_ONCE,
+            false,
+            &publishes->payloads[i],
+            s_on_op_complete,
+            state_test_data);
+    }
+}
+
+/**
+ * CONNECT, then make several PUBLISH requests during a single event-loop tick, and make sure they're written to the
+ * channel as one message. Then make PUBLISH requests too large to all fit in one message, and make sure the one that
+ * doesn't fit after the others starts a new message.
+ */
+static int s_test_mqtt_connect_coalesce_writes_fn(struct aws_allocator *allocator, void *ctx) {
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+    ASSERT_SUCCESS(s_install_write_capture(state_test_data));
+
+    struct coalesced_publishes small_publishes = {
+        .topic = aws_byte_cursor_from_c_str("/test/topic"),
+        .payloads =
+            {
+                aws_byte_cursor_from_c_str("Test Message 1"),
+                aws_byte_cursor_from_c_str("Test Message 2"),
+                aws_byte_cursor_from_c_str("Test Message 3"),
+            },
+    };
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 3;
+    aws_mutex_unlock(&state_test_data->lock);
+    s_run_on_client_channel(state_test_data, s_publish_task_fn, &small_publishes);
+    s_wait_for_ops_completed(state_test_data);
+
+    /* All three requests shared a single message */
+    ASSERT_UINT_EQUALS(1, s_written_message_count(state_test_data));
+    struct written_message written = s_get_written_message(state_test_data, 0);
+    ASSERT_UINT_EQUALS(3, written.packet_count);
+    for (size_t i = 0; i < written.packet_count; ++i) {
+        ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBLISH, written.packet_types[i]);
+    }
+
+    /* Two of these fit in a message, the third doesn't fit in what's left */
+    struct aws_byte_buf large_payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&large_payload, allocator, g_aws_channel_max_fragment_size * 2 / 5));
+    memset(large_payload.buffer, 'A', large_payload.capacity);
+    large_payload.len = large_payload.capacity;
+
+    struct coalesced_publishes large_publishes = {
+        .topic = small_publishes.topic,
+    };
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(large_publishes.payloads); ++i) {
+        large_publishes.payloads[i] = aws_byte_cursor_from_buf(&large_payload);
+    }
+
+    aws_mutex_lock(&state_test_data->lock);
+    state_test_data->expected_ops_completed = 6;
+    aws_mutex_unlock(&state_test_data->lock);
+    s_run_on_client_channel(state_test_data, s_publish_task_fn, &large_publishes);
+    s_wait_for_ops_completed(state_test_data);
+    aws_byte_buf_clean_up(&large_payload);
+
+    ASSERT_UINT_EQUALS(3, s_written_message_count(state_test_data));
+    written = s_get_written_message(state_test_data, 1);
+    ASSERT_UINT_EQUALS(2, written.packet_count);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBLISH, written.packet_types[0]);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBLISH, written.packet_types[1]);
+    written = s_get_written_message(state_test_data, 2);
+    ASSERT_UINT_EQUALS(1, written.packet_count);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBLISH, written.packet_types[0]);
+
+    ASSERT_SUCCESS(
+        aws_mqtt_client_connection_disconnect(state_test_data->mqtt_connection, s_on_disconnect_fn, state_test_data));
+    s_wait_for_disconnect_to_complete(state_test_data);
 
     return AWS_OP_SUCCESS;
 }
 
 AWS_TEST_CASE_FIXTURE(
-    mqtt_connect_publish_payload,
+    mqtt_connect_coalesce_writes,
     s_setup_mqtt_server_fn,
-    s_test_mqtt_publish_payload_fn,
+    s_test_mqtt_connect_coalesce_writes_fn,
+    s_clean_up_mqtt_server_fn,
+    &test_data)
+
+/* Writes a PUBACK the way the client writes its acks, coalesced with the others written during this tick */
+static void s_write_coalesced_puback(struct aws_mqtt_client_connection *connection, uint16_t packet_id) {
+    struct aws_mqtt_packet_ack puback;
+    aws_mqtt_packet_puback_init(&puback, packet_id);
+    struct aws_io_message *message = mqtt_get_coalesced_message_for_packet(connection, &puback.fixed_header);
+    if (message) {
+        aws_mqtt_packet_ack_encode(&message->message_data, &puback);
+    }
+}
+
+static void s_send_acks_then_disconnect_task_fn(struct mqtt_connection_state_test *state_test_data, void *user_data) {
+    (void)user_data;
+    struct aws_mqtt_client_connection *connection = state_test_data->mqtt_connection;
+
+    s_write_coalesced_puback(connection, 1);
+    s_write_coalesced_puback(connection, 2);
+    aws_mqtt_client_connection_disconnect(connection, s_on_disconnect_fn, state_test_data);
+}
+
+static void s_send_acks_then_fail_task_fn(struct mqtt_connection_state_test *state_test_data, void *user_data) {
+    (void)user_data;
+    struct aws_mqtt_client_connection *connection = state_test_data->mqtt_connection;
+
+    s_write_coalesced_puback(connection, 1);
+    s_write_coalesced_puback(connection, 2);
+    aws_channel_shutdown(connection->slot->channel, AWS_ERROR_INVALID_STATE);
+}
+
+/**
+ * CONNECT, then write acks and shut the connection down during the same event-loop tick, first with an error and then
+ * with a DISCONNECT. Make sure the acks coalesced that tick still make it out, ahead of the DISCONNECT.
+ */
+static int s_test_mqtt_connect_coalesce_writes_shutdown_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    struct mqtt_connection_state_test *state_test_data = ctx;
+
+    struct aws_mqtt_connection_options connection_options = {
+        .user_data = state_test_data,
+        .clean_session = false,
+        .client_id = aws_byte_cursor_from_c_str("client1234"),
+        .host_name = aws_byte_cursor_from_c_str(state_test_data->endpoint.address),
+        .socket_options = &state_test_data->socket_options,
+        .on_connection_complete = s_on_connection_complete_fn,
+    };
+
+    ASSERT_SUCCESS(aws_mqtt_client_connection_connect(state_test_data->mqtt_connection, &connection_options));
+    s_wait_for_connection_to_complete(state_test_data);
+    ASSERT_SUCCESS(s_install_write_capture(state_test_data));
+
+    s_run_on_client_channel(state_test_data, s_send_acks_then_fail_task_fn, NULL);
+    s_wait_for_interrupt_to_complete(state_test_data);
+
+    /* The acks went out in one message, and no DISCONNECT after them */
+    ASSERT_UINT_EQUALS(1, s_written_message_count(state_test_data));
+    struct written_message written = s_get_written_message(state_test_data, 0);
+    ASSERT_UINT_EQUALS(2, written.packet_count);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBACK, written.packet_types[0]);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBACK, written.packet_types[1]);
+
+    s_wait_for_reconnect_to_complete(state_test_data);
+    aws_mutex_lock(&state_test_data->lock);
+    aws_array_list_clear(&state_test_data->written_messages);
+    aws_mutex_unlock(&state_test_data->lock);
+    ASSERT_SUCCESS(s_install_write_capture(state_test_data));
+
+    s_run_on_client_channel(state_test_data, s_send_acks_then_disconnect_task_fn, NULL);
+    s_wait_for_disconnect_to_complete(state_test_data);
+
+    /* Coalesced or not, the DISCONNECT is the last packet written */
+    size_t packet_count = 0;
+    enum aws_mqtt_packet_type packet_types[4];
+    for (size_t i = 0; i < s_written_message_count(state_test_data); ++i) {
+        written = s_get_written_message(state_test_data, i);
+        for (size_t j = 0; j < written.packet_count; ++j) {
+            ASSERT_TRUE(packet_count < AWS_ARRAY_SIZE(packet_types));
+            packet_types[packet_count++] = written.packet_types[j];
+        }
+    }
+    ASSERT_UINT_EQUALS(3, packet_count);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBACK, packet_types[0]);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_PUBACK, packet_types[1]);
+    ASSERT_INT_EQUALS(AWS_MQTT_PACKET_DISCONNECT, packet_types[2]);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE_FIXTURE(
+    mqtt_connect_coalesce_writes_shutdown,
+    s_setup_mqtt_server_fn,
+    s_test_mqtt_connect_coalesce_writes_shutdown_fn,
     s_clean_up_mqtt_server_fn,
     &test_data)
 
@@ -2354,6 +4095,9 @@ static int s_test_mqtt_connection_destory_pending_requests_fn(struct aws_allocat
             s_on_suback,
             state_test_data) > 0);
 
+    /* Queued requests hold their packet IDs until they complete */
+    ASSERT_UINT_EQUALS(2, aws_mqtt_client_connection_get_packet_ids_in_use(state_test_data->mqtt_connection));
+
     return AWS_OP_SUCCESS;
 }
 
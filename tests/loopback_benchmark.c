@@ -0,0 +1,1267 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "benchmark_helpers.h"
+#include "mqtt_mock_server_handler.h"
+
+#include <aws/mqtt/client.h>
+
+#include <aws/io/channel.h>
+#include <aws/io/channel_bootstrap.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
+#include <aws/io/socket.h>
+
+#include <aws/common/clock.h>
+#include <aws/common/command_line_parser.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/math.h>
+#include <aws/common/mutex.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4996) /* Disable warnings about fopen() being insecure */
+#endif
+
+#ifdef _WIN32
+#    define LOCAL_SOCK_PATTERN "\\\\.\\pipe\\loopback_benchmark_%llu_%llu"
+#else
+#    define LOCAL_SOCK_PATTERN "loopback_benchmark_%llu_%llu.sock"
+#endif
+
+/*
+ * Benchmarks the client end to end against the mock server, over local sockets, so that it runs anywhere without a
+ * broker, a network or certificates.
+ *
+ * Every connection has a mock server of its own at the other end. For each number of connections and each payload
+ * size, it measures:
+ *  - publish_qos0/1/2: publishes sent by the client, keeping a number of them in flight on every connection. Latency
+ *    runs until the client completes the publish, which is once it's written for QoS 0, on PUBACK for QoS 1 and on
+ *    PUBCOMP for QoS 2. QoS 0 throughput also waits for the mock server to have read every publish.
+ *  - inbound_qos0/1: publishes sent by the mock server and dispatched by the client to its subscription.
+ * and then, for each number of connections:
+ *  - reconnect: the mock servers hang up on every connection at once, and time is taken until each client is
+ *    connected again, and from there until it has resubscribed to all its topics.
+ *
+ * Allocations are counted for the whole process, the mock servers included. Results are printed to stdout one JSON
+ * object per line.
+ */
+
+enum {
+    MAX_LIST_SIZE = 16,
+    DEFAULT_PUBLISH_COUNT = 10000,
+    DEFAULT_IN_FLIGHT = 64,
+    DEFAULT_SUBSCRIPTION_COUNT = 16,
+    DEFAULT_RECONNECT_COUNT = 20,
+    /* Publishes sent by the client on every connection before anything is measured */
+    WARM_UP_PUBLISH_COUNT = 1000,
+    /* Most publishes the mock server sends in one go */
+    MAX_INBOUND_BATCH_SIZE = 16,
+    MAX_TOPIC_SIZE = 64,
+    WAIT_TIMEOUT_SECS = 30,
+};
+
+static const char *s_benchmark_name = "loopback";
+static const char *s_default_connection_counts = "1,4";
+static const char *s_default_payload_sizes = "16,256,4096";
+
+struct loopback_benchmark;
+
+/* A client connection and the mock server at the other end of it, which listens on its own socket */
+struct loopback_pair {
+    struct loopback_benchmark *benchmark;
+    size_t index;
+
+    struct aws_channel_handler *mock_server;
+    struct aws_socket_endpoint endpoint;
+    struct aws_socket *listener;
+    struct aws_mqtt_client_connection *connection;
+
+    /* Storage for the topics below */
+    struct aws_byte_buf topics;
+    struct aws_byte_cursor publish_topic;
+    struct aws_byte_cursor inbound_topic;
+    /* aws_mqtt_topic_subscription, for inbound_topic and then filters that are only there to be resubscribed to */
+    struct aws_array_list subscriptions;
+
+    /* Only accessed from the main thread */
+    bool is_connected;
+    size_t server_publishes_base;
+
+    /* Lock must be held when accessing the rest */
+    struct aws_mutex lock;
+    struct aws_condition_variable cvar;
+
+    struct aws_channel *server_channel;
+    bool listener_destroyed;
+
+    bool connect_completed;
+    bool subscribe_completed;
+    bool disconnect_completed;
+    int error_code;
+
+    size_t publishes_in_flight;
+    size_t publish_errors;
+
+    size_t publishes_received;
+    size_t publishes_received_target;
+
+    bool resubscribe_completed;
+    uint64_t interrupted_ns;
+    uint64_t resumed_ns;
+    uint64_t resubscribed_ns;
+};
+
+/* A publish sent by the client, passed to its on_complete */
+struct loopback_publish {
+    struct loopback_pair *pair;
+    uint64_t start_ns;
+    uint64_t latency_ns;
+};
+
+struct loopback_benchmark {
+    /* Allocator for the benchmark itself */
+    struct aws_allocator *allocator;
+    /* Allocator for the client, the mock servers and everything under them */
+    struct benchmark_allocator counting_allocator;
+
+    struct benchmark_report report;
+
+    size_t connection_counts[MAX_LIST_SIZE];
+    size_t connection_count_count;
+    size_t payload_sizes[MAX_LIST_SIZE];
+    size_t payload_size_count;
+    size_t publish_count;
+    size_t in_flight;
+    size_t subscription_count;
+    size_t reconnect_count;
+    size_t thread_count;
+    const char *filter;
+
+    struct aws_event_loop_group *el_group;
+    struct aws_host_resolver *host_resolver;
+    struct aws_client_bootstrap *client_bootstrap;
+    struct aws_server_bootstrap *server_bootstrap;
+    struct aws_mqtt_client *mqtt_client;
+    struct aws_socket_options socket_options;
+
+    struct loopback_pair *pairs;
+    size_t pair_count;
+
+    /* One per publish of a case, across all connections */
+    struct loopback_publish *publishes;
+    uint64_t *samples;
+    size_t sample_capacity;
+
+    struct aws_byte_buf payload_storage;
+    struct aws_byte_cursor payload;
+};
+
+/*******************************************************************************
+ * Callbacks
+ ******************************************************************************/
+
+static void s_on_incoming_channel_setup(
+    struct aws_server_bootstrap *bootstrap,
+    int error_code,
+    struct aws_channel *channel,
+    void *user_data) {
+    (void)bootstrap;
+    struct loopback_pair *pair = user_data;
+
+    if (error_code) {
+        return;
+    }
+
+    struct aws_channel_slot *slot = aws_channel_slot_new(channel);
+    aws_channel_slot_insert_end(channel, slot);
+    mqtt_mock_server_handler_update_slot(pair->mock_server, slot);
+    aws_channel_slot_set_handler(slot, pair->mock_server);
+
+    aws_mutex_lock(&pair->lock);
+    pair->server_channel = channel;
+    aws_mutex_unlock(&pair->lock);
+}
+
+static void s_on_incoming_channel_shutdown(
+    struct aws_server_bootstrap *bootstrap,
+    int error_code,
+    struct aws_channel *channel,
+    void *user_data) {
+    (void)bootstrap;
+    (void)error_code;
+    struct loopback_pair *pair = user_data;
+
+    aws_mutex_lock(&pair->lock);
+    /* The channel of a reconnect may be set up before the one it replaces is done shutting down */
+    if (pair->server_channel == channel) {
+        pair->server_channel = NULL;
+    }
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_listener_destroy(struct aws_server_bootstrap *bootstrap, void *user_data) {
+    (void)bootstrap;
+    struct loopback_pair *pair = user_data;
+
+    aws_mutex_lock(&pair->lock);
+    pair->listener_destroyed = true;
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_connection_complete(
+    struct aws_mqtt_client_connection *connection,
+    int error_code,
+    enum aws_mqtt_connect_return_code return_code,
+    bool session_present,
+    void *userdata) {
+    (void)connection;
+    (void)session_present;
+    struct loopback_pair *pair = userdata;
+
+    aws_mutex_lock(&pair->lock);
+    pair->connect_completed = true;
+    if (error_code == AWS_ERROR_SUCCESS && return_code != AWS_MQTT_CONNECT_ACCEPTED) {
+        error_code = AWS_ERROR_MQTT_PROTOCOL_ERROR;
+    }
+    pair->error_code = error_code;
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_subscribe_complete(
+    struct aws_mqtt_client_connection *connection,
+    uint16_t packet_id,
+    const struct aws_array_list *topic_subacks,
+    int error_code,
+    void *userdata) {
+    (void)connection;
+    (void)packet_id;
+    (void)topic_subacks;
+    struct loopback_pair *pair = userdata;
+
+    aws_mutex_lock(&pair->lock);
+    pair->subscribe_completed = true;
+    pair->error_code = error_code;
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_disconnect_complete(struct aws_mqtt_client_connection *connection, void *userdata) {
+    (void)connection;
+    struct loopback_pair *pair = userdata;
+
+    aws_mutex_lock(&pair->lock);
+    pair->disconnect_completed = true;
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_publish_complete(
+    struct aws_mqtt_client_connection *connection,
+    uint16_t packet_id,
+    int error_code,
+    void *userdata) {
+    (void)connection;
+    (void)packet_id;
+    struct loopback_publish *publish = userdata;
+    struct loopback_pair *pair = publish->pair;
+
+    publish->latency_ns = benchmark_now_ns() - publish->start_ns;
+
+    aws_mutex_lock(&pair->lock);
+    --pair->publishes_in_flight;
+    if (error_code) {
+        ++pair->publish_errors;
+    }
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_inbound_publish(
+    struct aws_mqtt_client_connection *connection,
+    const struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *userdata) {
+    (void)connection;
+    (void)topic;
+    (void)payload;
+    (void)dup;
+    (void)qos;
+    (void)retain;
+    struct loopback_pair *pair = userdata;
+
+    /* Only wake the main thread once it has something to do */
+    aws_mutex_lock(&pair->lock);
+    const bool notify = ++pair->publishes_received >= pair->publishes_received_target;
+    aws_mutex_unlock(&pair->lock);
+    if (notify) {
+        aws_condition_variable_notify_one(&pair->cvar);
+    }
+}
+
+static void s_on_resubscribe_complete(
+    struct aws_mqtt_client_connection *connection,
+    uint16_t packet_id,
+    const struct aws_array_list *topic_subacks,
+    int error_code,
+    void *userdata) {
+    (void)connection;
+    (void)packet_id;
+    (void)topic_subacks;
+    struct loopback_pair *pair = userdata;
+
+    const uint64_t now = benchmark_now_ns();
+
+    aws_mutex_lock(&pair->lock);
+    pair->resubscribe_completed = true;
+    pair->resubscribed_ns = now;
+    pair->error_code = error_code;
+    aws_mutex_unlock(&pair->lock);
+    aws_condition_variable_notify_one(&pair->cvar);
+}
+
+static void s_on_connection_resumed(
+    struct aws_mqtt_client_connection *connection,
+    enum aws_mqtt_connect_return_code return_code,
+    bool session_present,
+    void *userdata) {
+    (void)session_present;
+    struct loopback_pair *pair = userdata;
+
+    const uint64_t now = benchmark_now_ns();
+
+    aws_mutex_lock(&pair->lock);
+    pair->resumed_ns = now;
+    aws_mutex_unlock(&pair->lock);
+
+    /* The mock server never keeps a session, so every subscription has to be made again */
+    if (return_code != AWS_MQTT_CONNECT_ACCEPTED ||
+        aws_mqtt_resubscribe_existing_topics(connection, s_on_resubscribe_complete, pair) == 0) {
+        aws_mutex_lock(&pair->lock);
+        pair->resubscribe_completed = true;
+        pair->error_code = return_code != AWS_MQTT_CONNECT_ACCEPTED ? AWS_ERROR_MQTT_PROTOCOL_ERROR : aws_last_error();
+        aws_mutex_unlock(&pair->lock);
+        aws_condition_variable_notify_one(&pair->cvar);
+    }
+}
+
+/*******************************************************************************
+ * Waiting
+ ******************************************************************************/
+
+static bool s_is_connect_completed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->connect_completed;
+}
+
+static bool s_is_subscribe_completed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->subscribe_completed;
+}
+
+static bool s_is_disconnect_completed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->disconnect_completed && pair->server_channel == NULL;
+}
+
+static bool s_is_listener_destroyed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->listener_destroyed;
+}
+
+static bool s_has_publish_room(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->publishes_in_flight < pair->benchmark->in_flight;
+}
+
+static bool s_is_publishing_completed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->publishes_in_flight == 0;
+}
+
+static bool s_is_received_target_reached(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->publishes_received >= pair->publishes_received_target;
+}
+
+static bool s_is_resubscribe_completed(void *arg) {
+    struct loopback_pair *pair = arg;
+    return pair->resubscribe_completed;
+}
+
+/* Lock must be held */
+static int s_wait_synced(struct loopback_pair *pair, aws_condition_predicate_fn *predicate) {
+    const int64_t timeout_ns = (int64_t)WAIT_TIMEOUT_SECS * 1000000000;
+    if (aws_condition_variable_wait_for_pred(&pair->cvar, &pair->lock, timeout_ns, predicate, pair)) {
+        fprintf(stderr, "Timed out waiting on connection %zu\n", pair->index);
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Waits for an operation, and returns the error it completed with */
+static int s_wait_for_completion(struct loopback_pair *pair, aws_condition_predicate_fn *predicate) {
+    aws_mutex_lock(&pair->lock);
+    int result = s_wait_synced(pair, predicate);
+    if (result == AWS_OP_SUCCESS && pair->error_code) {
+        fprintf(stderr, "Connection %zu failed: %s\n", pair->index, aws_error_debug_str(pair->error_code));
+        result = AWS_OP_ERR;
+    }
+    aws_mutex_unlock(&pair->lock);
+    return result;
+}
+
+/*******************************************************************************
+ * Setup
+ ******************************************************************************/
+
+static int s_append_topic(struct loopback_pair *pair, struct aws_byte_cursor *topic, const char *suffix) {
+    char buffer[MAX_TOPIC_SIZE];
+    snprintf(buffer, sizeof(buffer), "loopback/%zu/%s", pair->index, suffix);
+
+    struct aws_byte_cursor value = aws_byte_cursor_from_c_str(buffer);
+    topic->ptr = pair->topics.buffer + pair->topics.len;
+    topic->len = value.len;
+    /* The storage is sized up front, so the cursors into it stay valid */
+    if (!aws_byte_buf_write_from_whole_cursor(&pair->topics, value)) {
+        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_pair_init(struct loopback_benchmark *benchmark, struct loopback_pair *pair, size_t index) {
+    struct aws_allocator *allocator = &benchmark->counting_allocator.base;
+
+    pair->benchmark = benchmark;
+    pair->index = index;
+    if (aws_mutex_init(&pair->lock) || aws_condition_variable_init(&pair->cvar)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Topics */
+    if (aws_byte_buf_init(&pair->topics, benchmark->allocator, (benchmark->subscription_count + 2) * MAX_TOPIC_SIZE) ||
+        aws_array_list_init_dynamic(
+            &pair->subscriptions,
+            benchmark->allocator,
+            benchmark->subscription_count + 1,
+            sizeof(struct aws_mqtt_topic_subscription))) {
+        return AWS_OP_ERR;
+    }
+    if (s_append_topic(pair, &pair->publish_topic, "out") || s_append_topic(pair, &pair->inbound_topic, "in")) {
+        return AWS_OP_ERR;
+    }
+    for (size_t i = 0; i <= benchmark->subscription_count; ++i) {
+        struct aws_mqtt_topic_subscription subscription = {
+            .topic = pair->inbound_topic,
+            .qos = AWS_MQTT_QOS_AT_LEAST_ONCE,
+            .on_publish = s_on_inbound_publish,
+            .on_publish_ud = pair,
+        };
+        if (i > 0) {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "filter/%zu", i);
+            if (s_append_topic(pair, &subscription.topic, suffix)) {
+                return AWS_OP_ERR;
+            }
+        }
+        if (aws_array_list_push_back(&pair->subscriptions, &subscription)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    /* Server */
+    pair->mock_server = new_mqtt_mock_server(allocator);
+    if (!pair->mock_server) {
+        return AWS_OP_ERR;
+    }
+    mqtt_mock_server_set_record_packets(pair->mock_server, false);
+    mqtt_mock_server_set_qos_matched_acks(pair->mock_server, true);
+
+    uint64_t timestamp = 0;
+    aws_sys_clock_get_ticks(&timestamp);
+    snprintf(
+        pair->endpoint.address,
+        sizeof(pair->endpoint.address),
+        LOCAL_SOCK_PATTERN,
+        (long long unsigned)timestamp,
+        (long long unsigned)index);
+
+    struct aws_server_socket_channel_bootstrap_options listener_options = {
+        .bootstrap = benchmark->server_bootstrap,
+        .host_name = pair->endpoint.address,
+        .port = pair->endpoint.port,
+        .socket_options = &benchmark->socket_options,
+        .incoming_callback = s_on_incoming_channel_setup,
+        .shutdown_callback = s_on_incoming_channel_shutdown,
+        .destroy_callback = s_on_listener_destroy,
+        .user_data = pair,
+    };
+    pair->listener = aws_server_bootstrap_new_socket_listener(&listener_options);
+    if (!pair->listener) {
+        return AWS_OP_ERR;
+    }
+
+    /* Client */
+    pair->connection = aws_mqtt_client_connection_new(benchmark->mqtt_client);
+    if (!pair->connection) {
+        return AWS_OP_ERR;
+    }
+    /* Reconnect as soon as the connection is lost, so that only the reconnect itself is measured */
+    if (aws_mqtt_client_connection_set_reconnect_timeout(pair->connection, 0, 0) ||
+        aws_mqtt_client_connection_set_connection_interruption_handlers(
+            pair->connection, NULL, NULL, s_on_connection_resumed, pair)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_setup(struct loopback_benchmark *benchmark, size_t pair_count) {
+    struct aws_allocator *allocator = &benchmark->counting_allocator.base;
+
+    benchmark->el_group = aws_event_loop_group_new_default(allocator, (uint16_t)benchmark->thread_count, NULL);
+    if (!benchmark->el_group) {
+        return AWS_OP_ERR;
+    }
+
+    benchmark->server_bootstrap = aws_server_bootstrap_new(allocator, benchmark->el_group);
+    if (!benchmark->server_bootstrap) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_host_resolver_default_options resolver_options = {
+        .el_group = benchmark->el_group,
+        .max_entries = 1,
+    };
+    benchmark->host_resolver = aws_host_resolver_new_default(allocator, &resolver_options);
+    if (!benchmark->host_resolver) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = benchmark->el_group,
+        .host_resolver = benchmark->host_resolver,
+    };
+    benchmark->client_bootstrap = aws_client_bootstrap_new(allocator, &bootstrap_options);
+    if (!benchmark->client_bootstrap) {
+        return AWS_OP_ERR;
+    }
+
+    benchmark->mqtt_client = aws_mqtt_client_new(allocator, benchmark->client_bootstrap);
+    if (!benchmark->mqtt_client) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_socket_options socket_options = {
+        .connect_timeout_ms = 3000,
+        .domain = AWS_SOCKET_LOCAL,
+    };
+    benchmark->socket_options = socket_options;
+
+    benchmark->pairs = aws_mem_calloc(benchmark->allocator, pair_count, sizeof(struct loopback_pair));
+    if (!benchmark->pairs) {
+        return AWS_OP_ERR;
+    }
+    benchmark->pair_count = pair_count;
+
+    for (size_t i = 0; i < pair_count; ++i) {
+        if (s_pair_init(benchmark, &benchmark->pairs[i], i)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_clean_up(struct loopback_benchmark *benchmark) {
+    for (size_t i = 0; i < benchmark->pair_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        if (pair->connection) {
+            aws_mqtt_client_connection_release(pair->connection);
+        }
+    }
+    aws_mqtt_client_release(benchmark->mqtt_client);
+    aws_client_bootstrap_release(benchmark->client_bootstrap);
+    aws_host_resolver_release(benchmark->host_resolver);
+
+    for (size_t i = 0; i < benchmark->pair_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        if (pair->listener) {
+            aws_server_bootstrap_destroy_socket_listener(benchmark->server_bootstrap, pair->listener);
+            aws_mutex_lock(&pair->lock);
+            s_wait_synced(pair, s_is_listener_destroyed);
+            aws_mutex_unlock(&pair->lock);
+        }
+    }
+    aws_server_bootstrap_release(benchmark->server_bootstrap);
+    aws_event_loop_group_release(benchmark->el_group);
+
+    /* The mock servers go last, once nothing can be running in their channels anymore */
+    for (size_t i = 0; i < benchmark->pair_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        if (pair->mock_server) {
+            destroy_mqtt_mock_server(pair->mock_server);
+        }
+        aws_array_list_clean_up(&pair->subscriptions);
+        aws_byte_buf_clean_up(&pair->topics);
+        aws_condition_variable_clean_up(&pair->cvar);
+        aws_mutex_clean_up(&pair->lock);
+    }
+    aws_mem_release(benchmark->allocator, benchmark->pairs);
+}
+
+/*******************************************************************************
+ * Connections
+ ******************************************************************************/
+
+static int s_connect(struct loopback_benchmark *benchmark, size_t connection_count) {
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+
+        char client_id[64];
+        snprintf(client_id, sizeof(client_id), "loopback-benchmark-%zu", i);
+
+        struct aws_mqtt_connection_options connection_options = {
+            .host_name = aws_byte_cursor_from_c_str(pair->endpoint.address),
+            .port = pair->endpoint.port,
+            .socket_options = &benchmark->socket_options,
+            .client_id = aws_byte_cursor_from_c_str(client_id),
+            .on_connection_complete = s_on_connection_complete,
+            .user_data = pair,
+            .clean_session = true,
+        };
+
+        aws_mutex_lock(&pair->lock);
+        pair->connect_completed = false;
+        pair->error_code = AWS_ERROR_SUCCESS;
+        aws_mutex_unlock(&pair->lock);
+
+        if (aws_mqtt_client_connection_connect(pair->connection, &connection_options)) {
+            return AWS_OP_ERR;
+        }
+        pair->is_connected = true;
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        if (s_wait_for_completion(&benchmark->pairs[i], s_is_connect_completed)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+
+        aws_mutex_lock(&pair->lock);
+        pair->subscribe_completed = false;
+        aws_mutex_unlock(&pair->lock);
+
+        if (aws_mqtt_client_connection_subscribe_multiple(
+                pair->connection, &pair->subscriptions, s_on_subscribe_complete, pair) == 0) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        if (s_wait_for_completion(&benchmark->pairs[i], s_is_subscribe_completed)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_disconnect(struct loopback_benchmark *benchmark) {
+    int result = AWS_OP_SUCCESS;
+
+    for (size_t i = 0; i < benchmark->pair_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        if (!pair->is_connected) {
+            continue;
+        }
+
+        aws_mutex_lock(&pair->lock);
+        pair->disconnect_completed = false;
+        aws_mutex_unlock(&pair->lock);
+
+        if (aws_mqtt_client_connection_disconnect(pair->connection, s_on_disconnect_complete, pair)) {
+            result = AWS_OP_ERR;
+            continue;
+        }
+
+        /* The mock server hangs up once it gets the DISCONNECT */
+        aws_mutex_lock(&pair->lock);
+        result |= s_wait_synced(pair, s_is_disconnect_completed);
+        aws_mutex_unlock(&pair->lock);
+        pair->is_connected = false;
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+ * Cases
+ ******************************************************************************/
+
+static void s_report_begin(
+    struct loopback_benchmark *benchmark,
+    const char *name,
+    size_t connection_count,
+    size_t payload_size) {
+
+    benchmark_report_begin(&benchmark->report, s_benchmark_name, name);
+    benchmark_report_add_uint(&benchmark->report, "connections", connection_count);
+    if (payload_size != SIZE_MAX) {
+        benchmark_report_add_uint(&benchmark->report, "payload_size", payload_size);
+    }
+    benchmark_report_add_uint(&benchmark->report, "in_flight", benchmark->in_flight);
+}
+
+/* Sorts the samples and reports their percentiles, in microseconds */
+static void s_report_percentiles(
+    struct loopback_benchmark *benchmark,
+    const char *prefix,
+    uint64_t *samples,
+    size_t sample_count) {
+
+    static const struct {
+        const char *suffix;
+        double percentile;
+    } s_percentiles[] = {
+        {"p50_us", 50.0},
+        {"p90_us", 90.0},
+        {"p99_us", 99.0},
+        {"p999_us", 99.9},
+        {"max_us", 100.0},
+    };
+
+    benchmark_sort(samples, sample_count);
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(s_percentiles); ++i) {
+        char key[64];
+        snprintf(key, sizeof(key), "%s_%s", prefix, s_percentiles[i].suffix);
+        uint64_t value = benchmark_percentile(samples, sample_count, s_percentiles[i].percentile);
+        benchmark_report_add_double(&benchmark->report, key, (double)value / 1e3);
+    }
+}
+
+/* Sends publish_count publishes on each of the first connection_count connections, round robin */
+static int s_publish(
+    struct loopback_benchmark *benchmark,
+    size_t connection_count,
+    size_t publish_count,
+    enum aws_mqtt_qos qos) {
+
+    const size_t total = publish_count * connection_count;
+    AWS_FATAL_ASSERT(total <= benchmark->sample_capacity);
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        pair->server_publishes_base = mqtt_mock_server_publishes_received(pair->mock_server);
+
+        aws_mutex_lock(&pair->lock);
+        pair->publish_errors = 0;
+        aws_mutex_unlock(&pair->lock);
+    }
+
+    for (size_t i = 0; i < total; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i % connection_count];
+
+        aws_mutex_lock(&pair->lock);
+        int result = s_wait_synced(pair, s_has_publish_room);
+        if (result == AWS_OP_SUCCESS) {
+            ++pair->publishes_in_flight;
+        }
+        aws_mutex_unlock(&pair->lock);
+        if (result) {
+            return AWS_OP_ERR;
+        }
+
+        struct loopback_publish *publish = &benchmark->publishes[i];
+        publish->pair = pair;
+        publish->start_ns = benchmark_now_ns();
+        if (aws_mqtt_client_connection_publish(
+                pair->connection,
+                &pair->publish_topic,
+                qos,
+                false,
+                &benchmark->payload,
+                s_on_publish_complete,
+                publish) == 0) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+
+        aws_mutex_lock(&pair->lock);
+        int result = s_wait_synced(pair, s_is_publishing_completed);
+        if (result == AWS_OP_SUCCESS && pair->publish_errors) {
+            fprintf(stderr, "%zu publishes failed on connection %zu\n", pair->publish_errors, pair->index);
+            result = AWS_OP_ERR;
+        }
+        aws_mutex_unlock(&pair->lock);
+        if (result) {
+            return AWS_OP_ERR;
+        }
+
+        /* QoS 0 completes once written, so make sure the server got it all too */
+        mqtt_mock_server_wait_for_publishes(pair->mock_server, pair->server_publishes_base + publish_count);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_run_publish(
+    struct loopback_benchmark *benchmark,
+    const char *name,
+    size_t connection_count,
+    enum aws_mqtt_qos qos) {
+
+    const size_t total = benchmark->publish_count * connection_count;
+
+    benchmark_allocator_reset(&benchmark->counting_allocator);
+    const uint64_t start = benchmark_now_ns();
+
+    if (s_publish(benchmark, connection_count, benchmark->publish_count, qos)) {
+        return AWS_OP_ERR;
+    }
+
+    const uint64_t elapsed_ns = benchmark_now_ns() - start;
+    const size_t allocations = benchmark_allocator_allocations(&benchmark->counting_allocator);
+    const double seconds = (double)elapsed_ns / 1e9;
+
+    for (size_t i = 0; i < total; ++i) {
+        benchmark->samples[i] = benchmark->publishes[i].latency_ns;
+    }
+
+    s_report_begin(benchmark, name, connection_count, benchmark->payload.len);
+    benchmark_report_add_uint(&benchmark->report, "publishes", total);
+    benchmark_report_add_double(&benchmark->report, "publishes_per_second", (double)total / seconds);
+    benchmark_report_add_double(
+        &benchmark->report, "bytes_per_second", (double)total * (double)benchmark->payload.len / seconds);
+    s_report_percentiles(benchmark, "latency", benchmark->samples, total);
+    benchmark_report_add_double(&benchmark->report, "allocations_per_publish", (double)allocations / (double)total);
+    benchmark_report_end(&benchmark->report);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_run_inbound(
+    struct loopback_benchmark *benchmark,
+    const char *name,
+    size_t connection_count,
+    enum aws_mqtt_qos qos) {
+
+    const size_t publish_count = benchmark->publish_count;
+    const size_t total = publish_count * connection_count;
+    const size_t in_flight = benchmark->in_flight;
+    const size_t batch_size = aws_min_size(in_flight, MAX_INBOUND_BATCH_SIZE);
+
+    struct aws_byte_cursor payloads[MAX_INBOUND_BATCH_SIZE];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(payloads); ++i) {
+        payloads[i] = benchmark->payload;
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+        aws_mutex_lock(&pair->lock);
+        pair->publishes_received = 0;
+        pair->publishes_received_target = 0;
+        aws_mutex_unlock(&pair->lock);
+    }
+
+    benchmark_allocator_reset(&benchmark->counting_allocator);
+    const uint64_t start = benchmark_now_ns();
+
+    /* The mock servers send a batch at a time round robin, keeping at most in_flight publishes unread per connection */
+    for (size_t sent = 0; sent < publish_count;) {
+        const size_t count = aws_min_size(batch_size, publish_count - sent);
+
+        for (size_t i = 0; i < connection_count; ++i) {
+            struct loopback_pair *pair = &benchmark->pairs[i];
+
+            aws_mutex_lock(&pair->lock);
+            pair->publishes_received_target = sent + count > in_flight ? sent + count - in_flight : 0;
+            int result = s_wait_synced(pair, s_is_received_target_reached);
+            aws_mutex_unlock(&pair->lock);
+            if (result) {
+                return AWS_OP_ERR;
+            }
+
+            if (mqtt_mock_server_send_publishes(pair->mock_server, &pair->inbound_topic, payloads, count, qos)) {
+                return AWS_OP_ERR;
+            }
+        }
+
+        sent += count;
+    }
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        struct loopback_pair *pair = &benchmark->pairs[i];
+
+        aws_mutex_lock(&pair->lock);
+        pair->publishes_received_target = publish_count;
+        int result = s_wait_synced(pair, s_is_received_target_reached);
+        aws_mutex_unlock(&pair->lock);
+        if (result) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    const uint64_t elapsed_ns = benchmark_now_ns() - start;
+    const size_t allocations = benchmark_allocator_allocations(&benchmark->counting_allocator);
+    const double seconds = (double)elapsed_ns / 1e9;
+
+    s_report_begin(benchmark, name, connection_count, benchmark->payload.len);
+    benchmark_report_add_uint(&benchmark->report, "publishes", total);
+    benchmark_report_add_double(&benchmark->report, "publishes_per_second", (double)total / seconds);
+    benchmark_report_add_double(
+        &benchmark->report, "bytes_per_second", (double)total * (double)benchmark->payload.len / seconds);
+    benchmark_report_add_double(&benchmark->report, "allocations_per_publish", (double)allocations / (double)total);
+    benchmark_report_end(&benchmark->report);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_run_reconnect(struct loopback_benchmark *benchmark, size_t connection_count) {
+
+    const size_t total = benchmark->reconnect_count * connection_count;
+    uint64_t *reconnect_samples = benchmark->samples;
+    uint64_t *resubscribe_samples = aws_mem_calloc(benchmark->allocator, total, sizeof(uint64_t));
+    if (!resubscribe_samples) {
+        return AWS_OP_ERR;
+    }
+    AWS_FATAL_ASSERT(total <= benchmark->sample_capacity);
+
+    int result = AWS_OP_ERR;
+
+    for (size_t round = 0; round < benchmark->reconnect_count; ++round) {
+        for (size_t i = 0; i < connection_count; ++i) {
+            struct loopback_pair *pair = &benchmark->pairs[i];
+
+            aws_mutex_lock(&pair->lock);
+            struct aws_channel *server_channel = pair->server_channel;
+            if (server_channel) {
+                pair->resubscribe_completed = false;
+                pair->error_code = AWS_ERROR_SUCCESS;
+                pair->interrupted_ns = benchmark_now_ns();
+                aws_channel_shutdown(server_channel, AWS_OP_SUCCESS);
+            }
+            aws_mutex_unlock(&pair->lock);
+
+            if (!server_channel) {
+                fprintf(stderr, "Connection %zu has no server channel to hang up\n", pair->index);
+                goto done;
+            }
+        }
+
+        for (size_t i = 0; i < connection_count; ++i) {
+            struct loopback_pair *pair = &benchmark->pairs[i];
+            if (s_wait_for_completion(pair, s_is_resubscribe_completed)) {
+                goto done;
+            }
+
+            aws_mutex_lock(&pair->lock);
+            reconnect_samples[round * connection_count + i] = pair->resumed_ns - pair->interrupted_ns;
+            resubscribe_samples[round * connection_count + i] = pair->resubscribed_ns - pair->resumed_ns;
+            aws_mutex_unlock(&pair->lock);
+        }
+    }
+
+    s_report_begin(benchmark, "reconnect", connection_count, SIZE_MAX);
+    benchmark_report_add_uint(&benchmark->report, "reconnects", total);
+    benchmark_report_add_uint(&benchmark->report, "subscriptions", benchmark->subscription_count + 1);
+    s_report_percentiles(benchmark, "reconnect", reconnect_samples, total);
+    s_report_percentiles(benchmark, "resubscribe", resubscribe_samples, total);
+    benchmark_report_end(&benchmark->report);
+
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_mem_release(benchmark->allocator, resubscribe_samples);
+    return result;
+}
+
+static bool s_is_selected(struct loopback_benchmark *benchmark, const char *name) {
+    return benchmark->filter == NULL || strstr(name, benchmark->filter) != NULL;
+}
+
+static int s_run(struct loopback_benchmark *benchmark, size_t connection_count) {
+
+    static const struct {
+        const char *name;
+        enum aws_mqtt_qos qos;
+        bool inbound;
+    } s_cases[] = {
+        {"publish_qos0", AWS_MQTT_QOS_AT_MOST_ONCE, false},
+        {"publish_qos1", AWS_MQTT_QOS_AT_LEAST_ONCE, false},
+        {"publish_qos2", AWS_MQTT_QOS_EXACTLY_ONCE, false},
+        {"inbound_qos0", AWS_MQTT_QOS_AT_MOST_ONCE, true},
+        {"inbound_qos1", AWS_MQTT_QOS_AT_LEAST_ONCE, true},
+    };
+
+    if (s_connect(benchmark, connection_count)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Warm up */
+    benchmark->payload.len = benchmark->payload_sizes[0];
+    if (s_publish(
+            benchmark,
+            connection_count,
+            aws_min_size(WARM_UP_PUBLISH_COUNT, benchmark->publish_count),
+            AWS_MQTT_QOS_AT_LEAST_ONCE)) {
+        return AWS_OP_ERR;
+    }
+
+    for (size_t i = 0; i < benchmark->payload_size_count; ++i) {
+        benchmark->payload.len = benchmark->payload_sizes[i];
+
+        for (size_t j = 0; j < AWS_ARRAY_SIZE(s_cases); ++j) {
+            if (!s_is_selected(benchmark, s_cases[j].name)) {
+                continue;
+            }
+            int result = s_cases[j].inbound
+                             ? s_run_inbound(benchmark, s_cases[j].name, connection_count, s_cases[j].qos)
+                             : s_run_publish(benchmark, s_cases[j].name, connection_count, s_cases[j].qos);
+            if (result) {
+                return AWS_OP_ERR;
+            }
+        }
+    }
+
+    if (s_is_selected(benchmark, "reconnect") && s_run_reconnect(benchmark, connection_count)) {
+        return AWS_OP_ERR;
+    }
+
+    return s_disconnect(benchmark);
+}
+
+/*******************************************************************************
+ * Main
+ ******************************************************************************/
+
+static void s_usage(int exit_code) {
+
+    fprintf(stderr, "usage: aws-c-mqtt-loopback-benchmark [options]\n");
+    fprintf(stderr, "\n Options:\n\n");
+    fprintf(stderr, "  -c, --connections LIST: comma separated numbers of connections to run with\n");
+    fprintf(stderr, "                          (default %s)\n", s_default_connection_counts);
+    fprintf(stderr, "  -f, --filter STRING: only run the benchmarks whose name contains STRING\n");
+    fprintf(stderr, "  -i, --in-flight INT: most publishes in flight on each connection\n");
+    fprintf(stderr, "  -n, --publishes INT: number of publishes per connection for each benchmark\n");
+    fprintf(stderr, "  -o, --output FILE: write results to FILE instead of stdout\n");
+    fprintf(stderr, "  -p, --payload-sizes LIST: comma separated payload sizes to run with\n");
+    fprintf(stderr, "                            (default %s)\n", s_default_payload_sizes);
+    fprintf(stderr, "  -r, --reconnects INT: number of times every connection is hung up on and reconnects\n");
+    fprintf(stderr, "  -S, --subscriptions INT: number of topic filters to resubscribe to, besides the one\n");
+    fprintf(stderr, "                           publishes are received on\n");
+    fprintf(stderr, "  -t, --threads INT: number of event loop threads, 0 (the default) for one per processor\n");
+    fprintf(stderr, "  -h, --help\n");
+    fprintf(stderr, "            Display this message and quit.\n");
+    exit(exit_code);
+}
+
+static struct aws_cli_option s_long_options[] = {
+    {"connections", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'c'},
+    {"filter", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'f'},
+    {"in-flight", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'i'},
+    {"publishes", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'n'},
+    {"output", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'o'},
+    {"payload-sizes", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'p'},
+    {"reconnects", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'r'},
+    {"subscriptions", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'S'},
+    {"threads", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 't'},
+    {"help", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'h'},
+    /* Per getopt(3) the last element of the array has to be filled with all zeros */
+    {NULL, AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 0},
+};
+
+/* Parses a comma separated list of numbers into values, returns how many there were or 0 if it's malformed */
+static size_t s_parse_list(const char *list, size_t *values) {
+    size_t count = 0;
+    const char *c = list;
+    while (count < MAX_LIST_SIZE) {
+        char *end = NULL;
+        values[count++] = (size_t)strtoull(c, &end, 10);
+        if (end == c) {
+            return 0;
+        }
+        if (*end == '\0') {
+            return count;
+        }
+        if (*end != ',') {
+            return 0;
+        }
+        c = end + 1;
+    }
+    return 0;
+}
+
+static void s_parse_options(int argc, char **argv, struct loopback_benchmark *benchmark, const char **output) {
+    const char *connection_counts = s_default_connection_counts;
+    const char *payload_sizes = s_default_payload_sizes;
+
+    while (true) {
+        int option_index = 0;
+        int c = aws_cli_getopt_long(argc, argv, "c:f:i:n:o:p:r:S:t:h", s_long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 0:
+                /* getopt_long() returns 0 if an option.flag is non-null */
+                break;
+            case 'c':
+                connection_counts = aws_cli_optarg;
+                break;
+            case 'f':
+                benchmark->filter = aws_cli_optarg;
+                break;
+            case 'i':
+                benchmark->in_flight = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'n':
+                benchmark->publish_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'o':
+                *output = aws_cli_optarg;
+                break;
+            case 'p':
+                payload_sizes = aws_cli_optarg;
+                break;
+            case 'r':
+                benchmark->reconnect_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'S':
+                benchmark->subscription_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 't':
+                benchmark->thread_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'h':
+                s_usage(0);
+                break;
+            default:
+                fprintf(stderr, "Unknown option\n");
+                s_usage(1);
+        }
+    }
+
+    benchmark->connection_count_count = s_parse_list(connection_counts, benchmark->connection_counts);
+    benchmark->payload_size_count = s_parse_list(payload_sizes, benchmark->payload_sizes);
+    if (benchmark->connection_count_count == 0 || benchmark->payload_size_count == 0) {
+        fprintf(stderr, "--connections and --payload-sizes must be lists of at most %d numbers\n", MAX_LIST_SIZE);
+        s_usage(1);
+    }
+    for (size_t i = 0; i < benchmark->connection_count_count; ++i) {
+        if (benchmark->connection_counts[i] == 0) {
+            fprintf(stderr, "--connections must be greater than 0\n");
+            s_usage(1);
+        }
+    }
+    if (benchmark->publish_count == 0 || benchmark->in_flight == 0 || benchmark->reconnect_count == 0) {
+        fprintf(stderr, "--publishes, --in-flight and --reconnects must be greater than 0\n");
+        s_usage(1);
+    }
+    /* Every publish in flight needs a packet ID */
+    if (benchmark->in_flight > UINT16_MAX / 2 || benchmark->thread_count > UINT16_MAX) {
+        fprintf(stderr, "--in-flight or --threads is too large\n");
+        s_usage(1);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_mqtt_library_init(allocator);
+
+    struct loopback_benchmark benchmark;
+    AWS_ZERO_STRUCT(benchmark);
+    benchmark.allocator = allocator;
+    benchmark.publish_count = DEFAULT_PUBLISH_COUNT;
+    benchmark.in_flight = DEFAULT_IN_FLIGHT;
+    benchmark.subscription_count = DEFAULT_SUBSCRIPTION_COUNT;
+    benchmark.reconnect_count = DEFAULT_RECONNECT_COUNT;
+    benchmark_allocator_init(&benchmark.counting_allocator, allocator);
+
+    const char *output_filename = NULL;
+    s_parse_options(argc, argv, &benchmark, &output_filename);
+
+    FILE *out = stdout;
+    if (output_filename) {
+        out = fopen(output_filename, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", output_filename);
+            exit(1);
+        }
+    }
+    benchmark_report_init(&benchmark.report, out);
+
+    int result = AWS_OP_ERR;
+
+    size_t max_connection_count = 0;
+    for (size_t i = 0; i < benchmark.connection_count_count; ++i) {
+        max_connection_count = aws_max_size(max_connection_count, benchmark.connection_counts[i]);
+    }
+    size_t max_payload_size = 0;
+    for (size_t i = 0; i < benchmark.payload_size_count; ++i) {
+        max_payload_size = aws_max_size(max_payload_size, benchmark.payload_sizes[i]);
+    }
+
+    benchmark.sample_capacity = aws_max_size(benchmark.publish_count, benchmark.reconnect_count) * max_connection_count;
+    benchmark.publishes = aws_mem_calloc(allocator, benchmark.sample_capacity, sizeof(struct loopback_publish));
+    benchmark.samples = aws_mem_calloc(allocator, benchmark.sample_capacity, sizeof(uint64_t));
+    if (!benchmark.publishes || !benchmark.samples ||
+        aws_byte_buf_init(&benchmark.payload_storage, allocator, max_payload_size)) {
+        goto done;
+    }
+    if (max_payload_size > 0) {
+        memset(benchmark.payload_storage.buffer, 'x', max_payload_size);
+    }
+    benchmark.payload = aws_byte_cursor_from_array(benchmark.payload_storage.buffer, 0);
+
+    if (s_setup(&benchmark, max_connection_count)) {
+        goto clean_up;
+    }
+
+    for (size_t i = 0; i < benchmark.connection_count_count; ++i) {
+        if (s_run(&benchmark, benchmark.connection_counts[i])) {
+            goto clean_up;
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+clean_up:
+    if (result) {
+        fprintf(stderr, "Benchmark failed: %s\n", aws_error_debug_str(aws_last_error()));
+    }
+    s_disconnect(&benchmark);
+    s_clean_up(&benchmark);
+
+done:
+    aws_byte_buf_clean_up(&benchmark.payload_storage);
+    aws_mem_release(allocator, benchmark.samples);
+    aws_mem_release(allocator, benchmark.publishes);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    aws_mqtt_library_clean_up();
+
+    return result == AWS_OP_SUCCESS ? 0 : 1;
+}
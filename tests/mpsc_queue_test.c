@@ -0,0 +1,130 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/mpsc_queue.h>
+
+#include <aws/common/thread.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+struct test_node {
+    struct aws_mqtt_mpsc_queue_node node;
+    size_t producer;
+    size_t sequence;
+};
+
+static int s_mqtt_mpsc_queue_push_pop_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_mqtt_mpsc_queue queue;
+    aws_mqtt_mpsc_queue_init(&queue);
+    ASSERT_TRUE(aws_mqtt_mpsc_queue_is_empty(&queue));
+    ASSERT_NULL(aws_mqtt_mpsc_queue_pop_all(&queue));
+
+    struct test_node nodes[4];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(nodes); ++i) {
+        nodes[i].sequence = i;
+        /* Only the push onto an empty queue reports it */
+        ASSERT_TRUE(aws_mqtt_mpsc_queue_push(&queue, &nodes[i].node) == (i == 0));
+    }
+    ASSERT_FALSE(aws_mqtt_mpsc_queue_is_empty(&queue));
+
+    /* Everything comes out at once, in push order */
+    struct aws_mqtt_mpsc_queue_node *node = aws_mqtt_mpsc_queue_pop_all(&queue);
+    ASSERT_TRUE(aws_mqtt_mpsc_queue_is_empty(&queue));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(nodes); ++i) {
+        ASSERT_PTR_EQUALS(&nodes[i].node, node);
+        node = node->next;
+    }
+    ASSERT_NULL(node);
+
+    /* Empty again, so the next push reports it again */
+    ASSERT_TRUE(aws_mqtt_mpsc_queue_push(&queue, &nodes[0].node));
+    ASSERT_PTR_EQUALS(&nodes[0].node, aws_mqtt_mpsc_queue_pop_all(&queue));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_mpsc_queue_push_pop, s_mqtt_mpsc_queue_push_pop_fn)
+
+#define PRODUCER_COUNT 4
+#define NODES_PER_PRODUCER 10000
+
+struct producer_data {
+    struct aws_mqtt_mpsc_queue *queue;
+    struct test_node *nodes;
+    size_t wakeups;
+};
+
+static void s_producer_fn(void *arg) {
+    struct producer_data *producer = arg;
+    for (size_t i = 0; i < NODES_PER_PRODUCER; ++i) {
+        if (aws_mqtt_mpsc_queue_push(producer->queue, &producer->nodes[i].node)) {
+            ++producer->wakeups;
+        }
+    }
+}
+
+static int s_mqtt_mpsc_queue_multiple_producers_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_mpsc_queue queue;
+    aws_mqtt_mpsc_queue_init(&queue);
+
+    struct test_node *nodes = aws_mem_calloc(allocator, PRODUCER_COUNT * NODES_PER_PRODUCER, sizeof(struct test_node));
+    ASSERT_NOT_NULL(nodes);
+
+    struct aws_thread threads[PRODUCER_COUNT];
+    struct producer_data producers[PRODUCER_COUNT];
+    for (size_t p = 0; p < PRODUCER_COUNT; ++p) {
+        producers[p].queue = &queue;
+        producers[p].nodes = &nodes[p * NODES_PER_PRODUCER];
+        producers[p].wakeups = 0;
+        for (size_t i = 0; i < NODES_PER_PRODUCER; ++i) {
+            producers[p].nodes[i].producer = p;
+            producers[p].nodes[i].sequence = i;
+        }
+        ASSERT_SUCCESS(aws_thread_init(&threads[p], allocator));
+    }
+    for (size_t p = 0; p < PRODUCER_COUNT; ++p) {
+        ASSERT_SUCCESS(aws_thread_launch(&threads[p], s_producer_fn, &producers[p], aws_default_thread_options()));
+    }
+
+    /* Consume while the producers are running, every node must come out exactly once and in order per producer */
+    size_t next_sequence[PRODUCER_COUNT] = {0};
+    size_t consumed = 0;
+    size_t drains = 0;
+    while (consumed < PRODUCER_COUNT * NODES_PER_PRODUCER) {
+        struct aws_mqtt_mpsc_queue_node *node = aws_mqtt_mpsc_queue_pop_all(&queue);
+        if (node) {
+            ++drains;
+        }
+        while (node) {
+            struct test_node *test_node = AWS_CONTAINER_OF(node, struct test_node, node);
+            ASSERT_UINT_EQUALS(next_sequence[test_node->producer], test_node->sequence);
+            ++next_sequence[test_node->producer];
+            ++consumed;
+            node = node->next;
+        }
+    }
+
+    size_t wakeups = 0;
+    for (size_t p = 0; p < PRODUCER_COUNT; ++p) {
+        ASSERT_SUCCESS(aws_thread_join(&threads[p]));
+        aws_thread_clean_up(&threads[p]);
+        wakeups += producers[p].wakeups;
+    }
+
+    /* Exactly one producer saw the queue empty ahead of each drain */
+    ASSERT_UINT_EQUALS(drains, wakeups);
+    ASSERT_TRUE(aws_mqtt_mpsc_queue_is_empty(&queue));
+
+    aws_mem_release(allocator, nodes);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_mpsc_queue_multiple_producers, s_mqtt_mpsc_queue_multiple_producers_fn)
@@ -28,8 +28,13 @@ struct mqtt_mock_server_handler {
 
         size_t ping_resp_avail;
         size_t pubacks_received;
+        size_t pubrecs_received;
+        size_t publishes_received;
         size_t connacks_avail;
+        bool session_present;
         bool auto_ack;
+        bool qos_matched_acks;
+        bool record_packets;
 
         /* last ID used when sending PUBLISH (QoS1+) to client */
         uint16_t last_packet_id;
@@ -63,10 +68,12 @@ static void s_mqtt_decoded_packet_destroy(struct mqtt_decoded_packet *packet) {
 static int s_mqtt_mock_server_handler_process_packet(
     struct mqtt_mock_server_handler *server,
     struct aws_byte_cursor *message_cur) {
-    struct aws_byte_buf received_message;
-    aws_byte_buf_init_copy_from_cursor(&received_message, server->handler.alloc, *message_cur);
     aws_mutex_lock(&server->synced.lock);
-    aws_array_list_push_back(&server->synced.raw_packets, &received_message);
+    if (server->synced.record_packets) {
+        struct aws_byte_buf received_message;
+        aws_byte_buf_init_copy_from_cursor(&received_message, server->handler.alloc, *message_cur);
+        aws_array_list_push_back(&server->synced.raw_packets, &received_message);
+    }
     aws_mutex_unlock(&server->synced.lock);
 
     struct aws_byte_cursor message_cur_cpy = *message_cur;
@@ -82,6 +89,7 @@ static int s_mqtt_mock_server_handler_process_packet(
                 "server, CONNECT received, %llu available connacks.",
                 (long long unsigned)server->synced.connacks_avail);
             connacks_available = server->synced.connacks_avail > 0 ? server->synced.connacks_avail-- : 0;
+            bool session_present = server->synced.session_present;
             aws_mutex_unlock(&server->synced.lock);
 
             if (connacks_available) {
@@ -89,7 +97,7 @@ static int s_mqtt_mock_server_handler_process_packet(
                     aws_channel_acquire_message_from_pool(server->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, 256);
 
                 struct aws_mqtt_packet_connack conn_ack;
-                err |= aws_mqtt_packet_connack_init(&conn_ack, false, AWS_MQTT_CONNECT_ACCEPTED);
+                err |= aws_mqtt_packet_connack_init(&conn_ack, session_present, AWS_MQTT_CONNECT_ACCEPTED);
                 err |= aws_mqtt_packet_connack_encode(&connack_msg->message_data, &conn_ack);
                 if (aws_channel_slot_send_message(server->slot, connack_msg, AWS_CHANNEL_DIR_WRITE)) {
                     err |= 1;
@@ -182,16 +190,47 @@ static int s_mqtt_mock_server_handler_process_packet(
             err |= aws_mqtt_packet_publish_decode(message_cur, &publish_packet);
 
             aws_mutex_lock(&server->synced.lock);
+            server->synced.publishes_received++;
             bool auto_ack = server->synced.auto_ack;
+            bool qos_matched_acks = server->synced.qos_matched_acks;
+            aws_mutex_unlock(&server->synced.lock);
+            err |= aws_condition_variable_notify_one(&server->synced.cvar);
+
+            /* Every PUBLISH gets a PUBACK, unless acks match the QoS: then QoS 0 gets nothing, and QoS 2 gets a PUBREC
+             * and then a PUBCOMP once the client sends PUBREL */
+            enum aws_mqtt_qos qos = aws_mqtt_packet_publish_get_qos(&publish_packet);
+            if (auto_ack && (!qos_matched_acks || qos != AWS_MQTT_QOS_AT_MOST_ONCE)) {
+                struct aws_io_message *ack_msg =
+                    aws_channel_acquire_message_from_pool(server->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, 256);
+                struct aws_mqtt_packet_ack ack;
+                if (qos_matched_acks && qos == AWS_MQTT_QOS_EXACTLY_ONCE) {
+                    err |= aws_mqtt_packet_pubrec_init(&ack, publish_packet.packet_identifier);
+                } else {
+                    err |= aws_mqtt_packet_puback_init(&ack, publish_packet.packet_identifier);
+                }
+                err |= aws_mqtt_packet_ack_encode(&ack_msg->message_data, &ack);
+                err |= aws_channel_slot_send_message(server->slot, ack_msg, AWS_CHANNEL_DIR_WRITE);
+            }
+            break;
+        }
+
+        case AWS_MQTT_PACKET_PUBREL: {
+            AWS_LOGF_DEBUG(MOCK_LOG_SUBJECT, "server, PUBREL received");
+
+            struct aws_mqtt_packet_ack pubrel;
+            err |= aws_mqtt_packet_ack_decode(message_cur, &pubrel);
+
+            aws_mutex_lock(&server->synced.lock);
+            bool auto_ack = server->synced.auto_ack && server->synced.qos_matched_acks;
             aws_mutex_unlock(&server->synced.lock);
 
             if (auto_ack) {
-                struct aws_io_message *puback_msg =
+                struct aws_io_message *pubcomp_msg =
                     aws_channel_acquire_message_from_pool(server->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, 256);
-                struct aws_mqtt_packet_ack puback;
-                err |= aws_mqtt_packet_puback_init(&puback, publish_packet.packet_identifier);
-                err |= aws_mqtt_packet_ack_encode(&puback_msg->message_data, &puback);
-                err |= aws_channel_slot_send_message(server->slot, puback_msg, AWS_CHANNEL_DIR_WRITE);
+                struct aws_mqtt_packet_ack pubcomp;
+                err |= aws_mqtt_packet_pubcomp_init(&pubcomp, pubrel.packet_identifier);
+                err |= aws_mqtt_packet_ack_encode(&pubcomp_msg->message_data, &pubcomp);
+                err |= aws_channel_slot_send_message(server->slot, pubcomp_msg, AWS_CHANNEL_DIR_WRITE);
             }
             break;
         }
@@ -205,6 +244,15 @@ static int s_mqtt_mock_server_handler_process_packet(
             err |= aws_condition_variable_notify_one(&server->synced.cvar);
             break;
 
+        case AWS_MQTT_PACKET_PUBREC:
+            AWS_LOGF_DEBUG(MOCK_LOG_SUBJECT, "server, PUBREC received");
+
+            aws_mutex_lock(&server->synced.lock);
+            server->synced.pubrecs_received++;
+            aws_mutex_unlock(&server->synced.lock);
+            err |= aws_condition_variable_notify_one(&server->synced.cvar);
+            break;
+
         default:
             break;
     }
@@ -225,53 +273,40 @@ static int s_mqtt_mock_server_handler_process_read_message(
 
     struct aws_byte_cursor message_cursor = aws_byte_cursor_from_buf(&message->message_data);
 
-    if (server->pending_packet.len) {
-        size_t to_read = server->pending_packet.capacity - server->pending_packet.len;
-
-        bool packet_complete = true;
-        if (to_read > message_cursor.len) {
-            to_read = message_cursor.len;
-            packet_complete = false;
-        }
-
-        struct aws_byte_cursor chunk = aws_byte_cursor_advance(&message_cursor, to_read);
-        aws_byte_buf_write_from_whole_cursor(&server->pending_packet, chunk);
-
-        if (!packet_complete) {
-            goto cleanup;
-        }
-
-        struct aws_byte_cursor packet_data = aws_byte_cursor_from_buf(&server->pending_packet);
-        s_mqtt_mock_server_handler_process_packet(server, &packet_data);
+    /* Packets split across messages, even within the fixed header, are put back together in pending_packet */
+    const bool had_pending_packet = server->pending_packet.len > 0;
+    if (had_pending_packet) {
+        AWS_FATAL_ASSERT(0 == aws_byte_buf_append_dynamic(&server->pending_packet, &message_cursor));
+        message_cursor = aws_byte_cursor_from_buf(&server->pending_packet);
     }
 
     while (message_cursor.len) {
         struct aws_byte_cursor header_decode = message_cursor;
         struct aws_mqtt_fixed_header packet_header;
         AWS_ZERO_STRUCT(packet_header);
-        int result = aws_mqtt_fixed_header_decode(&header_decode, &packet_header);
+        if (aws_mqtt_fixed_header_decode(&header_decode, &packet_header)) {
+            AWS_FATAL_ASSERT(aws_last_error() == AWS_ERROR_SHORT_BUFFER && "mock received malformed packet");
+            aws_reset_error();
+            break;
+        }
 
         const size_t fixed_header_size = message_cursor.len - header_decode.len;
-
-        if (result) {
-            if (aws_last_error() == AWS_ERROR_SHORT_BUFFER) {
-                AWS_FATAL_ASSERT(
-                    packet_header.remaining_length > 0 &&
-                    "need to handle getting partial packet, but not enough to know total length");
-                aws_byte_buf_init(
-                    &server->pending_packet, server->handler.alloc, fixed_header_size + packet_header.remaining_length);
-                aws_byte_buf_write_from_whole_cursor(&server->pending_packet, message_cursor);
-                aws_reset_error();
-                goto cleanup;
-            }
-        }
         struct aws_byte_cursor packet_data =
             aws_byte_cursor_advance(&message_cursor, fixed_header_size + packet_header.remaining_length);
         s_mqtt_mock_server_handler_process_packet(server, &packet_data);
     }
-cleanup:
+
+    /* Keep what's there of the next packet until the rest arrives */
+    if (had_pending_packet) {
+        memmove(server->pending_packet.buffer, message_cursor.ptr, message_cursor.len);
+        server->pending_packet.len = message_cursor.len;
+    } else if (message_cursor.len) {
+        AWS_FATAL_ASSERT(0 == aws_byte_buf_append_dynamic(&server->pending_packet, &message_cursor));
+    }
+
+    const size_t message_len = message->message_data.len;
     aws_mem_release(message->allocator, message);
-    aws_channel_slot_increment_read_window(slot, message->message_data.len);
+    aws_channel_slot_increment_read_window(slot, message_len);
     return AWS_OP_SUCCESS;
 }
 
@@ -286,16 +321,30 @@ static void s_mqtt_send_in_thread(struct aws_channel_task *channel_task, void *a
     struct mqtt_mock_server_send_args *send_args = arg;
 
     if (status == AWS_TASK_STATUS_RUN_READY) {
-        struct aws_io_message *msg = aws_channel_acquire_message_from_pool(
-            send_args->server->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, send_args->data.len);
-        AWS_FATAL_ASSERT(aws_byte_buf_write_from_whole_buffer(&msg->message_data, send_args->data));
-        AWS_FATAL_ASSERT(0 == aws_channel_slot_send_message(send_args->server->slot, msg, AWS_CHANNEL_DIR_WRITE));
+        /* Messages from the pool are capped in size, so more than that goes out in several of them */
+        struct aws_byte_cursor remaining = aws_byte_cursor_from_buf(&send_args->data);
+        while (remaining.len) {
+            struct aws_io_message *msg = aws_channel_acquire_message_from_pool(
+                send_args->server->slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, remaining.len);
+            size_t len = remaining.len < msg->message_data.capacity ? remaining.len : msg->message_data.capacity;
+            struct aws_byte_cursor chunk = aws_byte_cursor_advance(&remaining, len);
+            AWS_FATAL_ASSERT(aws_byte_buf_write_from_whole_cursor(&msg->message_data, chunk));
+            AWS_FATAL_ASSERT(0 == aws_channel_slot_send_message(send_args->server->slot, msg, AWS_CHANNEL_DIR_WRITE));
+        }
     }
 
     aws_byte_buf_clean_up(&send_args->data);
     aws_mem_release(send_args->server->handler.alloc, send_args);
 }
 
+/* Lock must be held. 0 is not a valid packet ID, so it's skipped when the IDs wrap around */
+static uint16_t s_next_packet_id_synced(struct mqtt_mock_server_handler *server) {
+    if (++server->synced.last_packet_id == 0) {
+        ++server->synced.last_packet_id;
+    }
+    return server->synced.last_packet_id;
+}
+
 static struct mqtt_mock_server_send_args *s_mqtt_send_args_create(struct mqtt_mock_server_handler *server) {
     struct mqtt_mock_server_send_args *args =
         aws_mem_calloc(server->handler.alloc, 1, sizeof(struct mqtt_mock_server_send_args));
@@ -315,14 +364,28 @@ int mqtt_mock_server_send_publish(
 
     struct mqtt_mock_server_handler *server = handler->impl;
 
-    struct mqtt_mock_server_send_args *args = s_mqtt_send_args_create(server);
-
     aws_mutex_lock(&server->synced.lock);
-    uint16_t id = qos == 0 ? 0 : ++server->synced.last_packet_id;
+    uint16_t id = qos == 0 ? 0 : s_next_packet_id_synced(server);
     aws_mutex_unlock(&server->synced.lock);
 
+    return mqtt_mock_server_send_publish_by_id(handler, id, topic, payload, dup, qos, retain);
+}
+
+int mqtt_mock_server_send_publish_by_id(
+    struct aws_channel_handler *handler,
+    uint16_t packet_id,
+    struct aws_byte_cursor *topic,
+    struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain) {
+
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    struct mqtt_mock_server_send_args *args = s_mqtt_send_args_create(server);
+
     struct aws_mqtt_packet_publish publish;
-    ASSERT_SUCCESS(aws_mqtt_packet_publish_init(&publish, retain, qos, dup, *topic, id, *payload));
+    ASSERT_SUCCESS(aws_mqtt_packet_publish_init(&publish, retain, qos, dup, *topic, packet_id, *payload));
     ASSERT_SUCCESS(aws_mqtt_packet_publish_encode(&args->data, &publish));
 
     aws_channel_schedule_task_now(server->slot->channel, &args->task);
@@ -330,6 +393,68 @@ int mqtt_mock_server_send_publish(
     return AWS_OP_SUCCESS;
 }
 
+int mqtt_mock_server_send_publishes(
+    struct aws_channel_handler *handler,
+    struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payloads,
+    size_t payload_count,
+    enum aws_mqtt_qos qos) {
+
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    struct mqtt_mock_server_send_args *args = s_mqtt_send_args_create(server);
+
+    for (size_t i = 0; i < payload_count; ++i) {
+        aws_mutex_lock(&server->synced.lock);
+        uint16_t id = qos == 0 ? 0 : s_next_packet_id_synced(server);
+        aws_mutex_unlock(&server->synced.lock);
+
+        struct aws_mqtt_packet_publish publish;
+        ASSERT_SUCCESS(aws_mqtt_packet_publish_init(&publish, false, qos, false, *topic, id, payloads[i]));
+        ASSERT_SUCCESS(aws_byte_buf_reserve(&args->data, args->data.len + topic->len + payloads[i].len + 16));
+        ASSERT_SUCCESS(aws_mqtt_packet_publish_encode(&args->data, &publish));
+    }
+
+    aws_channel_schedule_task_now(server->slot->channel, &args->task);
+
+    return AWS_OP_SUCCESS;
+}
+
+int mqtt_mock_server_send_publish_split(
+    struct aws_channel_handler *handler,
+    struct aws_byte_cursor *topic,
+    struct aws_byte_cursor *payload,
+    enum aws_mqtt_qos qos,
+    size_t fragment_size) {
+
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    aws_mutex_lock(&server->synced.lock);
+    uint16_t id = qos == 0 ? 0 : s_next_packet_id_synced(server);
+    aws_mutex_unlock(&server->synced.lock);
+
+    struct aws_mqtt_packet_publish publish;
+    ASSERT_SUCCESS(aws_mqtt_packet_publish_init(&publish, false, qos, false, *topic, id, *payload));
+
+    struct aws_byte_buf encoded;
+    ASSERT_SUCCESS(aws_byte_buf_init(&encoded, server->handler.alloc, topic->len + payload->len + 16));
+    ASSERT_SUCCESS(aws_mqtt_packet_publish_encode(&encoded, &publish));
+
+    /* Tasks scheduled now run in order, so the client reads the fragments in order, each in its own message */
+    struct aws_byte_cursor remaining = aws_byte_cursor_from_buf(&encoded);
+    while (remaining.len) {
+        size_t len = remaining.len < fragment_size ? remaining.len : fragment_size;
+        struct mqtt_mock_server_send_args *args = s_mqtt_send_args_create(server);
+        struct aws_byte_cursor fragment = aws_byte_cursor_advance(&remaining, len);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&args->data, &fragment));
+        aws_channel_schedule_task_now(server->slot->channel, &args->task);
+    }
+
+    aws_byte_buf_clean_up(&encoded);
+
+    return AWS_OP_SUCCESS;
+}
+
 int mqtt_mock_server_send_single_suback(
     struct aws_channel_handler *handler,
     uint16_t packet_id,
@@ -373,6 +498,8 @@ static int s_mqtt_mock_server_handler_increment_read_window(
 void mqtt_mock_server_handler_update_slot(struct aws_channel_handler *handler, struct aws_channel_slot *slot) {
     struct mqtt_mock_server_handler *server = handler->impl;
     server->slot = slot;
+    /* A new channel starts on a packet boundary, whatever was left of the last one is dropped */
+    server->pending_packet.len = 0;
 }
 
 static int s_mqtt_mock_server_handler_shutdown(
@@ -414,6 +541,7 @@ struct aws_channel_handler *new_mqtt_mock_server(struct aws_allocator *allocator
     struct mqtt_mock_server_handler *server = aws_mem_calloc(allocator, 1, sizeof(struct mqtt_mock_server_handler));
     aws_array_list_init_dynamic(&server->decoded_packets, allocator, 4, sizeof(struct mqtt_decoded_packet *));
     aws_array_list_init_dynamic(&server->synced.raw_packets, allocator, 4, sizeof(struct aws_byte_buf));
+    aws_byte_buf_init(&server->pending_packet, allocator, 0);
 
     server->handler.impl = server;
     server->handler.vtable = &s_mqtt_mock_server_handler_vtable;
@@ -421,6 +549,7 @@ struct aws_channel_handler *new_mqtt_mock_server(struct aws_allocator *allocator
     server->synced.ping_resp_avail = SIZE_MAX;
     server->synced.connacks_avail = SIZE_MAX;
     server->synced.auto_ack = true;
+    server->synced.record_packets = true;
     aws_mutex_init(&server->synced.lock);
     aws_condition_variable_init(&server->synced.cvar);
 
@@ -443,6 +572,7 @@ void destroy_mqtt_mock_server(struct aws_channel_handler *handler) {
         aws_byte_buf_clean_up(byte_buf_ptr);
     }
     aws_array_list_clean_up(&server->synced.raw_packets);
+    aws_byte_buf_clean_up(&server->pending_packet);
 
     aws_mutex_clean_up(&server->synced.lock);
     aws_condition_variable_clean_up(&server->synced.cvar);
@@ -465,6 +595,30 @@ void mqtt_mock_server_set_max_connack(struct aws_channel_handler *handler, size_
     aws_mutex_unlock(&server->synced.lock);
 }
 
+void mqtt_mock_server_set_session_present(struct aws_channel_handler *handler, bool session_present) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    aws_mutex_lock(&server->synced.lock);
+    server->synced.session_present = session_present;
+    aws_mutex_unlock(&server->synced.lock);
+}
+
+void mqtt_mock_server_set_record_packets(struct aws_channel_handler *handler, bool record_packets) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    aws_mutex_lock(&server->synced.lock);
+    server->synced.record_packets = record_packets;
+    aws_mutex_unlock(&server->synced.lock);
+}
+
+void mqtt_mock_server_set_qos_matched_acks(struct aws_channel_handler *handler, bool qos_matched_acks) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    aws_mutex_lock(&server->synced.lock);
+    server->synced.qos_matched_acks = qos_matched_acks;
+    aws_mutex_unlock(&server->synced.lock);
+}
+
 void mqtt_mock_server_disable_auto_ack(struct aws_channel_handler *handler) {
     struct mqtt_mock_server_handler *server = handler->impl;
 
@@ -512,6 +666,9 @@ static int s_send_ack(struct aws_channel_handler *handler, uint16_t packet_id, e
         case AWS_MQTT_PACKET_UNSUBACK:
             ASSERT_SUCCESS(aws_mqtt_packet_unsuback_init(&args->ack, packet_id));
             break;
+        case AWS_MQTT_PACKET_PUBREL:
+            ASSERT_SUCCESS(aws_mqtt_packet_pubrel_init(&args->ack, packet_id));
+            break;
         default:
             AWS_FATAL_ASSERT(0);
             break;
@@ -527,6 +684,9 @@ int mqtt_mock_server_send_unsuback(struct aws_channel_handler *handler, uint16_t
 int mqtt_mock_server_send_puback(struct aws_channel_handler *handler, uint16_t packet_id) {
     return s_send_ack(handler, packet_id, AWS_MQTT_PACKET_PUBACK);
 }
+int mqtt_mock_server_send_pubrel(struct aws_channel_handler *handler, uint16_t packet_id) {
+    return s_send_ack(handler, packet_id, AWS_MQTT_PACKET_PUBREL);
+}
 
 struct puback_waiter {
     struct mqtt_mock_server_handler *server;
@@ -553,6 +713,60 @@ void mqtt_mock_server_wait_for_pubacks(struct aws_channel_handler *handler, size
     aws_mutex_unlock(&server->synced.lock);
 }
 
+static bool s_is_pubrecs_complete(void *arg) {
+    struct puback_waiter *waiter = arg;
+
+    return waiter->server->synced.pubrecs_received >= waiter->wait_for_count;
+}
+
+void mqtt_mock_server_wait_for_pubrecs(struct aws_channel_handler *handler, size_t pubrec_count) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    struct puback_waiter waiter;
+    waiter.server = server;
+    waiter.wait_for_count = pubrec_count;
+
+    aws_mutex_lock(&server->synced.lock);
+    AWS_FATAL_ASSERT(
+        0 == aws_condition_variable_wait_for_pred(
+                 &server->synced.cvar, &server->synced.lock, CVAR_TIMEOUT, s_is_pubrecs_complete, &waiter));
+    aws_mutex_unlock(&server->synced.lock);
+}
+
+struct publish_waiter {
+    struct mqtt_mock_server_handler *server;
+    size_t wait_for_count;
+};
+
+static bool s_is_publishes_complete(void *arg) {
+    struct publish_waiter *waiter = arg;
+
+    return waiter->server->synced.publishes_received >= waiter->wait_for_count;
+}
+
+void mqtt_mock_server_wait_for_publishes(struct aws_channel_handler *handler, size_t publish_count) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    struct publish_waiter waiter;
+    waiter.server = server;
+    waiter.wait_for_count = publish_count;
+
+    aws_mutex_lock(&server->synced.lock);
+    AWS_FATAL_ASSERT(
+        0 == aws_condition_variable_wait_for_pred(
+                 &server->synced.cvar, &server->synced.lock, CVAR_TIMEOUT, s_is_publishes_complete, &waiter));
+    aws_mutex_unlock(&server->synced.lock);
+}
+
+size_t mqtt_mock_server_publishes_received(struct aws_channel_handler *handler) {
+    struct mqtt_mock_server_handler *server = handler->impl;
+
+    aws_mutex_lock(&server->synced.lock);
+    size_t publishes_received = server->synced.publishes_received;
+    aws_mutex_unlock(&server->synced.lock);
+    return publishes_received;
+}
+
 size_t mqtt_mock_server_decoded_packets_count(struct aws_channel_handler *handler) {
     struct mqtt_mock_server_handler *server = handler->impl;
     size_t count = aws_array_list_length(&server->decoded_packets);
@@ -705,7 +919,9 @@ int mqtt_mock_server_decode_packets(struct aws_channel_handler *handler) {
                 packet->publish_payload = publish_packet.payload;
                 break;
             }
-            case AWS_MQTT_PACKET_PUBACK: {
+            case AWS_MQTT_PACKET_PUBACK:
+            case AWS_MQTT_PACKET_PUBREC:
+            case AWS_MQTT_PACKET_PUBCOMP: {
                 struct aws_mqtt_packet_ack puback;
                 ASSERT_SUCCESS(aws_mqtt_packet_ack_decode(&message_cur, &puback));
                 packet->packet_identifier = puback.packet_identifier;
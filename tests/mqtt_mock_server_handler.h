@@ -54,6 +54,35 @@ int mqtt_mock_server_send_publish(
     bool dup,
     enum aws_mqtt_qos qos,
     bool retain);
+/**
+ * Mock server sends a publish packet back to client with the given packet ID, to resend an earlier one
+ */
+int mqtt_mock_server_send_publish_by_id(
+    struct aws_channel_handler *handler,
+    uint16_t packet_id,
+    struct aws_byte_cursor *topic,
+    struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain);
+/**
+ * Mock server sends a publish packet back to client for each of payloads, all in one message
+ */
+int mqtt_mock_server_send_publishes(
+    struct aws_channel_handler *handler,
+    struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payloads,
+    size_t payload_count,
+    enum aws_mqtt_qos qos);
+/**
+ * Mock server sends a publish packet back to client, split into messages of at most fragment_size bytes
+ */
+int mqtt_mock_server_send_publish_split(
+    struct aws_channel_handler *handler,
+    struct aws_byte_cursor *topic,
+    struct aws_byte_cursor *payload,
+    enum aws_mqtt_qos qos,
+    size_t fragment_size);
 /**
  * Set max number of PINGRESP that mock server will send back to client
  */
@@ -62,6 +91,22 @@ void mqtt_mock_server_set_max_ping_resp(struct aws_channel_handler *handler, siz
  * Set max number of CONACK that mock server will send back to client
  */
 void mqtt_mock_server_set_max_connack(struct aws_channel_handler *handler, size_t connack_avail);
+/**
+ * Set whether the CONNACK the mock server sends back tells the client the session is present, false by default
+ */
+void mqtt_mock_server_set_session_present(struct aws_channel_handler *handler, bool session_present);
+
+/**
+ * Set whether the mock server keeps a copy of every packet it receives for mqtt_mock_server_decode_packets(), true by
+ * default. Turn it off for long runs where only the counts matter.
+ */
+void mqtt_mock_server_set_record_packets(struct aws_channel_handler *handler, bool record_packets);
+
+/**
+ * Set whether the mock server acks PUBLISH packets the way their QoS calls for, false by default: every PUBLISH gets a
+ * PUBACK. When true, QoS 0 gets no ack, QoS 1 a PUBACK, and QoS 2 a PUBREC and then a PUBCOMP for the PUBREL.
+ */
+void mqtt_mock_server_set_qos_matched_acks(struct aws_channel_handler *handler, bool qos_matched_acks);
 
 /**
  * Disable the automatically response (suback/unsuback/puback) to the client
@@ -76,6 +121,7 @@ void mqtt_mock_server_enable_auto_ack(struct aws_channel_handler *handler);
  */
 int mqtt_mock_server_send_unsuback(struct aws_channel_handler *handler, uint16_t packet_id);
 int mqtt_mock_server_send_puback(struct aws_channel_handler *handler, uint16_t packet_id);
+int mqtt_mock_server_send_pubrel(struct aws_channel_handler *handler, uint16_t packet_id);
 
 int mqtt_mock_server_send_single_suback(
     struct aws_channel_handler *handler,
@@ -85,6 +131,18 @@ int mqtt_mock_server_send_single_suback(
  * Wait for puback_count PUBACK packages from client
  */
 void mqtt_mock_server_wait_for_pubacks(struct aws_channel_handler *handler, size_t puback_count);
+/**
+ * Wait for pubrec_count PUBREC packages from client
+ */
+void mqtt_mock_server_wait_for_pubrecs(struct aws_channel_handler *handler, size_t pubrec_count);
+/**
+ * Wait until publish_count PUBLISH packets in total have been received from client
+ */
+void mqtt_mock_server_wait_for_publishes(struct aws_channel_handler *handler, size_t publish_count);
+/**
+ * Number of PUBLISH packets received from client so far
+ */
+size_t mqtt_mock_server_publishes_received(struct aws_channel_handler *handler);
 
 /**
  * Getters for decoded packets, call mqtt_mock_server_decode_packets first.
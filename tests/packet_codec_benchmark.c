@@ -0,0 +1,714 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "benchmark_helpers.h"
+
+#include <aws/mqtt/mqtt.h>
+#include <aws/mqtt/private/fixed_header.h>
+#include <aws/mqtt/private/packets.h>
+
+#include <aws/common/command_line_parser.h>
+#include <aws/common/math.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4996) /* Disable warnings about fopen() being insecure */
+#endif
+
+/*
+ * Benchmarks encoding and decoding of each packet type over a few realistic size distributions.
+ *
+ * Encoding covers building the packet from its fields and encoding it, as the client does when sending. Decoding
+ * covers initializing, decoding and cleaning up the packet, as the client does when receiving. Every packet is
+ * encoded to or decoded from memory that's already allocated, so any allocation counted is the codec's own.
+ *
+ * Results are printed to stdout one JSON object per line.
+ */
+
+enum {
+    CORPUS_SIZE = 256,
+    ENCODE_BUFFER_SIZE = 512 * 1024,
+    DEFAULT_PACKET_COUNT = 100000,
+    DEFAULT_SEED = 1,
+};
+
+static const char *s_benchmark_name = "packet_codec";
+
+struct size_range {
+    size_t min;
+    size_t max;
+};
+
+struct payload_band {
+    /* Percent of the packets that fall in this band, bands of a distribution add up to 100 */
+    uint32_t percent;
+    struct size_range size;
+};
+
+struct size_distribution {
+    const char *name;
+    struct size_range topic_size;
+    struct size_range filter_count;
+    struct payload_band payload_bands[3];
+};
+
+static const struct size_distribution s_distributions[] = {
+    /* Sensors reporting a few readings each */
+    {
+        .name = "telemetry",
+        .topic_size = {16, 64},
+        .filter_count = {1, 2},
+        .payload_bands = {{100, {8, 256}}},
+    },
+    /* Mostly small messages, with the occasional document or firmware chunk */
+    {
+        .name = "mixed",
+        .topic_size = {8, 128},
+        .filter_count = {1, 8},
+        .payload_bands = {{90, {0, 512}}, {9, {1024, 16384}}, {1, {65536, 262144}}},
+    },
+    /* Large transfers, and subscriptions to many topics at once */
+    {
+        .name = "bulk",
+        .topic_size = {32, 256},
+        .filter_count = {8, 32},
+        .payload_bands = {{100, {16384, 262144}}},
+    },
+};
+
+static const size_t s_max_payload_size = 262144;
+
+struct corpus_entry {
+    struct aws_byte_cursor topic;
+    struct aws_byte_cursor payload;
+    size_t index;
+    size_t filter_count;
+};
+
+struct codec_benchmark {
+    /* Allocator for the benchmark itself, whose allocations aren't counted */
+    struct aws_allocator *allocator;
+    /* Allocator given to the codec */
+    struct benchmark_allocator codec_allocator;
+
+    struct benchmark_report report;
+    struct benchmark_random random;
+    size_t packet_count;
+    const char *filter;
+
+    struct corpus_entry corpus[CORPUS_SIZE];
+    struct aws_byte_buf topics;
+    struct aws_byte_buf payload;
+    struct aws_byte_buf encode_buffer;
+    struct aws_byte_buf stream;
+};
+
+/*******************************************************************************
+ * Corpus
+ ******************************************************************************/
+
+static size_t s_draw_payload_size(struct codec_benchmark *benchmark, const struct size_distribution *distribution) {
+
+    uint32_t roll = (uint32_t)benchmark_random_range(&benchmark->random, 0, 99);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(distribution->payload_bands); ++i) {
+        const struct payload_band *band = &distribution->payload_bands[i];
+        if (roll < band->percent) {
+            return benchmark_random_range(&benchmark->random, band->size.min, band->size.max);
+        }
+        roll -= band->percent;
+    }
+
+    AWS_FATAL_ASSERT(false && "payload bands must add up to 100 percent");
+    return 0;
+}
+
+/* Topics are levels of random letters, the same shape as the ones the client sends */
+static void s_generate_topic(struct benchmark_random *random, uint8_t *topic, size_t size) {
+    benchmark_random_fill_letters(random, topic, size);
+    for (size_t i = 1; i + 1 < size; ++i) {
+        if (benchmark_random_range(random, 0, 7) == 0) {
+            topic[i] = '/';
+            ++i;
+        }
+    }
+}
+
+static void s_generate_corpus(struct codec_benchmark *benchmark, const struct size_distribution *distribution) {
+
+    benchmark->topics.len = 0;
+    for (size_t i = 0; i < CORPUS_SIZE; ++i) {
+        struct corpus_entry *entry = &benchmark->corpus[i];
+        entry->index = i;
+
+        size_t topic_size = benchmark_random_range(
+            &benchmark->random, distribution->topic_size.min, distribution->topic_size.max);
+        AWS_FATAL_ASSERT(benchmark->topics.len + topic_size <= benchmark->topics.capacity);
+        uint8_t *topic = benchmark->topics.buffer + benchmark->topics.len;
+        s_generate_topic(&benchmark->random, topic, topic_size);
+        benchmark->topics.len += topic_size;
+        entry->topic = aws_byte_cursor_from_array(topic, topic_size);
+
+        /* Every payload is a prefix of the same random bytes */
+        entry->payload = aws_byte_cursor_from_array(
+            benchmark->payload.buffer, s_draw_payload_size(benchmark, distribution));
+
+        entry->filter_count = benchmark_random_range(
+            &benchmark->random, distribution->filter_count.min, distribution->filter_count.max);
+    }
+}
+
+static uint16_t s_packet_identifier(const struct corpus_entry *entry) {
+    return (uint16_t)(entry->index + 1);
+}
+
+/* The filters of an entry are its own topic and those of the entries after it */
+static struct aws_byte_cursor s_filter(struct codec_benchmark *benchmark, const struct corpus_entry *entry, size_t i) {
+    return benchmark->corpus[(entry->index + i) % CORPUS_SIZE].topic;
+}
+
+/*******************************************************************************
+ * Cases
+ ******************************************************************************/
+
+typedef int(
+    codec_encode_fn)(struct codec_benchmark *benchmark, const struct corpus_entry *entry, struct aws_byte_buf *buf);
+typedef int(codec_decode_fn)(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur);
+
+static int s_encode_publish(const struct corpus_entry *entry, enum aws_mqtt_qos qos, struct aws_byte_buf *buf) {
+    struct aws_mqtt_packet_publish publish;
+    if (aws_mqtt_packet_publish_init(
+            &publish,
+            false /*retain*/,
+            qos,
+            false /*dup*/,
+            entry->topic,
+            qos == AWS_MQTT_QOS_AT_MOST_ONCE ? 0 : s_packet_identifier(entry),
+            entry->payload)) {
+        return AWS_OP_ERR;
+    }
+    return aws_mqtt_packet_publish_encode(buf, &publish);
+}
+
+static int s_encode_publish_qos0(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+    return s_encode_publish(entry, AWS_MQTT_QOS_AT_MOST_ONCE, buf);
+}
+
+static int s_encode_publish_qos1(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+    return s_encode_publish(entry, AWS_MQTT_QOS_AT_LEAST_ONCE, buf);
+}
+
+static int s_decode_publish(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_packet_publish publish;
+    return aws_mqtt_packet_publish_decode(cur, &publish);
+}
+
+static int s_decode_fixed_header(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_fixed_header header;
+    if (aws_mqtt_fixed_header_decode(cur, &header)) {
+        return AWS_OP_ERR;
+    }
+    aws_byte_cursor_advance(cur, header.remaining_length);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encode_puback(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+    struct aws_mqtt_packet_ack puback;
+    if (aws_mqtt_packet_puback_init(&puback, s_packet_identifier(entry))) {
+        return AWS_OP_ERR;
+    }
+    return aws_mqtt_packet_ack_encode(buf, &puback);
+}
+
+static int s_decode_ack(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_packet_ack ack;
+    return aws_mqtt_packet_ack_decode(cur, &ack);
+}
+
+static int s_encode_subscribe(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+
+    struct aws_mqtt_packet_subscribe subscribe;
+    if (aws_mqtt_packet_subscribe_init(&subscribe, &benchmark->codec_allocator.base, s_packet_identifier(entry))) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < entry->filter_count; ++i) {
+        if (aws_mqtt_packet_subscribe_add_topic(
+                &subscribe, s_filter(benchmark, entry, i), (enum aws_mqtt_qos)(i % 3))) {
+            goto done;
+        }
+    }
+    result = aws_mqtt_packet_subscribe_encode(buf, &subscribe);
+
+done:
+    aws_mqtt_packet_subscribe_clean_up(&subscribe);
+    return result;
+}
+
+static int s_decode_subscribe(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    struct aws_mqtt_packet_subscribe subscribe;
+    if (aws_mqtt_packet_subscribe_init(&subscribe, &benchmark->codec_allocator.base, 0)) {
+        return AWS_OP_ERR;
+    }
+    int result = aws_mqtt_packet_subscribe_decode(cur, &subscribe);
+    aws_mqtt_packet_subscribe_clean_up(&subscribe);
+    return result;
+}
+
+static int s_encode_suback(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+
+    struct aws_mqtt_packet_suback suback;
+    if (aws_mqtt_packet_suback_init(&suback, &benchmark->codec_allocator.base, s_packet_identifier(entry))) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < entry->filter_count; ++i) {
+        if (aws_mqtt_packet_suback_add_return_code(&suback, (uint8_t)(i % 3))) {
+            goto done;
+        }
+    }
+    result = aws_mqtt_packet_suback_encode(buf, &suback);
+
+done:
+    aws_mqtt_packet_suback_clean_up(&suback);
+    return result;
+}
+
+static int s_decode_suback(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    struct aws_mqtt_packet_suback suback;
+    if (aws_mqtt_packet_suback_init(&suback, &benchmark->codec_allocator.base, 0)) {
+        return AWS_OP_ERR;
+    }
+    int result = aws_mqtt_packet_suback_decode(cur, &suback);
+    aws_mqtt_packet_suback_clean_up(&suback);
+    return result;
+}
+
+static int s_encode_unsubscribe(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+
+    struct aws_mqtt_packet_unsubscribe unsubscribe;
+    if (aws_mqtt_packet_unsubscribe_init(
+            &unsubscribe, &benchmark->codec_allocator.base, s_packet_identifier(entry))) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < entry->filter_count; ++i) {
+        if (aws_mqtt_packet_unsubscribe_add_topic(&unsubscribe, s_filter(benchmark, entry, i))) {
+            goto done;
+        }
+    }
+    result = aws_mqtt_packet_unsubscribe_encode(buf, &unsubscribe);
+
+done:
+    aws_mqtt_packet_unsubscribe_clean_up(&unsubscribe);
+    return result;
+}
+
+static int s_decode_unsubscribe(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    struct aws_mqtt_packet_unsubscribe unsubscribe;
+    if (aws_mqtt_packet_unsubscribe_init(&unsubscribe, &benchmark->codec_allocator.base, 0)) {
+        return AWS_OP_ERR;
+    }
+    int result = aws_mqtt_packet_unsubscribe_decode(cur, &unsubscribe);
+    aws_mqtt_packet_unsubscribe_clean_up(&unsubscribe);
+    return result;
+}
+
+static int s_encode_connect(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+
+    /* Wills are small status messages, so only the start of the payload is used */
+    struct aws_byte_cursor will_payload = entry->payload;
+    if (will_payload.len > 256) {
+        will_payload.len = 256;
+    }
+
+    struct aws_mqtt_packet_connect connect;
+    if (aws_mqtt_packet_connect_init(&connect, entry->topic, true /*clean_session*/, 1200 /*keep_alive*/) ||
+        aws_mqtt_packet_connect_add_will(&connect, entry->topic, AWS_MQTT_QOS_AT_LEAST_ONCE, false, will_payload) ||
+        aws_mqtt_packet_connect_add_credentials(&connect, entry->topic, entry->topic)) {
+        return AWS_OP_ERR;
+    }
+    return aws_mqtt_packet_connect_encode(buf, &connect);
+}
+
+static int s_decode_connect(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_packet_connect connect;
+    AWS_ZERO_STRUCT(connect);
+    return aws_mqtt_packet_connect_decode(cur, &connect);
+}
+
+static int s_encode_connack(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+    (void)entry;
+    struct aws_mqtt_packet_connack connack;
+    if (aws_mqtt_packet_connack_init(&connack, true /*session_present*/, AWS_MQTT_CONNECT_ACCEPTED)) {
+        return AWS_OP_ERR;
+    }
+    return aws_mqtt_packet_connack_encode(buf, &connack);
+}
+
+static int s_decode_connack(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_packet_connack connack;
+    return aws_mqtt_packet_connack_decode(cur, &connack);
+}
+
+static int s_encode_pingreq(
+    struct codec_benchmark *benchmark,
+    const struct corpus_entry *entry,
+    struct aws_byte_buf *buf) {
+    (void)benchmark;
+    (void)entry;
+    struct aws_mqtt_packet_connection pingreq;
+    if (aws_mqtt_packet_pingreq_init(&pingreq)) {
+        return AWS_OP_ERR;
+    }
+    return aws_mqtt_packet_connection_encode(buf, &pingreq);
+}
+
+static int s_decode_connection(struct codec_benchmark *benchmark, struct aws_byte_cursor *cur) {
+    (void)benchmark;
+    struct aws_mqtt_packet_connection connection;
+    return aws_mqtt_packet_connection_decode(cur, &connection);
+}
+
+struct codec_case {
+    const char *name;
+    /* Whether the packets depend on the size distribution, those that don't are only run once */
+    bool sized;
+    /* Some cases only measure decoding, and use the encoder only to produce what they decode */
+    bool decode_only;
+    codec_encode_fn *encode;
+    codec_decode_fn *decode;
+};
+
+static const struct codec_case s_cases[] = {
+    {"publish_qos0", true, false, s_encode_publish_qos0, s_decode_publish},
+    {"publish_qos1", true, false, s_encode_publish_qos1, s_decode_publish},
+    {"fixed_header", true, true, s_encode_publish_qos1, s_decode_fixed_header},
+    {"puback", false, false, s_encode_puback, s_decode_ack},
+    {"subscribe", true, false, s_encode_subscribe, s_decode_subscribe},
+    {"suback", true, false, s_encode_suback, s_decode_suback},
+    {"unsubscribe", true, false, s_encode_unsubscribe, s_decode_unsubscribe},
+    {"connect", true, false, s_encode_connect, s_decode_connect},
+    {"connack", false, false, s_encode_connack, s_decode_connack},
+    {"pingreq", false, false, s_encode_pingreq, s_decode_connection},
+};
+
+/*******************************************************************************
+ * Runner
+ ******************************************************************************/
+
+static void s_report(
+    struct codec_benchmark *benchmark,
+    const char *name,
+    const char *distribution,
+    uint64_t elapsed_ns,
+    uint64_t bytes) {
+
+    double packets = (double)benchmark->packet_count;
+    double seconds = (double)elapsed_ns / 1e9;
+
+    benchmark_report_begin(&benchmark->report, s_benchmark_name, name);
+    benchmark_report_add_string(&benchmark->report, "distribution", distribution);
+    benchmark_report_add_uint(&benchmark->report, "packets", benchmark->packet_count);
+    benchmark_report_add_uint(&benchmark->report, "bytes", bytes);
+    benchmark_report_add_double(&benchmark->report, "ns_per_packet", (double)elapsed_ns / packets);
+    benchmark_report_add_double(&benchmark->report, "bytes_per_second", (double)bytes / seconds);
+    benchmark_report_add_double(
+        &benchmark->report,
+        "allocations_per_packet",
+        (double)benchmark_allocator_allocations(&benchmark->codec_allocator) / packets);
+    benchmark_report_end(&benchmark->report);
+}
+
+static int s_run_encode(
+    struct codec_benchmark *benchmark,
+    const struct codec_case *codec_case,
+    const char *name,
+    const char *distribution) {
+
+    struct aws_byte_buf *buf = &benchmark->encode_buffer;
+
+    /* Warm up */
+    for (size_t i = 0; i < CORPUS_SIZE; ++i) {
+        buf->len = 0;
+        if (codec_case->encode(benchmark, &benchmark->corpus[i], buf)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    benchmark_allocator_reset(&benchmark->codec_allocator);
+    uint64_t bytes = 0;
+    uint64_t start = benchmark_now_ns();
+
+    for (size_t i = 0; i < benchmark->packet_count; ++i) {
+        buf->len = 0;
+        if (codec_case->encode(benchmark, &benchmark->corpus[i % CORPUS_SIZE], buf)) {
+            return AWS_OP_ERR;
+        }
+        bytes += buf->len;
+    }
+
+    s_report(benchmark, name, distribution, benchmark_now_ns() - start, bytes);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_run_decode(
+    struct codec_benchmark *benchmark,
+    const struct codec_case *codec_case,
+    const char *name,
+    const char *distribution) {
+
+    /* Encode the whole corpus back to back, like packets arriving on a connection */
+    benchmark->stream.len = 0;
+    for (size_t i = 0; i < CORPUS_SIZE; ++i) {
+        benchmark->encode_buffer.len = 0;
+        if (codec_case->encode(benchmark, &benchmark->corpus[i], &benchmark->encode_buffer)) {
+            return AWS_OP_ERR;
+        }
+        struct aws_byte_cursor encoded = aws_byte_cursor_from_buf(&benchmark->encode_buffer);
+        if (aws_byte_buf_append_dynamic(&benchmark->stream, &encoded)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    /* Warm up */
+    struct aws_byte_cursor cur = aws_byte_cursor_from_buf(&benchmark->stream);
+    while (cur.len) {
+        if (codec_case->decode(benchmark, &cur)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    benchmark_allocator_reset(&benchmark->codec_allocator);
+    uint64_t bytes = 0;
+    uint64_t start = benchmark_now_ns();
+
+    for (size_t i = 0; i < benchmark->packet_count; ++i) {
+        if (cur.len == 0) {
+            cur = aws_byte_cursor_from_buf(&benchmark->stream);
+        }
+        const size_t remaining = cur.len;
+        if (codec_case->decode(benchmark, &cur)) {
+            return AWS_OP_ERR;
+        }
+        bytes += remaining - cur.len;
+    }
+
+    s_report(benchmark, name, distribution, benchmark_now_ns() - start, bytes);
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_is_selected(struct codec_benchmark *benchmark, const char *name) {
+    return benchmark->filter == NULL || strstr(name, benchmark->filter) != NULL;
+}
+
+static int s_run_case(
+    struct codec_benchmark *benchmark,
+    const struct codec_case *codec_case,
+    const char *distribution) {
+
+    char name[64];
+
+    if (!codec_case->decode_only) {
+        snprintf(name, sizeof(name), "%s_encode", codec_case->name);
+        if (s_is_selected(benchmark, name) && s_run_encode(benchmark, codec_case, name, distribution)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    snprintf(name, sizeof(name), "%s_decode", codec_case->name);
+    if (s_is_selected(benchmark, name) && s_run_decode(benchmark, codec_case, name, distribution)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*******************************************************************************
+ * Main
+ ******************************************************************************/
+
+static void s_usage(int exit_code) {
+
+    fprintf(stderr, "usage: aws-c-mqtt-packet-codec-benchmark [options]\n");
+    fprintf(stderr, "\n Options:\n\n");
+    fprintf(stderr, "  -f, --filter STRING: only run the benchmarks whose name contains STRING\n");
+    fprintf(stderr, "  -n, --packets INT: number of packets to encode or decode per benchmark\n");
+    fprintf(stderr, "  -o, --output FILE: write results to FILE instead of stdout\n");
+    fprintf(stderr, "  -s, --seed INT: seed for the generated packets\n");
+    fprintf(stderr, "  -h, --help\n");
+    fprintf(stderr, "            Display this message and quit.\n");
+    exit(exit_code);
+}
+
+static struct aws_cli_option s_long_options[] = {
+    {"filter", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'f'},
+    {"packets", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'n'},
+    {"output", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'o'},
+    {"seed", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 's'},
+    {"help", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'h'},
+    /* Per getopt(3) the last element of the array has to be filled with all zeros */
+    {NULL, AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 0},
+};
+
+int main(int argc, char **argv) {
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_mqtt_library_init(allocator);
+
+    struct codec_benchmark benchmark;
+    AWS_ZERO_STRUCT(benchmark);
+    benchmark.allocator = allocator;
+    benchmark.packet_count = DEFAULT_PACKET_COUNT;
+    benchmark_allocator_init(&benchmark.codec_allocator, allocator);
+
+    const char *output_filename = NULL;
+    uint64_t seed = DEFAULT_SEED;
+
+    while (true) {
+        int option_index = 0;
+        int c = aws_cli_getopt_long(argc, argv, "f:n:o:s:h", s_long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 0:
+                /* getopt_long() returns 0 if an option.flag is non-null */
+                break;
+            case 'f':
+                benchmark.filter = aws_cli_optarg;
+                break;
+            case 'n':
+                benchmark.packet_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'o':
+                output_filename = aws_cli_optarg;
+                break;
+            case 's':
+                seed = strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'h':
+                s_usage(0);
+                break;
+            default:
+                fprintf(stderr, "Unknown option\n");
+                s_usage(1);
+        }
+    }
+
+    if (benchmark.packet_count == 0) {
+        fprintf(stderr, "--packets must be greater than 0\n");
+        s_usage(1);
+    }
+
+    FILE *out = stdout;
+    if (output_filename) {
+        out = fopen(output_filename, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", output_filename);
+            exit(1);
+        }
+    }
+
+    benchmark_report_init(&benchmark.report, out);
+    benchmark_random_init(&benchmark.random, seed);
+
+    int result = AWS_OP_ERR;
+
+    size_t max_topic_size = 0;
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(s_distributions); ++i) {
+        max_topic_size = aws_max_size(max_topic_size, s_distributions[i].topic_size.max);
+    }
+
+    if (aws_byte_buf_init(&benchmark.topics, allocator, CORPUS_SIZE * max_topic_size) ||
+        aws_byte_buf_init(&benchmark.payload, allocator, s_max_payload_size) ||
+        aws_byte_buf_init(&benchmark.encode_buffer, allocator, ENCODE_BUFFER_SIZE) ||
+        aws_byte_buf_init(&benchmark.stream, allocator, ENCODE_BUFFER_SIZE)) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < s_max_payload_size; ++i) {
+        benchmark.payload.buffer[i] = (uint8_t)benchmark_random_next(&benchmark.random);
+    }
+    benchmark.payload.len = s_max_payload_size;
+
+    /* Packets that don't depend on sizes are run once, alongside the first distribution */
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(s_distributions); ++i) {
+        const struct size_distribution *distribution = &s_distributions[i];
+        s_generate_corpus(&benchmark, distribution);
+
+        for (size_t j = 0; j < AWS_ARRAY_SIZE(s_cases); ++j) {
+            const struct codec_case *codec_case = &s_cases[j];
+            if (!codec_case->sized && i > 0) {
+                continue;
+            }
+
+            if (s_run_case(&benchmark, codec_case, codec_case->sized ? distribution->name : "none")) {
+                fprintf(
+                    stderr,
+                    "%s over %s failed: %s\n",
+                    codec_case->name,
+                    distribution->name,
+                    aws_error_debug_str(aws_last_error()));
+                goto done;
+            }
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_byte_buf_clean_up(&benchmark.stream);
+    aws_byte_buf_clean_up(&benchmark.encode_buffer);
+    aws_byte_buf_clean_up(&benchmark.payload);
+    aws_byte_buf_clean_up(&benchmark.topics);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    aws_mqtt_library_clean_up();
+
+    return result == AWS_OP_SUCCESS ? 0 : 1;
+}
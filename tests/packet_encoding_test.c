@@ -790,6 +790,264 @@ PACKET_TEST_CONNETION(PINGRESP, pingresp)
 PACKET_TEST_CONNETION(DISCONNECT, disconnect)
 #undef PACKET_TEST_CONNETION
 
+/*****************************************************************************/
+/* Frame Index                                                               */
+
+static int s_mqtt_frame_index_scan_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_byte_buf buffer;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buffer, allocator, 512));
+
+    /* PINGRESP, remaining length 0 */
+    struct aws_mqtt_packet_connection pingresp;
+    ASSERT_SUCCESS(aws_mqtt_packet_pingresp_init(&pingresp));
+    ASSERT_SUCCESS(aws_mqtt_packet_connection_encode(&buffer, &pingresp));
+    const size_t pingresp_size = buffer.len;
+
+    /* QoS 1 retained PUBLISH, remaining length in 2 bytes */
+    uint8_t payload[200];
+    memset(payload, 'p', sizeof(payload));
+    struct aws_mqtt_packet_publish publish;
+    ASSERT_SUCCESS(aws_mqtt_packet_publish_init(
+        &publish,
+        true /*retain*/,
+        AWS_MQTT_QOS_AT_LEAST_ONCE,
+        false /*dup*/,
+        aws_byte_cursor_from_array(s_topic_name, TOPIC_NAME_LEN),
+        7,
+        aws_byte_cursor_from_array(payload, sizeof(payload))));
+    ASSERT_SUCCESS(aws_mqtt_packet_publish_encode(&buffer, &publish));
+    const size_t publish_size = buffer.len - pingresp_size;
+
+    /* PUBACK */
+    struct aws_mqtt_packet_ack puback;
+    ASSERT_SUCCESS(aws_mqtt_packet_puback_init(&puback, 7));
+    ASSERT_SUCCESS(aws_mqtt_packet_ack_encode(&buffer, &puback));
+    const size_t complete_size = buffer.len;
+
+    /* Then the start of a PUBLISH whose remaining length isn't all there */
+    ASSERT_TRUE(aws_byte_buf_write_u8(&buffer, 0x30));
+    ASSERT_TRUE(aws_byte_buf_write_u8(&buffer, 0x80));
+
+    struct aws_mqtt_frame frames[8];
+    ASSERT_UINT_EQUALS(3, aws_mqtt_frame_index_scan(aws_byte_cursor_from_buf(&buffer), frames, 8));
+
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PINGRESP, frames[0].packet_type);
+    ASSERT_UINT_EQUALS(0, frames[0].offset);
+    ASSERT_UINT_EQUALS(pingresp_size, frames[0].size);
+
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBLISH, frames[1].packet_type);
+    ASSERT_UINT_EQUALS(publish.fixed_header.flags, frames[1].flags);
+    ASSERT_UINT_EQUALS(pingresp_size, frames[1].offset);
+    ASSERT_UINT_EQUALS(publish_size, frames[1].size);
+
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PUBACK, frames[2].packet_type);
+    ASSERT_UINT_EQUALS(complete_size, frames[2].offset + frames[2].size);
+
+    /* No more than asked for */
+    ASSERT_UINT_EQUALS(2, aws_mqtt_frame_index_scan(aws_byte_cursor_from_buf(&buffer), frames, 2));
+
+    /* Nothing to index until the first packet is complete */
+    struct aws_byte_cursor partial = aws_byte_cursor_from_array(buffer.buffer + pingresp_size, publish_size - 1);
+    ASSERT_UINT_EQUALS(0, aws_mqtt_frame_index_scan(partial, frames, 8));
+
+    /* A continuation bit on the 4th byte of the remaining length is malformed, even with more bytes to follow */
+    uint8_t malformed[] = {0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x00, 0x00};
+    struct aws_byte_cursor malformed_cursor = aws_byte_cursor_from_array(malformed, sizeof(malformed));
+    ASSERT_UINT_EQUALS(0, aws_mqtt_frame_index_scan(malformed_cursor, frames, 8));
+
+    /* A PUBACK with reserved bits set isn't indexed, nor is anything after it */
+    uint8_t bad_flags[] = {0xD0, 0x00, 0x42, 0x02, 0x00, 0x07, 0xD0, 0x00};
+    struct aws_byte_cursor bad_flags_cursor = aws_byte_cursor_from_array(bad_flags, sizeof(bad_flags));
+    ASSERT_UINT_EQUALS(1, aws_mqtt_frame_index_scan(bad_flags_cursor, frames, 8));
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_PINGRESP, frames[0].packet_type);
+
+    /* Which the decoder rejects */
+    aws_byte_cursor_advance(&bad_flags_cursor, frames[0].size);
+    struct aws_mqtt_fixed_header bad_flags_header;
+    ASSERT_FAILS(aws_mqtt_fixed_header_decode(&bad_flags_cursor, &bad_flags_header));
+    ASSERT_INT_EQUALS(AWS_ERROR_MQTT_INVALID_RESERVED_BITS, aws_last_error());
+
+    aws_byte_buf_clean_up(&buffer);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_frame_index_scan, s_mqtt_frame_index_scan_fn)
+
+/*****************************************************************************/
+/* Encoded Size                                                              */
+
+typedef int(encoded_size_encode_fn)(struct aws_byte_buf *, const void *);
+
+/* Encodes packet into a buffer of exactly its encoded size, and checks that one byte less fails without writing */
+static int s_check_exact_encoded_size(
+    struct aws_allocator *allocator,
+    const struct aws_mqtt_fixed_header *header,
+    encoded_size_encode_fn *encode,
+    const void *packet) {
+
+    const size_t encoded_size = aws_mqtt_packet_encoded_size(header);
+
+    struct aws_byte_buf buffer;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buffer, allocator, encoded_size));
+    ASSERT_SUCCESS(encode(&buffer, packet));
+    ASSERT_UINT_EQUALS(encoded_size, buffer.len);
+
+    struct aws_mqtt_fixed_header decoded_header;
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_buf(&buffer);
+    ASSERT_SUCCESS(aws_mqtt_fixed_header_decode(&cursor, &decoded_header));
+    ASSERT_UINT_EQUALS(encoded_size - header->remaining_length, aws_mqtt_fixed_header_encoded_size(header));
+    ASSERT_UINT_EQUALS(header->remaining_length, cursor.len);
+
+    buffer.len = 0;
+    buffer.capacity = encoded_size - 1;
+    ASSERT_FAILS(encode(&buffer, packet));
+    ASSERT_INT_EQUALS(AWS_ERROR_SHORT_BUFFER, aws_last_error());
+    ASSERT_UINT_EQUALS(0, buffer.len);
+
+    buffer.capacity = encoded_size;
+    aws_byte_buf_clean_up(&buffer);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_mqtt_packet_encoded_size_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_byte_cursor topic = aws_byte_cursor_from_array(s_topic_name, TOPIC_NAME_LEN);
+
+    /* Remaining lengths either side of each boundary of the variable length encoding */
+    const size_t remaining_lengths[] = {2 + TOPIC_NAME_LEN, 127, 128, 16383, 16384, 2097151, 2097152};
+    const size_t max_payload_size = 2097152;
+    uint8_t *payload = aws_mem_calloc(allocator, 1, max_payload_size);
+    ASSERT_NOT_NULL(payload);
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(remaining_lengths); ++i) {
+        struct aws_mqtt_packet_publish publish;
+        ASSERT_SUCCESS(aws_mqtt_packet_publish_init(
+            &publish,
+            false /*retain*/,
+            AWS_MQTT_QOS_AT_MOST_ONCE,
+            false /*dup*/,
+            topic,
+            0,
+            aws_byte_cursor_from_array(payload, remaining_lengths[i] - (2 + TOPIC_NAME_LEN))));
+        ASSERT_UINT_EQUALS(remaining_lengths[i], publish.fixed_header.remaining_length);
+
+        ASSERT_SUCCESS(s_check_exact_encoded_size(
+            allocator, &publish.fixed_header, (encoded_size_encode_fn *)aws_mqtt_packet_publish_encode, &publish));
+    }
+
+    aws_mem_release(allocator, payload);
+
+    struct aws_mqtt_packet_ack puback;
+    ASSERT_SUCCESS(aws_mqtt_packet_puback_init(&puback, 7));
+    ASSERT_SUCCESS(s_check_exact_encoded_size(
+        allocator, &puback.fixed_header, (encoded_size_encode_fn *)aws_mqtt_packet_ack_encode, &puback));
+
+    struct aws_mqtt_packet_subscribe subscribe;
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_init(&subscribe, allocator, 7));
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_add_topic(&subscribe, topic, AWS_MQTT_QOS_AT_LEAST_ONCE));
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_add_topic(&subscribe, topic, AWS_MQTT_QOS_EXACTLY_ONCE));
+    ASSERT_SUCCESS(s_check_exact_encoded_size(
+        allocator, &subscribe.fixed_header, (encoded_size_encode_fn *)aws_mqtt_packet_subscribe_encode, &subscribe));
+    aws_mqtt_packet_subscribe_clean_up(&subscribe);
+
+    struct aws_mqtt_packet_unsubscribe unsubscribe;
+    ASSERT_SUCCESS(aws_mqtt_packet_unsubscribe_init(&unsubscribe, allocator, 7));
+    ASSERT_SUCCESS(aws_mqtt_packet_unsubscribe_add_topic(&unsubscribe, topic));
+    ASSERT_SUCCESS(s_check_exact_encoded_size(
+        allocator,
+        &unsubscribe.fixed_header,
+        (encoded_size_encode_fn *)aws_mqtt_packet_unsubscribe_encode,
+        &unsubscribe));
+    aws_mqtt_packet_unsubscribe_clean_up(&unsubscribe);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_encoded_size, s_mqtt_packet_encoded_size_fn)
+
 #ifdef _MSC_VER
 #    pragma warning(pop)
 #endif
+
+static int s_mqtt_packet_inline_lists_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_byte_cursor topic = aws_byte_cursor_from_array(s_topic_name, TOPIC_NAME_LEN);
+
+    /* Up to the inline size nothing is allocated, one more spills to the heap keeping what was already added */
+    struct aws_mqtt_packet_subscribe subscribe;
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_init(&subscribe, allocator, 7));
+    for (size_t i = 0; i < AWS_MQTT_PACKET_INLINE_LIST_SIZE; ++i) {
+        ASSERT_SUCCESS(aws_mqtt_packet_subscribe_add_topic(&subscribe, topic, (enum aws_mqtt_qos)(i % 3)));
+    }
+    ASSERT_NULL(subscribe.topic_filters.alloc);
+    ASSERT_PTR_EQUALS(subscribe.inline_topic_filters, subscribe.topic_filters.data);
+
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_add_topic(&subscribe, topic, AWS_MQTT_QOS_AT_LEAST_ONCE));
+    ASSERT_NOT_NULL(subscribe.topic_filters.alloc);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_INLINE_LIST_SIZE + 1, aws_array_list_length(&subscribe.topic_filters));
+    for (size_t i = 0; i < AWS_MQTT_PACKET_INLINE_LIST_SIZE; ++i) {
+        struct aws_mqtt_subscription *subscription = NULL;
+        ASSERT_SUCCESS(aws_array_list_get_at_ptr(&subscribe.topic_filters, (void **)&subscription, i));
+        ASSERT_INT_EQUALS(i % 3, subscription->qos);
+        ASSERT_TRUE(aws_byte_cursor_eq(&topic, &subscription->topic_filter));
+    }
+
+    /* Decoding spills the same way */
+    struct aws_byte_buf buffer;
+    ASSERT_SUCCESS(aws_byte_buf_init(&buffer, allocator, aws_mqtt_packet_encoded_size(&subscribe.fixed_header)));
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_encode(&buffer, &subscribe));
+    aws_mqtt_packet_subscribe_clean_up(&subscribe);
+
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_buf(&buffer);
+    struct aws_mqtt_packet_subscribe decoded_subscribe;
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_init(&decoded_subscribe, allocator, 0));
+    ASSERT_SUCCESS(aws_mqtt_packet_subscribe_decode(&cursor, &decoded_subscribe));
+    ASSERT_NOT_NULL(decoded_subscribe.topic_filters.alloc);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_INLINE_LIST_SIZE + 1, aws_array_list_length(&decoded_subscribe.topic_filters));
+    aws_mqtt_packet_subscribe_clean_up(&decoded_subscribe);
+    aws_byte_buf_clean_up(&buffer);
+
+    struct aws_mqtt_packet_unsubscribe unsubscribe;
+    ASSERT_SUCCESS(aws_mqtt_packet_unsubscribe_init(&unsubscribe, allocator, 7));
+    for (size_t i = 0; i < AWS_MQTT_PACKET_INLINE_LIST_SIZE; ++i) {
+        ASSERT_SUCCESS(aws_mqtt_packet_unsubscribe_add_topic(&unsubscribe, topic));
+    }
+    ASSERT_NULL(unsubscribe.topic_filters.alloc);
+    ASSERT_SUCCESS(aws_mqtt_packet_unsubscribe_add_topic(&unsubscribe, topic));
+    ASSERT_NOT_NULL(unsubscribe.topic_filters.alloc);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_INLINE_LIST_SIZE + 1, aws_array_list_length(&unsubscribe.topic_filters));
+    aws_mqtt_packet_unsubscribe_clean_up(&unsubscribe);
+
+    /* A decoded suback's return codes are a view of the buffer it was decoded from, however many there are */
+    struct aws_mqtt_packet_suback suback;
+    ASSERT_SUCCESS(aws_mqtt_packet_suback_init(&suback, allocator, 7));
+    for (size_t i = 0; i <= AWS_MQTT_PACKET_INLINE_LIST_SIZE; ++i) {
+        ASSERT_SUCCESS(aws_mqtt_packet_suback_add_return_code(&suback, AWS_MQTT_QOS_AT_LEAST_ONCE));
+    }
+    ASSERT_NOT_NULL(suback.return_codes.alloc);
+
+    ASSERT_SUCCESS(aws_byte_buf_init(&buffer, allocator, aws_mqtt_packet_encoded_size(&suback.fixed_header)));
+    ASSERT_SUCCESS(aws_mqtt_packet_suback_encode(&buffer, &suback));
+    aws_mqtt_packet_suback_clean_up(&suback);
+
+    cursor = aws_byte_cursor_from_buf(&buffer);
+    struct aws_mqtt_packet_suback decoded_suback;
+    ASSERT_SUCCESS(aws_mqtt_packet_suback_init(&decoded_suback, allocator, 0));
+    ASSERT_SUCCESS(aws_mqtt_packet_suback_decode(&cursor, &decoded_suback));
+    ASSERT_NULL(decoded_suback.return_codes.alloc);
+    uint8_t *encoded_return_codes = buffer.buffer + buffer.len - (AWS_MQTT_PACKET_INLINE_LIST_SIZE + 1);
+    ASSERT_PTR_EQUALS(encoded_return_codes, decoded_suback.return_codes.data);
+    ASSERT_UINT_EQUALS(AWS_MQTT_PACKET_INLINE_LIST_SIZE + 1, aws_array_list_length(&decoded_suback.return_codes));
+    aws_mqtt_packet_suback_clean_up(&decoded_suback);
+    aws_byte_buf_clean_up(&buffer);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_inline_lists, s_mqtt_packet_inline_lists_fn)
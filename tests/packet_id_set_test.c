@@ -0,0 +1,76 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/packet_id_set.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+static struct aws_mqtt_packet_id_set s_set;
+
+static int s_mqtt_packet_id_set_add_remove_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    aws_mqtt_packet_id_set_clear(&s_set);
+    ASSERT_UINT_EQUALS(0, aws_mqtt_packet_id_set_count(&s_set));
+
+    uint16_t ids[] = {1, 63, 64, 65, 4096, UINT16_MAX};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(ids); ++i) {
+        ASSERT_FALSE(aws_mqtt_packet_id_set_contains(&s_set, ids[i]));
+        ASSERT_TRUE(aws_mqtt_packet_id_set_add(&s_set, ids[i]));
+        ASSERT_TRUE(aws_mqtt_packet_id_set_contains(&s_set, ids[i]));
+        ASSERT_FALSE(aws_mqtt_packet_id_set_add(&s_set, ids[i]));
+    }
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(ids), aws_mqtt_packet_id_set_count(&s_set));
+    ASSERT_FALSE(aws_mqtt_packet_id_set_contains(&s_set, 0));
+    ASSERT_FALSE(aws_mqtt_packet_id_set_contains(&s_set, 2));
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(ids); ++i) {
+        ASSERT_TRUE(aws_mqtt_packet_id_set_remove(&s_set, ids[i]));
+        ASSERT_FALSE(aws_mqtt_packet_id_set_contains(&s_set, ids[i]));
+        ASSERT_FALSE(aws_mqtt_packet_id_set_remove(&s_set, ids[i]));
+    }
+    ASSERT_UINT_EQUALS(0, aws_mqtt_packet_id_set_count(&s_set));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_id_set_add_remove, s_mqtt_packet_id_set_add_remove_fn)
+
+static int s_mqtt_packet_id_set_find_free_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    aws_mqtt_packet_id_set_clear(&s_set);
+
+    /* 0 is never handed out */
+    ASSERT_UINT_EQUALS(1, aws_mqtt_packet_id_set_find_free(&s_set, 0));
+    ASSERT_UINT_EQUALS(70, aws_mqtt_packet_id_set_find_free(&s_set, 70));
+
+    /* Fill every id, in the order a connection would assign them */
+    uint16_t last_id = 0;
+    for (size_t i = 0; i < UINT16_MAX; ++i) {
+        uint16_t id = aws_mqtt_packet_id_set_find_free(&s_set, (uint16_t)(last_id + 1));
+        ASSERT_UINT_EQUALS(last_id + 1, id);
+        ASSERT_TRUE(aws_mqtt_packet_id_set_add(&s_set, id));
+        last_id = id;
+    }
+    ASSERT_UINT_EQUALS(UINT16_MAX, aws_mqtt_packet_id_set_count(&s_set));
+    ASSERT_UINT_EQUALS(0, aws_mqtt_packet_id_set_find_free(&s_set, 1));
+
+    /* Searching wraps around past UINT16_MAX */
+    ASSERT_TRUE(aws_mqtt_packet_id_set_remove(&s_set, 3));
+    ASSERT_UINT_EQUALS(3, aws_mqtt_packet_id_set_find_free(&s_set, 3));
+    ASSERT_UINT_EQUALS(3, aws_mqtt_packet_id_set_find_free(&s_set, 5));
+    ASSERT_UINT_EQUALS(3, aws_mqtt_packet_id_set_find_free(&s_set, UINT16_MAX));
+
+    ASSERT_TRUE(aws_mqtt_packet_id_set_remove(&s_set, UINT16_MAX));
+    ASSERT_UINT_EQUALS(UINT16_MAX, aws_mqtt_packet_id_set_find_free(&s_set, 4));
+    ASSERT_UINT_EQUALS(3, aws_mqtt_packet_id_set_find_free(&s_set, 0));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_id_set_find_free, s_mqtt_packet_id_set_find_free_fn)
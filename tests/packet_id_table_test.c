@@ -0,0 +1,85 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/mqtt/private/packet_id_table.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+static int s_mqtt_packet_id_table_put_remove_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_packet_id_table table;
+    aws_mqtt_packet_id_table_init(&table, allocator);
+
+    int values[6];
+    uint16_t ids[] = {1, 255, 256, 257, 4096, UINT16_MAX};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(ids); ++i) {
+        ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, ids[i]));
+        ASSERT_SUCCESS(aws_mqtt_packet_id_table_put(&table, ids[i], &values[i]));
+        ASSERT_PTR_EQUALS(&values[i], aws_mqtt_packet_id_table_find(&table, ids[i]));
+    }
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(ids), table.count);
+    ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, 0));
+    ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, 2));
+
+    /* Replacing a value does not change the count */
+    ASSERT_SUCCESS(aws_mqtt_packet_id_table_put(&table, ids[0], &values[1]));
+    ASSERT_PTR_EQUALS(&values[1], aws_mqtt_packet_id_table_find(&table, ids[0]));
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(ids), table.count);
+    ASSERT_SUCCESS(aws_mqtt_packet_id_table_put(&table, ids[0], &values[0]));
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(ids); ++i) {
+        ASSERT_PTR_EQUALS(&values[i], aws_mqtt_packet_id_table_remove(&table, ids[i]));
+        ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, ids[i]));
+        ASSERT_NULL(aws_mqtt_packet_id_table_remove(&table, ids[i]));
+    }
+    ASSERT_UINT_EQUALS(0, table.count);
+
+    /* Every page is freed once it empties, but for the last one which is kept as a spare */
+    for (size_t i = 0; i < AWS_MQTT_PACKET_ID_TABLE_PAGE_COUNT; ++i) {
+        ASSERT_NULL(table.pages[i]);
+    }
+    void **spare_page = table.spare_page;
+    ASSERT_NOT_NULL(spare_page);
+
+    /* The spare page is reused for whichever page is needed next, the way a single request in flight at a time uses
+     * a new id each time */
+    for (uint16_t id = 1; id < 1024; ++id) {
+        ASSERT_SUCCESS(aws_mqtt_packet_id_table_put(&table, id, &values[0]));
+        ASSERT_PTR_EQUALS(spare_page, table.pages[id / AWS_MQTT_PACKET_ID_TABLE_PAGE_SIZE]);
+        ASSERT_NULL(table.spare_page);
+        ASSERT_PTR_EQUALS(&values[0], aws_mqtt_packet_id_table_remove(&table, id));
+        ASSERT_PTR_EQUALS(spare_page, table.spare_page);
+    }
+    ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, 1));
+
+    aws_mqtt_packet_id_table_clean_up(&table);
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_id_table_put_remove, s_mqtt_packet_id_table_put_remove_fn)
+
+static int s_mqtt_packet_id_table_clean_up_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_packet_id_table table;
+    aws_mqtt_packet_id_table_init(&table, allocator);
+
+    /* Fill every id so that every page is allocated, clean_up must free them all */
+    int value = 0;
+    for (uint32_t id = 1; id <= UINT16_MAX; ++id) {
+        ASSERT_SUCCESS(aws_mqtt_packet_id_table_put(&table, (uint16_t)id, &value));
+    }
+    ASSERT_UINT_EQUALS(UINT16_MAX, table.count);
+
+    aws_mqtt_packet_id_table_clean_up(&table);
+    ASSERT_UINT_EQUALS(0, table.count);
+    ASSERT_NULL(aws_mqtt_packet_id_table_find(&table, 1));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_packet_id_table_clean_up, s_mqtt_packet_id_table_clean_up_fn)
@@ -0,0 +1,733 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "benchmark_helpers.h"
+
+#include <aws/mqtt/mqtt.h>
+#include <aws/mqtt/private/topic_tree.h>
+
+#include <aws/common/command_line_parser.h>
+#include <aws/common/math.h>
+#include <aws/common/string.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4996) /* Disable warnings about fopen() being insecure */
+#endif
+
+/*
+ * Benchmarks inserting subscriptions into a topic tree, matching publishes against it, matching them while
+ * subscriptions come and go, and cleaning it up.
+ *
+ * Subscriptions are either generated from a hierarchy of the given breadth and depth, with some of them using
+ * wildcards, or replayed from a file holding one topic filter per line. Publish topics are drawn from the same
+ * hierarchy, or for replayed filters, made from them by filling their wildcards in.
+ *
+ * Results are printed to stdout one JSON object per line.
+ */
+
+enum {
+    DEFAULT_BREADTH = 10,
+    DEFAULT_DEPTH = 4,
+    DEFAULT_SUBSCRIPTION_COUNT = 10000,
+    DEFAULT_PUBLISH_COUNT = 100000,
+    DEFAULT_CHURN_INTERVAL = 16,
+    DEFAULT_SEED = 1,
+    /* Publish topics are reused round robin */
+    PUBLISH_TOPIC_COUNT = 4096,
+    MAX_FILTER_SIZE = 65535,
+};
+
+static const char *s_benchmark_name = "topic_tree";
+
+struct topic_tree_benchmark {
+    /* Allocator for the benchmark itself */
+    struct aws_allocator *allocator;
+    /* Allocator given to the tree */
+    struct benchmark_allocator tree_allocator;
+
+    struct benchmark_report report;
+    struct benchmark_random random;
+
+    size_t breadth;
+    size_t depth;
+    double wildcard_ratio;
+    size_t subscription_count;
+    size_t publish_count;
+    size_t churn_interval;
+    size_t dispatch_cache_size;
+    const char *topics_filename;
+
+    /* aws_string *, the topic filters to subscribe to */
+    struct aws_array_list filters;
+    /* aws_byte_buf, the topics to publish on */
+    struct aws_array_list publish_topics;
+};
+
+/*******************************************************************************
+ * Workload
+ ******************************************************************************/
+
+/* Level names are a letter for how deep the level is followed by its index, eg. a3/b0/c7 */
+static int s_append_level(struct aws_byte_buf *topic, size_t depth, size_t index) {
+    char level[32];
+    int len = snprintf(level, sizeof(level), "%s%c%zu", depth ? "/" : "", (char)('a' + depth % 26), index);
+    struct aws_byte_cursor level_cur = aws_byte_cursor_from_array(level, (size_t)len);
+    return aws_byte_buf_append_dynamic(topic, &level_cur);
+}
+
+static int s_append_wildcard(struct aws_byte_buf *topic, size_t depth, char wildcard) {
+    char level[2] = {'/', wildcard};
+    struct aws_byte_cursor level_cur = aws_byte_cursor_from_array(depth ? level : level + 1, depth ? 2 : 1);
+    return aws_byte_buf_append_dynamic(topic, &level_cur);
+}
+
+static int s_append_random_level(struct topic_tree_benchmark *benchmark, struct aws_byte_buf *topic, size_t depth) {
+    return s_append_level(topic, depth, benchmark_random_range(&benchmark->random, 0, benchmark->breadth - 1));
+}
+
+static int s_add_filter(struct topic_tree_benchmark *benchmark, struct aws_byte_cursor filter) {
+    if (filter.len == 0 || filter.len > MAX_FILTER_SIZE) {
+        return aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+    }
+
+    /* Not counted against the tree, which frees it with the allocator it was created with */
+    struct aws_string *string = aws_string_new_from_array(benchmark->allocator, filter.ptr, filter.len);
+    if (!string) {
+        return AWS_OP_ERR;
+    }
+    if (aws_array_list_push_back(&benchmark->filters, &string)) {
+        aws_string_destroy(string);
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_add_publish_topic(struct topic_tree_benchmark *benchmark, struct aws_byte_buf *topic) {
+    if (aws_array_list_push_back(&benchmark->publish_topics, topic)) {
+        aws_byte_buf_clean_up(topic);
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_generate_workload(struct topic_tree_benchmark *benchmark) {
+
+    struct aws_byte_buf topic;
+    if (aws_byte_buf_init(&topic, benchmark->allocator, 64)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    for (size_t i = 0; i < benchmark->subscription_count; ++i) {
+        topic.len = 0;
+        size_t depth = benchmark_random_range(&benchmark->random, 1, benchmark->depth);
+
+        /* A wildcard filter has either one level replaced with +, or ends early with # */
+        bool wildcard = (double)benchmark_random_next(&benchmark->random) / (double)UINT64_MAX <
+                        benchmark->wildcard_ratio;
+        size_t wildcard_level = benchmark_random_range(&benchmark->random, 0, depth - 1);
+        bool multi_level = benchmark_random_range(&benchmark->random, 0, 1) == 1;
+
+        for (size_t level = 0; level < depth; ++level) {
+            int error = AWS_OP_SUCCESS;
+            if (wildcard && level == wildcard_level) {
+                error = s_append_wildcard(&topic, level, multi_level ? '#' : '+');
+                if (multi_level) {
+                    level = depth;
+                }
+            } else {
+                error = s_append_random_level(benchmark, &topic, level);
+            }
+            if (error) {
+                goto done;
+            }
+        }
+
+        if (s_add_filter(benchmark, aws_byte_cursor_from_buf(&topic))) {
+            goto done;
+        }
+    }
+
+    for (size_t i = 0; i < PUBLISH_TOPIC_COUNT; ++i) {
+        struct aws_byte_buf publish_topic;
+        if (aws_byte_buf_init(&publish_topic, benchmark->allocator, 64)) {
+            goto done;
+        }
+
+        size_t depth = benchmark_random_range(&benchmark->random, 1, benchmark->depth);
+        for (size_t level = 0; level < depth; ++level) {
+            if (s_append_random_level(benchmark, &publish_topic, level)) {
+                aws_byte_buf_clean_up(&publish_topic);
+                goto done;
+            }
+        }
+
+        if (s_add_publish_topic(benchmark, &publish_topic)) {
+            goto done;
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_byte_buf_clean_up(&topic);
+    return result;
+}
+
+/* Makes a topic matching the filter, by replacing each of its wildcards with a level */
+static int s_topic_from_filter(
+    struct topic_tree_benchmark *benchmark,
+    struct aws_byte_cursor filter,
+    struct aws_byte_buf *topic) {
+
+    if (aws_byte_buf_init(topic, benchmark->allocator, filter.len + 16)) {
+        return AWS_OP_ERR;
+    }
+
+    size_t depth = 0;
+    struct aws_byte_cursor level;
+    AWS_ZERO_STRUCT(level);
+    while (aws_byte_cursor_next_split(&filter, '/', &level)) {
+        bool is_wildcard = level.len == 1 && (level.ptr[0] == '+' || level.ptr[0] == '#');
+        int error = AWS_OP_SUCCESS;
+        if (is_wildcard) {
+            error = s_append_random_level(benchmark, topic, depth);
+        } else {
+            struct aws_byte_cursor separator = aws_byte_cursor_from_c_str("/");
+            if (depth > 0) {
+                error = aws_byte_buf_append_dynamic(topic, &separator);
+            }
+            error = error ? error : aws_byte_buf_append_dynamic(topic, &level);
+        }
+        if (error) {
+            aws_byte_buf_clean_up(topic);
+            return AWS_OP_ERR;
+        }
+        ++depth;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_load_workload(struct topic_tree_benchmark *benchmark) {
+
+    FILE *file = fopen(benchmark->topics_filename, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", benchmark->topics_filename);
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    int result = AWS_OP_ERR;
+    char *line = aws_mem_acquire(benchmark->allocator, MAX_FILTER_SIZE + 2);
+    if (!line) {
+        goto done;
+    }
+
+    size_t line_number = 0;
+    while (fgets(line, MAX_FILTER_SIZE + 2, file)) {
+        ++line_number;
+
+        struct aws_byte_cursor filter = aws_byte_cursor_from_c_str(line);
+        if (filter.len > MAX_FILTER_SIZE && filter.ptr[filter.len - 1] != '\n') {
+            fprintf(stderr, "%s:%zu: topic filter too long\n", benchmark->topics_filename, line_number);
+            aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+            goto done;
+        }
+        while (filter.len && (filter.ptr[filter.len - 1] == '\n' || filter.ptr[filter.len - 1] == '\r')) {
+            --filter.len;
+        }
+        if (filter.len == 0) {
+            continue;
+        }
+
+        if (!aws_mqtt_is_valid_topic_filter(&filter)) {
+            fprintf(stderr, "%s:%zu: invalid topic filter\n", benchmark->topics_filename, line_number);
+            aws_raise_error(AWS_ERROR_MQTT_INVALID_TOPIC);
+            goto done;
+        }
+
+        if (s_add_filter(benchmark, filter)) {
+            goto done;
+        }
+    }
+
+    /* Publish on topics made from filters spread evenly over the file */
+    const size_t filter_count = aws_array_list_length(&benchmark->filters);
+    const size_t publish_topic_count = aws_min_size(filter_count, PUBLISH_TOPIC_COUNT);
+    for (size_t i = 0; i < publish_topic_count; ++i) {
+        struct aws_string *filter = NULL;
+        aws_array_list_get_at(&benchmark->filters, &filter, (i * filter_count) / publish_topic_count);
+
+        struct aws_byte_buf topic;
+        if (s_topic_from_filter(benchmark, aws_byte_cursor_from_string(filter), &topic) ||
+            s_add_publish_topic(benchmark, &topic)) {
+            goto done;
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_mem_release(benchmark->allocator, line);
+    fclose(file);
+    return result;
+}
+
+/*******************************************************************************
+ * Runner
+ ******************************************************************************/
+
+static size_t s_matches = 0;
+static void s_on_publish(
+    const struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *user_data) {
+
+    (void)topic;
+    (void)payload;
+    (void)dup;
+    (void)qos;
+    (void)retain;
+    (void)user_data;
+
+    ++s_matches;
+}
+
+static void s_string_clean_up(void *userdata) {
+    struct aws_string *string = userdata;
+    aws_string_destroy(string);
+}
+
+static void s_report_begin(struct topic_tree_benchmark *benchmark, const char *name) {
+    benchmark_report_begin(&benchmark->report, s_benchmark_name, name);
+    if (benchmark->topics_filename) {
+        benchmark_report_add_string(&benchmark->report, "topics_file", benchmark->topics_filename);
+    } else {
+        benchmark_report_add_uint(&benchmark->report, "breadth", benchmark->breadth);
+        benchmark_report_add_uint(&benchmark->report, "depth", benchmark->depth);
+        benchmark_report_add_double(&benchmark->report, "wildcard_ratio", benchmark->wildcard_ratio);
+    }
+    benchmark_report_add_uint(&benchmark->report, "dispatch_cache_size", benchmark->dispatch_cache_size);
+}
+
+/*
+ * Matches publishes while one subscription is made and one is dropped every churn_interval publishes, as when clients
+ * keep subscribing to and unsubscribing from short-lived topics. The churned filters are the publish topics with an
+ * extra level, so they land among the existing subscriptions without replacing any.
+ */
+static int s_run_churn(
+    struct topic_tree_benchmark *benchmark,
+    struct aws_mqtt_topic_tree *tree,
+    size_t subscription_count) {
+
+    const size_t publish_topic_count = aws_array_list_length(&benchmark->publish_topics);
+    const struct aws_byte_cursor churn_level = aws_byte_cursor_from_c_str("/churn");
+
+    int result = AWS_OP_ERR;
+
+    /* aws_string *, the filters to churn through, the tree keeps its own copies */
+    struct aws_array_list churn_filters;
+    if (aws_array_list_init_dynamic(
+            &churn_filters, benchmark->allocator, publish_topic_count, sizeof(struct aws_string *))) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_buf filter_buf;
+    if (aws_byte_buf_init(&filter_buf, benchmark->allocator, 64)) {
+        goto done;
+    }
+    for (size_t i = 0; i < publish_topic_count; ++i) {
+        struct aws_byte_buf *topic = NULL;
+        aws_array_list_get_at_ptr(&benchmark->publish_topics, (void **)&topic, i);
+
+        filter_buf.len = 0;
+        struct aws_byte_cursor topic_cur = aws_byte_cursor_from_buf(topic);
+        if (aws_byte_buf_append_dynamic(&filter_buf, &topic_cur) ||
+            aws_byte_buf_append_dynamic(&filter_buf, &churn_level)) {
+            aws_byte_buf_clean_up(&filter_buf);
+            goto done;
+        }
+
+        struct aws_string *filter = aws_string_new_from_array(benchmark->allocator, filter_buf.buffer, filter_buf.len);
+        if (!filter) {
+            aws_byte_buf_clean_up(&filter_buf);
+            goto done;
+        }
+        if (aws_array_list_push_back(&churn_filters, &filter)) {
+            aws_string_destroy(filter);
+            aws_byte_buf_clean_up(&filter_buf);
+            goto done;
+        }
+    }
+    aws_byte_buf_clean_up(&filter_buf);
+
+    struct aws_mqtt_packet_publish publish;
+    AWS_ZERO_STRUCT(publish);
+
+    /* The subscription made at the last change, dropped at the next one */
+    struct aws_string *subscribed = NULL;
+    size_t change_count = 0;
+
+    s_matches = 0;
+    benchmark_allocator_reset(&benchmark->tree_allocator);
+    uint64_t start = benchmark_now_ns();
+
+    for (size_t i = 0; i < benchmark->publish_count; ++i) {
+        if (i % benchmark->churn_interval == 0) {
+            if (subscribed) {
+                struct aws_byte_cursor subscribed_cur = aws_byte_cursor_from_string(subscribed);
+                if (aws_mqtt_topic_tree_remove(tree, &subscribed_cur)) {
+                    goto done;
+                }
+                subscribed = NULL;
+                ++change_count;
+            }
+
+            struct aws_string *filter = NULL;
+            aws_array_list_get_at(&churn_filters, &filter, change_count / 2 % publish_topic_count);
+            if (aws_mqtt_topic_tree_insert(tree, filter, AWS_MQTT_QOS_AT_MOST_ONCE, s_on_publish, NULL, NULL)) {
+                goto done;
+            }
+            subscribed = filter;
+            ++change_count;
+        }
+
+        struct aws_byte_buf *topic = NULL;
+        aws_array_list_get_at_ptr(&benchmark->publish_topics, (void **)&topic, i % publish_topic_count);
+        publish.topic_name = aws_byte_cursor_from_buf(topic);
+        aws_mqtt_topic_tree_publish(tree, &publish);
+    }
+
+    uint64_t elapsed_ns = benchmark_now_ns() - start;
+    size_t allocations = benchmark_allocator_allocations(&benchmark->tree_allocator);
+    const double publish_count = (double)benchmark->publish_count;
+
+    if (subscribed) {
+        struct aws_byte_cursor subscribed_cur = aws_byte_cursor_from_string(subscribed);
+        if (aws_mqtt_topic_tree_remove(tree, &subscribed_cur)) {
+            goto done;
+        }
+    }
+
+    s_report_begin(benchmark, "churn");
+    benchmark_report_add_uint(&benchmark->report, "subscriptions", subscription_count);
+    benchmark_report_add_uint(&benchmark->report, "publishes", benchmark->publish_count);
+    benchmark_report_add_uint(&benchmark->report, "churn_interval", benchmark->churn_interval);
+    benchmark_report_add_uint(&benchmark->report, "subscription_changes", change_count);
+    benchmark_report_add_double(&benchmark->report, "ns_per_publish", (double)elapsed_ns / publish_count);
+    benchmark_report_add_double(&benchmark->report, "publishes_per_second", publish_count / ((double)elapsed_ns / 1e9));
+    benchmark_report_add_double(&benchmark->report, "matches_per_publish", (double)s_matches / publish_count);
+    benchmark_report_add_double(&benchmark->report, "allocations_per_publish", (double)allocations / publish_count);
+    benchmark_report_end(&benchmark->report);
+
+    result = AWS_OP_SUCCESS;
+
+done:
+    for (size_t i = 0; i < aws_array_list_length(&churn_filters); ++i) {
+        struct aws_string *filter = NULL;
+        aws_array_list_get_at(&churn_filters, &filter, i);
+        aws_string_destroy(filter);
+    }
+    aws_array_list_clean_up(&churn_filters);
+
+    return result;
+}
+
+static int s_run(struct topic_tree_benchmark *benchmark) {
+
+    struct aws_allocator *tree_allocator = &benchmark->tree_allocator.base;
+    const size_t filter_count = aws_array_list_length(&benchmark->filters);
+    const size_t publish_topic_count = aws_array_list_length(&benchmark->publish_topics);
+
+    /* Everything the tree holds on to counts towards the size of its subscriptions */
+    const size_t bytes_before = benchmark_allocator_outstanding_bytes(&benchmark->tree_allocator);
+
+    struct aws_mqtt_topic_tree tree;
+    if (aws_mqtt_topic_tree_init(&tree, tree_allocator)) {
+        return AWS_OP_ERR;
+    }
+    if (aws_mqtt_topic_tree_set_dispatch_cache_size(&tree, benchmark->dispatch_cache_size)) {
+        aws_mqtt_topic_tree_clean_up(&tree);
+        return AWS_OP_ERR;
+    }
+
+    /* Insert */
+    benchmark_allocator_reset(&benchmark->tree_allocator);
+    uint64_t start = benchmark_now_ns();
+
+    for (size_t i = 0; i < filter_count; ++i) {
+        struct aws_string *filter = NULL;
+        aws_array_list_get_at(&benchmark->filters, &filter, i);
+        if (aws_mqtt_topic_tree_insert(
+                &tree, filter, AWS_MQTT_QOS_AT_MOST_ONCE, s_on_publish, s_string_clean_up, filter)) {
+            /* The tree frees the filters inserted so far, the rest are left for the caller */
+            aws_array_list_pop_front_n(&benchmark->filters, i);
+            aws_mqtt_topic_tree_clean_up(&tree);
+            return AWS_OP_ERR;
+        }
+    }
+
+    uint64_t elapsed_ns = benchmark_now_ns() - start;
+    size_t allocations = benchmark_allocator_allocations(&benchmark->tree_allocator);
+    size_t tree_bytes = benchmark_allocator_outstanding_bytes(&benchmark->tree_allocator) - bytes_before;
+    /* Inserting the same filter twice replaces the first subscription */
+    size_t subscription_count = aws_mqtt_topic_tree_get_sub_count(&tree);
+
+    s_report_begin(benchmark, "insert");
+    benchmark_report_add_uint(&benchmark->report, "filters", filter_count);
+    benchmark_report_add_uint(&benchmark->report, "subscriptions", subscription_count);
+    benchmark_report_add_double(&benchmark->report, "ns_per_insert", (double)elapsed_ns / (double)filter_count);
+    benchmark_report_add_double(
+        &benchmark->report, "inserts_per_second", (double)filter_count / ((double)elapsed_ns / 1e9));
+    benchmark_report_add_double(
+        &benchmark->report, "allocations_per_insert", (double)allocations / (double)filter_count);
+    benchmark_report_add_double(
+        &benchmark->report, "bytes_per_subscription", (double)tree_bytes / (double)subscription_count);
+    benchmark_report_end(&benchmark->report);
+
+    /* The tree frees the filters from now on */
+    aws_array_list_clear(&benchmark->filters);
+
+    /* Match */
+    struct aws_mqtt_packet_publish publish;
+    AWS_ZERO_STRUCT(publish);
+
+    /* Warm up */
+    for (size_t i = 0; i < publish_topic_count; ++i) {
+        struct aws_byte_buf *topic = NULL;
+        aws_array_list_get_at_ptr(&benchmark->publish_topics, (void **)&topic, i);
+        publish.topic_name = aws_byte_cursor_from_buf(topic);
+        aws_mqtt_topic_tree_publish(&tree, &publish);
+    }
+
+    s_matches = 0;
+    benchmark_allocator_reset(&benchmark->tree_allocator);
+    start = benchmark_now_ns();
+
+    for (size_t i = 0; i < benchmark->publish_count; ++i) {
+        struct aws_byte_buf *topic = NULL;
+        aws_array_list_get_at_ptr(&benchmark->publish_topics, (void **)&topic, i % publish_topic_count);
+        publish.topic_name = aws_byte_cursor_from_buf(topic);
+        aws_mqtt_topic_tree_publish(&tree, &publish);
+    }
+
+    elapsed_ns = benchmark_now_ns() - start;
+    allocations = benchmark_allocator_allocations(&benchmark->tree_allocator);
+    const double publish_count = (double)benchmark->publish_count;
+
+    s_report_begin(benchmark, "match");
+    benchmark_report_add_uint(&benchmark->report, "subscriptions", subscription_count);
+    benchmark_report_add_uint(&benchmark->report, "publishes", benchmark->publish_count);
+    benchmark_report_add_double(&benchmark->report, "ns_per_publish", (double)elapsed_ns / publish_count);
+    benchmark_report_add_double(&benchmark->report, "publishes_per_second", publish_count / ((double)elapsed_ns / 1e9));
+    benchmark_report_add_double(&benchmark->report, "matches_per_publish", (double)s_matches / publish_count);
+    benchmark_report_add_double(&benchmark->report, "allocations_per_publish", (double)allocations / publish_count);
+    benchmark_report_end(&benchmark->report);
+
+    if (benchmark->churn_interval && s_run_churn(benchmark, &tree, subscription_count)) {
+        aws_mqtt_topic_tree_clean_up(&tree);
+        return AWS_OP_ERR;
+    }
+
+    /* Clean up */
+    start = benchmark_now_ns();
+    aws_mqtt_topic_tree_clean_up(&tree);
+    elapsed_ns = benchmark_now_ns() - start;
+
+    s_report_begin(benchmark, "clean_up");
+    benchmark_report_add_uint(&benchmark->report, "subscriptions", subscription_count);
+    benchmark_report_add_double(
+        &benchmark->report, "ns_per_subscription", (double)elapsed_ns / (double)subscription_count);
+    benchmark_report_end(&benchmark->report);
+
+    return AWS_OP_SUCCESS;
+}
+
+/*******************************************************************************
+ * Main
+ ******************************************************************************/
+
+static void s_usage(int exit_code) {
+
+    fprintf(stderr, "usage: aws-c-mqtt-topic-tree-benchmark [options]\n");
+    fprintf(stderr, "\n Options:\n\n");
+    fprintf(stderr, "  -b, --breadth INT: number of distinct names at each level of generated topics\n");
+    fprintf(stderr, "  -c, --dispatch-cache INT: size of the tree's dispatch cache, 0 (the default) disables it\n");
+    fprintf(stderr, "  -d, --depth INT: maximum number of levels of generated topics\n");
+    fprintf(stderr, "  -f, --topics FILE: subscribe to the topic filters in FILE, one per line, instead of\n");
+    fprintf(stderr, "                     generated ones\n");
+    fprintf(stderr, "  -n, --subscriptions INT: number of topic filters to generate\n");
+    fprintf(stderr, "  -o, --output FILE: write results to FILE instead of stdout\n");
+    fprintf(stderr, "  -p, --publishes INT: number of publishes to match\n");
+    fprintf(stderr, "  -s, --seed INT: seed for the generated topics\n");
+    fprintf(stderr, "  -u, --churn-interval INT: publishes between subscription changes in the churn case, 0 skips\n");
+    fprintf(stderr, "                            it\n");
+    fprintf(stderr, "  -w, --wildcard-ratio FLOAT: fraction of generated topic filters that have a wildcard\n");
+    fprintf(stderr, "  -h, --help\n");
+    fprintf(stderr, "            Display this message and quit.\n");
+    exit(exit_code);
+}
+
+static struct aws_cli_option s_long_options[] = {
+    {"breadth", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'b'},
+    {"dispatch-cache", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'c'},
+    {"depth", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'd'},
+    {"topics", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'f'},
+    {"subscriptions", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'n'},
+    {"output", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'o'},
+    {"publishes", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'p'},
+    {"seed", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 's'},
+    {"churn-interval", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'u'},
+    {"wildcard-ratio", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'w'},
+    {"help", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'h'},
+    /* Per getopt(3) the last element of the array has to be filled with all zeros */
+    {NULL, AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 0},
+};
+
+static void s_parse_options(int argc, char **argv, struct topic_tree_benchmark *benchmark, const char **output) {
+    uint64_t seed = DEFAULT_SEED;
+
+    while (true) {
+        int option_index = 0;
+        int c = aws_cli_getopt_long(argc, argv, "b:c:d:f:n:o:p:s:u:w:h", s_long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 0:
+                /* getopt_long() returns 0 if an option.flag is non-null */
+                break;
+            case 'b':
+                benchmark->breadth = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'c':
+                benchmark->dispatch_cache_size = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'd':
+                benchmark->depth = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'f':
+                benchmark->topics_filename = aws_cli_optarg;
+                break;
+            case 'n':
+                benchmark->subscription_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'o':
+                *output = aws_cli_optarg;
+                break;
+            case 'p':
+                benchmark->publish_count = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'u':
+                benchmark->churn_interval = (size_t)strtoull(aws_cli_optarg, NULL, 10);
+                break;
+            case 'w':
+                benchmark->wildcard_ratio = strtod(aws_cli_optarg, NULL);
+                break;
+            case 'h':
+                s_usage(0);
+                break;
+            default:
+                fprintf(stderr, "Unknown option\n");
+                s_usage(1);
+        }
+    }
+
+    if (benchmark->breadth == 0 || benchmark->depth == 0 || benchmark->subscription_count == 0 ||
+        benchmark->publish_count == 0) {
+        fprintf(stderr, "--breadth, --depth, --subscriptions and --publishes must be greater than 0\n");
+        s_usage(1);
+    }
+    if (!(benchmark->wildcard_ratio >= 0.0 && benchmark->wildcard_ratio <= 1.0)) {
+        fprintf(stderr, "--wildcard-ratio must be between 0 and 1\n");
+        s_usage(1);
+    }
+
+    benchmark_random_init(&benchmark->random, seed);
+}
+
+int main(int argc, char **argv) {
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_mqtt_library_init(allocator);
+
+    struct topic_tree_benchmark benchmark;
+    AWS_ZERO_STRUCT(benchmark);
+    benchmark.allocator = allocator;
+    benchmark.breadth = DEFAULT_BREADTH;
+    benchmark.depth = DEFAULT_DEPTH;
+    benchmark.wildcard_ratio = 0.1;
+    benchmark.subscription_count = DEFAULT_SUBSCRIPTION_COUNT;
+    benchmark.publish_count = DEFAULT_PUBLISH_COUNT;
+    benchmark.churn_interval = DEFAULT_CHURN_INTERVAL;
+    benchmark_allocator_init(&benchmark.tree_allocator, allocator);
+
+    const char *output_filename = NULL;
+    s_parse_options(argc, argv, &benchmark, &output_filename);
+
+    FILE *out = stdout;
+    if (output_filename) {
+        out = fopen(output_filename, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", output_filename);
+            exit(1);
+        }
+    }
+    benchmark_report_init(&benchmark.report, out);
+
+    int result = AWS_OP_ERR;
+
+    if (aws_array_list_init_dynamic(&benchmark.filters, allocator, 16, sizeof(struct aws_string *)) ||
+        aws_array_list_init_dynamic(&benchmark.publish_topics, allocator, 16, sizeof(struct aws_byte_buf))) {
+        goto done;
+    }
+
+    if (benchmark.topics_filename ? s_load_workload(&benchmark) : s_generate_workload(&benchmark)) {
+        goto done;
+    }
+    if (aws_array_list_length(&benchmark.filters) == 0) {
+        fprintf(stderr, "No topic filters to subscribe to\n");
+        goto done;
+    }
+
+    result = s_run(&benchmark);
+    if (result) {
+        fprintf(stderr, "Benchmark failed: %s\n", aws_error_debug_str(aws_last_error()));
+    }
+
+done:
+    for (size_t i = 0; i < aws_array_list_length(&benchmark.filters); ++i) {
+        struct aws_string *filter = NULL;
+        aws_array_list_get_at(&benchmark.filters, &filter, i);
+        aws_string_destroy(filter);
+    }
+    aws_array_list_clean_up(&benchmark.filters);
+
+    for (size_t i = 0; i < aws_array_list_length(&benchmark.publish_topics); ++i) {
+        struct aws_byte_buf *topic = NULL;
+        aws_array_list_get_at_ptr(&benchmark.publish_topics, (void **)&topic, i);
+        aws_byte_buf_clean_up(topic);
+    }
+    aws_array_list_clean_up(&benchmark.publish_topics);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    aws_mqtt_library_clean_up();
+
+    return result == AWS_OP_SUCCESS ? 0 : 1;
+}
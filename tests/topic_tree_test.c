@@ -300,6 +300,280 @@ static int s_mqtt_topic_tree_transactions_fn(struct aws_allocator *allocator, vo
     return AWS_OP_SUCCESS;
 }
 
+static void s_on_publish_count(
+    const struct aws_byte_cursor *topic,
+    const struct aws_byte_cursor *payload,
+    bool dup,
+    enum aws_mqtt_qos qos,
+    bool retain,
+    void *user_data) {
+
+    (void)topic;
+    (void)payload;
+    (void)dup;
+    (void)qos;
+    (void)retain;
+
+    size_t *count = user_data;
+    ++*count;
+}
+
+/* Straightforward matcher with the same semantics as the tree: '#' needs at least one level to match */
+static bool s_reference_topic_match(const char *filter, const char *topic) {
+    struct aws_byte_cursor filter_cur = aws_byte_cursor_from_c_str(filter);
+    struct aws_byte_cursor topic_cur = aws_byte_cursor_from_c_str(topic);
+    struct aws_byte_cursor filter_part;
+    struct aws_byte_cursor topic_part;
+    AWS_ZERO_STRUCT(filter_part);
+    AWS_ZERO_STRUCT(topic_part);
+
+    while (aws_byte_cursor_next_split(&filter_cur, '/', &filter_part)) {
+        bool has_topic_part = aws_byte_cursor_next_split(&topic_cur, '/', &topic_part);
+        if (aws_byte_cursor_eq_c_str(&filter_part, "#")) {
+            return has_topic_part;
+        }
+        if (!has_topic_part) {
+            return false;
+        }
+        if (!aws_byte_cursor_eq_c_str(&filter_part, "+") && !aws_byte_cursor_eq(&filter_part, &topic_part)) {
+            return false;
+        }
+    }
+
+    return !aws_byte_cursor_next_split(&topic_cur, '/', &topic_part);
+}
+
+/* Builds a random topic of up to 4 levels, with wildcards if is_filter. Returns the length written. */
+static size_t s_random_topic(uint32_t *seed, bool is_filter, char *out) {
+    static const char *s_levels[] = {"a", "b", "c", "fleet", ""};
+    size_t len = 0;
+    const size_t level_count = 1 + (*seed = *seed * 1103515245 + 12345) % 4;
+    for (size_t i = 0; i < level_count; ++i) {
+        if (i > 0) {
+            out[len++] = '/';
+        }
+        const uint32_t roll = (*seed = *seed * 1103515245 + 12345) >> 16;
+        const char *level = s_levels[roll % AWS_ARRAY_SIZE(s_levels)];
+        if (is_filter && roll % 7 == 0) {
+            level = "+";
+        } else if (is_filter && roll % 11 == 0 && i == level_count - 1) {
+            level = "#";
+        }
+        memcpy(out + len, level, strlen(level));
+        len += strlen(level);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+AWS_TEST_CASE(mqtt_topic_tree_match_random, s_mqtt_topic_tree_match_random_fn)
+static int s_mqtt_topic_tree_match_random_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    enum { FILTER_COUNT = 64, PUBLISH_COUNT = 512 };
+    char filters[FILTER_COUNT][32];
+    size_t filter_count = 0;
+    size_t counts[FILTER_COUNT];
+    size_t expected_counts[FILTER_COUNT];
+    AWS_ZERO_ARRAY(counts);
+    AWS_ZERO_ARRAY(expected_counts);
+
+    struct aws_mqtt_topic_tree tree;
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_init(&tree, allocator));
+
+    uint32_t seed = 42;
+    for (size_t i = 0; i < FILTER_COUNT; ++i) {
+        s_random_topic(&seed, true, filters[filter_count]);
+
+        /* Inserting a filter twice replaces the first subscription, keep them unique */
+        bool is_duplicate = false;
+        for (size_t j = 0; j < filter_count; ++j) {
+            is_duplicate |= strcmp(filters[j], filters[filter_count]) == 0;
+        }
+        if (is_duplicate) {
+            continue;
+        }
+
+        struct aws_string *filter = aws_string_new_from_c_str(allocator, filters[filter_count]);
+        ASSERT_SUCCESS(aws_mqtt_topic_tree_insert(
+            &tree, filter, AWS_MQTT_QOS_AT_MOST_ONCE, s_on_publish_count, NULL, &counts[filter_count]));
+        aws_string_destroy(filter);
+        ++filter_count;
+    }
+
+    for (size_t i = 0; i < PUBLISH_COUNT; ++i) {
+        char topic[32];
+        size_t topic_len = s_random_topic(&seed, false, topic);
+        for (size_t j = 0; j < filter_count; ++j) {
+            expected_counts[j] += s_reference_topic_match(filters[j], topic);
+        }
+
+        struct aws_mqtt_packet_publish publish;
+        aws_mqtt_packet_publish_init(
+            &publish,
+            false,
+            AWS_MQTT_QOS_AT_MOST_ONCE,
+            false,
+            aws_byte_cursor_from_array(topic, topic_len),
+            1,
+            s_empty_cursor);
+        aws_mqtt_topic_tree_publish(&tree, &publish);
+    }
+
+    for (size_t i = 0; i < filter_count; ++i) {
+        ASSERT_UINT_EQUALS(expected_counts[i], counts[i], "filter %s", filters[i]);
+    }
+
+    aws_mqtt_topic_tree_clean_up(&tree);
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(mqtt_topic_tree_dispatch_cache, s_mqtt_topic_tree_dispatch_cache_fn)
+static int s_mqtt_topic_tree_dispatch_cache_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    /* More topics than the cache holds, so that entries get evicted as well as hit */
+    enum { FILTER_COUNT = 64, TOPIC_COUNT = 8, CACHE_SIZE = 4, PUBLISH_COUNT = 512, REMOVE_EVERY = 50 };
+    char filters[FILTER_COUNT][32];
+    bool is_removed[FILTER_COUNT];
+    size_t filter_count = 0;
+    size_t counts[FILTER_COUNT];
+    size_t expected_counts[FILTER_COUNT];
+    char topics[TOPIC_COUNT][32];
+    AWS_ZERO_ARRAY(is_removed);
+    AWS_ZERO_ARRAY(counts);
+    AWS_ZERO_ARRAY(expected_counts);
+
+    struct aws_mqtt_topic_tree tree;
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_init(&tree, allocator));
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_set_dispatch_cache_size(&tree, CACHE_SIZE));
+
+    uint32_t seed = 7;
+    for (size_t i = 0; i < FILTER_COUNT; ++i) {
+        s_random_topic(&seed, true, filters[filter_count]);
+
+        bool is_duplicate = false;
+        for (size_t j = 0; j < filter_count; ++j) {
+            is_duplicate |= strcmp(filters[j], filters[filter_count]) == 0;
+        }
+        if (is_duplicate) {
+            continue;
+        }
+
+        struct aws_string *filter = aws_string_new_from_c_str(allocator, filters[filter_count]);
+        ASSERT_SUCCESS(aws_mqtt_topic_tree_insert(
+            &tree, filter, AWS_MQTT_QOS_AT_MOST_ONCE, s_on_publish_count, NULL, &counts[filter_count]));
+        aws_string_destroy(filter);
+        ++filter_count;
+    }
+
+    for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        s_random_topic(&seed, false, topics[i]);
+    }
+
+    for (size_t i = 0; i < PUBLISH_COUNT; ++i) {
+        /* Cached subscriptions must not outlive an unsubscribe, so remove one that some topic matches */
+        if (i % REMOVE_EVERY == REMOVE_EVERY - 1) {
+            for (size_t j = 0; j < filter_count; ++j) {
+                if (!is_removed[j] && s_reference_topic_match(filters[j], topics[i % TOPIC_COUNT])) {
+                    struct aws_byte_cursor filter = aws_byte_cursor_from_c_str(filters[j]);
+                    ASSERT_SUCCESS(aws_mqtt_topic_tree_remove(&tree, &filter));
+                    is_removed[j] = true;
+                    break;
+                }
+            }
+        }
+
+        const char *topic = topics[((seed = seed * 1103515245 + 12345) >> 16) % TOPIC_COUNT];
+        for (size_t j = 0; j < filter_count; ++j) {
+            expected_counts[j] += !is_removed[j] && s_reference_topic_match(filters[j], topic);
+        }
+
+        struct aws_mqtt_packet_publish publish;
+        aws_mqtt_packet_publish_init(
+            &publish,
+            false,
+            AWS_MQTT_QOS_AT_MOST_ONCE,
+            false,
+            aws_byte_cursor_from_c_str(topic),
+            1,
+            s_empty_cursor);
+        aws_mqtt_topic_tree_publish(&tree, &publish);
+    }
+
+    for (size_t i = 0; i < filter_count; ++i) {
+        ASSERT_UINT_EQUALS(expected_counts[i], counts[i], "filter %s", filters[i]);
+    }
+
+    /* Disabling the cache leaves dispatch working */
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_set_dispatch_cache_size(&tree, 0));
+    ASSERT_NULL(tree.dispatch_cache);
+
+    aws_mqtt_topic_tree_clean_up(&tree);
+    return AWS_OP_SUCCESS;
+}
+
+/* Enough publishes in a row for a stale matcher to be rebuilt, so that both it and the tree walk are checked */
+enum { SETTLED_PUBLISH_COUNT = 128 };
+
+static void s_publish_until_settled(struct aws_mqtt_topic_tree *tree, struct aws_mqtt_packet_publish *publish) {
+    for (size_t i = 0; i < SETTLED_PUBLISH_COUNT; ++i) {
+        aws_mqtt_topic_tree_publish(tree, publish);
+    }
+}
+
+AWS_TEST_CASE(mqtt_topic_tree_match_after_change, s_mqtt_topic_tree_match_after_change_fn)
+static int s_mqtt_topic_tree_match_after_change_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_mqtt_topic_tree tree;
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_init(&tree, allocator));
+
+    struct aws_mqtt_packet_publish publish;
+    aws_mqtt_packet_publish_init(&publish, false, AWS_MQTT_QOS_AT_MOST_ONCE, false, s_topic_a_a_a, 1, s_empty_cursor);
+
+    /* Publishing on an empty tree matches nothing */
+    times_called = 0;
+    aws_mqtt_topic_tree_publish(&tree, &publish);
+    ASSERT_INT_EQUALS(0, times_called);
+
+    /* Subscriptions made after a publish are seen by the next one */
+    struct aws_string *topic_a_a_a = aws_string_new_from_array(allocator, s_topic_a_a_a.ptr, s_topic_a_a_a.len);
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_insert(
+        &tree, topic_a_a_a, AWS_MQTT_QOS_AT_MOST_ONCE, &on_publish, s_string_clean_up, topic_a_a_a));
+    struct aws_string *topic_a_plus_a = aws_string_new_from_c_str(allocator, "a/+/a");
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_insert(
+        &tree, topic_a_plus_a, AWS_MQTT_QOS_AT_MOST_ONCE, &on_publish, s_string_clean_up, topic_a_plus_a));
+
+    times_called = 0;
+    s_publish_until_settled(&tree, &publish);
+    ASSERT_INT_EQUALS(2 * SETTLED_PUBLISH_COUNT, times_called);
+
+    /* And so are removals */
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_remove(&tree, &s_topic_a_a_a));
+
+    times_called = 0;
+    s_publish_until_settled(&tree, &publish);
+    ASSERT_INT_EQUALS(SETTLED_PUBLISH_COUNT, times_called);
+
+    /* Topics deeper than the matcher keeps on the stack */
+    char deep_topic[128] = "a";
+    for (size_t i = 1; i < 40; ++i) {
+        strcat(deep_topic, "/a");
+    }
+    struct aws_string *deep_filter = aws_string_new_from_c_str(allocator, deep_topic);
+    ASSERT_SUCCESS(aws_mqtt_topic_tree_insert(
+        &tree, deep_filter, AWS_MQTT_QOS_AT_MOST_ONCE, &on_publish, s_string_clean_up, deep_filter));
+
+    publish.topic_name = aws_byte_cursor_from_c_str(deep_topic);
+    times_called = 0;
+    s_publish_until_settled(&tree, &publish);
+    ASSERT_INT_EQUALS(SETTLED_PUBLISH_COUNT, times_called);
+
+    aws_mqtt_topic_tree_clean_up(&tree);
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(mqtt_topic_validation, s_mqtt_topic_validation_fn)
 static int s_mqtt_topic_validation_fn(struct aws_allocator *allocator, void *ctx) {
     (void)allocator;
@@ -325,3 +599,47 @@ static int s_mqtt_topic_validation_fn(struct aws_allocator *allocator, void *ctx
 
     return AWS_OP_SUCCESS;
 }
+
+AWS_TEST_CASE(mqtt_topic_validation_levels, s_mqtt_topic_validation_levels_fn)
+static int s_mqtt_topic_validation_levels_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    uint16_t level_offsets[4];
+    size_t level_count = 0;
+
+    /* Long enough for level names to be skipped 8 bytes at a time */
+    struct aws_byte_cursor topic = aws_byte_cursor_from_c_str("sensors/building-one/floor-two/temperature");
+    ASSERT_TRUE(aws_mqtt_validate_topic_levels(&topic, false, level_offsets, 4, &level_count));
+    ASSERT_UINT_EQUALS(4, level_count);
+    ASSERT_UINT_EQUALS(0, level_offsets[0]);
+    ASSERT_UINT_EQUALS(8, level_offsets[1]);
+    ASSERT_UINT_EQUALS(21, level_offsets[2]);
+    ASSERT_UINT_EQUALS(31, level_offsets[3]);
+
+    /* Levels past max_levels are counted, not stored */
+    topic = aws_byte_cursor_from_c_str("a//b/c/d/");
+    ASSERT_TRUE(aws_mqtt_validate_topic_levels(&topic, false, level_offsets, 2, &level_count));
+    ASSERT_UINT_EQUALS(6, level_count);
+    ASSERT_UINT_EQUALS(0, level_offsets[0]);
+    ASSERT_UINT_EQUALS(2, level_offsets[1]);
+
+    /* Wildcards are only allowed in filters, alone in their level, and # only last */
+    topic = aws_byte_cursor_from_c_str("sensors/+/floor-two/#");
+    ASSERT_TRUE(aws_mqtt_validate_topic_levels(&topic, true, NULL, 0, NULL));
+    ASSERT_FALSE(aws_mqtt_validate_topic_levels(&topic, false, NULL, 0, NULL));
+    topic = aws_byte_cursor_from_c_str("sensors/+building-one/floor-two");
+    ASSERT_FALSE(aws_mqtt_validate_topic_levels(&topic, true, NULL, 0, NULL));
+    topic = aws_byte_cursor_from_c_str("sensors/building-one+/floor-two");
+    ASSERT_FALSE(aws_mqtt_validate_topic_levels(&topic, true, NULL, 0, NULL));
+    topic = aws_byte_cursor_from_c_str("sensors/#/floor-two");
+    ASSERT_FALSE(aws_mqtt_validate_topic_levels(&topic, true, NULL, 0, NULL));
+
+    /* No null character anywhere, including in the middle of a long level name */
+    uint8_t with_null[] = "sensors/building-one/floor-two";
+    with_null[12] = 0;
+    topic = aws_byte_cursor_from_array(with_null, sizeof(with_null) - 1);
+    ASSERT_FALSE(aws_mqtt_validate_topic_levels(&topic, true, NULL, 0, NULL));
+
+    return AWS_OP_SUCCESS;
+}